@@ -31,6 +31,9 @@
 
 #include "gpm-array-float.h"
 
+#define GPM_ARRAY_FLOAT_CHUNK_LENGTH	4096 /* values for each thread at a time */
+#define GPM_FILTER_PIPELINE_PARALLEL_LENGTH	(4 * GPM_ARRAY_FLOAT_CHUNK_LENGTH)
+
 /**
  * gpm_array_float_guassian_value:
  *
@@ -57,8 +60,7 @@ gpm_array_float_new (guint length)
 {
 	guint i;
 	GpmArrayFloat *array;
-	array = g_array_sized_new (TRUE, FALSE, sizeof(gfloat), length);
-	array->len = length;
+	array = gpm_array_float_new_uninitialised (length);
 
 	/* clear to 0.0 */
 	for (i=0; i<length; i++)
@@ -66,6 +68,62 @@ gpm_array_float_new (guint length)
 	return array;
 }
 
+/**
+ * gpm_array_float_new_uninitialised:
+ *
+ * @length: length of array
+ * Return value: Allocate array
+ *
+ * Creates a new size array without clearing it, for when every value is
+ * going to be set anyway. Free with g_array_free();
+ **/
+GpmArrayFloat *
+gpm_array_float_new_uninitialised (guint length)
+{
+	GpmArrayFloat *array;
+	array = g_array_sized_new (TRUE, FALSE, sizeof(gfloat), length);
+	array->len = length;
+	return array;
+}
+
+/**
+ * gpm_array_float_ring_new:
+ *
+ * Gets somewhere to keep the last @length values of an array that is being
+ * written over, which is nearly always small enough for @stack.
+ **/
+static gfloat *
+gpm_array_float_ring_new (gfloat *stack, guint stack_length, guint length)
+{
+	if (length <= stack_length)
+		return stack;
+	return g_new (gfloat, length);
+}
+
+/**
+ * gpm_array_float_ring_free:
+ **/
+static void
+gpm_array_float_ring_free (gfloat *stack, gfloat *ring)
+{
+	if (ring != stack)
+		g_free (ring);
+}
+
+/**
+ * gpm_array_float_ring_get:
+ *
+ * Gets the value that was at @j before @i was written, from the ring if
+ * the array is being written over.
+ **/
+static inline gfloat
+gpm_array_float_ring_get (GpmArrayFloat *data, const gfloat *ring, guint length_ring, guint i, guint j)
+{
+	if (ring != NULL && j < i)
+		return ring[j % length_ring];
+	return g_array_index (data, gfloat, j);
+}
+
 /**
  * gpm_array_float_get:
  *
@@ -143,7 +201,7 @@ gpm_array_float_compute_gaussian (guint length, gfloat sigma)
 
 	g_return_val_if_fail (length % 2 == 1, NULL);
 
-	array = gpm_array_float_new (length);
+	array = gpm_array_float_new_uninitialised (length);
 
 	/* array positions 0..length, has to be an odd number */
 	half_length = (length / 2) + 1;
@@ -223,32 +281,236 @@ gpm_array_float_print (GpmArrayFloat *array)
 GpmArrayFloat *
 gpm_array_float_convolve (GpmArrayFloat *data, GpmArrayFloat *kernel)
 {
-	gint length_data;
-	gint length_kernel;
-	GpmArrayFloat *result;
-	gfloat value;
-	gint i;
+	return gpm_array_float_convolve_into (data, kernel, gpm_array_float_new_uninitialised (data->len));
+}
+
+/**
+ * gpm_array_float_convolve_value:
+ *
+ * Convolves the kernel with the values around @i, repeating the values at
+ * @start and @end - 1 past the ends. Both the serial and the parallel
+ * convolve use this, so they add up in the same order and give exactly
+ * the same result.
+ **/
+static inline gfloat
+gpm_array_float_convolve_value (GpmArrayFloat *data, const gfloat *ring, gint length_ring,
+				GpmArrayFloat *kernel, gint i, gint start, gint end)
+{
+	gint length_kernel = kernel->len;
+	gfloat value = 0;
 	gint j;
 	gint idx;
 
-	length_data = data->len;
-	length_kernel = kernel->len;
+	for (j=0;j<length_kernel;j++) {
+		idx = i+j-(length_kernel/2);
+		if (idx < start)
+			idx = start;
+		else if (idx >= end)
+			idx = end - 1;
+		value += gpm_array_float_ring_get (data, ring, length_ring, i, idx) * g_array_index (kernel, gfloat, j);
+	}
+	return value;
+}
+
+/**
+ * gpm_array_float_convolve_range:
+ * @start: the first value to convolve
+ * @end: the value after the last, as the values past either end are
+ * taken to be the same as the ones at the ends
+ * @from: the first value to write, as the ones before are still right
+ * from last time, which has to be @start in place
+ * @result: array for the output, which is already at least @end long
+ **/
+static void
+gpm_array_float_convolve_range (GpmArrayFloat *data, GpmArrayFloat *kernel,
+				guint start, guint end, guint from, GpmArrayFloat *result)
+{
+	gint length_ring = 0;
+	gfloat ring_stack[32];
+	gfloat *ring = NULL;
+	gfloat value;
+	gint i;
 
-	result = gpm_array_float_new (length_data);
+	/* in place, the values before i have already been replaced */
+	if (result == data) {
+		length_ring = kernel->len / 2 + 1;
+		ring = gpm_array_float_ring_new (ring_stack, G_N_ELEMENTS (ring_stack), length_ring);
+	}
 
 	/* convolve */
-	for (i=0;i<length_data;i++) {
-		value = 0;
-		for (j=0;j<length_kernel;j++) {
-			idx = i+j-(length_kernel/2);
-			if (idx < 0)
-				idx = 0;
-			else if (idx >= length_data)
-				idx = length_data - 1;
-			value += g_array_index (data, gfloat, idx) * g_array_index (kernel, gfloat, j);
-		}
+	for (i=MAX(start,from);i<(gint)end;i++) {
+		value = gpm_array_float_convolve_value (data, ring, length_ring, kernel, i, start, end);
+		if (ring != NULL)
+			ring[i % length_ring] = g_array_index (data, gfloat, i);
 		g_array_index (result, gfloat, i) = value;
 	}
+
+	if (ring != NULL)
+		gpm_array_float_ring_free (ring_stack, ring);
+}
+
+/**
+ * gpm_array_float_convolve_into:
+ *
+ * @data: input array
+ * @kernel: kernel array
+ * @result: array for the output, which is set to the same length as data
+ * Return value: @result, so the operations can be chained
+ *
+ * Like gpm_array_float_convolve() but reuses an existing array, which can
+ * be @data to convolve in place.
+ **/
+GpmArrayFloat *
+gpm_array_float_convolve_into (GpmArrayFloat *data, GpmArrayFloat *kernel, GpmArrayFloat *result)
+{
+	g_return_val_if_fail (data != NULL, NULL);
+	g_return_val_if_fail (kernel != NULL, NULL);
+	g_return_val_if_fail (result != NULL, NULL);
+
+	if (result != data)
+		g_array_set_size (result, data->len);
+	gpm_array_float_convolve_range (data, kernel, 0, data->len, 0, result);
+	return result;
+}
+
+/* The output is split into chunks that each thread takes the next of until
+ * there are none left, so a thread that is held up just does fewer. Each
+ * chunk reads up to the kernel radius either side of it from @data, which
+ * nothing writes to, so the chunks don't depend on each other. */
+typedef struct {
+	GpmArrayFloat		*data;
+	GpmArrayFloat		*kernel;
+	GpmArrayFloat		*result;
+	gint			 next_chunk; /* atomic */
+	gint			 n_chunks;
+	guint			 pending; /* helper threads still running */
+	GMutex			 mutex;
+	GCond			 cond;
+} GpmArrayFloatConvolveJob;
+
+/**
+ * gpm_array_float_convolve_chunks:
+ *
+ * Convolves chunks until there are none left.
+ **/
+static void
+gpm_array_float_convolve_chunks (GpmArrayFloatConvolveJob *job)
+{
+	gint chunk;
+	gint i;
+	gint start;
+	gint end;
+	gint length_data = job->data->len;
+
+	while ((chunk = g_atomic_int_add (&job->next_chunk, 1)) < job->n_chunks) {
+		start = chunk * GPM_ARRAY_FLOAT_CHUNK_LENGTH;
+		end = MIN (start + GPM_ARRAY_FLOAT_CHUNK_LENGTH, length_data);
+		for (i=start; i<end; i++)
+			g_array_index (job->result, gfloat, i) =
+				gpm_array_float_convolve_value (job->data, NULL, 0, job->kernel, i, 0, length_data);
+	}
+}
+
+/**
+ * gpm_array_float_convolve_thread_cb:
+ **/
+static void
+gpm_array_float_convolve_thread_cb (gpointer data, gpointer user_data)
+{
+	GpmArrayFloatConvolveJob *job = (GpmArrayFloatConvolveJob *) data;
+
+	gpm_array_float_convolve_chunks (job);
+	g_mutex_lock (&job->mutex);
+	if (--job->pending == 0)
+		g_cond_signal (&job->cond);
+	g_mutex_unlock (&job->mutex);
+}
+
+/**
+ * gpm_array_float_get_pool:
+ *
+ * Return value: the threads shared by every parallel convolve, one for
+ * each CPU as the thread that asks helps too
+ **/
+static GThreadPool *
+gpm_array_float_get_pool (void)
+{
+	static gsize once = 0;
+	static GThreadPool *pool = NULL;
+	GError *error = NULL;
+
+	if (g_once_init_enter (&once)) {
+		pool = g_thread_pool_new (gpm_array_float_convolve_thread_cb, NULL,
+					  g_get_num_processors (), FALSE, &error);
+		if (pool == NULL) {
+			g_warning ("failed to create pool: %s", error->message);
+			g_error_free (error);
+		}
+		g_once_init_leave (&once, 1);
+	}
+	return pool;
+}
+
+/**
+ * gpm_array_float_convolve_parallel_into:
+ *
+ * @data: input array
+ * @kernel: kernel array
+ * @n_threads: the most threads to use, or 0 for one for each CPU
+ * @result: array for the output, which must not be @data
+ * Return value: @result, so the operations can be chained
+ *
+ * Like gpm_array_float_convolve_into(), but shares the work between
+ * threads, which is worth it for tens of thousands of values. The result
+ * is exactly the same as convolving with one thread.
+ **/
+GpmArrayFloat *
+gpm_array_float_convolve_parallel_into (GpmArrayFloat *data, GpmArrayFloat *kernel,
+					guint n_threads, GpmArrayFloat *result)
+{
+	GpmArrayFloatConvolveJob job;
+	GThreadPool *pool;
+	guint i;
+
+	g_return_val_if_fail (data != NULL, NULL);
+	g_return_val_if_fail (kernel != NULL, NULL);
+	g_return_val_if_fail (result != NULL, NULL);
+	g_return_val_if_fail (result != data, NULL);
+
+	if (n_threads == 0)
+		n_threads = g_get_num_processors ();
+
+	job.data = data;
+	job.kernel = kernel;
+	job.result = result;
+	job.next_chunk = 0;
+	job.n_chunks = (data->len + GPM_ARRAY_FLOAT_CHUNK_LENGTH - 1) / GPM_ARRAY_FLOAT_CHUNK_LENGTH;
+	job.pending = 0;
+	g_array_set_size (result, data->len);
+
+	/* not enough to share */
+	n_threads = MIN (n_threads, (guint) job.n_chunks);
+	pool = gpm_array_float_get_pool ();
+	if (n_threads <= 1 || pool == NULL) {
+		gpm_array_float_convolve_chunks (&job);
+		return result;
+	}
+
+	/* this thread does some of the chunks too */
+	g_mutex_init (&job.mutex);
+	g_cond_init (&job.cond);
+	job.pending = n_threads - 1;
+	for (i=1; i<n_threads; i++)
+		g_thread_pool_push (pool, &job, NULL);
+	gpm_array_float_convolve_chunks (&job);
+
+	/* the job is on our stack */
+	g_mutex_lock (&job.mutex);
+	while (job.pending > 0)
+		g_cond_wait (&job.cond, &job.mutex);
+	g_mutex_unlock (&job.mutex);
+	g_mutex_clear (&job.mutex);
+	g_cond_clear (&job.cond);
 	return result;
 }
 
@@ -303,41 +565,68 @@ powfi (gfloat base, guint n)
  **/
 GpmArrayFloat *
 gpm_array_float_remove_outliers (GpmArrayFloat *data, guint length, gfloat sigma)
+{
+	g_return_val_if_fail (length % 2 == 1, NULL);
+	return gpm_array_float_remove_outliers_into (data, length, sigma,
+						     gpm_array_float_new_uninitialised (data->len));
+}
+
+/**
+ * gpm_array_float_remove_outliers_range:
+ * @start: the first value to look at
+ * @end: the value after the last
+ * @from: the first value to write, which has to be @start in place
+ * @result: array for the output, which is already at least @end long
+ **/
+static void
+gpm_array_float_remove_outliers_range (GpmArrayFloat *data, guint length, gfloat sigma,
+				       guint start, guint end, guint from, GpmArrayFloat *result)
 {
 	guint i;
 	guint j;
 	guint half_length;
+	guint length_ring = 0;
+	gfloat ring_stack[32];
+	gfloat *ring = NULL;
 	gfloat value;
 	gfloat average;
 	gfloat average_not_inc;
+	gfloat new_value;
 	gfloat average_square;
 	gfloat biggest_difference;
 	gfloat outlier_value;
-	GpmArrayFloat *result;
-
-	g_return_val_if_fail (length % 2 == 1, NULL);
-	result = gpm_array_float_new (data->len);
-
-	/* check for no data */
-	if (data->len == 0)
-		goto out;
 
 	half_length = (length - 1) / 2;
 
-	/* copy start and end of array */
-	for (i=0; i < half_length; i++)
-		g_array_index (result, gfloat, i) = g_array_index (data, gfloat, i);
-	for (i=data->len-half_length; i < data->len; i++)
-		g_array_index (result, gfloat, i) = g_array_index (data, gfloat, i);
+	/* too short to have a whole window, so nothing is changed */
+	if (end - start <= 2 * half_length) {
+		for (i=MAX(start,from); result != data && i < end; i++)
+			g_array_index (result, gfloat, i) = g_array_index (data, gfloat, i);
+		return;
+	}
+
+	/* in place, the values before i have already been replaced */
+	if (result == data) {
+		length_ring = half_length + 1;
+		ring = gpm_array_float_ring_new (ring_stack, G_N_ELEMENTS (ring_stack), length_ring);
+		for (i=start; i < start+half_length; i++)
+			ring[i % length_ring] = g_array_index (data, gfloat, i);
+	} else {
+		/* copy start and end of array */
+		for (i=MAX(start,from); i < start+half_length; i++)
+			g_array_index (result, gfloat, i) = g_array_index (data, gfloat, i);
+		for (i=MAX(end-half_length,from); i < end; i++)
+			g_array_index (result, gfloat, i) = g_array_index (data, gfloat, i);
+	}
 
 	/* find the standard deviation of a block off data */
-	for (i=half_length; i < data->len-half_length; i++) {
+	for (i=MAX(start+half_length,from); i < end-half_length; i++) {
 		average = 0;
 		average_square = 0;
 
 		/* find the average and the squared average */
 		for (j=i-half_length; j<i+half_length+1; j++) {
-			value = g_array_index (data, gfloat, j);
+			value = gpm_array_float_ring_get (data, ring, length_ring, i, j);
 			average += value;
 			average_square += powfi (value, 2);
 		}
@@ -351,23 +640,1260 @@ gpm_array_float_remove_outliers (GpmArrayFloat *data, guint length, gfloat sigma
 
 		/* stddev is okay */
 		if (value < sigma) {
-			g_array_index (result, gfloat, i) = g_array_index (data, gfloat, i);
+			new_value = g_array_index (data, gfloat, i);
 		} else {
 			/* ignore the biggest difference from the average */
 			biggest_difference = 0;
 			outlier_value = 0;
 			for (j=i-half_length; j<i+half_length+1; j++) {
-				value = fabs (g_array_index (data, gfloat, j) - average);
+				value = fabs (gpm_array_float_ring_get (data, ring, length_ring, i, j) - average);
 				if (value > biggest_difference) {
 					biggest_difference = value;
-					outlier_value = g_array_index (data, gfloat, j);
+					outlier_value = gpm_array_float_ring_get (data, ring, length_ring, i, j);
 				}
 			}
 			average_not_inc = (average * length) - outlier_value;
 			average_not_inc /= length - 1;
-			g_array_index (result, gfloat, i) = average_not_inc;
+			new_value = average_not_inc;
 		}
+
+		/* keep the old value for the next windows */
+		if (ring != NULL)
+			ring[i % length_ring] = g_array_index (data, gfloat, i);
+		g_array_index (result, gfloat, i) = new_value;
+	}
+
+	if (ring != NULL)
+		gpm_array_float_ring_free (ring_stack, ring);
+}
+
+/**
+ * gpm_array_float_remove_outliers_into:
+ *
+ * @data: input array
+ * @length: size to analyse
+ * @sigma: sigma for standard deviation
+ * @result: array for the output, which is set to the same length as data
+ * Return value: @result, so the operations can be chained
+ *
+ * Like gpm_array_float_remove_outliers() but reuses an existing array,
+ * which can be @data to remove the outliers in place.
+ **/
+GpmArrayFloat *
+gpm_array_float_remove_outliers_into (GpmArrayFloat *data, guint length, gfloat sigma, GpmArrayFloat *result)
+{
+	g_return_val_if_fail (data != NULL, NULL);
+	g_return_val_if_fail (result != NULL, NULL);
+	g_return_val_if_fail (length % 2 == 1, NULL);
+
+	if (result != data)
+		g_array_set_size (result, data->len);
+	gpm_array_float_remove_outliers_range (data, length, sigma, 0, data->len, 0, result);
+	return result;
+}
+
+/* The running median keeps the window in a single array of heaps, with
+ * the median at 0, a max-heap of the smaller values at -1, -2, ... and a
+ * min-heap of the bigger values at 1, 2, ... so the parent of i is i/2
+ * for both. Each new value replaces the oldest in its place in the heaps
+ * and is then moved up or down, which is O(log w) rather than the O(w) of
+ * keeping the window sorted. */
+typedef struct {
+	gfloat			*values; /* the window, oldest first from idx */
+	gint			*pos; /* where each value is in the heap */
+	gint			*heap; /* the middle of the heap storage */
+	gint			 length;
+	gint			 idx;
+	gint			 count;
+} GpmArrayFloatMedian;
+
+#define GPM_ARRAY_FLOAT_MEDIAN_MIN_COUNT(m)	(((m)->count - 1) / 2)
+#define GPM_ARRAY_FLOAT_MEDIAN_MAX_COUNT(m)	((m)->count / 2)
+
+/**
+ * gpm_array_float_median_less:
+ **/
+static inline gboolean
+gpm_array_float_median_less (GpmArrayFloatMedian *m, gint i, gint j)
+{
+	return m->values[m->heap[i]] < m->values[m->heap[j]];
+}
+
+/**
+ * gpm_array_float_median_swap:
+ *
+ * Swaps the heap entries if @i is less than @j.
+ *
+ * Return value: %TRUE if they were swapped
+ **/
+static inline gboolean
+gpm_array_float_median_swap (GpmArrayFloatMedian *m, gint i, gint j)
+{
+	gint tmp;
+
+	if (!gpm_array_float_median_less (m, i, j))
+		return FALSE;
+	tmp = m->heap[i];
+	m->heap[i] = m->heap[j];
+	m->heap[j] = tmp;
+	m->pos[m->heap[i]] = i;
+	m->pos[m->heap[j]] = j;
+	return TRUE;
+}
+
+/**
+ * gpm_array_float_median_min_down:
+ **/
+static void
+gpm_array_float_median_min_down (GpmArrayFloatMedian *m, gint i)
+{
+	for (; i <= GPM_ARRAY_FLOAT_MEDIAN_MIN_COUNT (m); i *= 2) {
+		if (i > 1 && i < GPM_ARRAY_FLOAT_MEDIAN_MIN_COUNT (m) &&
+		    gpm_array_float_median_less (m, i + 1, i))
+			i++;
+		if (!gpm_array_float_median_swap (m, i, i / 2))
+			break;
+	}
+}
+
+/**
+ * gpm_array_float_median_max_down:
+ **/
+static void
+gpm_array_float_median_max_down (GpmArrayFloatMedian *m, gint i)
+{
+	for (; i >= -GPM_ARRAY_FLOAT_MEDIAN_MAX_COUNT (m); i *= 2) {
+		if (i < -1 && i > -GPM_ARRAY_FLOAT_MEDIAN_MAX_COUNT (m) &&
+		    gpm_array_float_median_less (m, i, i - 1))
+			i--;
+		if (!gpm_array_float_median_swap (m, i / 2, i))
+			break;
+	}
+}
+
+/**
+ * gpm_array_float_median_min_up:
+ *
+ * Return value: %TRUE if the value got to the median
+ **/
+static gboolean
+gpm_array_float_median_min_up (GpmArrayFloatMedian *m, gint i)
+{
+	while (i > 0 && gpm_array_float_median_swap (m, i, i / 2))
+		i /= 2;
+	return i == 0;
+}
+
+/**
+ * gpm_array_float_median_max_up:
+ *
+ * Return value: %TRUE if the value got to the median
+ **/
+static gboolean
+gpm_array_float_median_max_up (GpmArrayFloatMedian *m, gint i)
+{
+	while (i < 0 && gpm_array_float_median_swap (m, i / 2, i))
+		i /= 2;
+	return i == 0;
+}
+
+/**
+ * gpm_array_float_median_init:
+ * @storage: space for @length floats and 2 * @length ints
+ **/
+static void
+gpm_array_float_median_init (GpmArrayFloatMedian *m, gpointer storage, gint length)
+{
+	gint i;
+
+	m->values = storage;
+	m->pos = (gint *) (m->values + length);
+	m->heap = m->pos + length + length / 2;
+	m->length = length;
+	m->idx = 0;
+	m->count = 0;
+
+	/* alternate between the heaps, so they fill evenly */
+	for (i=length-1; i>=0; i--) {
+		m->pos[i] = ((i + 1) / 2) * ((i & 1) ? -1 : 1);
+		m->heap[m->pos[i]] = i;
+	}
+}
+
+/**
+ * gpm_array_float_median_insert:
+ *
+ * Adds a value, dropping the oldest once the window is full.
+ **/
+static void
+gpm_array_float_median_insert (GpmArrayFloatMedian *m, gfloat value)
+{
+	gboolean is_new;
+	gfloat old;
+	gint p;
+
+	is_new = m->count < m->length;
+	p = m->pos[m->idx];
+	old = m->values[m->idx];
+	m->values[m->idx] = value;
+	m->idx = (m->idx + 1) % m->length;
+	if (is_new)
+		m->count++;
+
+	if (p > 0) {
+		/* in the min-heap */
+		if (!is_new && old < value)
+			gpm_array_float_median_min_down (m, p * 2);
+		else if (gpm_array_float_median_min_up (m, p))
+			gpm_array_float_median_max_down (m, -1);
+	} else if (p < 0) {
+		/* in the max-heap */
+		if (!is_new && value < old)
+			gpm_array_float_median_max_down (m, p * 2);
+		else if (gpm_array_float_median_max_up (m, p))
+			gpm_array_float_median_min_down (m, 1);
+	} else {
+		/* replaced the median */
+		if (GPM_ARRAY_FLOAT_MEDIAN_MAX_COUNT (m) > 0)
+			gpm_array_float_median_max_down (m, -1);
+		if (GPM_ARRAY_FLOAT_MEDIAN_MIN_COUNT (m) > 0)
+			gpm_array_float_median_min_down (m, 1);
+	}
+}
+
+/**
+ * gpm_array_float_median_range:
+ * @start: the first value to filter
+ * @end: the value after the last
+ * @from: the first value to write
+ * @result: array for the output, which is already at least @end long
+ **/
+static void
+gpm_array_float_median_range (GpmArrayFloat *data, guint length, guint start, guint end,
+			      guint from, GpmArrayFloat *result)
+{
+	GpmArrayFloatMedian m;
+	gint half_length;
+	gint32 storage_stack[3 * 64];
+	gpointer storage;
+	gint i;
+
+	from = MAX (start, from);
+	if (from >= end)
+		return;
+	half_length = length / 2;
+
+	storage = storage_stack;
+	if (length > 64)
+		storage = g_new (gint32, 3 * length);
+	gpm_array_float_median_init (&m, storage, length);
+
+	/* the window around the first value */
+	for (i=(gint)from-half_length; i<(gint)from+half_length; i++)
+		gpm_array_float_median_insert (&m, g_array_index (data, gfloat, CLAMP (i, (gint) start, (gint) end - 1)));
+
+	/* the window keeps its own copy, and only looks ahead of i, so this
+	 * works in place */
+	for (i=from; i<(gint)end; i++) {
+		gpm_array_float_median_insert (&m, g_array_index (data, gfloat, MIN (i + half_length, (gint) end - 1)));
+		g_array_index (result, gfloat, i) = m.values[m.heap[0]];
+	}
+
+	if (storage != storage_stack)
+		g_free (storage);
+}
+
+/**
+ * gpm_array_float_median_into:
+ *
+ * @data: input array
+ * @length: size of the window, which has to be an odd number
+ * @result: array for the output, which can be @data
+ * Return value: @result, so the operations can be chained
+ *
+ * Replaces each value with the median of the window around it, repeating
+ * the first and last values past the ends like gpm_array_float_convolve().
+ * Unlike gpm_array_float_remove_outliers() this removes bursts of up to
+ * half the window, and it takes O(n log @length).
+ **/
+GpmArrayFloat *
+gpm_array_float_median_into (GpmArrayFloat *data, guint length, GpmArrayFloat *result)
+{
+	g_return_val_if_fail (data != NULL, NULL);
+	g_return_val_if_fail (result != NULL, NULL);
+	g_return_val_if_fail (length % 2 == 1, NULL);
+
+	if (result != data)
+		g_array_set_size (result, data->len);
+	gpm_array_float_median_range (data, length, 0, data->len, 0, result);
+	return result;
+}
+
+/**
+ * gpm_array_float_ema_range:
+ * @start: the first value, which the average starts at
+ * @end: the value after the last
+ * @from: the first value to write, carrying on from the output before it
+ * @result: array for the output, which is already at least @end long
+ **/
+static void
+gpm_array_float_ema_range (GpmArrayFloat *data, gfloat alpha, guint start, guint end,
+			   guint from, GpmArrayFloat *result)
+{
+	guint i;
+	gfloat value;
+
+	from = MAX (start, from);
+	if (from >= end)
+		return;
+	if (from == start)
+		value = g_array_index (data, gfloat, start);
+	else
+		value = g_array_index (result, gfloat, from - 1);
+	for (i=from; i<end; i++) {
+		value += alpha * (g_array_index (data, gfloat, i) - value);
+		g_array_index (result, gfloat, i) = value;
+	}
+}
+
+/**
+ * gpm_array_float_ema_into:
+ *
+ * @data: input array
+ * @alpha: how much of each new value to use, from 0 to 1
+ * @result: array for the output, which can be @data
+ * Return value: @result, so the operations can be chained
+ *
+ * Computes the exponential moving average, starting at the first value.
+ **/
+GpmArrayFloat *
+gpm_array_float_ema_into (GpmArrayFloat *data, gfloat alpha, GpmArrayFloat *result)
+{
+	g_return_val_if_fail (data != NULL, NULL);
+	g_return_val_if_fail (result != NULL, NULL);
+	g_return_val_if_fail (alpha > 0.0f && alpha <= 1.0f, NULL);
+
+	if (result != data)
+		g_array_set_size (result, data->len);
+	gpm_array_float_ema_range (data, alpha, 0, data->len, 0, result);
+	return result;
+}
+
+/**
+ * gpm_array_float_resample_into:
+ *
+ * @data: input array
+ * @length: the number of values wanted
+ * @result: array for the output, which must not be @data
+ * Return value: @result, so the operations can be chained
+ *
+ * Resamples the data to @length values spaced evenly from the first to
+ * the last, using linear interpolation.
+ **/
+GpmArrayFloat *
+gpm_array_float_resample_into (GpmArrayFloat *data, guint length, GpmArrayFloat *result)
+{
+	guint i;
+	guint idx;
+	gfloat pos;
+	gfloat step = 0.0f;
+
+	g_return_val_if_fail (data != NULL, NULL);
+	g_return_val_if_fail (result != NULL, NULL);
+	g_return_val_if_fail (result != data, NULL);
+
+	/* nothing to interpolate from */
+	if (data->len == 0) {
+		g_array_set_size (result, 0);
+		return result;
+	}
+
+	g_array_set_size (result, length);
+	if (length > 1)
+		step = (gfloat) (data->len - 1) / (gfloat) (length - 1);
+	for (i=0; i<length; i++) {
+		pos = i * step;
+		idx = (guint) pos;
+		if (idx >= data->len - 1) {
+			g_array_index (result, gfloat, i) = g_array_index (data, gfloat, data->len - 1);
+			continue;
+		}
+		pos -= idx;
+		g_array_index (result, gfloat, i) = g_array_index (data, gfloat, idx) * (1.0f - pos) +
+						    g_array_index (data, gfloat, idx + 1) * pos;
+	}
+	return result;
+}
+
+/**
+ * gpm_array_float_smooth_time_into:
+ *
+ * @data: input array
+ * @times: the time of each value, in order
+ * @tau: how quickly the weight falls off with the time between values
+ * @gap: values further apart than this are never mixed, e.g. a suspend
+ * @weights: array for the working, which is set to the same length as data
+ * @result: array for the output, which must not be @data
+ * Return value: @result, so the operations can be chained
+ *
+ * Replaces each value with the average of all the values, weighted by
+ * exp(-|dt|/tau) so that samples that are close in time count for more
+ * however irregularly they were taken. The weighted sums of the values
+ * before and after each point are kept as they go along, which makes this
+ * O(n) for any @tau rather than needing a window of points.
+ **/
+GpmArrayFloat *
+gpm_array_float_smooth_time_into (GpmArrayFloat *data, GpmArrayFloat *times, gfloat tau, gfloat gap,
+				  GpmArrayFloat *weights, GpmArrayFloat *result)
+{
+	guint i;
+	guint length;
+	gfloat decay;
+	gfloat dt;
+	gfloat sum;
+	gfloat weight;
+
+	g_return_val_if_fail (data != NULL, NULL);
+	g_return_val_if_fail (times != NULL, NULL);
+	g_return_val_if_fail (weights != NULL, NULL);
+	g_return_val_if_fail (result != NULL, NULL);
+	g_return_val_if_fail (result != data && weights != data && weights != result, NULL);
+	g_return_val_if_fail (times->len == data->len, NULL);
+	g_return_val_if_fail (tau > 0.0f, NULL);
+
+	length = data->len;
+	g_array_set_size (result, length);
+	g_array_set_size (weights, length);
+
+	/* the values up to and including each point */
+	sum = 0.0f;
+	weight = 0.0f;
+	for (i=0; i<length; i++) {
+		decay = 0.0f;
+		if (i > 0) {
+			dt = g_array_index (times, gfloat, i) - g_array_index (times, gfloat, i - 1);
+			if (dt <= gap)
+				decay = expf (-dt / tau);
+		}
+		sum = g_array_index (data, gfloat, i) + decay * sum;
+		weight = 1.0f + decay * weight;
+		g_array_index (result, gfloat, i) = sum;
+		g_array_index (weights, gfloat, i) = weight;
+	}
+
+	/* add the values after each point, going backwards */
+	sum = 0.0f;
+	weight = 0.0f;
+	for (i=length; i>0; i--) {
+		g_array_index (result, gfloat, i - 1) = (g_array_index (result, gfloat, i - 1) + sum) /
+							 (g_array_index (weights, gfloat, i - 1) + weight);
+		if (i == 1)
+			break;
+		decay = 0.0f;
+		dt = g_array_index (times, gfloat, i - 1) - g_array_index (times, gfloat, i - 2);
+		if (dt <= gap)
+			decay = expf (-dt / tau);
+		sum = decay * (g_array_index (data, gfloat, i - 1) + sum);
+		weight = decay * (1.0f + weight);
+	}
+	return result;
+}
+
+typedef enum {
+	GPM_FILTER_PIPELINE_OUTLIERS,
+	GPM_FILTER_PIPELINE_GAUSSIAN,
+	GPM_FILTER_PIPELINE_MEDIAN,
+	GPM_FILTER_PIPELINE_EMA,
+	GPM_FILTER_PIPELINE_RESAMPLE,
+	GPM_FILTER_PIPELINE_TIME,
+	GPM_FILTER_PIPELINE_SEGMENTS
+} GpmFilterPipelineKind;
+
+typedef struct {
+	GpmFilterPipelineKind	 kind;
+	guint			 length;
+	gfloat			 value; /* sigma, alpha or tau */
+	gfloat			 gap;
+	GpmArrayFloat		*kernel;
+} GpmFilterPipelineStage;
+
+/* The stages are run one after the other over the same buffer, which is
+ * kept between runs and only grows, so smoothing the same amount of data
+ * again allocates nothing. The data shown is at most a few thousand points
+ * so the buffer stays in the cache from one stage to the next; only a
+ * resample, smoothing by time or convolving a very long series in several
+ * threads has to write to a second buffer.
+ *
+ * After a segments stage the other stages run on each segment on its own,
+ * so nothing is smoothed across a suspend. The segments are kept as the
+ * index of the first value of each, not as copies of the data.
+ *
+ * An incremental pipeline keeps what each stage gave last time instead, and
+ * only works out again the values that are within reach of the new data,
+ * e.g. the kernel radius for a convolve. Smoothing by time and resampling
+ * depend on all the values, so everything after them is done again. */
+struct GpmFilterPipeline {
+	GArray			*stages;
+	GArray			*breaks; /* of guint, where each segment after the first starts */
+	GpmArrayFloat		*input;
+	GpmArrayFloat		*other;
+	GpmArrayFloat		*times; /* as the caller set them */
+	GpmArrayFloat		*resampled[2]; /* the times after each resample */
+	GpmArrayFloat		*spare;
+	GArray			*points; /* of GpmPointObj, for gpm_filter_pipeline_run_points() */
+	GPtrArray		*outputs; /* of GpmArrayFloat for each stage, or NULL */
+	GpmArrayFloat		*last_input;
+	GpmArrayFloat		*last_times;
+	GArray			*last_breaks; /* what the segments stage found */
+	gboolean		 last_valid;
+	GpmFilterPipelineStopFunc stop_func;
+	gpointer		 stop_data;
+};
+
+/**
+ * gpm_filter_pipeline_new:
+ *
+ * Return value: a pipeline with no stages, free with gpm_filter_pipeline_free()
+ **/
+GpmFilterPipeline *
+gpm_filter_pipeline_new (void)
+{
+	GpmFilterPipeline *pipeline;
+
+	pipeline = g_new0 (GpmFilterPipeline, 1);
+	pipeline->stages = g_array_new (FALSE, FALSE, sizeof (GpmFilterPipelineStage));
+	pipeline->breaks = g_array_new (FALSE, FALSE, sizeof (guint));
+	pipeline->input = gpm_array_float_new_uninitialised (0);
+	pipeline->other = gpm_array_float_new_uninitialised (0);
+	pipeline->times = gpm_array_float_new_uninitialised (0);
+	pipeline->resampled[0] = gpm_array_float_new_uninitialised (0);
+	pipeline->resampled[1] = gpm_array_float_new_uninitialised (0);
+	pipeline->spare = gpm_array_float_new_uninitialised (0);
+	pipeline->points = g_array_new (FALSE, FALSE, sizeof (GpmPointObj));
+	return pipeline;
+}
+
+/**
+ * gpm_filter_pipeline_free:
+ **/
+void
+gpm_filter_pipeline_free (GpmFilterPipeline *pipeline)
+{
+	GpmFilterPipelineStage *stage;
+	guint i;
+
+	if (pipeline == NULL)
+		return;
+	for (i=0; i<pipeline->stages->len; i++) {
+		stage = &g_array_index (pipeline->stages, GpmFilterPipelineStage, i);
+		gpm_array_float_free (stage->kernel);
+	}
+	g_array_free (pipeline->stages, TRUE);
+	g_array_free (pipeline->breaks, TRUE);
+	gpm_array_float_free (pipeline->input);
+	gpm_array_float_free (pipeline->other);
+	gpm_array_float_free (pipeline->times);
+	gpm_array_float_free (pipeline->resampled[0]);
+	gpm_array_float_free (pipeline->resampled[1]);
+	gpm_array_float_free (pipeline->spare);
+	g_array_free (pipeline->points, TRUE);
+	if (pipeline->outputs != NULL) {
+		g_ptr_array_unref (pipeline->outputs);
+		gpm_array_float_free (pipeline->last_input);
+		gpm_array_float_free (pipeline->last_times);
+		g_array_free (pipeline->last_breaks, TRUE);
+	}
+	g_free (pipeline);
+}
+
+/**
+ * gpm_filter_pipeline_add_stage:
+ **/
+static void
+gpm_filter_pipeline_add_stage (GpmFilterPipeline *pipeline, GpmFilterPipelineKind kind,
+			       guint length, gfloat value, GpmArrayFloat *kernel)
+{
+	GpmFilterPipelineStage stage;
+
+	stage.kind = kind;
+	stage.length = length;
+	stage.value = value;
+	stage.gap = 0.0f;
+	stage.kernel = kernel;
+	g_array_append_val (pipeline->stages, stage);
+	pipeline->last_valid = FALSE;
+}
+
+/**
+ * gpm_filter_pipeline_add_outliers:
+ * @length: the window, see gpm_array_float_remove_outliers()
+ * @sigma: the standard deviation above which the biggest outlier is removed
+ **/
+void
+gpm_filter_pipeline_add_outliers (GpmFilterPipeline *pipeline, guint length, gfloat sigma)
+{
+	g_return_if_fail (pipeline != NULL);
+	g_return_if_fail (length % 2 == 1);
+	gpm_filter_pipeline_add_stage (pipeline, GPM_FILTER_PIPELINE_OUTLIERS, length, sigma, NULL);
+}
+
+/**
+ * gpm_filter_pipeline_add_gaussian:
+ * @length: the number of points in the kernel
+ * @sigma: sigma value
+ *
+ * The kernel is worked out once, here.
+ *
+ * Return value: %FALSE if @sigma is too big for @length
+ **/
+gboolean
+gpm_filter_pipeline_add_gaussian (GpmFilterPipeline *pipeline, guint length, gfloat sigma)
+{
+	GpmArrayFloat *kernel;
+
+	g_return_val_if_fail (pipeline != NULL, FALSE);
+
+	kernel = gpm_array_float_compute_gaussian (length, sigma);
+	if (kernel == NULL)
+		return FALSE;
+	gpm_filter_pipeline_add_stage (pipeline, GPM_FILTER_PIPELINE_GAUSSIAN, length, sigma, kernel);
+	return TRUE;
+}
+
+/**
+ * gpm_filter_pipeline_add_median:
+ * @length: the window, see gpm_array_float_median_into()
+ **/
+void
+gpm_filter_pipeline_add_median (GpmFilterPipeline *pipeline, guint length)
+{
+	g_return_if_fail (pipeline != NULL);
+	g_return_if_fail (length % 2 == 1);
+	gpm_filter_pipeline_add_stage (pipeline, GPM_FILTER_PIPELINE_MEDIAN, length, 0.0f, NULL);
+}
+
+/**
+ * gpm_filter_pipeline_add_ema:
+ * @alpha: see gpm_array_float_ema_into()
+ **/
+void
+gpm_filter_pipeline_add_ema (GpmFilterPipeline *pipeline, gfloat alpha)
+{
+	g_return_if_fail (pipeline != NULL);
+	g_return_if_fail (alpha > 0.0f && alpha <= 1.0f);
+	gpm_filter_pipeline_add_stage (pipeline, GPM_FILTER_PIPELINE_EMA, 0, alpha, NULL);
+}
+
+/**
+ * gpm_filter_pipeline_add_resample:
+ * @length: the number of values after this stage
+ **/
+void
+gpm_filter_pipeline_add_resample (GpmFilterPipeline *pipeline, guint length)
+{
+	g_return_if_fail (pipeline != NULL);
+	gpm_filter_pipeline_add_stage (pipeline, GPM_FILTER_PIPELINE_RESAMPLE, length, 0.0f, NULL);
+}
+
+/**
+ * gpm_filter_pipeline_add_time:
+ * @tau: see gpm_array_float_smooth_time_into()
+ * @gap: the time between values that is never smoothed across
+ *
+ * This needs the times from gpm_filter_pipeline_get_times().
+ **/
+void
+gpm_filter_pipeline_add_time (GpmFilterPipeline *pipeline, gfloat tau, gfloat gap)
+{
+	GpmFilterPipelineStage *stage;
+
+	g_return_if_fail (pipeline != NULL);
+	g_return_if_fail (tau > 0.0f);
+	gpm_filter_pipeline_add_stage (pipeline, GPM_FILTER_PIPELINE_TIME, 0, tau, NULL);
+	stage = &g_array_index (pipeline->stages, GpmFilterPipelineStage, pipeline->stages->len - 1);
+	stage->gap = gap;
+}
+
+/**
+ * gpm_filter_pipeline_add_segments:
+ * @gap: the time between values that starts a new segment
+ *
+ * Splits the values wherever the time between them is more than @gap, and
+ * runs the stages after this on each segment separately. A resample puts
+ * the values back together again.
+ *
+ * This needs the times from gpm_filter_pipeline_get_times().
+ **/
+void
+gpm_filter_pipeline_add_segments (GpmFilterPipeline *pipeline, gfloat gap)
+{
+	g_return_if_fail (pipeline != NULL);
+	g_return_if_fail (gap > 0.0f);
+	gpm_filter_pipeline_add_stage (pipeline, GPM_FILTER_PIPELINE_SEGMENTS, 0, gap, NULL);
+}
+
+/**
+ * gpm_filter_pipeline_set_incremental:
+ * @incremental: if only the values that have changed should be smoothed
+ *
+ * Makes gpm_filter_pipeline_run() compare the values with the ones from
+ * last time, and only smooth again what the first difference can reach.
+ * This is worth it when values are added to the end, or when the same
+ * values are often smoothed again, and takes another buffer for each stage.
+ **/
+void
+gpm_filter_pipeline_set_incremental (GpmFilterPipeline *pipeline, gboolean incremental)
+{
+	g_return_if_fail (pipeline != NULL);
+
+	if (incremental == (pipeline->outputs != NULL))
+		return;
+	if (incremental) {
+		pipeline->outputs = g_ptr_array_new_with_free_func ((GDestroyNotify) gpm_array_float_free);
+		pipeline->last_input = gpm_array_float_new_uninitialised (0);
+		pipeline->last_times = gpm_array_float_new_uninitialised (0);
+		pipeline->last_breaks = g_array_new (FALSE, FALSE, sizeof (guint));
+	} else {
+		g_ptr_array_unref (pipeline->outputs);
+		gpm_array_float_free (pipeline->last_input);
+		gpm_array_float_free (pipeline->last_times);
+		g_array_free (pipeline->last_breaks, TRUE);
+		pipeline->outputs = NULL;
+		pipeline->last_input = NULL;
+		pipeline->last_times = NULL;
+		pipeline->last_breaks = NULL;
+	}
+	pipeline->last_valid = FALSE;
+}
+
+/**
+ * gpm_filter_pipeline_set_stop_func:
+ * @func: called before each stage and each segment, or %NULL
+ * @user_data: passed to @func
+ *
+ * Lets a run be given up part of the way through, e.g. when the data it is
+ * smoothing is not going to be shown. A convolve that is shared between
+ * the CPUs is not split up, so it is always finished once it has started.
+ **/
+void
+gpm_filter_pipeline_set_stop_func (GpmFilterPipeline *pipeline, GpmFilterPipelineStopFunc func, gpointer user_data)
+{
+	g_return_if_fail (pipeline != NULL);
+	pipeline->stop_func = func;
+	pipeline->stop_data = user_data;
+}
+
+/**
+ * gpm_filter_pipeline_should_stop:
+ *
+ * Return value: %TRUE if the run has to be given up, in which case the
+ * values from last time are forgotten as some stages have only been done
+ * in part
+ **/
+static gboolean
+gpm_filter_pipeline_should_stop (GpmFilterPipeline *pipeline)
+{
+	if (pipeline->stop_func == NULL)
+		return FALSE;
+	if (!pipeline->stop_func (pipeline->stop_data))
+		return FALSE;
+	pipeline->last_valid = FALSE;
+	return TRUE;
+}
+
+/**
+ * gpm_filter_pipeline_get_input:
+ * @length: the number of values that will be smoothed
+ *
+ * Gets the buffer to copy the values into before calling
+ * gpm_filter_pipeline_run(). It belongs to the pipeline and is not cleared.
+ *
+ * Return value: an array of @length values
+ **/
+GpmArrayFloat *
+gpm_filter_pipeline_get_input (GpmFilterPipeline *pipeline, guint length)
+{
+	g_return_val_if_fail (pipeline != NULL, NULL);
+	g_array_set_size (pipeline->input, length);
+	return pipeline->input;
+}
+
+/**
+ * gpm_filter_pipeline_get_times:
+ * @length: the number of values that will be smoothed
+ *
+ * Like gpm_filter_pipeline_get_input(), for the time of each value.
+ *
+ * Return value: an array of @length values
+ **/
+GpmArrayFloat *
+gpm_filter_pipeline_get_times (GpmFilterPipeline *pipeline, guint length)
+{
+	g_return_val_if_fail (pipeline != NULL, NULL);
+	g_array_set_size (pipeline->times, length);
+	return pipeline->times;
+}
+
+/**
+ * gpm_filter_pipeline_swap:
+ *
+ * Makes the output of the last stage the input of the next.
+ **/
+static GpmArrayFloat *
+gpm_filter_pipeline_swap (GpmFilterPipeline *pipeline)
+{
+	GpmArrayFloat *tmp;
+
+	tmp = pipeline->other;
+	pipeline->other = pipeline->input;
+	pipeline->input = tmp;
+	return tmp;
+}
+
+/**
+ * gpm_filter_pipeline_find_breaks:
+ * @times: the time of each value
+ * @from: the first time that is different from last time
+ *
+ * Finds where the time between values is more than @gap.
+ **/
+static void
+gpm_filter_pipeline_find_breaks (GpmFilterPipeline *pipeline, GpmArrayFloat *times, gfloat gap, guint from)
+{
+	GArray *last = pipeline->last_breaks;
+	guint i;
+
+	/* the breaks before the first new time are the same */
+	g_array_set_size (pipeline->breaks, 0);
+	for (i=0; from > 0 && i<last->len && g_array_index (last, guint, i) < from; i++)
+		g_array_append_val (pipeline->breaks, g_array_index (last, guint, i));
+
+	for (i=MAX(from,1); i<times->len; i++) {
+		if (g_array_index (times, gfloat, i) - g_array_index (times, gfloat, i - 1) > gap)
+			g_array_append_val (pipeline->breaks, i);
+	}
+
+	/* for next time */
+	if (last != NULL) {
+		g_array_set_size (last, 0);
+		g_array_append_vals (last, pipeline->breaks->data, pipeline->breaks->len);
+	}
+}
+
+/**
+ * gpm_filter_pipeline_run_segment:
+ * @start: the first value of the segment
+ * @end: the value after the last
+ * @from: the first value to work out, which has to be @start in place
+ *
+ * Runs a stage that looks at a window of values on just one segment.
+ **/
+static void
+gpm_filter_pipeline_run_segment (GpmFilterPipelineStage *stage, GpmArrayFloat *data,
+				 guint start, guint end, guint from, GpmArrayFloat *result)
+{
+	switch (stage->kind) {
+	case GPM_FILTER_PIPELINE_OUTLIERS:
+		gpm_array_float_remove_outliers_range (data, stage->length, stage->value, start, end, from, result);
+		break;
+	case GPM_FILTER_PIPELINE_GAUSSIAN:
+		gpm_array_float_convolve_range (data, stage->kernel, start, end, from, result);
+		break;
+	case GPM_FILTER_PIPELINE_MEDIAN:
+		gpm_array_float_median_range (data, stage->length, start, end, from, result);
+		break;
+	case GPM_FILTER_PIPELINE_EMA:
+		gpm_array_float_ema_range (data, stage->value, start, end, from, result);
+		break;
+	default:
+		g_assert_not_reached ();
+	}
+}
+
+/**
+ * gpm_filter_pipeline_get_radius:
+ *
+ * Return value: how far back a changed value can change the output
+ **/
+static guint
+gpm_filter_pipeline_get_radius (GpmFilterPipelineStage *stage)
+{
+	switch (stage->kind) {
+	case GPM_FILTER_PIPELINE_GAUSSIAN:
+		return stage->kernel->len / 2;
+	case GPM_FILTER_PIPELINE_OUTLIERS:
+	case GPM_FILTER_PIPELINE_MEDIAN:
+		return stage->length / 2;
+	default:
+		return 0;
+	}
+}
+
+/**
+ * gpm_filter_pipeline_get_halo:
+ *
+ * Return value: how many values either side of a block have to be smoothed
+ * with it for it to come out the same as when all the values are smoothed,
+ * or %G_MAXUINT if a stage needs all of the values before it
+ **/
+static guint
+gpm_filter_pipeline_get_halo (GpmFilterPipeline *pipeline)
+{
+	GpmFilterPipelineStage *stage;
+	guint halo = 0;
+	guint i;
+
+	for (i=0; i<pipeline->stages->len; i++) {
+		stage = &g_array_index (pipeline->stages, GpmFilterPipelineStage, i);
+		switch (stage->kind) {
+		case GPM_FILTER_PIPELINE_GAUSSIAN:
+		case GPM_FILTER_PIPELINE_OUTLIERS:
+		case GPM_FILTER_PIPELINE_MEDIAN:
+			halo += gpm_filter_pipeline_get_radius (stage);
+			break;
+		default:
+			return G_MAXUINT;
+		}
+	}
+	return halo;
+}
+
+/**
+ * gpm_filter_pipeline_get_unchanged:
+ *
+ * Return value: the number of values, and times if there are any, that are
+ * the same as last time
+ **/
+static guint
+gpm_filter_pipeline_get_unchanged (GpmFilterPipeline *pipeline)
+{
+	GpmArrayFloat *input = pipeline->input;
+	GpmArrayFloat *times = pipeline->times;
+	guint length;
+	guint i;
+
+	if (!pipeline->last_valid)
+		return 0;
+
+	length = MIN (input->len, pipeline->last_input->len);
+	for (i=0; i<length; i++) {
+		if (g_array_index (input, gfloat, i) != g_array_index (pipeline->last_input, gfloat, i))
+			break;
+	}
+	length = i;
+	if (times->len > 0 || pipeline->last_times->len > 0) {
+		length = MIN (length, MIN (times->len, pipeline->last_times->len));
+		for (i=0; i<length; i++) {
+			if (g_array_index (times, gfloat, i) != g_array_index (pipeline->last_times, gfloat, i))
+				break;
+		}
+		length = i;
+	}
+	return length;
+}
+
+/**
+ * gpm_filter_pipeline_save_input:
+ * @from: the first value that is different from last time
+ **/
+static void
+gpm_filter_pipeline_save_input (GpmFilterPipeline *pipeline, guint from)
+{
+	GpmArrayFloat *input = pipeline->input;
+	GpmArrayFloat *times = pipeline->times;
+
+	g_array_set_size (pipeline->last_input, input->len);
+	memcpy (&g_array_index (pipeline->last_input, gfloat, from),
+		&g_array_index (input, gfloat, from), (input->len - from) * sizeof (gfloat));
+	g_array_set_size (pipeline->last_times, times->len);
+	if (times->len > from)
+		memcpy (&g_array_index (pipeline->last_times, gfloat, from),
+			&g_array_index (times, gfloat, from), (times->len - from) * sizeof (gfloat));
+	pipeline->last_valid = TRUE;
+}
+
+/**
+ * gpm_filter_pipeline_get_breaks:
+ * @n_breaks: the returned number of breaks
+ *
+ * Gets where the values were split by the last gpm_filter_pipeline_run(),
+ * as the index of the first value of each segment apart from the first.
+ *
+ * Return value: the indexes, which belong to the pipeline
+ **/
+const guint *
+gpm_filter_pipeline_get_breaks (GpmFilterPipeline *pipeline, guint *n_breaks)
+{
+	g_return_val_if_fail (pipeline != NULL, NULL);
+	g_return_val_if_fail (n_breaks != NULL, NULL);
+	*n_breaks = pipeline->breaks->len;
+	return (const guint *) pipeline->breaks->data;
+}
+
+/**
+ * gpm_filter_pipeline_run_real:
+ * @from: the number of values, and times, that are the same as last time
+ **/
+static GpmArrayFloat *
+gpm_filter_pipeline_run_real (GpmFilterPipeline *pipeline, guint from)
+{
+	GpmArrayFloat *data;
+	GpmArrayFloat *result;
+	GpmArrayFloat *times = pipeline->times;
+	GpmFilterPipelineStage *stage;
+	guint radius;
+	guint start;
+	guint end;
+	guint i;
+	guint j;
+
+	/* only what the first new value can reach has to be done again */
+	if (pipeline->outputs != NULL) {
+		gpm_filter_pipeline_save_input (pipeline, from);
+		while (pipeline->outputs->len < pipeline->stages->len)
+			g_ptr_array_add (pipeline->outputs, gpm_array_float_new_uninitialised (0));
+	}
+
+	data = pipeline->input;
+	g_array_set_size (pipeline->breaks, 0);
+	for (i=0; i<pipeline->stages->len; i++) {
+		if (gpm_filter_pipeline_should_stop (pipeline))
+			return NULL;
+		stage = &g_array_index (pipeline->stages, GpmFilterPipelineStage, i);
+		result = data;
+		if (pipeline->outputs != NULL)
+			result = g_ptr_array_index (pipeline->outputs, i);
+		switch (stage->kind) {
+		case GPM_FILTER_PIPELINE_GAUSSIAN:
+		case GPM_FILTER_PIPELINE_OUTLIERS:
+		case GPM_FILTER_PIPELINE_MEDIAN:
+		case GPM_FILTER_PIPELINE_EMA:
+			radius = gpm_filter_pipeline_get_radius (stage);
+			from = from > radius ? from - radius : 0;
+			if (result != data)
+				g_array_set_size (result, data->len);
+
+			/* a long history is worth sharing between the CPUs */
+			if (stage->kind == GPM_FILTER_PIPELINE_GAUSSIAN &&
+			    pipeline->breaks->len == 0 && from == 0 &&
+			    data->len >= GPM_FILTER_PIPELINE_PARALLEL_LENGTH) {
+				if (result != data) {
+					gpm_array_float_convolve_parallel_into (data, stage->kernel, 0, result);
+					data = result;
+					break;
+				}
+				gpm_array_float_convolve_parallel_into (data, stage->kernel, 0, pipeline->other);
+				data = gpm_filter_pipeline_swap (pipeline);
+				break;
+			}
+
+			/* each segment is independent of the others */
+			start = 0;
+			for (j=0; j<=pipeline->breaks->len; j++) {
+				if (j > 0 && gpm_filter_pipeline_should_stop (pipeline))
+					return NULL;
+				end = data->len;
+				if (j < pipeline->breaks->len)
+					end = g_array_index (pipeline->breaks, guint, j);
+				if (end > from)
+					gpm_filter_pipeline_run_segment (stage, data, start, end, from, result);
+				start = end;
+			}
+			data = result;
+			break;
+		case GPM_FILTER_PIPELINE_SEGMENTS:
+			if (times->len != data->len) {
+				g_warning ("no times for splitting %u values", data->len);
+				if (pipeline->last_breaks != NULL)
+					g_array_set_size (pipeline->last_breaks, 0);
+				break;
+			}
+			gpm_filter_pipeline_find_breaks (pipeline, times, stage->value, from);
+			break;
+		case GPM_FILTER_PIPELINE_RESAMPLE:
+			/* the breaks are not where they were after this */
+			g_array_set_size (pipeline->breaks, 0);
+
+			/* the times are evenly spaced afterwards too, but the
+			 * ones the caller set are kept for the next run */
+			if (times->len == data->len) {
+				times = gpm_array_float_resample_into (times, stage->length,
+								       pipeline->resampled[times == pipeline->resampled[0] ? 1 : 0]);
+			}
+			from = 0;
+			if (result != data) {
+				data = gpm_array_float_resample_into (data, stage->length, result);
+				break;
+			}
+			gpm_array_float_resample_into (data, stage->length, pipeline->other);
+			data = gpm_filter_pipeline_swap (pipeline);
+			break;
+		case GPM_FILTER_PIPELINE_TIME:
+			if (times->len != data->len) {
+				g_warning ("no times for smoothing %u values", data->len);
+				break;
+			}
+			from = 0;
+			if (result != data) {
+				data = gpm_array_float_smooth_time_into (data, times, stage->value, stage->gap,
+									 pipeline->spare, result);
+				break;
+			}
+			gpm_array_float_smooth_time_into (data, times, stage->value, stage->gap,
+							  pipeline->spare, pipeline->other);
+			data = gpm_filter_pipeline_swap (pipeline);
+			break;
+		}
+	}
+	return data;
+}
+
+/**
+ * gpm_filter_pipeline_run:
+ *
+ * Runs each stage in turn on the values from gpm_filter_pipeline_get_input().
+ *
+ * Return value: the smoothed values, which belong to the pipeline and are
+ * only valid until it is next used, or %NULL if the stop function gave up
+ **/
+GpmArrayFloat *
+gpm_filter_pipeline_run (GpmFilterPipeline *pipeline)
+{
+	guint from = 0;
+
+	g_return_val_if_fail (pipeline != NULL, NULL);
+
+	if (pipeline->outputs != NULL)
+		from = gpm_filter_pipeline_get_unchanged (pipeline);
+	return gpm_filter_pipeline_run_real (pipeline, from);
+}
+
+/**
+ * gpm_filter_pipeline_run_pack:
+ * @pack: the points to smooth, with the time as x
+ * @result: where the smoothed points are added
+ *
+ * Smooths the y value of each point one block of the pack at a time, so the
+ * points are never all decompressed at once. Each block is smoothed with
+ * enough of the points either side that it comes out the same as when all
+ * of the points are smoothed, which only works for the stages that look at
+ * a window of values.
+ *
+ * Return value: %TRUE if all of the points were added to @result
+ **/
+gboolean
+gpm_filter_pipeline_run_pack (GpmFilterPipeline *pipeline, GpmHistoryPack *pack, GpmHistoryPack *result)
+{
+	GArray *window;
+	GpmArrayFloat *values;
+	GpmArrayFloat *smoothed;
+	GpmHistoryPackIter iter;
+	const GpmPointObj *points = NULL;
+	const GpmPointObj *point;
+	gboolean more = TRUE;
+	guint done = 0;
+	guint halo;
+	guint end;
+	guint len;
+	guint i;
+
+	g_return_val_if_fail (pipeline != NULL, FALSE);
+	g_return_val_if_fail (pack != NULL, FALSE);
+	g_return_val_if_fail (result != NULL, FALSE);
+
+	/* the values from last time are from a different part of the pack */
+	g_return_val_if_fail (pipeline->outputs == NULL, FALSE);
+
+	halo = gpm_filter_pipeline_get_halo (pipeline);
+	if (halo == G_MAXUINT) {
+		g_warning ("cannot smooth a block at a time");
+		return FALSE;
+	}
+
+	/* the points that have not been added yet, and the @halo before them */
+	window = pipeline->points;
+	g_array_set_size (window, 0);
+	g_array_set_size (pipeline->times, 0);
+	gpm_history_pack_iter_init (&iter, pack);
+	while (more) {
+		len = gpm_history_pack_iter_next (&iter, &points);
+		more = (len > 0);
+		g_array_append_vals (window, points, len);
+
+		/* the last @halo points change when the next block is added */
+		end = window->len;
+		if (more)
+			end = end > halo ? end - halo : 0;
+		if (end <= done)
+			continue;
+
+		values = gpm_filter_pipeline_get_input (pipeline, window->len);
+		for (i=0; i<window->len; i++)
+			g_array_index (values, gfloat, i) = g_array_index (window, GpmPointObj, i).y;
+		smoothed = gpm_filter_pipeline_run_real (pipeline, 0);
+		if (smoothed == NULL)
+			return FALSE;
+		for (i=done; i<end; i++) {
+			point = &g_array_index (window, GpmPointObj, i);
+			gpm_history_pack_append (result, point->x, g_array_index (smoothed, gfloat, i), point->color);
+		}
+
+		/* only keep what the next block needs */
+		done = end;
+		if (done > halo) {
+			g_array_remove_range (window, 0, done - halo);
+			done = halo;
+		}
+	}
+	return TRUE;
+}
+
+/**
+ * gpm_filter_pipeline_run_points:
+ * @points: the points to smooth, with the time as x
+ * @length: the number of points
+ *
+ * Smooths the y value of each point using the buffers the pipeline keeps
+ * between runs, so once the longest data has been smoothed this doesn't
+ * allocate anything. This is what the statistics window does on each
+ * refresh.
+ *
+ * Return value: points with the same x and color and the smoothed y, which
+ * belong to the pipeline and are only valid until it is next used, or %NULL
+ * if the pipeline resamples or the stop function gave up
+ **/
+const GpmPointObj *
+gpm_filter_pipeline_run_points (GpmFilterPipeline *pipeline, const GpmPointObj *points, guint length)
+{
+	GpmArrayFloat *values;
+	GpmArrayFloat *times;
+	GpmArrayFloat *smoothed;
+	GpmPointObj *result;
+	guint i;
+
+	g_return_val_if_fail (pipeline != NULL, NULL);
+	g_return_val_if_fail (points != NULL || length == 0, NULL);
+
+	values = gpm_filter_pipeline_get_input (pipeline, length);
+	times = gpm_filter_pipeline_get_times (pipeline, length);
+	for (i=0; i<length; i++) {
+		g_array_index (values, gfloat, i) = points[i].y;
+		g_array_index (times, gfloat, i) = points[i].x;
+	}
+	smoothed = gpm_filter_pipeline_run (pipeline);
+	if (smoothed == NULL)
+		return NULL;
+	if (smoothed->len != length) {
+		g_warning ("smoothed %u points into %u", length, smoothed->len);
+		return NULL;
+	}
+
+	g_array_set_size (pipeline->points, length);
+	result = (GpmPointObj *) pipeline->points->data;
+	for (i=0; i<length; i++) {
+		result[i].x = points[i].x;
+		result[i].y = g_array_index (smoothed, gfloat, i);
+		result[i].color = points[i].color;
 	}
-out:
 	return result;
 }
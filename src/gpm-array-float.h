@@ -24,12 +24,16 @@
 
 #include <glib.h>
 
+#include "gpm-point-obj.h"
+#include "gpm-history-pack.h"
+
 G_BEGIN_DECLS
 
 /* at the moment just use a GArray as it's quick */
 typedef GArray GpmArrayFloat;
 
 GpmArrayFloat	*gpm_array_float_new			(guint		 length);
+GpmArrayFloat	*gpm_array_float_new_uninitialised	(guint		 length);
 void		 gpm_array_float_free			(GpmArrayFloat	*array);
 gfloat		 gpm_array_float_sum			(GpmArrayFloat	*array);
 GpmArrayFloat	*gpm_array_float_compute_gaussian	(guint		 length,
@@ -41,14 +45,82 @@ gfloat		 gpm_array_float_get_average		(GpmArrayFloat	*array);
 gboolean	 gpm_array_float_print			(GpmArrayFloat	*array);
 GpmArrayFloat	*gpm_array_float_convolve		(GpmArrayFloat	*data,
 							 GpmArrayFloat	*kernel);
+GpmArrayFloat	*gpm_array_float_convolve_into		(GpmArrayFloat	*data,
+							 GpmArrayFloat	*kernel,
+							 GpmArrayFloat	*result);
+GpmArrayFloat	*gpm_array_float_convolve_parallel_into	(GpmArrayFloat	*data,
+							 GpmArrayFloat	*kernel,
+							 guint		 n_threads,
+							 GpmArrayFloat	*result);
 gfloat		 gpm_array_float_get			(GpmArrayFloat	*array,
 							 guint		 i);
 void		 gpm_array_float_set			(GpmArrayFloat	*array,
 							 guint		 i,
 							 gfloat		 value);
 GpmArrayFloat	*gpm_array_float_remove_outliers	(GpmArrayFloat *data, guint length, gfloat sigma);
+GpmArrayFloat	*gpm_array_float_remove_outliers_into	(GpmArrayFloat	*data,
+							 guint		 length,
+							 gfloat		 sigma,
+							 GpmArrayFloat	*result);
 gfloat		 gpm_array_float_guassian_value		(gfloat		 x,
 							 gfloat		 sigma);
+GpmArrayFloat	*gpm_array_float_median_into		(GpmArrayFloat	*data,
+							 guint		 length,
+							 GpmArrayFloat	*result);
+GpmArrayFloat	*gpm_array_float_ema_into		(GpmArrayFloat	*data,
+							 gfloat		 alpha,
+							 GpmArrayFloat	*result);
+GpmArrayFloat	*gpm_array_float_resample_into		(GpmArrayFloat	*data,
+							 guint		 length,
+							 GpmArrayFloat	*result);
+GpmArrayFloat	*gpm_array_float_smooth_time_into	(GpmArrayFloat	*data,
+							 GpmArrayFloat	*times,
+							 gfloat		 tau,
+							 gfloat		 gap,
+							 GpmArrayFloat	*weights,
+							 GpmArrayFloat	*result);
+
+typedef struct GpmFilterPipeline GpmFilterPipeline;
+
+typedef gboolean (*GpmFilterPipelineStopFunc)	(gpointer	 user_data);
+
+GpmFilterPipeline *gpm_filter_pipeline_new		(void);
+void		 gpm_filter_pipeline_free		(GpmFilterPipeline *pipeline);
+void		 gpm_filter_pipeline_add_outliers	(GpmFilterPipeline *pipeline,
+							 guint		 length,
+							 gfloat		 sigma);
+gboolean	 gpm_filter_pipeline_add_gaussian	(GpmFilterPipeline *pipeline,
+							 guint		 length,
+							 gfloat		 sigma);
+void		 gpm_filter_pipeline_add_median		(GpmFilterPipeline *pipeline,
+							 guint		 length);
+void		 gpm_filter_pipeline_add_ema		(GpmFilterPipeline *pipeline,
+							 gfloat		 alpha);
+void		 gpm_filter_pipeline_add_resample	(GpmFilterPipeline *pipeline,
+							 guint		 length);
+void		 gpm_filter_pipeline_add_time		(GpmFilterPipeline *pipeline,
+							 gfloat		 tau,
+							 gfloat		 gap);
+void		 gpm_filter_pipeline_add_segments	(GpmFilterPipeline *pipeline,
+							 gfloat		 gap);
+void		 gpm_filter_pipeline_set_incremental	(GpmFilterPipeline *pipeline,
+							 gboolean	 incremental);
+void		 gpm_filter_pipeline_set_stop_func	(GpmFilterPipeline *pipeline,
+							 GpmFilterPipelineStopFunc func,
+							 gpointer	 user_data);
+GpmArrayFloat	*gpm_filter_pipeline_get_input		(GpmFilterPipeline *pipeline,
+							 guint		 length);
+GpmArrayFloat	*gpm_filter_pipeline_get_times		(GpmFilterPipeline *pipeline,
+							 guint		 length);
+GpmArrayFloat	*gpm_filter_pipeline_run		(GpmFilterPipeline *pipeline);
+gboolean	 gpm_filter_pipeline_run_pack		(GpmFilterPipeline *pipeline,
+							 GpmHistoryPack	*pack,
+							 GpmHistoryPack	*result);
+const GpmPointObj *gpm_filter_pipeline_run_points	(GpmFilterPipeline *pipeline,
+							 const GpmPointObj *points,
+							 guint		 length);
+const guint	*gpm_filter_pipeline_get_breaks		(GpmFilterPipeline *pipeline,
+							 guint		*n_breaks);
 
 G_END_DECLS
 
@@ -0,0 +1,1037 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2011 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+
+#include <math.h>
+#include <string.h>
+#include <glib.h>
+
+#include "gpm-graph-series.h"
+
+#define GPM_GRAPH_SERIES_MIN_ALLOC	16
+#define GPM_GRAPH_SERIES_PALETTE_SIZE	256
+#define GPM_GRAPH_SERIES_Y_LEVELS	65536
+
+/* the points are stored contiguously, and once the capacity is reached the
+ * oldest point at head is overwritten by the newest.
+ *
+ * Data that is assigned all at once can be stored compactly, which is 7 bytes
+ * a point rather than 12. The x values are whole numbers, e.g. seconds, saved
+ * as an offset from the first point, the y value is rounded to one of 65536
+ * levels between the smallest and largest values, and the color is an index
+ * into the few colors that are used.
+ *
+ * Where consecutive x values are further apart than the gap, e.g. when the
+ * machine was suspended, the series is split into segments. Only the index of
+ * the first point of each new segment is kept, as the points don't move.
+ *
+ * The points are drawn from a cache of where they are on the screen, which
+ * is kept by index rather than by slot so that it can be walked in order.
+ * Dropping the oldest point just moves where index 0 is in the cache, and only
+ * new points, or all of them if the graph has moved, are transformed again. */
+struct GpmGraphSeries
+{
+	GpmPointObj		*points; /* NULL if compact */
+	gint32			*xs;
+	gint16			*ys;
+	guint8			*colors;
+	gfloat			 x_base;
+	gfloat			 y_base;
+	gfloat			 y_scale;
+	guint32			*palette;
+	guint			 palette_len;
+	guint			 palette_alloc;
+	guint			 alloc;
+	guint			 head;
+	guint			 len;
+	guint			 capacity; /* 0 is unlimited */
+	gboolean		 ascending; /* x order, both are true for < 2 points */
+	gboolean		 descending;
+	gboolean		 bounds_valid;
+	gfloat			 min_x;
+	gfloat			 max_x;
+	gfloat			 min_y;
+	gfloat			 max_y;
+	gfloat			 gap; /* 0 is never split */
+	GArray			*breaks; /* of guint, the first point of each segment after the first */
+	GpmPointObj		*screen; /* index i is at screen_start + i */
+	guint			 screen_alloc;
+	guint			 screen_start;
+	guint			 screen_first; /* the transformed indexes */
+	guint			 screen_end;
+	GpmGraphSeriesTransform	 transform;
+};
+
+/**
+ * gpm_graph_series_new:
+ * @capacity: the maximum number of points to keep, or 0 for no limit
+ *
+ * Return value: a new series, free with gpm_graph_series_free()
+ **/
+GpmGraphSeries *
+gpm_graph_series_new (guint capacity)
+{
+	GpmGraphSeries *series;
+	series = g_new0 (GpmGraphSeries, 1);
+	series->capacity = capacity;
+	series->ascending = TRUE;
+	series->descending = TRUE;
+	series->breaks = g_array_new (FALSE, FALSE, sizeof (guint));
+	return series;
+}
+
+/**
+ * gpm_graph_series_free_storage:
+ **/
+static void
+gpm_graph_series_free_storage (GpmGraphSeries *series)
+{
+	g_free (series->points);
+	g_free (series->xs);
+	g_free (series->ys);
+	g_free (series->colors);
+	g_free (series->palette);
+	series->points = NULL;
+	series->xs = NULL;
+	series->ys = NULL;
+	series->colors = NULL;
+	series->palette = NULL;
+	series->palette_len = 0;
+	series->palette_alloc = 0;
+}
+
+/**
+ * gpm_graph_series_free:
+ **/
+void
+gpm_graph_series_free (GpmGraphSeries *series)
+{
+	if (series == NULL)
+		return;
+	gpm_graph_series_free_storage (series);
+	g_array_unref (series->breaks);
+	g_free (series->screen);
+	g_free (series);
+}
+
+/**
+ * gpm_graph_series_is_compact:
+ **/
+static gboolean
+gpm_graph_series_is_compact (GpmGraphSeries *series)
+{
+	return series->xs != NULL;
+}
+
+/**
+ * gpm_graph_series_get_slot:
+ * @slot: the position in the storage, not the index of the point
+ **/
+static void
+gpm_graph_series_get_slot (GpmGraphSeries *series, guint slot, GpmPointObj *point)
+{
+	if (series->points != NULL) {
+		*point = series->points[slot];
+		return;
+	}
+	point->x = series->x_base + (gfloat) series->xs[slot];
+	point->y = series->y_base + series->y_scale * ((gint) series->ys[slot] - G_MININT16);
+	point->color = series->palette[series->colors[slot]];
+}
+
+/**
+ * gpm_graph_series_set_slot:
+ * @slot: the position in the storage, not the index of the point
+ *
+ * Return value: %FALSE if the point can't be stored compactly
+ **/
+static gboolean
+gpm_graph_series_set_slot (GpmGraphSeries *series, guint slot, gfloat x, gfloat y, guint32 color)
+{
+	gdouble offset;
+	gdouble level;
+	guint i;
+
+	if (series->points != NULL) {
+		series->points[slot].x = x;
+		series->points[slot].y = y;
+		series->points[slot].color = color;
+		return TRUE;
+	}
+
+	/* the x value has to come back exactly, as it's used for searching */
+	offset = (gdouble) x - series->x_base;
+	if (offset < G_MININT32 || offset > G_MAXINT32 || offset != floor (offset))
+		return FALSE;
+	if (series->x_base + (gfloat) (gint32) offset != x)
+		return FALSE;
+
+	/* the y value can be rounded, but not clamped */
+	level = floor (((gdouble) y - series->y_base) / series->y_scale + 0.5);
+	if (!(level >= 0 && level < GPM_GRAPH_SERIES_Y_LEVELS))
+		return FALSE;
+
+	/* there are only a few states, so only a few colors */
+	for (i=0; i<series->palette_len; i++) {
+		if (series->palette[i] == color)
+			break;
+	}
+	if (i == series->palette_len) {
+		if (i == GPM_GRAPH_SERIES_PALETTE_SIZE)
+			return FALSE;
+		if (i == series->palette_alloc) {
+			series->palette_alloc = MAX (series->palette_alloc * 2, 4);
+			series->palette = g_renew (guint32, series->palette, series->palette_alloc);
+		}
+		series->palette[series->palette_len++] = color;
+	}
+
+	series->xs[slot] = (gint32) offset;
+	series->ys[slot] = (gint16) ((gint) level + G_MININT16);
+	series->colors[slot] = i;
+	return TRUE;
+}
+
+/**
+ * gpm_graph_series_set_alloc:
+ * @alloc: the number of slots, which must be at least the length
+ *
+ * Changes the storage size, and moves the points so head is at the start.
+ **/
+static void
+gpm_graph_series_set_alloc (GpmGraphSeries *series, guint alloc)
+{
+	GpmPointObj *points;
+	gint32 *xs;
+	gint16 *ys;
+	guint8 *colors;
+	guint slot;
+	guint i;
+
+	/* not wrapped, so the storage can just be resized */
+	if (series->head == 0) {
+		if (gpm_graph_series_is_compact (series)) {
+			series->xs = g_renew (gint32, series->xs, alloc);
+			series->ys = g_renew (gint16, series->ys, alloc);
+			series->colors = g_renew (guint8, series->colors, alloc);
+		} else {
+			series->points = g_renew (GpmPointObj, series->points, alloc);
+		}
+		series->alloc = alloc;
+		return;
+	}
+
+	if (gpm_graph_series_is_compact (series)) {
+		xs = g_new (gint32, alloc);
+		ys = g_new (gint16, alloc);
+		colors = g_new (guint8, alloc);
+		for (i=0; i<series->len; i++) {
+			slot = (series->head + i) % series->alloc;
+			xs[i] = series->xs[slot];
+			ys[i] = series->ys[slot];
+			colors[i] = series->colors[slot];
+		}
+		g_free (series->xs);
+		g_free (series->ys);
+		g_free (series->colors);
+		series->xs = xs;
+		series->ys = ys;
+		series->colors = colors;
+	} else {
+		points = g_new (GpmPointObj, alloc);
+		for (i=0; i<series->len; i++)
+			points[i] = series->points[(series->head + i) % series->alloc];
+		g_free (series->points);
+		series->points = points;
+	}
+	series->alloc = alloc;
+	series->head = 0;
+}
+
+/**
+ * gpm_graph_series_expand:
+ *
+ * Stores the points as floats again, e.g. when a new point doesn't fit.
+ **/
+static void
+gpm_graph_series_expand (GpmGraphSeries *series)
+{
+	GpmPointObj *points;
+	guint i;
+
+	points = g_new (GpmPointObj, series->alloc);
+	for (i=0; i<series->alloc; i++) {
+		if ((i + series->alloc - series->head) % series->alloc < series->len)
+			gpm_graph_series_get_slot (series, i, &points[i]);
+	}
+	gpm_graph_series_free_storage (series);
+	series->points = points;
+}
+
+/**
+ * gpm_graph_series_invalidate_screen:
+ **/
+static void
+gpm_graph_series_invalidate_screen (GpmGraphSeries *series)
+{
+	series->screen_first = 0;
+	series->screen_end = 0;
+}
+
+/**
+ * gpm_graph_series_drop_screen:
+ * @dropped: the number of points dropped from the start
+ **/
+static void
+gpm_graph_series_drop_screen (GpmGraphSeries *series, guint dropped)
+{
+	series->screen_start += dropped;
+	series->screen_first = series->screen_first > dropped ? series->screen_first - dropped : 0;
+	series->screen_end = series->screen_end > dropped ? series->screen_end - dropped : 0;
+}
+
+/**
+ * gpm_graph_series_clear:
+ *
+ * Removes all the points, but keeps the storage for reuse.
+ **/
+void
+gpm_graph_series_clear (GpmGraphSeries *series)
+{
+	g_return_if_fail (series != NULL);
+	gpm_graph_series_invalidate_screen (series);
+	series->head = 0;
+	series->len = 0;
+	series->bounds_valid = FALSE;
+	series->ascending = TRUE;
+	series->descending = TRUE;
+	g_array_set_size (series->breaks, 0);
+
+	/* the new points may not fit the old encoding */
+	if (gpm_graph_series_is_compact (series)) {
+		gpm_graph_series_free_storage (series);
+		series->alloc = 0;
+	}
+}
+
+/**
+ * gpm_graph_series_drop_breaks:
+ * @dropped: the number of points dropped from the start
+ *
+ * Moves the segment breaks to the new indexes. A break at the new first
+ * point is removed, as the first segment always starts there.
+ **/
+static void
+gpm_graph_series_drop_breaks (GpmGraphSeries *series, guint dropped)
+{
+	guint *breaks;
+	guint kept = 0;
+	guint i;
+
+	breaks = (guint *) series->breaks->data;
+	for (i=0; i<series->breaks->len; i++) {
+		if (breaks[i] > dropped)
+			breaks[kept++] = breaks[i] - dropped;
+	}
+	g_array_set_size (series->breaks, kept);
+}
+
+/**
+ * gpm_graph_series_set_capacity:
+ * @capacity: the maximum number of points to keep, or 0 for no limit
+ *
+ * If there are more points than the new capacity then the oldest are dropped.
+ **/
+void
+gpm_graph_series_set_capacity (GpmGraphSeries *series, guint capacity)
+{
+	guint kept;
+
+	g_return_if_fail (series != NULL);
+
+	/* keep only the newest points */
+	kept = series->len;
+	if (capacity > 0 && kept > capacity) {
+		kept = capacity;
+		gpm_graph_series_drop_breaks (series, series->len - kept);
+		gpm_graph_series_drop_screen (series, series->len - kept);
+		series->head = (series->head + series->len - kept) % series->alloc;
+		series->len = kept;
+		series->bounds_valid = FALSE;
+	}
+
+	/* unwrap the ring so head is at the start again */
+	gpm_graph_series_set_alloc (series, MAX (kept, 1));
+	series->capacity = capacity;
+}
+
+/**
+ * gpm_graph_series_get_capacity:
+ **/
+guint
+gpm_graph_series_get_capacity (GpmGraphSeries *series)
+{
+	g_return_val_if_fail (series != NULL, 0);
+	return series->capacity;
+}
+
+/**
+ * gpm_graph_series_get_length:
+ **/
+guint
+gpm_graph_series_get_length (GpmGraphSeries *series)
+{
+	g_return_val_if_fail (series != NULL, 0);
+	return series->len;
+}
+
+/**
+ * gpm_graph_series_get_slot_for_index:
+ **/
+static guint
+gpm_graph_series_get_slot_for_index (GpmGraphSeries *series, guint index)
+{
+	guint i;
+	i = series->head + index;
+	if (i >= series->alloc)
+		i -= series->alloc;
+	return i;
+}
+
+/**
+ * gpm_graph_series_get:
+ * @index: the point, where 0 is the oldest
+ * @point: the returned point
+ *
+ * Gets a copy of a point, as compact data has to be decoded.
+ **/
+void
+gpm_graph_series_get (GpmGraphSeries *series, guint index, GpmPointObj *point)
+{
+	gpm_graph_series_get_slot (series, gpm_graph_series_get_slot_for_index (series, index), point);
+}
+
+/**
+ * gpm_graph_series_update_bounds:
+ **/
+static void
+gpm_graph_series_update_bounds (GpmGraphSeries *series, const GpmPointObj *point)
+{
+	if (point->x < series->min_x)
+		series->min_x = point->x;
+	if (point->x > series->max_x)
+		series->max_x = point->x;
+	if (point->y < series->min_y)
+		series->min_y = point->y;
+	if (point->y > series->max_y)
+		series->max_y = point->y;
+}
+
+/**
+ * gpm_graph_series_append:
+ * @evicted: the oldest point if it was dropped, or %NULL
+ *
+ * Adds a point to the end of the series. If the series is at capacity then
+ * the oldest point is dropped to make room.
+ *
+ * Return value: %TRUE if a point was dropped
+ **/
+gboolean
+gpm_graph_series_append (GpmGraphSeries *series, gfloat x, gfloat y, guint32 color, GpmPointObj *evicted)
+{
+	GpmPointObj point;
+	gboolean dropped = FALSE;
+	guint alloc;
+	guint slot;
+
+	g_return_val_if_fail (series != NULL, FALSE);
+
+	if (series->capacity > 0 && series->len == series->capacity) {
+		/* overwrite the oldest */
+		gpm_graph_series_get_slot (series, series->head, &point);
+		if (evicted != NULL)
+			*evicted = point;
+
+		/* only an extreme point makes the bounds stale */
+		if (point.x <= series->min_x || point.x >= series->max_x ||
+		    point.y <= series->min_y || point.y >= series->max_y)
+			series->bounds_valid = FALSE;
+
+		series->head++;
+		if (series->head == series->alloc)
+			series->head = 0;
+		series->len--;
+		if (series->breaks->len > 0)
+			gpm_graph_series_drop_breaks (series, 1);
+		gpm_graph_series_drop_screen (series, 1);
+		dropped = TRUE;
+	} else if (series->len == series->alloc) {
+		/* not yet full, so head is always zero here */
+		alloc = MAX (series->alloc * 2, GPM_GRAPH_SERIES_MIN_ALLOC);
+		if (series->capacity > 0)
+			alloc = MIN (alloc, series->capacity);
+		gpm_graph_series_set_alloc (series, alloc);
+	}
+
+	/* dropping the oldest point never changes the order */
+	if (series->len > 0) {
+		gpm_graph_series_get (series, series->len - 1, &point);
+		if (x < point.x)
+			series->ascending = FALSE;
+		if (x > point.x)
+			series->descending = FALSE;
+		if (series->gap > 0 && fabsf (x - point.x) > series->gap)
+			g_array_append_val (series->breaks, series->len);
+	}
+
+	/* the slot after the newest point */
+	slot = gpm_graph_series_get_slot_for_index (series, series->len);
+	if (!gpm_graph_series_set_slot (series, slot, x, y, color)) {
+		gpm_graph_series_expand (series);
+		gpm_graph_series_set_slot (series, slot, x, y, color);
+	}
+	series->len++;
+
+	/* compact data may have been rounded */
+	gpm_graph_series_get_slot (series, slot, &point);
+	if (series->len == 1) {
+		series->min_x = series->max_x = point.x;
+		series->min_y = series->max_y = point.y;
+		series->bounds_valid = TRUE;
+	} else if (series->bounds_valid) {
+		gpm_graph_series_update_bounds (series, &point);
+	}
+	return dropped;
+}
+
+/**
+ * gpm_graph_series_get_y_scale:
+ *
+ * Finds the smallest round step, e.g. 0.01, 0.2 or 50, that fits the range
+ * into the levels we have. Round steps keep values such as 12.3 exact.
+ **/
+static gdouble
+gpm_graph_series_get_y_scale (gdouble min_y, gdouble max_y)
+{
+	const gdouble steps[] = { 1, 2, 5 };
+	gdouble scale;
+	gdouble base;
+	gint power;
+	guint i;
+
+	for (power=-3; power<38; power++) {
+		for (i=0; i<G_N_ELEMENTS (steps); i++) {
+			scale = steps[i] * pow (10, power);
+			base = floor (min_y / scale) * scale;
+			if ((max_y - base) / scale < GPM_GRAPH_SERIES_Y_LEVELS - 1)
+				return scale;
+		}
+	}
+	return 0;
+}
+
+/**
+ * gpm_graph_series_compact:
+ *
+ * Stores the points compactly if they can be, which is worth doing for a long
+ * history that is not going to change. Points can still be added, but the
+ * series is stored as floats again if a new point does not fit.
+ *
+ * Return value: %TRUE if the series is now compact
+ **/
+gboolean
+gpm_graph_series_compact (GpmGraphSeries *series)
+{
+	GpmGraphSeries *compact;
+	GpmPointObj point;
+	gdouble scale;
+	guint i;
+
+	g_return_val_if_fail (series != NULL, FALSE);
+
+	if (gpm_graph_series_is_compact (series))
+		return TRUE;
+	if (series->len == 0)
+		return FALSE;
+
+	gpm_graph_series_get_bounds (series, NULL, NULL, NULL, NULL);
+	if (isnan (series->min_y) || isnan (series->max_y))
+		return FALSE;
+	scale = gpm_graph_series_get_y_scale (series->min_y, series->max_y);
+	if (scale == 0)
+		return FALSE;
+
+	/* encode into a new series, so we can give up half way through */
+	compact = gpm_graph_series_new (series->capacity);
+	compact->alloc = series->len;
+	compact->xs = g_new (gint32, compact->alloc);
+	compact->ys = g_new (gint16, compact->alloc);
+	compact->colors = g_new (guint8, compact->alloc);
+	compact->x_base = series->min_x;
+	compact->y_base = floor (series->min_y / scale) * scale;
+	compact->y_scale = scale;
+	for (i=0; i<series->len; i++) {
+		gpm_graph_series_get (series, i, &point);
+		if (!gpm_graph_series_set_slot (compact, i, point.x, point.y, point.color)) {
+			gpm_graph_series_free (compact);
+			return FALSE;
+		}
+	}
+
+	/* swap the storage over */
+	gpm_graph_series_free_storage (series);
+	series->xs = compact->xs;
+	series->ys = compact->ys;
+	series->colors = compact->colors;
+	series->palette = compact->palette;
+	series->palette_len = compact->palette_len;
+	series->palette_alloc = compact->palette_alloc;
+	series->x_base = compact->x_base;
+	series->y_base = compact->y_base;
+	series->y_scale = compact->y_scale;
+	series->alloc = compact->alloc;
+	series->head = 0;
+	series->bounds_valid = FALSE;
+	g_free (compact);
+
+	/* the y values have been rounded */
+	gpm_graph_series_invalidate_screen (series);
+	return TRUE;
+}
+
+/**
+ * gpm_graph_series_get_bounds:
+ *
+ * Gets the range of the data, which is only rescanned when a point that was
+ * an extreme has been dropped.
+ *
+ * Return value: %FALSE if there is no data
+ **/
+gboolean
+gpm_graph_series_get_bounds (GpmGraphSeries *series, gfloat *min_x, gfloat *max_x, gfloat *min_y, gfloat *max_y)
+{
+	GpmPointObj point;
+	guint i;
+
+	g_return_val_if_fail (series != NULL, FALSE);
+
+	if (series->len == 0)
+		return FALSE;
+
+	if (!series->bounds_valid) {
+		gpm_graph_series_get (series, 0, &point);
+		series->min_x = series->max_x = point.x;
+		series->min_y = series->max_y = point.y;
+		for (i=1; i<series->len; i++) {
+			gpm_graph_series_get (series, i, &point);
+			gpm_graph_series_update_bounds (series, &point);
+		}
+		series->bounds_valid = TRUE;
+	}
+
+	if (min_x != NULL)
+		*min_x = series->min_x;
+	if (max_x != NULL)
+		*max_x = series->max_x;
+	if (min_y != NULL)
+		*min_y = series->min_y;
+	if (max_y != NULL)
+		*max_y = series->max_y;
+	return TRUE;
+}
+
+/**
+ * gpm_graph_series_get_x:
+ * @reversed: if the index counts from the newest point
+ **/
+static gfloat
+gpm_graph_series_get_x (GpmGraphSeries *series, guint index, gboolean reversed)
+{
+	guint slot;
+	if (reversed)
+		index = series->len - 1 - index;
+	slot = gpm_graph_series_get_slot_for_index (series, index);
+	if (series->points != NULL)
+		return series->points[slot].x;
+	return series->x_base + (gfloat) series->xs[slot];
+}
+
+/**
+ * gpm_graph_series_find_x:
+ * @reversed: if the series is in descending x order
+ * @inclusive: if points equal to @x count as before it
+ *
+ * Return value: the number of points before @x, using a binary search
+ **/
+static guint
+gpm_graph_series_find_x (GpmGraphSeries *series, gfloat x, gboolean reversed, gboolean inclusive)
+{
+	gfloat value;
+	guint low = 0;
+	guint high = series->len;
+	guint mid;
+
+	while (low < high) {
+		mid = low + (high - low) / 2;
+		value = gpm_graph_series_get_x (series, mid, reversed);
+		if (value < x || (inclusive && value == x))
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return low;
+}
+
+/**
+ * gpm_graph_series_get_range:
+ * @x1: the smallest visible x value
+ * @x2: the largest visible x value
+ * @first: the returned index of the first point to draw
+ * @last: the returned index of the last point to draw
+ *
+ * Finds the points between @x1 and @x2, and the point either side of them so
+ * that lines leaving the visible range are still drawn.
+ *
+ * Return value: %FALSE if the points are not in x order, so all of them
+ * have to be drawn
+ **/
+gboolean
+gpm_graph_series_get_range (GpmGraphSeries *series, gfloat x1, gfloat x2, guint *first, guint *last)
+{
+	gboolean reversed;
+	guint start;
+	guint end;
+
+	g_return_val_if_fail (series != NULL, FALSE);
+	g_return_val_if_fail (series->len > 0, FALSE);
+
+	*first = 0;
+	*last = series->len - 1;
+	if (!series->ascending && !series->descending)
+		return FALSE;
+
+	/* the index of the first point >= x1, and the first point > x2 */
+	reversed = !series->ascending;
+	start = gpm_graph_series_find_x (series, x1, reversed, FALSE);
+	end = gpm_graph_series_find_x (series, x2, reversed, TRUE);
+	if (start > 0)
+		start--;
+	if (end == series->len)
+		end--;
+	if (reversed) {
+		*first = series->len - 1 - end;
+		*last = series->len - 1 - start;
+	} else {
+		*first = start;
+		*last = end;
+	}
+	return TRUE;
+}
+
+/**
+ * gpm_graph_series_set_gap:
+ * @gap: the largest x step within a segment, or 0 to never split the series
+ *
+ * Splits the series wherever consecutive points are further apart than @gap,
+ * so that a line is not drawn across the time the machine was suspended.
+ **/
+void
+gpm_graph_series_set_gap (GpmGraphSeries *series, gfloat gap)
+{
+	gfloat last;
+	gfloat x;
+	guint i;
+
+	g_return_if_fail (series != NULL);
+
+	if (series->gap == gap)
+		return;
+	series->gap = gap;
+	g_array_set_size (series->breaks, 0);
+	if (gap <= 0 || series->len == 0)
+		return;
+
+	last = gpm_graph_series_get_x (series, 0, FALSE);
+	for (i=1; i<series->len; i++) {
+		x = gpm_graph_series_get_x (series, i, FALSE);
+		if (fabsf (x - last) > gap)
+			g_array_append_val (series->breaks, i);
+		last = x;
+	}
+}
+
+/**
+ * gpm_graph_series_get_gap:
+ **/
+gfloat
+gpm_graph_series_get_gap (GpmGraphSeries *series)
+{
+	g_return_val_if_fail (series != NULL, 0);
+	return series->gap;
+}
+
+/**
+ * gpm_graph_series_new_from_points:
+ * @points: the points, which are copied
+ * @length: the number of points
+ * @gap: see gpm_graph_series_set_gap()
+ *
+ * Makes a series with no limit on the number of points, which is compact
+ * if the points can be.
+ *
+ * Return value: a new series, free with gpm_graph_series_free()
+ **/
+GpmGraphSeries *
+gpm_graph_series_new_from_points (const GpmPointObj *points, guint length, gfloat gap)
+{
+	GpmGraphSeries *series;
+
+	g_return_val_if_fail (points != NULL || length == 0, NULL);
+
+	series = gpm_graph_series_new (0);
+	gpm_graph_series_set_gap (series, gap);
+	gpm_graph_series_assign (series, points, length);
+	return series;
+}
+
+/**
+ * gpm_graph_series_assign:
+ * @points: the new points, which are copied
+ * @length: the number of points
+ *
+ * Replaces all of the points, and stores them compactly if they can be. The
+ * storage is kept if it is big enough, so filling a series again with about
+ * the same number of points doesn't allocate anything. All the points are
+ * kept, so the series has no capacity afterwards.
+ **/
+void
+gpm_graph_series_assign (GpmGraphSeries *series, const GpmPointObj *points, guint length)
+{
+	gdouble scale = 0;
+	gfloat min_x;
+	gfloat min_y;
+	gfloat max_y;
+	guint i;
+
+	g_return_if_fail (series != NULL);
+	g_return_if_fail (points != NULL || length == 0);
+
+	gpm_graph_series_invalidate_screen (series);
+	series->capacity = 0;
+	series->head = 0;
+	series->len = 0;
+	series->bounds_valid = FALSE;
+	series->ascending = TRUE;
+	series->descending = TRUE;
+	series->palette_len = 0;
+	g_array_set_size (series->breaks, 0);
+	if (length == 0)
+		return;
+
+	/* a long history takes a lot less memory this way */
+	min_x = points[0].x;
+	min_y = max_y = points[0].y;
+	for (i=1; i<length; i++) {
+		if (points[i].x < min_x)
+			min_x = points[i].x;
+		if (points[i].y < min_y)
+			min_y = points[i].y;
+		if (points[i].y > max_y)
+			max_y = points[i].y;
+	}
+	if (!isnan (min_y) && !isnan (max_y))
+		scale = gpm_graph_series_get_y_scale (min_y, max_y);
+	if (scale != 0) {
+		if (!gpm_graph_series_is_compact (series)) {
+			gpm_graph_series_free_storage (series);
+			series->alloc = 0;
+		}
+		if (series->alloc < length) {
+			series->xs = g_renew (gint32, series->xs, length);
+			series->ys = g_renew (gint16, series->ys, length);
+			series->colors = g_renew (guint8, series->colors, length);
+			series->alloc = length;
+		}
+		series->x_base = min_x;
+		series->y_base = floor (min_y / scale) * scale;
+		series->y_scale = scale;
+		for (i=0; i<length; i++) {
+			if (!gpm_graph_series_set_slot (series, i, points[i].x, points[i].y, points[i].color))
+				break;
+		}
+		if (i == length)
+			goto out;
+	}
+
+	/* store them as floats instead */
+	if (gpm_graph_series_is_compact (series)) {
+		gpm_graph_series_free_storage (series);
+		series->alloc = 0;
+	}
+	if (series->alloc < length) {
+		series->points = g_renew (GpmPointObj, series->points, length);
+		series->alloc = length;
+	}
+	memcpy (series->points, points, length * sizeof (GpmPointObj));
+out:
+	series->len = length;
+	for (i=1; i<length; i++) {
+		if (points[i].x < points[i - 1].x)
+			series->ascending = FALSE;
+		if (points[i].x > points[i - 1].x)
+			series->descending = FALSE;
+		if (series->gap > 0 && fabsf (points[i].x - points[i - 1].x) > series->gap)
+			g_array_append_val (series->breaks, i);
+	}
+}
+
+/**
+ * gpm_graph_series_get_breaks:
+ * @n_breaks: the returned number of breaks
+ *
+ * Gets where the series is split, as the index of the first point of each
+ * segment apart from the first, in ascending order. The array is owned by
+ * the series and is only valid until it is next changed.
+ *
+ * Return value: the indexes, or %NULL if the series is not split
+ **/
+const guint *
+gpm_graph_series_get_breaks (GpmGraphSeries *series, guint *n_breaks)
+{
+	g_return_val_if_fail (series != NULL, NULL);
+	g_return_val_if_fail (n_breaks != NULL, NULL);
+
+	*n_breaks = series->breaks->len;
+	if (series->breaks->len == 0)
+		return NULL;
+	return (const guint *) series->breaks->data;
+}
+
+/**
+ * gpm_graph_series_transform_range:
+ * @first: the first index to transform
+ * @end: the index after the last one
+ *
+ * Works out where the points are on the screen. The loops are kept simple
+ * so that the compiler can vectorize them, and are split where the ring of
+ * storage wraps around.
+ **/
+static void
+gpm_graph_series_transform_range (GpmGraphSeries *series, guint first, guint end)
+{
+	const GpmGraphSeriesTransform *t = &series->transform;
+	GpmPointObj *screen;
+	guint slot;
+	guint run;
+	guint i;
+
+	while (first < end) {
+		slot = gpm_graph_series_get_slot_for_index (series, first);
+		run = MIN (end - first, series->alloc - slot);
+		screen = &series->screen[series->screen_start + first];
+		if (series->points != NULL) {
+			const GpmPointObj *points = &series->points[slot];
+			for (i=0; i<run; i++) {
+				screen[i].x = (points[i].x - t->origin_x) * t->scale_x + t->offset_x;
+				screen[i].y = (points[i].y - t->origin_y) * t->scale_y + t->offset_y;
+				screen[i].color = points[i].color;
+			}
+		} else {
+			const gint32 *xs = &series->xs[slot];
+			const gint16 *ys = &series->ys[slot];
+			const guint8 *colors = &series->colors[slot];
+			for (i=0; i<run; i++) {
+				screen[i].x = ((series->x_base + (gfloat) xs[i]) - t->origin_x) * t->scale_x + t->offset_x;
+				screen[i].y = ((series->y_base + series->y_scale * ((gint) ys[i] - G_MININT16)) - t->origin_y) *
+					      t->scale_y + t->offset_y;
+				screen[i].color = series->palette[colors[i]];
+			}
+		}
+		first += run;
+	}
+}
+
+/**
+ * gpm_graph_series_get_screen:
+ * @transform: how to get from data to screen coordinates
+ * @first: the first point that is needed
+ * @last: the last point that is needed
+ *
+ * Gets the points from @first to @last in screen coordinates, so that they
+ * can be drawn without working out each one again for every frame. Points
+ * that were transformed with the same @transform are reused, so drawing
+ * again after a few points were added only transforms the new ones.
+ *
+ * Return value: the points, indexed in the same way as the series, which
+ * belong to the series and are only valid until it is next changed
+ **/
+const GpmPointObj *
+gpm_graph_series_get_screen (GpmGraphSeries *series, const GpmGraphSeriesTransform *transform,
+			     guint first, guint last)
+{
+	guint end;
+	guint alloc;
+
+	g_return_val_if_fail (series != NULL, NULL);
+	g_return_val_if_fail (transform != NULL, NULL);
+	g_return_val_if_fail (first <= last && last < series->len, NULL);
+
+	/* zoomed, scrolled or resized */
+	if (memcmp (transform, &series->transform, sizeof (GpmGraphSeriesTransform)) != 0) {
+		series->transform = *transform;
+		gpm_graph_series_invalidate_screen (series);
+	}
+
+	/* move the cache back to the start once enough points have been
+	 * dropped, and keep room for as many again so this is not often */
+	if (series->screen_start + series->len > series->screen_alloc) {
+		if (series->screen_end > series->screen_first)
+			memmove (&series->screen[series->screen_first],
+				 &series->screen[series->screen_start + series->screen_first],
+				 (series->screen_end - series->screen_first) * sizeof (GpmPointObj));
+		series->screen_start = 0;
+		if (series->screen_alloc < series->len * 2) {
+			alloc = MAX (series->len * 2, GPM_GRAPH_SERIES_MIN_ALLOC);
+			series->screen = g_renew (GpmPointObj, series->screen, alloc);
+			series->screen_alloc = alloc;
+		}
+	}
+
+	/* only transform what is not already cached */
+	end = last + 1;
+	if (series->screen_end <= series->screen_first ||
+	    end < series->screen_first || first > series->screen_end) {
+		gpm_graph_series_transform_range (series, first, end);
+		series->screen_first = first;
+		series->screen_end = end;
+	} else {
+		if (first < series->screen_first) {
+			gpm_graph_series_transform_range (series, first, series->screen_first);
+			series->screen_first = first;
+		}
+		if (end > series->screen_end) {
+			gpm_graph_series_transform_range (series, series->screen_end, end);
+			series->screen_end = end;
+		}
+	}
+	return &series->screen[series->screen_start];
+}
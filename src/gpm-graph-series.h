@@ -0,0 +1,87 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2011 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __GPM_GRAPH_SERIES_H
+#define __GPM_GRAPH_SERIES_H
+
+#include <glib.h>
+
+#include "gpm-point-obj.h"
+
+G_BEGIN_DECLS
+
+typedef struct GpmGraphSeries GpmGraphSeries;
+
+/* screen = (data - origin) * scale + offset */
+typedef struct {
+	gfloat			 origin_x;
+	gfloat			 scale_x;
+	gfloat			 offset_x;
+	gfloat			 origin_y;
+	gfloat			 scale_y;
+	gfloat			 offset_y;
+} GpmGraphSeriesTransform;
+
+GpmGraphSeries	*gpm_graph_series_new			(guint		 capacity);
+GpmGraphSeries	*gpm_graph_series_new_from_points	(const GpmPointObj *points,
+							 guint		 length,
+							 gfloat		 gap);
+void		 gpm_graph_series_free			(GpmGraphSeries	*series);
+void		 gpm_graph_series_clear			(GpmGraphSeries	*series);
+void		 gpm_graph_series_assign		(GpmGraphSeries	*series,
+							 const GpmPointObj *points,
+							 guint		 length);
+void		 gpm_graph_series_set_capacity		(GpmGraphSeries	*series,
+							 guint		 capacity);
+guint		 gpm_graph_series_get_capacity		(GpmGraphSeries	*series);
+guint		 gpm_graph_series_get_length		(GpmGraphSeries	*series);
+void		 gpm_graph_series_get			(GpmGraphSeries	*series,
+							 guint		 index,
+							 GpmPointObj	*point);
+gboolean	 gpm_graph_series_append		(GpmGraphSeries	*series,
+							 gfloat		 x,
+							 gfloat		 y,
+							 guint32	 color,
+							 GpmPointObj	*evicted);
+gboolean	 gpm_graph_series_compact		(GpmGraphSeries	*series);
+gboolean	 gpm_graph_series_get_bounds		(GpmGraphSeries	*series,
+							 gfloat		*min_x,
+							 gfloat		*max_x,
+							 gfloat		*min_y,
+							 gfloat		*max_y);
+gboolean	 gpm_graph_series_get_range		(GpmGraphSeries	*series,
+							 gfloat		 x1,
+							 gfloat		 x2,
+							 guint		*first,
+							 guint		*last);
+void		 gpm_graph_series_set_gap		(GpmGraphSeries	*series,
+							 gfloat		 gap);
+gfloat		 gpm_graph_series_get_gap		(GpmGraphSeries	*series);
+const guint	*gpm_graph_series_get_breaks		(GpmGraphSeries	*series,
+							 guint		*n_breaks);
+const GpmPointObj *gpm_graph_series_get_screen		(GpmGraphSeries	*series,
+							 const GpmGraphSeriesTransform *transform,
+							 guint		 first,
+							 guint		 last);
+
+G_END_DECLS
+
+#endif /* __GPM_GRAPH_SERIES_H */
@@ -21,111 +21,89 @@
 
 #include "config.h"
 #include <gtk/gtk.h>
+#include <string.h>
 #include <pango/pangocairo.h>
-#include <glib/gi18n.h>
-#include <stdlib.h>
-#include <math.h>
 
 #include "gpm-point-obj.h"
+#include "gpm-graph.h"
 #include "gpm-graph-widget.h"
+#include "gpm-trace.h"
 
 G_DEFINE_TYPE (GpmGraphWidget, gpm_graph_widget, GTK_TYPE_DRAWING_AREA);
 #define GPM_GRAPH_WIDGET_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), GPM_TYPE_GRAPH_WIDGET, GpmGraphWidgetPrivate))
-#define GPM_GRAPH_WIDGET_FONT "Sans 8"
+#define GPM_GRAPH_WIDGET_ZOOM_STEP	1.25f
+#define GPM_GRAPH_WIDGET_ZOOM_MAX	1000 /* of the whole x axis */
+#define GPM_GRAPH_WIDGET_HOVER_RADIUS	20 /* px */
+#define GPM_GRAPH_WIDGET_ANIMATION_TIME	200000 /* us */
 
 struct GpmGraphWidgetPrivate
 {
-	gboolean		 use_grid;
-	gboolean		 use_legend;
-	gboolean		 autorange_x;
-	gboolean		 autorange_y;
-
-	GSList			*key_data; /* lines */
-
-	gint			 stop_x;
-	gint			 stop_y;
-	gint			 start_x;
-	gint			 start_y;
-	gint			 box_x; /* size of the white box, not the widget */
-	gint			 box_y;
-	gint			 box_width;
-	gint			 box_height;
-
-	gfloat			 unit_x; /* 10th width of graph */
-	gfloat			 unit_y; /* 10th width of graph */
-
-	GpmGraphWidgetType	 type_x;
-	GpmGraphWidgetType	 type_y;
-	gchar			*title;
-
-	cairo_t			*cr;
-	PangoLayout 		*layout;
+	GpmGraph		*graph; /* the data, and how it is drawn */
+	gulong			 damage_id;
+	gulong			 damage_area_id;
+
+	gboolean		 use_viewport;
+	gboolean		 use_hover;
+	gboolean		 show_render_stats;
+	gboolean		 use_animation;
+
+	gboolean		 viewport_active; /* zoomed or panned */
+	gfloat			 view_start_x; /* the visible part of the x axis */
+	gfloat			 view_stop_x;
+	gboolean		 dragging;
+	gdouble			 drag_x; /* where the pointer was pressed */
+	gfloat			 drag_start_x; /* view_start_x when pressed */
+
+	/* changes to the axes move from what was last shown, in the order
+	 * start x, stop x, start y, stop y */
+	guint			 anim_tick_id; /* 0 if not animating */
+	gint64			 anim_start; /* frame time, us */
+	gboolean		 anim_valid; /* anim_shown is on the screen */
+	GpmGraphType		 anim_type_x; /* of the axes in anim_shown */
+	GpmGraphType		 anim_type_y;
+	gfloat			 anim_from[4];
+	gfloat			 anim_to[4];
+	gfloat			 anim_shown[4];
+
+	/* everything apart from the hover overlay is cached */
+	cairo_surface_t		*layer;
+	gint			 layer_width;
+	gint			 layer_height;
+	gboolean		 layer_valid;
+	cairo_region_t		*layer_damage; /* stale parts of a valid layer */
+
+	gboolean		 hover_active;
+	GpmPointObj		 hover_point;
+	GdkRectangle		 hover_rect; /* covers everything last drawn */
+
+	/* what the last frame did, for show-render-stats */
+	gint64			 stats_frame_time; /* us */
+	GpmGraphCache		 stats_layer;
+	GdkRectangle		 stats_rect;
 
-	GPtrArray		*data_list;
-	GPtrArray		*plot_list;
+	PangoLayout 		*layout;
 };
 
 static gboolean gpm_graph_widget_draw (GtkWidget *widget, cairo_t *cr);
+static gboolean gpm_graph_widget_scroll_event (GtkWidget *widget, GdkEventScroll *event);
+static gboolean gpm_graph_widget_button_press_event (GtkWidget *widget, GdkEventButton *event);
+static gboolean gpm_graph_widget_button_release_event (GtkWidget *widget, GdkEventButton *event);
+static gboolean gpm_graph_widget_motion_notify_event (GtkWidget *widget, GdkEventMotion *event);
+static gboolean gpm_graph_widget_leave_notify_event (GtkWidget *widget, GdkEventCrossing *event);
+static void	gpm_graph_widget_set_hover (GpmGraphWidget *graph, gboolean active, const GpmPointObj *point);
 static void	gpm_graph_widget_finalize (GObject *object);
+static void	gpm_graph_widget_animation_stop (GpmGraphWidget *graph);
+static void	gpm_graph_widget_queue_damage (GpmGraphWidget *graph, GpmGraphDamage damage);
 
 enum
 {
 	PROP_0,
-	PROP_USE_LEGEND,
-	PROP_USE_GRID,
-	PROP_TYPE_X,
-	PROP_TYPE_Y,
-	PROP_AUTORANGE_X,
-	PROP_AUTORANGE_Y,
-	PROP_START_X,
-	PROP_START_Y,
-	PROP_STOP_X,
-	PROP_STOP_Y,
+	PROP_USE_VIEWPORT,
+	PROP_USE_HOVER,
+	PROP_SHOW_RENDER_STATS,
+	PROP_USE_ANIMATION,
 };
 
-/**
- * gpm_graph_widget_key_data_clear:
- **/
-static gboolean
-gpm_graph_widget_key_data_clear (GpmGraphWidget *graph)
-{
-	GpmGraphWidgetKeyData *keyitem;
-	guint i;
-
-	g_return_val_if_fail (GPM_IS_GRAPH_WIDGET (graph), FALSE);
-
-	/* remove items in list and free */
-	for (i=0; i<g_slist_length (graph->priv->key_data); i++) {
-		keyitem = (GpmGraphWidgetKeyData *) g_slist_nth_data (graph->priv->key_data, i);
-		g_free (keyitem->desc);
-		g_free (keyitem);
-	}
-	g_slist_free (graph->priv->key_data);
-	graph->priv->key_data = NULL;
-
-	return TRUE;
-}
-
-/**
- * gpm_graph_widget_key_data_add:
- **/
-gboolean
-gpm_graph_widget_key_data_add (GpmGraphWidget *graph, guint32 color, const gchar *desc)
-{
-	GpmGraphWidgetKeyData *keyitem;
-
-	g_return_val_if_fail (GPM_IS_GRAPH_WIDGET (graph), FALSE);
-
-	g_debug ("add to list %s", desc);
-	keyitem = g_new0 (GpmGraphWidgetKeyData, 1);
-
-	keyitem->color = color;
-	keyitem->desc = g_strdup (desc);
-
-	graph->priv->key_data = g_slist_append (graph->priv->key_data, (gpointer) keyitem);
-	return TRUE;
-}
-
 /**
  * up_graph_get_property:
  **/
@@ -134,35 +112,17 @@ up_graph_get_property (GObject *object, guint prop_id, GValue *value, GParamSpec
 {
 	GpmGraphWidget *graph = GPM_GRAPH_WIDGET (object);
 	switch (prop_id) {
-	case PROP_USE_LEGEND:
-		g_value_set_boolean (value, graph->priv->use_legend);
-		break;
-	case PROP_USE_GRID:
-		g_value_set_boolean (value, graph->priv->use_grid);
-		break;
-	case PROP_TYPE_X:
-		g_value_set_uint (value, graph->priv->type_x);
-		break;
-	case PROP_TYPE_Y:
-		g_value_set_uint (value, graph->priv->type_y);
+	case PROP_USE_VIEWPORT:
+		g_value_set_boolean (value, graph->priv->use_viewport);
 		break;
-	case PROP_AUTORANGE_X:
-		g_value_set_boolean (value, graph->priv->autorange_x);
+	case PROP_USE_HOVER:
+		g_value_set_boolean (value, graph->priv->use_hover);
 		break;
-	case PROP_AUTORANGE_Y:
-		g_value_set_boolean (value, graph->priv->autorange_y);
+	case PROP_SHOW_RENDER_STATS:
+		g_value_set_boolean (value, graph->priv->show_render_stats);
 		break;
-	case PROP_START_X:
-		g_value_set_int (value, graph->priv->start_x);
-		break;
-	case PROP_START_Y:
-		g_value_set_int (value, graph->priv->start_y);
-		break;
-	case PROP_STOP_X:
-		g_value_set_int (value, graph->priv->stop_x);
-		break;
-	case PROP_STOP_Y:
-		g_value_set_int (value, graph->priv->stop_y);
+	case PROP_USE_ANIMATION:
+		g_value_set_boolean (value, graph->priv->use_animation);
 		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -179,44 +139,31 @@ up_graph_set_property (GObject *object, guint prop_id, const GValue *value, GPar
 	GpmGraphWidget *graph = GPM_GRAPH_WIDGET (object);
 
 	switch (prop_id) {
-	case PROP_USE_LEGEND:
-		graph->priv->use_legend = g_value_get_boolean (value);
-		break;
-	case PROP_USE_GRID:
-		graph->priv->use_grid = g_value_get_boolean (value);
-		break;
-	case PROP_TYPE_X:
-		graph->priv->type_x = g_value_get_uint (value);
-		break;
-	case PROP_TYPE_Y:
-		graph->priv->type_y = g_value_get_uint (value);
-		break;
-	case PROP_AUTORANGE_X:
-		graph->priv->autorange_x = g_value_get_boolean (value);
-		break;
-	case PROP_AUTORANGE_Y:
-		graph->priv->autorange_y = g_value_get_boolean (value);
-		break;
-	case PROP_START_X:
-		graph->priv->start_x = g_value_get_int (value);
+	case PROP_USE_VIEWPORT:
+		graph->priv->use_viewport = g_value_get_boolean (value);
+		graph->priv->viewport_active = FALSE;
+		graph->priv->dragging = FALSE;
+		gpm_graph_widget_queue_damage (graph, GPM_GRAPH_DAMAGE_DATA |
+						      GPM_GRAPH_DAMAGE_LABELS_X);
 		break;
-	case PROP_START_Y:
-		graph->priv->start_y = g_value_get_int (value);
+	case PROP_USE_HOVER:
+		graph->priv->use_hover = g_value_get_boolean (value);
+		gpm_graph_widget_set_hover (graph, FALSE, NULL);
 		break;
-	case PROP_STOP_X:
-		graph->priv->stop_x = g_value_get_int (value);
+	case PROP_SHOW_RENDER_STATS:
+		/* only the overlay changes */
+		graph->priv->show_render_stats = g_value_get_boolean (value);
+		gtk_widget_queue_draw (GTK_WIDGET (graph));
 		break;
-	case PROP_STOP_Y:
-		graph->priv->stop_y = g_value_get_int (value);
+	case PROP_USE_ANIMATION:
+		/* only later changes are animated */
+		graph->priv->use_animation = g_value_get_boolean (value);
+		gpm_graph_widget_animation_stop (graph);
 		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
 		break;
 	}
-
-	/* refresh widget */
-	gtk_widget_hide (GTK_WIDGET (graph));
-	gtk_widget_show (GTK_WIDGET (graph));
 }
 
 /**
@@ -230,114 +177,173 @@ gpm_graph_widget_class_init (GpmGraphWidgetClass *class)
 	GObjectClass *object_class = G_OBJECT_CLASS (class);
 
 	widget_class->draw = gpm_graph_widget_draw;
+	widget_class->scroll_event = gpm_graph_widget_scroll_event;
+	widget_class->button_press_event = gpm_graph_widget_button_press_event;
+	widget_class->button_release_event = gpm_graph_widget_button_release_event;
+	widget_class->motion_notify_event = gpm_graph_widget_motion_notify_event;
+	widget_class->leave_notify_event = gpm_graph_widget_leave_notify_event;
 	object_class->get_property = up_graph_get_property;
 	object_class->set_property = up_graph_set_property;
 	object_class->finalize = gpm_graph_widget_finalize;
 
 	g_type_class_add_private (class, sizeof (GpmGraphWidgetPrivate));
 
-	/* properties */
+	/* zoom with the mouse wheel and pan by dragging */
 	g_object_class_install_property (object_class,
-					 PROP_USE_LEGEND,
-					 g_param_spec_boolean ("use-legend", NULL, NULL,
+					 PROP_USE_VIEWPORT,
+					 g_param_spec_boolean ("use-viewport", NULL, NULL,
 							       FALSE,
 							       G_PARAM_READWRITE));
+
+	/* show the nearest point to the pointer */
 	g_object_class_install_property (object_class,
-					 PROP_USE_GRID,
-					 g_param_spec_boolean ("use-grid", NULL, NULL,
-							       TRUE,
+					 PROP_USE_HOVER,
+					 g_param_spec_boolean ("use-hover", NULL, NULL,
+							       FALSE,
 							       G_PARAM_READWRITE));
+
+	/* show how long the last frame took, and what was drawn */
 	g_object_class_install_property (object_class,
-					 PROP_TYPE_X,
-					 g_param_spec_uint ("type-x", NULL, NULL,
-							    GPM_GRAPH_WIDGET_TYPE_INVALID,
-							    GPM_GRAPH_WIDGET_TYPE_UNKNOWN,
-							    GPM_GRAPH_WIDGET_TYPE_TIME,
-							    G_PARAM_READWRITE));
-	g_object_class_install_property (object_class,
-					 PROP_TYPE_Y,
-					 g_param_spec_uint ("type-y", NULL, NULL,
-							    GPM_GRAPH_WIDGET_TYPE_INVALID,
-							    GPM_GRAPH_WIDGET_TYPE_UNKNOWN,
-							    GPM_GRAPH_WIDGET_TYPE_PERCENTAGE,
-							    G_PARAM_READWRITE));
-	g_object_class_install_property (object_class,
-					 PROP_AUTORANGE_X,
-					 g_param_spec_boolean ("autorange-x", NULL, NULL,
-							       TRUE,
+					 PROP_SHOW_RENDER_STATS,
+					 g_param_spec_boolean ("show-render-stats", NULL, NULL,
+							       FALSE,
 							       G_PARAM_READWRITE));
+
+	/* move smoothly to a new range rather than jump */
 	g_object_class_install_property (object_class,
-					 PROP_AUTORANGE_Y,
-					 g_param_spec_boolean ("autorange-y", NULL, NULL,
-							       TRUE,
+					 PROP_USE_ANIMATION,
+					 g_param_spec_boolean ("use-animation", NULL, NULL,
+							       FALSE,
 							       G_PARAM_READWRITE));
-	g_object_class_install_property (object_class,
-					 PROP_START_X,
-					 g_param_spec_int ("start-x", NULL, NULL,
-							   G_MININT, G_MAXINT, 0,
-							   G_PARAM_READWRITE));
-	g_object_class_install_property (object_class,
-					 PROP_START_Y,
-					 g_param_spec_int ("start-y", NULL, NULL,
-							   G_MININT, G_MAXINT, 0,
-							   G_PARAM_READWRITE));
-	g_object_class_install_property (object_class,
-					 PROP_STOP_X,
-					 g_param_spec_int ("stop-x", NULL, NULL,
-							   G_MININT, G_MAXINT, 60,
-							   G_PARAM_READWRITE));
-	g_object_class_install_property (object_class,
-					 PROP_STOP_Y,
-					 g_param_spec_int ("stop-y", NULL, NULL,
-							   G_MININT, G_MAXINT, 100,
-							   G_PARAM_READWRITE));
 }
 
 /**
- * gpm_graph_widget_init:
+ * gpm_graph_widget_queue_layer_area:
  * @graph: This class instance
+ *
+ * Marks part of the cached graph as stale, and queues it to be drawn.
  **/
 static void
-gpm_graph_widget_init (GpmGraphWidget *graph)
+gpm_graph_widget_queue_layer_area (GpmGraphWidget *graph, gint x, gint y, gint width, gint height)
 {
-	PangoContext *context;
-	PangoFontDescription *desc;
+	cairo_rectangle_int_t rect;
+	rect.x = x;
+	rect.y = y;
+	rect.width = width;
+	rect.height = height;
+	cairo_region_union_rectangle (graph->priv->layer_damage, &rect);
+	gtk_widget_queue_draw_area (GTK_WIDGET (graph), x, y, width, height);
+
+	/* the stats are for the frame that draws this */
+	if (graph->priv->show_render_stats && graph->priv->stats_rect.width > 0)
+		gtk_widget_queue_draw_area (GTK_WIDGET (graph),
+					    graph->priv->stats_rect.x,
+					    graph->priv->stats_rect.y,
+					    graph->priv->stats_rect.width,
+					    graph->priv->stats_rect.height);
+}
 
-	graph->priv = GPM_GRAPH_WIDGET_GET_PRIVATE (graph);
-	graph->priv->start_x = 0;
-	graph->priv->start_y = 0;
-	graph->priv->stop_x = 60;
-	graph->priv->stop_y = 100;
-	graph->priv->use_grid = TRUE;
-	graph->priv->use_legend = FALSE;
-	graph->priv->data_list = g_ptr_array_new_with_free_func ((GDestroyNotify) g_ptr_array_unref);
-	graph->priv->plot_list = g_ptr_array_new ();
-	graph->priv->key_data = NULL;
-	graph->priv->type_x = GPM_GRAPH_WIDGET_TYPE_TIME;
-	graph->priv->type_y = GPM_GRAPH_WIDGET_TYPE_PERCENTAGE;
+/**
+ * gpm_graph_widget_queue_layer_all:
+ * @graph: This class instance
+ *
+ * Marks all of the cached graph as stale, and queues it to be drawn.
+ **/
+static void
+gpm_graph_widget_queue_layer_all (GpmGraphWidget *graph)
+{
+	graph->priv->layer_valid = FALSE;
+	gtk_widget_queue_draw (GTK_WIDGET (graph));
+}
 
-	/* do pango stuff */
-	context = gtk_widget_get_pango_context (GTK_WIDGET (graph));
-	pango_context_set_base_gravity (context, PANGO_GRAVITY_AUTO);
+/**
+ * gpm_graph_widget_queue_damage:
+ * @graph: This class instance
+ * @damage: The parts of the widget that are stale
+ *
+ * Only redraw the parts of the widget that have changed, using the positions
+ * from the last time we were drawn.
+ **/
+static void
+gpm_graph_widget_queue_damage (GpmGraphWidget *graph, GpmGraphDamage damage)
+{
+	GtkWidget *widget = GTK_WIDGET (graph);
+	cairo_rectangle_int_t box;
+	cairo_rectangle_int_t legend;
+	gint bottom;
+	gint width;
+	gint height;
+
+	/* we don't know where anything is until we've been drawn */
+	gpm_graph_get_box (graph->priv->graph, &box);
+	if (damage == GPM_GRAPH_DAMAGE_ALL || box.width == 0) {
+		gpm_graph_widget_queue_layer_all (graph);
+		return;
+	}
 
-	graph->priv->layout = pango_layout_new (context);
-	desc = pango_font_description_from_string (GPM_GRAPH_WIDGET_FONT);
-	pango_layout_set_font_description (graph->priv->layout, desc);
-	pango_font_description_free (desc);
+	width = gtk_widget_get_allocated_width (widget);
+	height = gtk_widget_get_allocated_height (widget);
+	bottom = box.y + box.height;
+	gpm_graph_get_legend_rect (graph->priv->graph, &legend);
+	if (damage & GPM_GRAPH_DAMAGE_DATA)
+		gpm_graph_widget_queue_layer_area (graph, box.x, box.y, box.width, box.height);
+	if (damage & GPM_GRAPH_DAMAGE_LABELS_X)
+		gpm_graph_widget_queue_layer_area (graph, 0, bottom, width, height - bottom);
+	if (damage & GPM_GRAPH_DAMAGE_LABELS_Y)
+		gpm_graph_widget_queue_layer_area (graph, 0, 0, box.x, height);
+	if (damage & GPM_GRAPH_DAMAGE_LEGEND && legend.width > 0)
+		gpm_graph_widget_queue_layer_area (graph, legend.x, legend.y,
+						   legend.width, legend.height);
 }
 
 /**
- * gpm_graph_widget_data_clear:
+ * gpm_graph_widget_damage_cb:
+ *
+ * The data or the axes have changed. Any hovered point may have moved or
+ * gone, so it is hidden until the pointer moves again.
  **/
-gboolean
-gpm_graph_widget_data_clear (GpmGraphWidget *graph)
+static void
+gpm_graph_widget_damage_cb (GpmGraph *graph, GpmGraphDamage damage, GpmGraphWidget *widget)
 {
-	g_return_val_if_fail (GPM_IS_GRAPH_WIDGET (graph), FALSE);
+	if (damage & GPM_GRAPH_DAMAGE_DATA)
+		gpm_graph_widget_set_hover (widget, FALSE, NULL);
+	gpm_graph_widget_queue_damage (widget, damage);
+}
 
-	g_ptr_array_set_size (graph->priv->data_list, 0);
-	g_ptr_array_set_size (graph->priv->plot_list, 0);
+/**
+ * gpm_graph_widget_damage_area_cb:
+ **/
+static void
+gpm_graph_widget_damage_area_cb (GpmGraph *graph, cairo_rectangle_int_t *area, GpmGraphWidget *widget)
+{
+	gpm_graph_widget_queue_layer_area (widget, area->x, area->y, area->width, area->height);
+}
 
-	return TRUE;
+/**
+ * gpm_graph_widget_init:
+ * @graph: This class instance
+ **/
+static void
+gpm_graph_widget_init (GpmGraphWidget *graph)
+{
+	graph->priv = GPM_GRAPH_WIDGET_GET_PRIVATE (graph);
+	graph->priv->graph = gpm_graph_new ();
+	graph->priv->damage_id =
+		g_signal_connect (graph->priv->graph, "damage",
+				  G_CALLBACK (gpm_graph_widget_damage_cb), graph);
+	graph->priv->damage_area_id =
+		g_signal_connect (graph->priv->graph, "damage-area",
+				  G_CALLBACK (gpm_graph_widget_damage_area_cb), graph);
+	gtk_widget_add_events (GTK_WIDGET (graph),
+			       GDK_SCROLL_MASK |
+			       GDK_BUTTON_PRESS_MASK |
+			       GDK_BUTTON_RELEASE_MASK |
+			       GDK_POINTER_MOTION_MASK |
+			       GDK_LEAVE_NOTIFY_MASK);
+	graph->priv->layer_damage = cairo_region_create ();
+
+	/* the layout is created when we first draw */
+	graph->priv->layout = NULL;
 }
 
 /**
@@ -349,778 +355,557 @@ gpm_graph_widget_finalize (GObject *object)
 {
 	GpmGraphWidget *graph = (GpmGraphWidget*) object;
 
-	/* clear key and data */
-	gpm_graph_widget_key_data_clear (graph);
-	gpm_graph_widget_data_clear (graph);
+	g_signal_handler_disconnect (graph->priv->graph, graph->priv->damage_id);
+	g_signal_handler_disconnect (graph->priv->graph, graph->priv->damage_area_id);
+	g_object_unref (graph->priv->graph);
 
-	/* free data */
-	g_ptr_array_unref (graph->priv->data_list);
-	g_ptr_array_unref (graph->priv->plot_list);
-
-	g_object_unref (graph->priv->layout);
+	if (graph->priv->layout != NULL)
+		g_object_unref (graph->priv->layout);
+	if (graph->priv->layer != NULL)
+		cairo_surface_destroy (graph->priv->layer);
+	cairo_region_destroy (graph->priv->layer_damage);
 
 	G_OBJECT_CLASS (gpm_graph_widget_parent_class)->finalize (object);
 }
 
 /**
- * gpm_graph_widget_data_assign:
+ * gpm_graph_widget_get_graph:
  * @graph: This class instance
- * @data: an array of GpmPointObj's
  *
- * Sets the data for the graph
+ * Gets the data, the axes and the key that are shown, which are changed
+ * using the GpmGraph functions and properties.
+ *
+ * Return value: the graph, which belongs to the widget
  **/
-gboolean
-gpm_graph_widget_data_assign (GpmGraphWidget *graph, GpmGraphWidgetPlot plot, GPtrArray *data)
+GpmGraph *
+gpm_graph_widget_get_graph (GpmGraphWidget *graph)
 {
-	GPtrArray *copy;
-	GpmPointObj *obj;
-	guint i;
-
-	g_return_val_if_fail (data != NULL, FALSE);
-	g_return_val_if_fail (GPM_IS_GRAPH_WIDGET (graph), FALSE);
+	g_return_val_if_fail (GPM_IS_GRAPH_WIDGET (graph), NULL);
+	return graph->priv->graph;
+}
 
-	/* make a deep copy */
-	copy = g_ptr_array_new_with_free_func ((GDestroyNotify) gpm_point_obj_free);
-	for (i=0; i<data->len; i++) {
-		obj = gpm_point_obj_copy (g_ptr_array_index (data, i));
-		g_ptr_array_add (copy, obj);
+/**
+ * gpm_graph_widget_viewport_clamp:
+ * @graph: This class instance
+ *
+ * Keeps the visible part of the x axis inside the axis range, and shows the
+ * whole axis if we're not zoomed in.
+ **/
+static void
+gpm_graph_widget_viewport_clamp (GpmGraphWidget *graph)
+{
+	gint start_x, stop_x;
+	gfloat width;
+	gfloat full;
+	GpmGraphWidgetPrivate *priv = graph->priv;
+
+	gpm_graph_get_axes (priv->graph, &start_x, &stop_x, NULL, NULL);
+	full = stop_x - start_x;
+	width = priv->view_stop_x - priv->view_start_x;
+	if (!priv->use_viewport || !priv->viewport_active || width >= full) {
+		priv->viewport_active = FALSE;
+		priv->view_start_x = start_x;
+		priv->view_stop_x = stop_x;
+		return;
 	}
 
-	/* get the new data */
-	g_ptr_array_add (graph->priv->data_list, copy);
-	g_ptr_array_add (graph->priv->plot_list, GUINT_TO_POINTER(plot));
-
-	/* refresh */
-	gtk_widget_queue_draw (GTK_WIDGET (graph));
+	/* don't zoom in so far that there's nothing to see */
+	if (width < full / GPM_GRAPH_WIDGET_ZOOM_MAX)
+		width = full / GPM_GRAPH_WIDGET_ZOOM_MAX;
 
-	return TRUE;
+	/* slide back inside the axis */
+	if (priv->view_start_x < start_x)
+		priv->view_start_x = start_x;
+	if (priv->view_start_x + width > stop_x)
+		priv->view_start_x = stop_x - width;
+	priv->view_stop_x = priv->view_start_x + width;
 }
 
 /**
- * gpm_get_axis_label:
- * @axis: The axis type, e.g. GPM_GRAPH_WIDGET_TYPE_TIME
- * @value: The data value, e.g. 120
- *
- * Unit is:
- * GPM_GRAPH_WIDGET_TYPE_TIME:		seconds
- * GPM_GRAPH_WIDGET_TYPE_POWER: 	Wh (not Ah)
- * GPM_GRAPH_WIDGET_TYPE_PERCENTAGE:	%
+ * gpm_graph_widget_viewport_reset:
+ * @graph: This class instance
  *
- * Return value: a string value depending on the axis type and the value.
+ * Shows the whole x axis again, e.g. when the data is for a different range.
  **/
-static gchar *
-gpm_get_axis_label (GpmGraphWidgetType axis, gfloat value)
+void
+gpm_graph_widget_viewport_reset (GpmGraphWidget *graph)
 {
-	gchar *text = NULL;
-	if (axis == GPM_GRAPH_WIDGET_TYPE_TIME) {
-		gint time_s = abs((gint) value);
-		gint minutes = time_s / 60;
-		gint seconds = time_s - (minutes * 60);
-		gint hours = minutes / 60;
-		gint days = hours / 24;
-		minutes = minutes - (hours * 60);
-		hours = hours - (days * 24);
-		if (days > 0) {
-			if (hours == 0) {
-				/*Translators: This is %i days*/
-				text = g_strdup_printf (_("%id"), days);
-			} else {
-				/*Translators: This is %i days %02i hours*/
-				text = g_strdup_printf (_("%id%02ih"), days, hours);
-			}
-		} else if (hours > 0) {
-			if (minutes == 0) {
-				/*Translators: This is %i hours*/
-				text = g_strdup_printf (_("%ih"), hours);
-			} else {
-				/*Translators: This is %i hours %02i minutes*/
-				text = g_strdup_printf (_("%ih%02im"), hours, minutes);
-			}
-		} else if (minutes > 0) {
-			if (seconds == 0) {
-				/*Translators: This is %2i minutes*/
-				text = g_strdup_printf (_("%2im"), minutes);
-			} else {
-				/*Translators: This is %2i minutes %02i seconds*/
-				text = g_strdup_printf (_("%2im%02i"), minutes, seconds);
-			}
-		} else {
-			/*Translators: This is %2i seconds*/
-			text = g_strdup_printf (_("%2is"), seconds);
-		}
-	} else if (axis == GPM_GRAPH_WIDGET_TYPE_PERCENTAGE) {
-		/*Translators: This is %i Percentage*/
-		text = g_strdup_printf (_("%i%%"), (gint) value);
-	} else if (axis == GPM_GRAPH_WIDGET_TYPE_POWER) {
-		/*Translators: This is %.1f Watts*/
-		text = g_strdup_printf (_("%.1fW"), value);
-	} else if (axis == GPM_GRAPH_WIDGET_TYPE_FACTOR) {
-		text = g_strdup_printf ("%.1f", value);
-	} else if (axis == GPM_GRAPH_WIDGET_TYPE_VOLTAGE) {
-		/*Translators: This is %.1f Volts*/
-		text = g_strdup_printf (_("%.1fV"), value);
-	} else {
-		text = g_strdup_printf ("%i", (gint) value);
-	}
-	return text;
+	g_return_if_fail (GPM_IS_GRAPH_WIDGET (graph));
+
+	if (!graph->priv->viewport_active)
+		return;
+	graph->priv->viewport_active = FALSE;
+	graph->priv->dragging = FALSE;
+	gpm_graph_widget_queue_damage (graph, GPM_GRAPH_DAMAGE_DATA |
+					      GPM_GRAPH_DAMAGE_LABELS_X);
 }
 
 /**
- * gpm_graph_widget_draw_grid:
- * @graph: This class instance
- * @cr: Cairo drawing context
+ * gpm_graph_widget_scroll_event:
  *
- * Draw the 10x10 dotted grid onto the graph.
+ * Zoom the x axis in or out around the pointer.
  **/
-static void
-gpm_graph_widget_draw_grid (GpmGraphWidget *graph, cairo_t *cr)
+static gboolean
+gpm_graph_widget_scroll_event (GtkWidget *widget, GdkEventScroll *event)
 {
-	guint i;
-	gfloat b;
-	gdouble dotted[] = {1., 2.};
-	gfloat divwidth  = (gfloat)graph->priv->box_width / 10.0f;
-	gfloat divheight = (gfloat)graph->priv->box_height / 10.0f;
-
-	cairo_save (cr);
+	gfloat factor;
+	gfloat pointer_x;
+	cairo_rectangle_int_t box;
+	GpmGraphWidget *graph = (GpmGraphWidget*) widget;
+	GpmGraphWidgetPrivate *priv = graph->priv;
 
-	cairo_set_line_width (cr, 1);
-	cairo_set_dash (cr, dotted, 2, 0.0);
+	gpm_graph_get_box (priv->graph, &box);
+	if (!priv->use_viewport || box.width == 0)
+		return FALSE;
 
-	/* do vertical lines */
-	cairo_set_source_rgb (cr, 0.1, 0.1, 0.1);
-	for (i=1; i<10; i++) {
-		b = graph->priv->box_x + ((gfloat) i * divwidth);
-		cairo_move_to (cr, (gint)b + 0.5f, graph->priv->box_y);
-		cairo_line_to (cr, (gint)b + 0.5f, graph->priv->box_y + graph->priv->box_height);
-		cairo_stroke (cr);
+	if (event->direction == GDK_SCROLL_UP) {
+		factor = 1.0f / GPM_GRAPH_WIDGET_ZOOM_STEP;
+	} else if (event->direction == GDK_SCROLL_DOWN) {
+		factor = GPM_GRAPH_WIDGET_ZOOM_STEP;
+	} else {
+		return FALSE;
 	}
 
-	/* do horizontal lines */
-	for (i=1; i<10; i++) {
-		b = graph->priv->box_y + ((gfloat) i * divheight);
-		cairo_move_to (cr, graph->priv->box_x, (gint)b + 0.5f);
-		cairo_line_to (cr, graph->priv->box_x + graph->priv->box_width, (int)b + 0.5f);
-		cairo_stroke (cr);
-	}
+	/* keep the value under the pointer in the same place */
+	gpm_graph_widget_animation_stop (graph);
+	pointer_x = gpm_graph_get_data_x (priv->graph, event->x);
+	priv->view_start_x = pointer_x - (pointer_x - priv->view_start_x) * factor;
+	priv->view_stop_x = pointer_x + (priv->view_stop_x - pointer_x) * factor;
+	priv->viewport_active = TRUE;
+	gpm_graph_widget_viewport_clamp (graph);
 
-	cairo_restore (cr);
+	gpm_graph_widget_queue_damage (graph, GPM_GRAPH_DAMAGE_DATA |
+					      GPM_GRAPH_DAMAGE_LABELS_X);
+	return TRUE;
 }
 
 /**
- * gpm_graph_widget_draw_labels:
- * @graph: This class instance
- * @cr: Cairo drawing context
+ * gpm_graph_widget_button_press_event:
  *
- * Draw the X and the Y labels onto the graph.
+ * Start panning, or show the whole x axis on a double click.
  **/
-static void
-gpm_graph_widget_draw_labels (GpmGraphWidget *graph, cairo_t *cr)
+static gboolean
+gpm_graph_widget_button_press_event (GtkWidget *widget, GdkEventButton *event)
 {
-	guint i;
-	gfloat b;
-	gchar *text;
-	gfloat value;
-	gfloat divwidth  = (gfloat)graph->priv->box_width / 10.0f;
-	gfloat divheight = (gfloat)graph->priv->box_height / 10.0f;
-	gint length_x = graph->priv->stop_x - graph->priv->start_x;
-	gint length_y = graph->priv->stop_y - graph->priv->start_y;
-	PangoRectangle ink_rect, logical_rect;
-	gfloat offsetx = 0;
-	gfloat offsety = 0;
-
-	cairo_save (cr);
-
-	/* do x text */
-	cairo_set_source_rgb (cr, 0, 0, 0);
-	for (i=0; i<11; i++) {
-		b = graph->priv->box_x + ((gfloat) i * divwidth);
-		value = ((length_x / 10.0f) * (gfloat) i) + (gfloat) graph->priv->start_x;
-		text = gpm_get_axis_label (graph->priv->type_x, value);
-
-		pango_layout_set_text (graph->priv->layout, text, -1);
-		pango_layout_get_pixel_extents (graph->priv->layout, &ink_rect, &logical_rect);
-		/* have data points 0 and 10 bounded, but 1..9 centered */
-		if (i == 0)
-			offsetx = 2.0;
-		else if (i == 10)
-			offsetx = ink_rect.width;
-		else
-			offsetx = (ink_rect.width / 2.0f);
-
-		cairo_move_to (cr, b - offsetx,
-			       graph->priv->box_y + graph->priv->box_height + 2.0);
-
-		pango_cairo_show_layout (cr, graph->priv->layout);
-		g_free (text);
-	}
-
-	/* do y text */
-	for (i=0; i<11; i++) {
-		b = graph->priv->box_y + ((gfloat) i * divheight);
-		value = ((gfloat) length_y / 10.0f) * (10 - (gfloat) i) + graph->priv->start_y;
-		text = gpm_get_axis_label (graph->priv->type_y, value);
-
-		pango_layout_set_text (graph->priv->layout, text, -1);
-		pango_layout_get_pixel_extents (graph->priv->layout, &ink_rect, &logical_rect);
+	GpmGraphWidget *graph = (GpmGraphWidget*) widget;
 
-		/* have data points 0 and 10 bounded, but 1..9 centered */
-		if (i == 10)
-			offsety = 0;
-		else if (i == 0)
-			offsety = ink_rect.height;
-		else
-			offsety = (ink_rect.height / 2.0f);
-		offsetx = ink_rect.width + 7;
-		offsety -= 10;
-		cairo_move_to (cr, graph->priv->box_x - offsetx - 2, b + offsety);
-		pango_cairo_show_layout (cr, graph->priv->layout);
-		g_free (text);
+	if (!graph->priv->use_viewport || event->button != 1)
+		return FALSE;
+	if (event->type == GDK_2BUTTON_PRESS) {
+		gpm_graph_widget_viewport_reset (graph);
+		return TRUE;
 	}
-
-	cairo_restore (cr);
+	if (!graph->priv->viewport_active)
+		return FALSE;
+	gpm_graph_widget_animation_stop (graph);
+	graph->priv->dragging = TRUE;
+	graph->priv->drag_x = event->x;
+	graph->priv->drag_start_x = graph->priv->view_start_x;
+	return TRUE;
 }
 
 /**
- * gpm_color_to_rgb:
- * @red: The red value
- * @green: The green value
- * @blue: The blue value
+ * gpm_graph_widget_button_release_event:
  **/
-static void
-gpm_color_to_rgb (guint32 color, guint8 *red, guint8 *green, guint8 *blue)
+static gboolean
+gpm_graph_widget_button_release_event (GtkWidget *widget, GdkEventButton *event)
 {
-	*red = (color & 0xff0000) / 0x10000;
-	*green = (color & 0x00ff00) / 0x100;
-	*blue = color & 0x0000ff;
+	GpmGraphWidget *graph = (GpmGraphWidget*) widget;
+	if (!graph->priv->dragging || event->button != 1)
+		return FALSE;
+	graph->priv->dragging = FALSE;
+	return TRUE;
 }
 
 /**
- * gpm_graph_widget_get_y_label_max_width:
+ * gpm_graph_widget_get_hover_rect:
  * @graph: This class instance
- * @cr: Cairo drawing context
+ * @rect: The returned position of the label
  *
- * Draw the X and the Y labels onto the graph.
+ * Sets the layout to the text for the hovered point, e.g. "2h10m 12.3W
+ * Charging", and works out where the label goes next to the point.
  **/
-static guint
-gpm_graph_widget_get_y_label_max_width (GpmGraphWidget *graph, cairo_t *cr)
+static void
+gpm_graph_widget_get_hover_rect (GpmGraphWidget *graph, GdkRectangle *rect)
 {
-	guint i;
 	gchar *text;
-	gint value;
-	gint length_y = graph->priv->stop_y - graph->priv->start_y;
+	gfloat x, y;
+	cairo_rectangle_int_t box;
 	PangoRectangle ink_rect, logical_rect;
-	guint biggest = 0;
-
-	/* do y text */
-	for (i=0; i<11; i++) {
-		value = (length_y / 10) * (10 - (gfloat) i) + graph->priv->start_y;
-		text = gpm_get_axis_label (graph->priv->type_y, value);
-		pango_layout_set_text (graph->priv->layout, text, -1);
-		pango_layout_get_pixel_extents (graph->priv->layout, &ink_rect, &logical_rect);
-		if (ink_rect.width > (gint) biggest)
-			biggest = ink_rect.width;
-		g_free (text);
-	}
-	return biggest;
+	GpmGraphWidgetPrivate *priv = graph->priv;
+
+	text = gpm_graph_get_point_label (priv->graph, &priv->hover_point);
+	pango_layout_set_text (priv->layout, text, -1);
+	pango_layout_get_pixel_extents (priv->layout, &ink_rect, &logical_rect);
+
+	/* above and to the right of the point, unless that's off the graph */
+	gpm_graph_get_box (priv->graph, &box);
+	gpm_graph_get_pos_on_graph (priv->graph, priv->hover_point.x, priv->hover_point.y, &x, &y);
+	rect->width = logical_rect.width + 8;
+	rect->height = logical_rect.height + 4;
+	rect->x = x + 8;
+	rect->y = y - 8 - rect->height;
+	if (rect->x + rect->width > box.x + box.width)
+		rect->x = x - 8 - rect->width;
+	if (rect->y < box.y)
+		rect->y = y + 8;
+
+	/* a wide label near the left edge still has to be on the widget */
+	rect->x = MAX (MIN (rect->x, gtk_widget_get_allocated_width (GTK_WIDGET (graph)) - rect->width), 0);
+	rect->y = MAX (MIN (rect->y, gtk_widget_get_allocated_height (GTK_WIDGET (graph)) - rect->height), 0);
+
+	g_free (text);
 }
 
 /**
- * gpm_round_up:
- * @value: The input value
- * @smallest: The smallest increment allowed
+ * gpm_graph_widget_set_hover:
+ * @graph: This class instance
+ * @active: If there is a point under the pointer
+ * @point: The point, or %NULL
  *
- * 101, 10	110
- * 95,  10	100
- * 0,   10	0
- * 112, 10	120
- * 100, 10	100
+ * Redraws the old and new crosshair. This does not touch the cached graph
+ * so the series are not drawn again.
  **/
-static gint
-gpm_round_up (gfloat value, gint smallest)
+static void
+gpm_graph_widget_set_hover (GpmGraphWidget *graph, gboolean active, const GpmPointObj *point)
 {
-	gfloat division;
-	if (fabs (value) < 0.01)
-		return 0;
-	if (smallest == 0) {
-		g_warning ("divisor zero");
-		return 0;
-	}
-	division = (gfloat) value / (gfloat) smallest;
-	division = ceilf (division);
-	division *= smallest;
-	return (gint) division;
+	GtkWidget *widget = GTK_WIDGET (graph);
+	GpmGraphWidgetPrivate *priv = graph->priv;
+	GdkRectangle rect;
+
+	/* nothing changed */
+	if (!active && !priv->hover_active)
+		return;
+	if (active && priv->hover_active &&
+	    point->x == priv->hover_point.x &&
+	    point->y == priv->hover_point.y)
+		return;
+
+	/* the old crosshair */
+	if (priv->hover_active)
+		gtk_widget_queue_draw_area (widget, priv->hover_rect.x, priv->hover_rect.y,
+					    priv->hover_rect.width, priv->hover_rect.height);
+
+	priv->hover_active = active;
+	if (!active)
+		return;
+	priv->hover_point = *point;
+
+	/* the crosshair covers the box, plus the label */
+	gpm_graph_widget_get_hover_rect (graph, &rect);
+	gpm_graph_get_box (priv->graph, &priv->hover_rect);
+	gdk_rectangle_union (&priv->hover_rect, &rect, &priv->hover_rect);
+	priv->hover_rect.x -= GPM_GRAPH_DAMAGE_PAD;
+	priv->hover_rect.y -= GPM_GRAPH_DAMAGE_PAD;
+	priv->hover_rect.width += 2 * GPM_GRAPH_DAMAGE_PAD;
+	priv->hover_rect.height += 2 * GPM_GRAPH_DAMAGE_PAD;
+	gtk_widget_queue_draw_area (widget, priv->hover_rect.x, priv->hover_rect.y,
+				    priv->hover_rect.width, priv->hover_rect.height);
 }
 
 /**
- * gpm_round_down:
- * @value: The input value
- * @smallest: The smallest increment allowed
- *
- * 101, 10	100
- * 95,  10	90
- * 0,   10	0
- * 112, 10	110
- * 100, 10	100
+ * gpm_graph_widget_leave_notify_event:
  **/
-static gint
-gpm_round_down (gfloat value, gint smallest)
+static gboolean
+gpm_graph_widget_leave_notify_event (GtkWidget *widget, GdkEventCrossing *event)
 {
-	gfloat division;
-	if (fabs (value) < 0.01)
-		return 0;
-	if (smallest == 0) {
-		g_warning ("divisor zero");
-		return 0;
-	}
-	division = (gfloat) value / (gfloat) smallest;
-	division = floorf (division);
-	division *= smallest;
-	return (gint) division;
+	GpmGraphWidget *graph = (GpmGraphWidget*) widget;
+	gpm_graph_widget_set_hover (graph, FALSE, NULL);
+	return FALSE;
 }
 
 /**
- * gpm_graph_widget_autorange_x:
+ * gpm_graph_widget_draw_hover:
  * @graph: This class instance
+ * @cr: Cairo drawing context
  *
- * Autoranges the graph axis depending on the axis type, and the maximum
- * value of the data. We have to be careful to choose a number that gives good
- * resolution but also a number that scales "well" to a 10x10 grid.
+ * Draw the crosshair and the label for the point under the pointer.
  **/
 static void
-gpm_graph_widget_autorange_x (GpmGraphWidget *graph)
+gpm_graph_widget_draw_hover (GpmGraphWidget *graph, cairo_t *cr)
 {
-	gfloat biggest_x = G_MINFLOAT;
-	gfloat smallest_x = G_MAXFLOAT;
-	guint rounding_x = 1;
-	GPtrArray *data;
-	GpmPointObj *point;
-	guint i, j;
-	guint len = 0;
-	GPtrArray *array;
-
-	array = graph->priv->data_list;
-
-	/* find out if we have no data */
-	for (j=0; j<array->len; j++) {
-		data = g_ptr_array_index (array, j);
-		len = data->len;
-		if (len > 0)
-			break;
-	}
+	gfloat x, y;
+	gdouble dotted[] = {3., 3.};
+	GdkRectangle rect;
+	cairo_rectangle_int_t box;
+	GpmGraphWidgetPrivate *priv = graph->priv;
 
-	/* no data in any array */
-	if (len == 0) {
-		g_debug ("no data");
-		graph->priv->start_x = 0;
-		graph->priv->stop_x = 10;
-		return;
-	}
+	gpm_graph_get_box (priv->graph, &box);
+	gpm_graph_get_pos_on_graph (priv->graph, priv->hover_point.x, priv->hover_point.y, &x, &y);
 
-	/* get the range for the graph */
-	for (j=0; j<array->len; j++) {
-		data = g_ptr_array_index (array, j);
-		for (i=0; i < data->len; i++) {
-			point = (GpmPointObj *) g_ptr_array_index (data, i);
-			if (point->x > biggest_x)
-				biggest_x = point->x;
-			if (point->x < smallest_x)
-				smallest_x = point->x;
-		}
-	}
-	g_debug ("Data range is %f<x<%f", smallest_x, biggest_x);
-	/* don't allow no difference */
-	if (biggest_x - smallest_x < 0.0001) {
-		biggest_x++;
-		smallest_x--;
-	}
-
-	if (graph->priv->type_x == GPM_GRAPH_WIDGET_TYPE_PERCENTAGE) {
-		rounding_x = 10;
-	} else if (graph->priv->type_x == GPM_GRAPH_WIDGET_TYPE_FACTOR) {
-		rounding_x = 1;
-	} else if (graph->priv->type_x == GPM_GRAPH_WIDGET_TYPE_POWER) {
-		rounding_x = 10;
-	} else if (graph->priv->type_x == GPM_GRAPH_WIDGET_TYPE_VOLTAGE) {
-		rounding_x = 1000;
-	} else if (graph->priv->type_x == GPM_GRAPH_WIDGET_TYPE_TIME) {
-		if (biggest_x-smallest_x < 150)
-			rounding_x = 150;
-		else if (biggest_x-smallest_x < 5*60)
-			rounding_x = 5 * 60;
-		else
-			rounding_x = 10 * 60;
-	}
+	/* crosshair, keeping the clip from GTK for the label */
+	cairo_save (cr);
+	cairo_rectangle (cr, box.x, box.y, box.width, box.height);
+	cairo_clip (cr);
+	cairo_set_line_width (cr, 1);
+	cairo_set_dash (cr, dotted, 2, 0.0);
+	cairo_set_source_rgb (cr, 0.3, 0.3, 0.3);
+	cairo_move_to (cr, (gint) x + 0.5f, box.y);
+	cairo_line_to (cr, (gint) x + 0.5f, box.y + box.height);
+	cairo_move_to (cr, box.x, (gint) y + 0.5f);
+	cairo_line_to (cr, box.x + box.width, (gint) y + 0.5f);
+	cairo_stroke (cr);
+	cairo_set_dash (cr, NULL, 0, 0.0);
+	cairo_arc (cr, x, y, 3.0, 0, 2 * G_PI);
+	gpm_graph_set_color (cr, priv->hover_point.color);
+	cairo_fill_preserve (cr);
+	cairo_set_source_rgb (cr, 0, 0, 0);
+	cairo_stroke (cr);
+	cairo_restore (cr);
 
-	graph->priv->start_x = gpm_round_down (smallest_x, rounding_x);
-	graph->priv->stop_x = gpm_round_up (biggest_x, rounding_x);
-
-	g_debug ("Processed(1) range is %i<x<%i",
-		   graph->priv->start_x, graph->priv->stop_x);
-
-	/* if percentage, and close to the end points, then extend */
-	if (graph->priv->type_x == GPM_GRAPH_WIDGET_TYPE_PERCENTAGE) {
-		if (graph->priv->stop_x >= 90)
-			graph->priv->stop_x = 100;
-		if (graph->priv->start_x > 0 && graph->priv->start_x <= 10)
-			graph->priv->start_x = 0;
-	} else if (graph->priv->type_x == GPM_GRAPH_WIDGET_TYPE_TIME) {
-		if (graph->priv->start_x > 0 && graph->priv->start_x <= 60*10)
-			graph->priv->start_x = 0;
-	}
+	/* label */
+	cairo_save (cr);
+	gpm_graph_widget_get_hover_rect (graph, &rect);
+	gpm_graph_draw_bounding_box (cr, rect.x, rect.y, rect.width, rect.height);
+	cairo_move_to (cr, rect.x + 4, rect.y + 2);
+	cairo_set_source_rgb (cr, 0, 0, 0);
+	pango_cairo_show_layout (cr, priv->layout);
 
-	g_debug ("Processed range is %i<x<%i",
-		   graph->priv->start_x, graph->priv->stop_x);
+	cairo_restore (cr);
 }
 
 /**
- * gpm_graph_widget_autorange_y:
- * @graph: This class instance
+ * gpm_graph_widget_motion_notify_event:
  *
- * Autoranges the graph axis depending on the axis type, and the maximum
- * value of the data. We have to be careful to choose a number that gives good
- * resolution but also a number that scales "well" to a 10x10 grid.
+ * Pan the x axis with the pointer. Only the visible points are drawn so this
+ * is cheap even with a lot of data.
  **/
-static void
-gpm_graph_widget_autorange_y (GpmGraphWidget *graph)
+static gboolean
+gpm_graph_widget_motion_notify_event (GtkWidget *widget, GdkEventMotion *event)
 {
-	gfloat biggest_y = G_MINFLOAT;
-	gfloat smallest_y = G_MAXFLOAT;
-	guint rounding_y = 1;
-	GPtrArray *data;
-	GpmPointObj *point;
-	guint i, j;
-	guint len = 0;
-	GPtrArray *array;
-
-	array = graph->priv->data_list;
-
-	/* find out if we have no data */
-	for (j=0; j<array->len; j++) {
-		data = g_ptr_array_index (array, j);
-		len = data->len;
-		if (len > 0)
-			break;
-	}
-
-	/* no data in any array */
-	if (len == 0) {
-		g_debug ("no data");
-		graph->priv->start_y = 0;
-		graph->priv->stop_y = 10;
-		return;
-	}
-
-	/* get the range for the graph */
-	for (j=0; j<array->len; j++) {
-		data = g_ptr_array_index (array, j);
-		for (i=0; i < data->len; i++) {
-			point = (GpmPointObj *) g_ptr_array_index (data, i);
-			if (point->y > biggest_y)
-				biggest_y = point->y;
-			if (point->y < smallest_y)
-				smallest_y = point->y;
-		}
-	}
-	g_debug ("Data range is %f<y<%f", smallest_y, biggest_y);
-	/* don't allow no difference */
-	if (biggest_y - smallest_y < 0.0001) {
-		biggest_y++;
-		smallest_y--;
-	}
-
-	if (graph->priv->type_y == GPM_GRAPH_WIDGET_TYPE_PERCENTAGE) {
-		rounding_y = 10;
-	} else if (graph->priv->type_y == GPM_GRAPH_WIDGET_TYPE_FACTOR) {
-		rounding_y = 1;
-	} else if (graph->priv->type_y == GPM_GRAPH_WIDGET_TYPE_POWER) {
-		rounding_y = 10;
-	} else if (graph->priv->type_y == GPM_GRAPH_WIDGET_TYPE_VOLTAGE) {
-		rounding_y = 1000;
-	} else if (graph->priv->type_y == GPM_GRAPH_WIDGET_TYPE_TIME) {
-		if (biggest_y-smallest_y < 150)
-			rounding_y = 150;
-		else if (biggest_y < 5*60)
-			rounding_y = 5 * 60;
-		else
-			rounding_y = 10 * 60;
-	}
-
-	graph->priv->start_y = gpm_round_down (smallest_y, rounding_y);
-	graph->priv->stop_y = gpm_round_up (biggest_y, rounding_y);
-
-	/* a factor graph always is centered around zero */
-	if (graph->priv->type_y == GPM_GRAPH_WIDGET_TYPE_FACTOR) {
-		if (abs (graph->priv->stop_y) > abs (graph->priv->start_y))
-			graph->priv->start_y = -graph->priv->stop_y;
-		else
-			graph->priv->stop_y = -graph->priv->start_y;
+	gfloat width;
+	gfloat moved;
+	gboolean found;
+	cairo_rectangle_int_t box;
+	GpmPointObj point;
+	GpmGraphWidget *graph = (GpmGraphWidget*) widget;
+	GpmGraphWidgetPrivate *priv = graph->priv;
+
+	if (!priv->dragging) {
+		gpm_graph_get_box (priv->graph, &box);
+		if (!priv->use_hover || box.width == 0)
+			return FALSE;
+		found = gpm_graph_find_nearest (priv->graph, event->x, event->y,
+						GPM_GRAPH_WIDGET_HOVER_RADIUS, &point);
+		gpm_graph_widget_set_hover (graph, found, &point);
+		return TRUE;
 	}
 
-	g_debug ("Processed(1) range is %i<y<%i",
-		   graph->priv->start_y, graph->priv->stop_y);
-
-	if (graph->priv->type_y == GPM_GRAPH_WIDGET_TYPE_PERCENTAGE) {
-		if (graph->priv->stop_y >= 90)
-			graph->priv->stop_y = 100;
-		if (graph->priv->start_y > 0 && graph->priv->start_y <= 10)
-			graph->priv->start_y = 0;
-	} else if (graph->priv->type_y == GPM_GRAPH_WIDGET_TYPE_TIME) {
-		if (graph->priv->start_y <= 60*10)
-			graph->priv->start_y = 0;
-	}
+	/* the point moves with the data */
+	gpm_graph_widget_set_hover (graph, FALSE, NULL);
 
-	g_debug ("Processed range is %i<y<%i",
-		   graph->priv->start_y, graph->priv->stop_y);
-}
+	/* how far the pointer has moved in data units */
+	gpm_graph_widget_animation_stop (graph);
+	moved = gpm_graph_get_data_x (priv->graph, event->x) -
+		gpm_graph_get_data_x (priv->graph, priv->drag_x);
+	width = priv->view_stop_x - priv->view_start_x;
+	priv->view_start_x = priv->drag_start_x - moved;
+	priv->view_stop_x = priv->view_start_x + width;
+	gpm_graph_widget_viewport_clamp (graph);
 
-/**
- * gpm_graph_widget_set_color:
- * @cr: Cairo drawing context
- * @color: The color enum
- **/
-static void
-gpm_graph_widget_set_color (cairo_t *cr, guint32 color)
-{
-	guint8 r, g, b;
-	gpm_color_to_rgb (color, &r, &g, &b);
-	cairo_set_source_rgb (cr, ((gdouble) r)/256.0f, ((gdouble) g)/256.0f, ((gdouble) b)/256.0f);
+	gpm_graph_widget_queue_damage (graph, GPM_GRAPH_DAMAGE_DATA |
+					      GPM_GRAPH_DAMAGE_LABELS_X);
+	return TRUE;
 }
 
 /**
- * gpm_graph_widget_draw_legend_line:
- * @cr: Cairo drawing context
- * @x: The X-coordinate for the center
- * @y: The Y-coordinate for the center
- * @color: The color enum
+ * gpm_graph_widget_animation_tick_cb:
  *
- * Draw the legend line on the graph of a specified color
+ * Redraws everything that moves for each frame until the animation is over.
  **/
-static void
-gpm_graph_widget_draw_legend_line (cairo_t *cr, gfloat x, gfloat y, guint32 color)
+static gboolean
+gpm_graph_widget_animation_tick_cb (GtkWidget *widget, GdkFrameClock *clock, gpointer user_data)
 {
-	gfloat width = 10;
-	gfloat height = 2;
-	/* background */
-	cairo_rectangle (cr, (int) (x - (width/2)) + 0.5, (int) (y - (height/2)) + 0.5, width, height);
-	gpm_graph_widget_set_color (cr, color);
-	cairo_fill (cr);
-	/* solid outline box */
-	cairo_rectangle (cr, (int) (x - (width/2)) + 0.5, (int) (y - (height/2)) + 0.5, width, height);
-	cairo_set_source_rgb (cr, 0.1, 0.1, 0.1);
-	cairo_set_line_width (cr, 1);
-	cairo_stroke (cr);
-}
+	GpmGraphWidget *graph = (GpmGraphWidget*) widget;
 
-/**
- * gpm_graph_widget_get_pos_on_graph:
- * @graph: This class instance
- * @data_x: The data X-coordinate
- * @data_y: The data Y-coordinate
- * @x: The returned X position on the cairo surface
- * @y: The returned Y position on the cairo surface
- **/
-static void
-gpm_graph_widget_get_pos_on_graph (GpmGraphWidget *graph, gfloat data_x, gfloat data_y, float *x, float *y)
-{
-	*x = graph->priv->box_x + (graph->priv->unit_x * (data_x - graph->priv->start_x)) + 1;
-	*y = graph->priv->box_y + (graph->priv->unit_y * (gfloat)(graph->priv->stop_y - data_y)) + 1.5;
+	gpm_graph_widget_queue_damage (graph, GPM_GRAPH_DAMAGE_DATA |
+					      GPM_GRAPH_DAMAGE_LABELS_X |
+					      GPM_GRAPH_DAMAGE_LABELS_Y);
+	if (gdk_frame_clock_get_frame_time (clock) - graph->priv->anim_start < GPM_GRAPH_WIDGET_ANIMATION_TIME)
+		return TRUE;
+	graph->priv->anim_tick_id = 0;
+	return FALSE;
 }
 
 /**
- * gpm_graph_widget_draw_dot:
+ * gpm_graph_widget_animation_stop:
+ *
+ * Jumps straight to the axes at the next frame, e.g. when zooming with the
+ * mouse, which has to follow the pointer.
  **/
 static void
-gpm_graph_widget_draw_dot (cairo_t *cr, gfloat x, gfloat y, guint32 color)
+gpm_graph_widget_animation_stop (GpmGraphWidget *graph)
 {
-	gfloat width;
-	/* box */
-	width = 2.0;
-	cairo_rectangle (cr, (gint)x + 0.5f - (width/2), (gint)y + 0.5f - (width/2), width, width);
-	gpm_graph_widget_set_color (cr, color);
-	cairo_fill (cr);
-	cairo_rectangle (cr, (gint)x + 0.5f - (width/2), (gint)y + 0.5f - (width/2), width, width);
-	cairo_set_source_rgb (cr, 0, 0, 0);
-	cairo_set_line_width (cr, 1);
-	cairo_stroke (cr);
+	if (graph->priv->anim_tick_id != 0) {
+		gtk_widget_remove_tick_callback (GTK_WIDGET (graph), graph->priv->anim_tick_id);
+		graph->priv->anim_tick_id = 0;
+	}
+	graph->priv->anim_valid = FALSE;
 }
 
 /**
- * gpm_graph_widget_draw_line:
+ * gpm_graph_widget_animate:
  * @graph: This class instance
- * @cr: Cairo drawing context
  *
- * Draw the data line onto the graph with a big green line. We should already
- * limit the data to < ~100 values, so this shouldn't take too long.
+ * Sets the visible part of the axes for this frame. When the axes change the
+ * old range moves to the new one over a few frames, using the data we already
+ * have, so each frame only costs transforming and stroking the visible points.
  **/
 static void
-gpm_graph_widget_draw_line (GpmGraphWidget *graph, cairo_t *cr)
+gpm_graph_widget_animate (GpmGraphWidget *graph)
 {
-	gfloat oldx, oldy;
-	gfloat newx, newy;
-	GPtrArray *data;
-	GPtrArray *array;
-	GpmGraphWidgetPlot plot;
-	GpmPointObj *point;
-	guint i, j;
-
-	if (graph->priv->data_list->len == 0) {
-		g_debug ("no data");
-		return;
+	GtkWidget *widget = GTK_WIDGET (graph);
+	GdkFrameClock *clock = NULL;
+	GpmGraphWidgetPrivate *priv = graph->priv;
+	GpmGraphType type_x, type_y;
+	gint start_y, stop_y;
+	gfloat target[4];
+	gfloat t = 1.0f;
+	gint64 now = 0;
+	guint i;
+
+	gpm_graph_get_axes (priv->graph, NULL, NULL, &start_y, &stop_y);
+	target[0] = priv->view_start_x;
+	target[1] = priv->view_stop_x;
+	target[2] = start_y;
+	target[3] = stop_y;
+
+	/* moving between different kinds of axis makes no sense */
+	g_object_get (priv->graph,
+		      "type-x", &type_x,
+		      "type-y", &type_y,
+		      NULL);
+	if (type_x != priv->anim_type_x || type_y != priv->anim_type_y)
+		gpm_graph_widget_animation_stop (graph);
+	priv->anim_type_x = type_x;
+	priv->anim_type_y = type_y;
+
+	if (priv->use_animation && gtk_widget_get_mapped (widget))
+		clock = gtk_widget_get_frame_clock (widget);
+	if (clock != NULL)
+		now = gdk_frame_clock_get_frame_time (clock);
+
+	if (!priv->anim_valid || clock == NULL) {
+		memcpy (priv->anim_from, target, sizeof (target));
+		memcpy (priv->anim_to, target, sizeof (target));
+	} else if (memcmp (priv->anim_to, target, sizeof (target)) != 0) {
+		/* start from wherever we are, even half way through */
+		memcpy (priv->anim_from, priv->anim_shown, sizeof (target));
+		memcpy (priv->anim_to, target, sizeof (target));
+		priv->anim_start = now;
+		if (priv->anim_tick_id == 0)
+			priv->anim_tick_id = gtk_widget_add_tick_callback (widget, gpm_graph_widget_animation_tick_cb,
+									   NULL, NULL);
 	}
-	cairo_save (cr);
 
-	array = graph->priv->data_list;
-
-	/* do each line */
-	for (j=0; j<array->len; j++) {
-		data = g_ptr_array_index (array, j);
-		if (data->len == 0)
-			continue;
-		plot = GPOINTER_TO_UINT (g_ptr_array_index (graph->priv->plot_list, j));
-
-		/* get the very first point so we can work out the old */
-		point = (GpmPointObj *) g_ptr_array_index (data, 0);
-		oldx = 0;
-		oldy = 0;
-		gpm_graph_widget_get_pos_on_graph (graph, point->x, point->y, &oldx, &oldy);
-		if (plot == GPM_GRAPH_WIDGET_PLOT_POINTS || plot == GPM_GRAPH_WIDGET_PLOT_BOTH)
-			gpm_graph_widget_draw_dot (cr, oldx, oldy, point->color);
-
-		for (i=1; i < data->len; i++) {
-			point = (GpmPointObj *) g_ptr_array_index (data, i);
-
-			gpm_graph_widget_get_pos_on_graph (graph, point->x, point->y, &newx, &newy);
-
-			/* ignore white lines */
-			if (point->color == 0xffffff) {
-				oldx = newx;
-				oldy = newy;
-				continue;
-			}
-
-			/* draw line */
-			if (plot == GPM_GRAPH_WIDGET_PLOT_LINE || plot == GPM_GRAPH_WIDGET_PLOT_BOTH) {
-				cairo_move_to (cr, oldx, oldy);
-				cairo_line_to (cr, newx, newy);
-				cairo_set_line_width (cr, 1.5);
-				gpm_graph_widget_set_color (cr, point->color);
-				cairo_stroke (cr);
-			}
-
-			/* draw data dot */
-			if (plot == GPM_GRAPH_WIDGET_PLOT_POINTS || plot == GPM_GRAPH_WIDGET_PLOT_BOTH)
-				gpm_graph_widget_draw_dot (cr, newx, newy, point->color);
-
-			/* save old */
-			oldx = newx;
-			oldy = newy;
-		}
+	/* ease out, so it starts quickly and settles gently */
+	if (priv->anim_tick_id != 0 && now - priv->anim_start < GPM_GRAPH_WIDGET_ANIMATION_TIME) {
+		t = (gfloat) (now - priv->anim_start) / GPM_GRAPH_WIDGET_ANIMATION_TIME;
+		t = 1.0f - (1.0f - t) * (1.0f - t) * (1.0f - t);
+	}
+	for (i=0; i<4; i++) {
+		if (t < 1.0f)
+			priv->anim_shown[i] = priv->anim_from[i] + (priv->anim_to[i] - priv->anim_from[i]) * t;
+		else
+			priv->anim_shown[i] = priv->anim_to[i];
 	}
+	priv->anim_valid = TRUE;
 
-	cairo_restore (cr);
+	priv->view_start_x = priv->anim_shown[0];
+	priv->view_stop_x = priv->anim_shown[1];
+	gpm_graph_set_view (priv->graph,
+			    priv->anim_shown[0], priv->anim_shown[1],
+			    priv->anim_shown[2], priv->anim_shown[3]);
 }
 
 /**
- * gpm_graph_widget_draw_bounding_box:
+ * gpm_graph_widget_draw_graph:
+ * @graph: This class instance
  * @cr: Cairo drawing context
- * @x: The X-coordinate for the top-left
- * @y: The Y-coordinate for the top-left
- * @width: The item width
- * @height: The item height
+ * @width: The width of the area to draw into
+ * @height: The height of the area to draw into
+ *
+ * Draws the graph with the part of the axes that is shown for this frame.
  **/
 static void
-gpm_graph_widget_draw_bounding_box (cairo_t *cr, gint x, gint y, gint width, gint height)
+gpm_graph_widget_draw_graph (GpmGraphWidget *graph, cairo_t *cr, gint width, gint height)
 {
-	/* background */
-	cairo_rectangle (cr, x, y, width, height);
-	cairo_set_source_rgb (cr, 1, 1, 1);
-	cairo_fill (cr);
-	/* solid outline box */
-	cairo_rectangle (cr, x + 0.5f, y + 0.5f, width - 1, height - 1);
-	cairo_set_source_rgb (cr, 0.1, 0.1, 0.1);
-	cairo_set_line_width (cr, 1);
-	cairo_stroke (cr);
+	GpmGraphWidgetPrivate *priv = graph->priv;
+
+	gpm_graph_layout_box (priv->graph, cr, width, height);
+
+	/* the axis we are moving towards, rather than what was last shown */
+	if (priv->anim_valid) {
+		priv->view_start_x = priv->anim_to[0];
+		priv->view_stop_x = priv->anim_to[1];
+	}
+	gpm_graph_widget_viewport_clamp (graph);
+	gpm_graph_widget_animate (graph);
+
+	gpm_graph_draw (priv->graph, cr, width, height);
 }
 
 /**
- * gpm_graph_widget_draw_legend:
- * @cr: Cairo drawing context
- * @x: The X-coordinate for the top-left
- * @y: The Y-coordinate for the top-left
- * @width: The item width
- * @height: The item height
+ * gpm_graph_widget_cache_to_string:
  **/
-static void
-gpm_graph_widget_draw_legend (GpmGraphWidget *graph, gint x, gint y, gint width, gint height)
+static const gchar *
+gpm_graph_widget_cache_to_string (GpmGraphCache cache)
 {
-	cairo_t *cr = graph->priv->cr;
-	gint y_count;
-	guint i;
-	GpmGraphWidgetKeyData *keydataitem;
-
-	gpm_graph_widget_draw_bounding_box (cr, x, y, width, height);
-	y_count = y + 10;
-
-	/* add the line colors to the legend */
-	for (i=0; i<g_slist_length (graph->priv->key_data); i++) {
-		keydataitem = (GpmGraphWidgetKeyData *) g_slist_nth_data (graph->priv->key_data, i);
-		if (keydataitem == NULL) {
-			/* this shouldn't ever happen */
-			g_warning ("keydataitem NULL!");
-			break;
-		}
-		gpm_graph_widget_draw_legend_line (cr, x + 8, y_count, keydataitem->color);
-		cairo_move_to (cr, x + 8 + 10, y_count - 6);
-		cairo_set_source_rgb (cr, 0, 0, 0);
-		pango_layout_set_text (graph->priv->layout, keydataitem->desc, -1);
-		pango_cairo_show_layout (cr, graph->priv->layout);
-		y_count = y_count + GPM_GRAPH_WIDGET_LEGEND_SPACING;
-	}
+	if (cache == GPM_GRAPH_CACHE_HIT)
+		return "hit";
+	if (cache == GPM_GRAPH_CACHE_PARTIAL)
+		return "partial";
+	return "miss";
 }
 
 /**
- * gpm_graph_widget_legend_calculate_width:
+ * gpm_graph_widget_draw_render_stats:
  * @graph: This class instance
  * @cr: Cairo drawing context
- * Return value: The width of the legend, including borders.
  *
- * We have to find the maximum size of the text so we know the width of the
- * legend box. We can't hardcode this as the dpi or font size might differ
- * from machine to machine.
+ * Draw what the last frame cost in the top left of the graph. This is for
+ * debugging, so the text is not translated.
  **/
-static gboolean
-gpm_graph_widget_legend_calculate_size (GpmGraphWidget *graph, cairo_t *cr,
-					guint *width, guint *height)
+static void
+gpm_graph_widget_draw_render_stats (GpmGraphWidget *graph, cairo_t *cr)
 {
-	guint i;
+	gchar *text;
+	cairo_rectangle_int_t box;
+	GpmGraphStats stats;
 	PangoRectangle ink_rect, logical_rect;
-	GpmGraphWidgetKeyData *keydataitem;
-
-	g_return_val_if_fail (GPM_IS_GRAPH_WIDGET (graph), FALSE);
-
-	/* set defaults */
-	*width = 0;
-	*height = 0;
-
-	/* add the line colors to the legend */
-	for (i=0; i<g_slist_length (graph->priv->key_data); i++) {
-		keydataitem = (GpmGraphWidgetKeyData *) g_slist_nth_data (graph->priv->key_data, i);
-		*height = *height + GPM_GRAPH_WIDGET_LEGEND_SPACING;
-		pango_layout_set_text (graph->priv->layout, keydataitem->desc, -1);
-		pango_layout_get_pixel_extents (graph->priv->layout, &ink_rect, &logical_rect);
-		if ((gint) *width < ink_rect.width)
-			*width = ink_rect.width;
-	}
-
-	/* have we got no entries? */
-	if (*width == 0 && *height == 0)
-		return TRUE;
+	GpmGraphWidgetPrivate *priv = graph->priv;
+
+	gpm_graph_get_stats (priv->graph, &stats);
+	text = g_strdup_printf ("frame %.2f ms\n"
+				"points %u of %u\n"
+				"strokes %u\n"
+				"layer %s, labels %s, autorange %s",
+				priv->stats_frame_time / 1000.0f,
+				stats.points, stats.points_total,
+				stats.strokes,
+				gpm_graph_widget_cache_to_string (priv->stats_layer),
+				gpm_graph_widget_cache_to_string (stats.labels),
+				gpm_graph_widget_cache_to_string (stats.autorange));
+	pango_layout_set_text (priv->layout, text, -1);
+	pango_layout_get_pixel_extents (priv->layout, &ink_rect, &logical_rect);
+
+	/* keep the old area if the text gets smaller, so nothing is left behind */
+	gpm_graph_get_box (priv->graph, &box);
+	priv->stats_rect.x = box.x + 4;
+	priv->stats_rect.y = box.y + 4;
+	priv->stats_rect.width = MAX (priv->stats_rect.width, logical_rect.width + 8);
+	priv->stats_rect.height = MAX (priv->stats_rect.height, logical_rect.height + 4);
 
-	/* add for borders */
-	*width += 25;
-	*height += 3;
-
-	return TRUE;
+	cairo_save (cr);
+	cairo_rectangle (cr, priv->stats_rect.x, priv->stats_rect.y,
+			 priv->stats_rect.width, priv->stats_rect.height);
+	cairo_set_source_rgba (cr, 1, 1, 0.8, 0.9);
+	cairo_fill (cr);
+	cairo_move_to (cr, priv->stats_rect.x + 4, priv->stats_rect.y + 2);
+	cairo_set_source_rgb (cr, 0, 0, 0);
+	pango_cairo_show_layout (cr, priv->layout);
+	cairo_restore (cr);
+	g_free (text);
 }
 
 /**
@@ -1128,68 +913,87 @@ gpm_graph_widget_legend_calculate_size (GpmGraphWidget *graph, cairo_t *cr,
  * @graph: This class instance
  * @event: The expose event
  *
- * Just repaint the entire graph widget on expose.
+ * Repaint the parts of the graph widget that are stale.
  **/
 static gboolean
 gpm_graph_widget_draw (GtkWidget *widget, cairo_t *cr)
 {
 	GtkAllocation allocation;
-	gint legend_x = 0;
-	gint legend_y = 0;
-	guint legend_height = 0;
-	guint legend_width = 0;
-	gfloat data_x;
-	gfloat data_y;
+	PangoContext *context;
+	cairo_t *layer_cr;
+	gint64 trace;
+	gint64 start;
 
 	GpmGraphWidget *graph = (GpmGraphWidget*) widget;
+	GpmGraphWidgetPrivate *priv;
 	g_return_val_if_fail (graph != NULL, FALSE);
 	g_return_val_if_fail (GPM_IS_GRAPH_WIDGET (graph), FALSE);
+	priv = graph->priv;
 
-	gpm_graph_widget_legend_calculate_size (graph, cr, &legend_width, &legend_height);
-	cairo_save (cr);
-
-	/* we need this so we know the y text */
-	if (graph->priv->autorange_x)
-		gpm_graph_widget_autorange_x (graph);
-	if (graph->priv->autorange_y)
-		gpm_graph_widget_autorange_y (graph);
+	/* anything not drawn this frame was cached */
+	start = g_get_monotonic_time ();
+	gpm_graph_reset_stats (priv->graph);
+	priv->stats_layer = GPM_GRAPH_CACHE_HIT;
 
-	graph->priv->box_x = gpm_graph_widget_get_y_label_max_width (graph, cr) + 10;
-	graph->priv->box_y = 5;
+	/* do pango stuff */
+	if (priv->layout == NULL) {
+		context = gtk_widget_get_pango_context (widget);
+		pango_context_set_base_gravity (context, PANGO_GRAVITY_AUTO);
+		priv->layout = pango_layout_new (context);
+		gpm_graph_set_layout (priv->graph, priv->layout);
+	}
 
+	/* the cache is the size of the widget */
 	gtk_widget_get_allocation (widget, &allocation);
-	graph->priv->box_height = allocation.height - (20 + graph->priv->box_y);
-
-	/* make size adjustment for legend */
-	if (graph->priv->use_legend && legend_height > 0) {
-		graph->priv->box_width = allocation.width -
-					 (3 + legend_width + 5 + graph->priv->box_x);
-		legend_x = graph->priv->box_x + graph->priv->box_width + 6;
-		legend_y = graph->priv->box_y;
-	} else {
-		graph->priv->box_width = allocation.width -
-					 (3 + graph->priv->box_x);
+	if (priv->layer == NULL ||
+	    priv->layer_width != allocation.width ||
+	    priv->layer_height != allocation.height) {
+		if (priv->layer != NULL)
+			cairo_surface_destroy (priv->layer);
+		priv->layer = gdk_window_create_similar_surface (gtk_widget_get_window (widget),
+								 CAIRO_CONTENT_COLOR_ALPHA,
+								 allocation.width,
+								 allocation.height);
+		priv->layer_width = allocation.width;
+		priv->layer_height = allocation.height;
+		priv->layer_valid = FALSE;
 	}
 
-	/* graph background */
-	gpm_graph_widget_draw_bounding_box (cr, graph->priv->box_x, graph->priv->box_y,
-				     graph->priv->box_width, graph->priv->box_height);
-	if (graph->priv->use_grid)
-		gpm_graph_widget_draw_grid (graph, cr);
-
-	/* -3 is so we can keep the lines inside the box at both extremes */
-	data_x = graph->priv->stop_x - graph->priv->start_x;
-	data_y = graph->priv->stop_y - graph->priv->start_y;
-	graph->priv->unit_x = (float)(graph->priv->box_width - 3) / (float) data_x;
-	graph->priv->unit_y = (float)(graph->priv->box_height - 3) / (float) data_y;
+	/* only draw the stale parts of the cache */
+	if (!priv->layer_valid || !cairo_region_is_empty (priv->layer_damage)) {
+		trace = gpm_trace_begin ();
+		layer_cr = cairo_create (priv->layer);
+		priv->stats_layer = GPM_GRAPH_CACHE_MISS;
+		if (priv->layer_valid) {
+			gdk_cairo_region (layer_cr, priv->layer_damage);
+			cairo_clip (layer_cr);
+			priv->stats_layer = GPM_GRAPH_CACHE_PARTIAL;
+		}
+		cairo_save (layer_cr);
+		cairo_set_operator (layer_cr, CAIRO_OPERATOR_CLEAR);
+		cairo_paint (layer_cr);
+		cairo_restore (layer_cr);
+		gpm_graph_widget_draw_graph (graph, layer_cr, allocation.width, allocation.height);
+		cairo_destroy (layer_cr);
+		cairo_region_destroy (priv->layer_damage);
+		priv->layer_damage = cairo_region_create ();
+		priv->layer_valid = TRUE;
+		gpm_trace_end (trace, "draw", "Layer");
+	}
 
-	gpm_graph_widget_draw_labels (graph, cr);
-	gpm_graph_widget_draw_line (graph, cr);
+	trace = gpm_trace_begin ();
+	cairo_set_source_surface (cr, priv->layer, 0, 0);
+	cairo_paint (cr);
 
-	if (graph->priv->use_legend && legend_height > 0)
-		gpm_graph_widget_draw_legend (graph, legend_x, legend_y, legend_width, legend_height);
+	/* the overlay is drawn on top every time */
+	if (priv->hover_active)
+		gpm_graph_widget_draw_hover (graph, cr);
+	gpm_trace_end (trace, "draw", "Composite");
 
-	cairo_restore (cr);
+	if (priv->show_render_stats) {
+		priv->stats_frame_time = g_get_monotonic_time () - start;
+		gpm_graph_widget_draw_render_stats (graph, cr);
+	}
 	return FALSE;
 }
 
@@ -1202,4 +1006,3 @@ gpm_graph_widget_new (void)
 {
 	return g_object_new (GPM_TYPE_GRAPH_WIDGET, NULL);
 }
-
@@ -23,7 +23,7 @@
 #define __GPM_GRAPH_WIDGET_H__
 
 #include <gtk/gtk.h>
-#include "gpm-point-obj.h"
+#include "gpm-graph.h"
 
 G_BEGIN_DECLS
 
@@ -34,34 +34,10 @@ G_BEGIN_DECLS
 #define GPM_IS_GRAPH_WIDGET_CLASS(obj)	(G_TYPE_CHECK_CLASS_TYPE ((obj), EFF_TYPE_GRAPH_WIDGET))
 #define GPM_GRAPH_WIDGET_GET_CLASS	(G_TYPE_INSTANCE_GET_CLASS ((obj), GPM_TYPE_GRAPH_WIDGET, GpmGraphWidgetClass))
 
-#define GPM_GRAPH_WIDGET_LEGEND_SPACING		17
-
 typedef struct GpmGraphWidget		GpmGraphWidget;
 typedef struct GpmGraphWidgetClass	GpmGraphWidgetClass;
 typedef struct GpmGraphWidgetPrivate	GpmGraphWidgetPrivate;
 
-typedef enum {
-	GPM_GRAPH_WIDGET_TYPE_INVALID,
-	GPM_GRAPH_WIDGET_TYPE_PERCENTAGE,
-	GPM_GRAPH_WIDGET_TYPE_FACTOR,
-	GPM_GRAPH_WIDGET_TYPE_TIME,
-	GPM_GRAPH_WIDGET_TYPE_POWER,
-	GPM_GRAPH_WIDGET_TYPE_VOLTAGE,
-	GPM_GRAPH_WIDGET_TYPE_UNKNOWN
-} GpmGraphWidgetType;
-
-typedef enum {
-	GPM_GRAPH_WIDGET_PLOT_LINE,
-	GPM_GRAPH_WIDGET_PLOT_POINTS,
-	GPM_GRAPH_WIDGET_PLOT_BOTH
-} GpmGraphWidgetPlot;
-
-/* the different kinds of lines in the key */
-typedef struct {
-	guint32			 color;
-	gchar			*desc;
-} GpmGraphWidgetKeyData;
-
 struct GpmGraphWidget
 {
 	GtkDrawingArea		 parent;
@@ -76,13 +52,8 @@ struct GpmGraphWidgetClass
 GType		 gpm_graph_widget_get_type		(void);
 GtkWidget	*gpm_graph_widget_new			(void);
 
-gboolean	 gpm_graph_widget_data_clear		(GpmGraphWidget		*graph);
-gboolean	 gpm_graph_widget_data_assign		(GpmGraphWidget		*graph,
-							 GpmGraphWidgetPlot	 plot,
-							 GPtrArray		*array);
-gboolean	 gpm_graph_widget_key_data_add		(GpmGraphWidget		*graph,
-							 guint32		 color,
-							 const gchar		*desc);
+GpmGraph	*gpm_graph_widget_get_graph		(GpmGraphWidget		*graph);
+void		 gpm_graph_widget_viewport_reset	(GpmGraphWidget		*graph);
 
 G_END_DECLS
 
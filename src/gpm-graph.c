@@ -0,0 +1,2298 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2006-2011 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include <pango/pangocairo.h>
+#include <glib/gi18n.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "gpm-point-obj.h"
+#include "gpm-graph-series.h"
+#include "gpm-graph.h"
+#include "gpm-history-pack.h"
+#include "gpm-raster.h"
+#include "gpm-trace.h"
+
+G_DEFINE_TYPE (GpmGraph, gpm_graph, G_TYPE_OBJECT);
+#define GPM_GRAPH_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), GPM_TYPE_GRAPH, GpmGraphPrivate))
+#define GPM_GRAPH_FONT "Sans 8"
+
+/* the data, the axes and everything needed to draw them, which does not
+ * need a display so it can also be drawn into a file */
+struct GpmGraphPrivate
+{
+	gboolean		 use_grid;
+	gboolean		 use_legend;
+	gboolean		 autorange_x;
+	gboolean		 autorange_y;
+	gboolean		 use_raster;
+
+	GSList			*key_data; /* lines */
+
+	gint			 stop_x;
+	gint			 stop_y;
+	gint			 start_x;
+	gint			 start_y;
+	gint			 gap_x; /* split lines further apart than this, or 0 */
+	gint			 box_x; /* size of the white box, not the surface */
+	gint			 box_y;
+	gint			 box_width;
+	gint			 box_height;
+	cairo_rectangle_int_t	 legend_rect; /* empty if there is no legend */
+
+	gfloat			 unit_x; /* 10th width of graph */
+	gfloat			 unit_y; /* 10th width of graph */
+
+	gboolean		 autorange_valid; /* the data has not changed */
+	gboolean		 label_width_valid;
+	guint			 label_width; /* of the widest y label */
+	gint			 label_start_y;
+	gint			 label_stop_y;
+	GpmGraphType		 label_type_y;
+
+	gfloat			 view_start_x; /* the part of the axes that is drawn */
+	gfloat			 view_stop_x;
+	gfloat			 view_start_y;
+	gfloat			 view_stop_y;
+
+	cairo_surface_t		*raster; /* the data inside the box, for use-raster */
+	guint32			*density; /* a count for each pixel in the box */
+	gsize			 density_len;
+
+	GpmGraphStats		 stats;
+
+	GpmGraphType		 type_x;
+	GpmGraphType		 type_y;
+
+	PangoLayout 		*layout;
+
+	GPtrArray		*data_list; /* of GpmGraphSeries */
+	GPtrArray		*plot_list;
+};
+
+static void	gpm_graph_finalize (GObject *object);
+static GpmGraphDamage gpm_graph_autorange_damage (GpmGraph *graph);
+static gboolean gpm_graph_legend_calculate_size (GpmGraph *graph, cairo_t *cr, guint *width, guint *height);
+
+enum
+{
+	PROP_0,
+	PROP_USE_LEGEND,
+	PROP_USE_GRID,
+	PROP_TYPE_X,
+	PROP_TYPE_Y,
+	PROP_AUTORANGE_X,
+	PROP_AUTORANGE_Y,
+	PROP_START_X,
+	PROP_START_Y,
+	PROP_STOP_X,
+	PROP_STOP_Y,
+	PROP_GAP_X,
+	PROP_USE_RASTER,
+};
+
+enum {
+	SIGNAL_DAMAGE,
+	SIGNAL_DAMAGE_AREA,
+	SIGNAL_LAST
+};
+
+static guint signals [SIGNAL_LAST] = { 0 };
+
+/**
+ * gpm_graph_queue_damage:
+ * @graph: This class instance
+ * @damage: The parts of the graph that are stale
+ **/
+static void
+gpm_graph_queue_damage (GpmGraph *graph, GpmGraphDamage damage)
+{
+	g_signal_emit (graph, signals [SIGNAL_DAMAGE], 0, damage);
+}
+
+/**
+ * gpm_graph_key_data_free:
+ **/
+static void
+gpm_graph_key_data_free (GpmGraph *graph)
+{
+	GpmGraphKeyData *keyitem;
+	GSList *l;
+
+	for (l=graph->priv->key_data; l != NULL; l=l->next) {
+		keyitem = (GpmGraphKeyData *) l->data;
+		g_free (keyitem->desc);
+		g_free (keyitem);
+	}
+	g_slist_free (graph->priv->key_data);
+	graph->priv->key_data = NULL;
+}
+
+/**
+ * gpm_graph_key_data_clear:
+ **/
+gboolean
+gpm_graph_key_data_clear (GpmGraph *graph)
+{
+	g_return_val_if_fail (GPM_IS_GRAPH (graph), FALSE);
+
+	gpm_graph_key_data_free (graph);
+
+	/* the graph gets bigger without the legend */
+	if (graph->priv->use_legend)
+		gpm_graph_queue_damage (graph, GPM_GRAPH_DAMAGE_ALL);
+	return TRUE;
+}
+
+/**
+ * gpm_graph_key_data_add:
+ **/
+gboolean
+gpm_graph_key_data_add (GpmGraph *graph, guint32 color, const gchar *desc)
+{
+	GpmGraphKeyData *keyitem;
+	guint width;
+	guint height;
+
+	g_return_val_if_fail (GPM_IS_GRAPH (graph), FALSE);
+
+	g_debug ("add to list %s", desc);
+	keyitem = g_new0 (GpmGraphKeyData, 1);
+
+	keyitem->color = color;
+	keyitem->desc = g_strdup (desc);
+
+	graph->priv->key_data = g_slist_append (graph->priv->key_data, (gpointer) keyitem);
+
+	/* the graph has to shrink if the legend gets bigger */
+	if (!graph->priv->use_legend)
+		return TRUE;
+	if (graph->priv->layout == NULL) {
+		gpm_graph_queue_damage (graph, GPM_GRAPH_DAMAGE_ALL);
+		return TRUE;
+	}
+	gpm_graph_legend_calculate_size (graph, NULL, &width, &height);
+	if ((gint) width == graph->priv->legend_rect.width &&
+	    (gint) height == graph->priv->legend_rect.height)
+		gpm_graph_queue_damage (graph, GPM_GRAPH_DAMAGE_LEGEND);
+	else
+		gpm_graph_queue_damage (graph, GPM_GRAPH_DAMAGE_ALL);
+	return TRUE;
+}
+
+/**
+ * gpm_graph_get_property:
+ **/
+static void
+gpm_graph_get_property (GObject *object, guint prop_id, GValue *value, GParamSpec *pspec)
+{
+	GpmGraph *graph = GPM_GRAPH (object);
+	switch (prop_id) {
+	case PROP_USE_LEGEND:
+		g_value_set_boolean (value, graph->priv->use_legend);
+		break;
+	case PROP_USE_GRID:
+		g_value_set_boolean (value, graph->priv->use_grid);
+		break;
+	case PROP_TYPE_X:
+		g_value_set_uint (value, graph->priv->type_x);
+		break;
+	case PROP_TYPE_Y:
+		g_value_set_uint (value, graph->priv->type_y);
+		break;
+	case PROP_AUTORANGE_X:
+		g_value_set_boolean (value, graph->priv->autorange_x);
+		break;
+	case PROP_AUTORANGE_Y:
+		g_value_set_boolean (value, graph->priv->autorange_y);
+		break;
+	case PROP_START_X:
+		g_value_set_int (value, graph->priv->start_x);
+		break;
+	case PROP_START_Y:
+		g_value_set_int (value, graph->priv->start_y);
+		break;
+	case PROP_STOP_X:
+		g_value_set_int (value, graph->priv->stop_x);
+		break;
+	case PROP_STOP_Y:
+		g_value_set_int (value, graph->priv->stop_y);
+		break;
+	case PROP_GAP_X:
+		g_value_set_int (value, graph->priv->gap_x);
+		break;
+	case PROP_USE_RASTER:
+		g_value_set_boolean (value, graph->priv->use_raster);
+		break;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+		break;
+	}
+}
+
+/**
+ * gpm_graph_set_property:
+ **/
+static void
+gpm_graph_set_property (GObject *object, guint prop_id, const GValue *value, GParamSpec *pspec)
+{
+	GpmGraph *graph = GPM_GRAPH (object);
+	GpmGraphDamage damage = GPM_GRAPH_DAMAGE_ALL;
+	guint i;
+
+	switch (prop_id) {
+	case PROP_USE_LEGEND:
+		graph->priv->use_legend = g_value_get_boolean (value);
+		break;
+	case PROP_USE_GRID:
+		graph->priv->use_grid = g_value_get_boolean (value);
+		damage = GPM_GRAPH_DAMAGE_DATA;
+		break;
+	case PROP_TYPE_X:
+		graph->priv->type_x = g_value_get_uint (value);
+		damage = GPM_GRAPH_DAMAGE_DATA | GPM_GRAPH_DAMAGE_LABELS_X;
+		break;
+	case PROP_TYPE_Y:
+		graph->priv->type_y = g_value_get_uint (value);
+		break;
+	case PROP_AUTORANGE_X:
+		graph->priv->autorange_x = g_value_get_boolean (value);
+		damage = GPM_GRAPH_DAMAGE_DATA | GPM_GRAPH_DAMAGE_LABELS_X;
+		break;
+	case PROP_AUTORANGE_Y:
+		graph->priv->autorange_y = g_value_get_boolean (value);
+		break;
+	case PROP_START_X:
+		graph->priv->start_x = g_value_get_int (value);
+		damage = GPM_GRAPH_DAMAGE_DATA | GPM_GRAPH_DAMAGE_LABELS_X;
+		break;
+	case PROP_START_Y:
+		graph->priv->start_y = g_value_get_int (value);
+		break;
+	case PROP_STOP_X:
+		graph->priv->stop_x = g_value_get_int (value);
+		damage = GPM_GRAPH_DAMAGE_DATA | GPM_GRAPH_DAMAGE_LABELS_X;
+		break;
+	case PROP_STOP_Y:
+		graph->priv->stop_y = g_value_get_int (value);
+		break;
+	case PROP_GAP_X:
+		/* only where the lines are split changes */
+		graph->priv->gap_x = g_value_get_int (value);
+		for (i=0; i<graph->priv->data_list->len; i++)
+			gpm_graph_series_set_gap (g_ptr_array_index (graph->priv->data_list, i),
+						  graph->priv->gap_x);
+		gpm_graph_queue_damage (graph, GPM_GRAPH_DAMAGE_DATA);
+		return;
+	case PROP_USE_RASTER:
+		graph->priv->use_raster = g_value_get_boolean (value);
+		gpm_graph_queue_damage (graph, GPM_GRAPH_DAMAGE_DATA);
+		return;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+		return;
+	}
+
+	/* the y labels can change width, which moves everything else */
+	graph->priv->autorange_valid = FALSE;
+	gpm_graph_queue_damage (graph, damage);
+}
+
+/**
+ * gpm_graph_class_init:
+ * @klass: This graph class instance
+ **/
+static void
+gpm_graph_class_init (GpmGraphClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	object_class->get_property = gpm_graph_get_property;
+	object_class->set_property = gpm_graph_set_property;
+	object_class->finalize = gpm_graph_finalize;
+
+	g_type_class_add_private (klass, sizeof (GpmGraphPrivate));
+
+	/* the parts that have to be drawn again, e.g. by a widget showing us */
+	signals [SIGNAL_DAMAGE] =
+		g_signal_new ("damage",
+			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (GpmGraphClass, damage),
+			      NULL, NULL, g_cclosure_marshal_VOID__UINT,
+			      G_TYPE_NONE, 1, G_TYPE_UINT);
+
+	/* a cairo_rectangle_int_t, when only a few points are stale */
+	signals [SIGNAL_DAMAGE_AREA] =
+		g_signal_new ("damage-area",
+			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (GpmGraphClass, damage_area),
+			      NULL, NULL, g_cclosure_marshal_VOID__POINTER,
+			      G_TYPE_NONE, 1, G_TYPE_POINTER);
+
+	/* properties */
+	g_object_class_install_property (object_class,
+					 PROP_USE_LEGEND,
+					 g_param_spec_boolean ("use-legend", NULL, NULL,
+							       FALSE,
+							       G_PARAM_READWRITE));
+	g_object_class_install_property (object_class,
+					 PROP_USE_GRID,
+					 g_param_spec_boolean ("use-grid", NULL, NULL,
+							       TRUE,
+							       G_PARAM_READWRITE));
+	g_object_class_install_property (object_class,
+					 PROP_TYPE_X,
+					 g_param_spec_uint ("type-x", NULL, NULL,
+							    GPM_GRAPH_TYPE_INVALID,
+							    GPM_GRAPH_TYPE_UNKNOWN,
+							    GPM_GRAPH_TYPE_TIME,
+							    G_PARAM_READWRITE));
+	g_object_class_install_property (object_class,
+					 PROP_TYPE_Y,
+					 g_param_spec_uint ("type-y", NULL, NULL,
+							    GPM_GRAPH_TYPE_INVALID,
+							    GPM_GRAPH_TYPE_UNKNOWN,
+							    GPM_GRAPH_TYPE_PERCENTAGE,
+							    G_PARAM_READWRITE));
+	g_object_class_install_property (object_class,
+					 PROP_AUTORANGE_X,
+					 g_param_spec_boolean ("autorange-x", NULL, NULL,
+							       TRUE,
+							       G_PARAM_READWRITE));
+	g_object_class_install_property (object_class,
+					 PROP_AUTORANGE_Y,
+					 g_param_spec_boolean ("autorange-y", NULL, NULL,
+							       TRUE,
+							       G_PARAM_READWRITE));
+	g_object_class_install_property (object_class,
+					 PROP_START_X,
+					 g_param_spec_int ("start-x", NULL, NULL,
+							   G_MININT, G_MAXINT, 0,
+							   G_PARAM_READWRITE));
+	g_object_class_install_property (object_class,
+					 PROP_START_Y,
+					 g_param_spec_int ("start-y", NULL, NULL,
+							   G_MININT, G_MAXINT, 0,
+							   G_PARAM_READWRITE));
+	g_object_class_install_property (object_class,
+					 PROP_STOP_X,
+					 g_param_spec_int ("stop-x", NULL, NULL,
+							   G_MININT, G_MAXINT, 60,
+							   G_PARAM_READWRITE));
+	g_object_class_install_property (object_class,
+					 PROP_STOP_Y,
+					 g_param_spec_int ("stop-y", NULL, NULL,
+							   G_MININT, G_MAXINT, 100,
+							   G_PARAM_READWRITE));
+
+	/* don't join points further apart than this, e.g. across a suspend */
+	g_object_class_install_property (object_class,
+					 PROP_GAP_X,
+					 g_param_spec_int ("gap-x", NULL, NULL,
+							   0, G_MAXINT, 0,
+							   G_PARAM_READWRITE));
+
+	/* draw the data into an image ourselves, which is faster than cairo
+	 * for a lot of points but can't be saved as a vector graphic */
+	g_object_class_install_property (object_class,
+					 PROP_USE_RASTER,
+					 g_param_spec_boolean ("use-raster", NULL, NULL,
+							       FALSE,
+							       G_PARAM_READWRITE));
+}
+
+/**
+ * gpm_graph_init:
+ * @graph: This class instance
+ **/
+static void
+gpm_graph_init (GpmGraph *graph)
+{
+	graph->priv = GPM_GRAPH_GET_PRIVATE (graph);
+	graph->priv->start_x = 0;
+	graph->priv->start_y = 0;
+	graph->priv->stop_x = 60;
+	graph->priv->stop_y = 100;
+	graph->priv->view_stop_y = 100;
+	graph->priv->use_grid = TRUE;
+	graph->priv->use_legend = FALSE;
+	graph->priv->data_list = g_ptr_array_new_with_free_func ((GDestroyNotify) gpm_graph_series_free);
+	graph->priv->plot_list = g_ptr_array_new ();
+	graph->priv->key_data = NULL;
+	graph->priv->type_x = GPM_GRAPH_TYPE_TIME;
+	graph->priv->type_y = GPM_GRAPH_TYPE_PERCENTAGE;
+
+	/* set by whatever draws us, as only it knows the screen */
+	graph->priv->layout = NULL;
+}
+
+/**
+ * gpm_graph_finalize:
+ * @object: This graph class instance
+ **/
+static void
+gpm_graph_finalize (GObject *object)
+{
+	GpmGraph *graph = (GpmGraph*) object;
+
+	if (graph->priv->layout != NULL)
+		g_object_unref (graph->priv->layout);
+	gpm_graph_key_data_free (graph);
+	g_ptr_array_unref (graph->priv->data_list);
+	g_ptr_array_unref (graph->priv->plot_list);
+	if (graph->priv->raster != NULL)
+		cairo_surface_destroy (graph->priv->raster);
+	g_free (graph->priv->density);
+
+	G_OBJECT_CLASS (gpm_graph_parent_class)->finalize (object);
+}
+
+/**
+ * gpm_graph_data_clear:
+ **/
+gboolean
+gpm_graph_data_clear (GpmGraph *graph)
+{
+	g_return_val_if_fail (GPM_IS_GRAPH (graph), FALSE);
+
+	g_ptr_array_set_size (graph->priv->data_list, 0);
+	g_ptr_array_set_size (graph->priv->plot_list, 0);
+	graph->priv->autorange_valid = FALSE;
+	gpm_graph_queue_damage (graph, gpm_graph_autorange_damage (graph));
+	return TRUE;
+}
+
+/**
+ * gpm_graph_data_assign:
+ * @graph: This class instance
+ * @data: an array of GpmPointObj's
+ *
+ * Sets the data for the graph
+ **/
+gboolean
+gpm_graph_data_assign (GpmGraph *graph, GpmGraphPlot plot, GPtrArray *data)
+{
+	GpmGraphSeries *series;
+	GpmPointObj *obj;
+	guint i;
+
+	g_return_val_if_fail (data != NULL, FALSE);
+	g_return_val_if_fail (GPM_IS_GRAPH (graph), FALSE);
+
+	/* make a copy */
+	series = gpm_graph_series_new (0);
+	gpm_graph_series_set_gap (series, graph->priv->gap_x);
+	for (i=0; i<data->len; i++) {
+		obj = g_ptr_array_index (data, i);
+		gpm_graph_series_append (series, obj->x, obj->y, obj->color, NULL);
+	}
+
+	/* a long history takes a lot less memory this way */
+	gpm_graph_series_compact (series);
+
+	/* get the new data */
+	g_ptr_array_add (graph->priv->data_list, series);
+	g_ptr_array_add (graph->priv->plot_list, GUINT_TO_POINTER(plot));
+
+	/* refresh */
+	gpm_graph_queue_damage (graph, gpm_graph_autorange_damage (graph));
+
+	return TRUE;
+}
+
+/**
+ * gpm_graph_data_assign_pack:
+ * @graph: This class instance
+ * @pack: compressed data, which is decoded one block at a time
+ *
+ * Sets the data for the graph without decompressing all of it at once.
+ **/
+gboolean
+gpm_graph_data_assign_pack (GpmGraph *graph, GpmGraphPlot plot, GpmHistoryPack *pack)
+{
+	GpmGraphSeries *series;
+	GpmHistoryPackIter iter;
+	const GpmPointObj *points;
+	guint len;
+	guint i;
+
+	g_return_val_if_fail (pack != NULL, FALSE);
+	g_return_val_if_fail (GPM_IS_GRAPH (graph), FALSE);
+
+	series = gpm_graph_series_new (0);
+	gpm_graph_series_set_gap (series, graph->priv->gap_x);
+	gpm_history_pack_iter_init (&iter, pack);
+	while ((len = gpm_history_pack_iter_next (&iter, &points)) > 0) {
+		for (i=0; i<len; i++)
+			gpm_graph_series_append (series, points[i].x, points[i].y, points[i].color, NULL);
+	}
+	gpm_graph_series_compact (series);
+
+	g_ptr_array_add (graph->priv->data_list, series);
+	g_ptr_array_add (graph->priv->plot_list, GUINT_TO_POINTER(plot));
+	gpm_graph_queue_damage (graph, gpm_graph_autorange_damage (graph));
+	return TRUE;
+}
+
+/**
+ * gpm_graph_set_layout_font:
+ * @layout: A PangoLayout
+ *
+ * Sets the font used for all the text on the graph.
+ **/
+static void
+gpm_graph_set_layout_font (PangoLayout *layout)
+{
+	PangoFontDescription *desc;
+	desc = pango_font_description_from_string (GPM_GRAPH_FONT);
+	pango_layout_set_font_description (layout, desc);
+	pango_font_description_free (desc);
+}
+
+/**
+ * gpm_graph_data_assign_series:
+ * @graph: This class instance
+ * @series: the data, which belongs to the graph afterwards
+ *
+ * Sets the data for the graph without copying it, e.g. from a series that
+ * was made in another thread.
+ **/
+gboolean
+gpm_graph_data_assign_series (GpmGraph *graph, GpmGraphPlot plot, GpmGraphSeries *series)
+{
+	g_return_val_if_fail (series != NULL, FALSE);
+	g_return_val_if_fail (GPM_IS_GRAPH (graph), FALSE);
+
+	gpm_graph_series_set_gap (series, graph->priv->gap_x);
+	g_ptr_array_add (graph->priv->data_list, series);
+	g_ptr_array_add (graph->priv->plot_list, GUINT_TO_POINTER(plot));
+	gpm_graph_queue_damage (graph, gpm_graph_autorange_damage (graph));
+	return TRUE;
+}
+
+/**
+ * gpm_graph_data_swap_series:
+ * @graph: This class instance
+ * @series: the new data, an array of GpmGraphSeries that frees them with
+ * gpm_graph_series_free(), which is swapped for the data the graph had
+ * @plots: the GpmGraphPlot for each new series
+ *
+ * Sets all of the data for the graph at once without copying it, and gives
+ * the old series back so that their storage can be used again.
+ **/
+gboolean
+gpm_graph_data_swap_series (GpmGraph *graph, GPtrArray **series, GArray *plots)
+{
+	GPtrArray *old;
+	guint i;
+
+	g_return_val_if_fail (GPM_IS_GRAPH (graph), FALSE);
+	g_return_val_if_fail (series != NULL && *series != NULL, FALSE);
+	g_return_val_if_fail (plots != NULL && plots->len == (*series)->len, FALSE);
+
+	old = graph->priv->data_list;
+	graph->priv->data_list = *series;
+	*series = old;
+
+	g_ptr_array_set_size (graph->priv->plot_list, plots->len);
+	for (i=0; i<plots->len; i++) {
+		gpm_graph_series_set_gap (g_ptr_array_index (graph->priv->data_list, i), graph->priv->gap_x);
+		g_ptr_array_index (graph->priv->plot_list, i) = GUINT_TO_POINTER(g_array_index (plots, GpmGraphPlot, i));
+	}
+	graph->priv->autorange_valid = FALSE;
+	gpm_graph_queue_damage (graph, gpm_graph_autorange_damage (graph));
+	return TRUE;
+}
+
+/**
+ * gpm_graph_add_series:
+ * @graph: This class instance
+ * @plot: The plot type for the series
+ * @capacity: The maximum number of points to keep, or 0 for no limit
+ *
+ * Adds an empty series that can be added to one point at a time using
+ * gpm_graph_append(). Once the series has @capacity points
+ * the oldest point is dropped for each new point.
+ *
+ * Return value: the series ID
+ **/
+guint
+gpm_graph_add_series (GpmGraph *graph, GpmGraphPlot plot, guint capacity)
+{
+	GpmGraphSeries *series;
+
+	g_return_val_if_fail (GPM_IS_GRAPH (graph), G_MAXUINT);
+
+	/* nothing to redraw until a point is added */
+	series = gpm_graph_series_new (capacity);
+	gpm_graph_series_set_gap (series, graph->priv->gap_x);
+	g_ptr_array_add (graph->priv->data_list, series);
+	g_ptr_array_add (graph->priv->plot_list, GUINT_TO_POINTER(plot));
+	return graph->priv->data_list->len - 1;
+}
+
+/**
+ * gpm_graph_set_series_capacity:
+ * @graph: This class instance
+ * @series_id: The series ID, e.g. from gpm_graph_add_series()
+ * @capacity: The maximum number of points to keep, or 0 for no limit
+ **/
+gboolean
+gpm_graph_set_series_capacity (GpmGraph *graph, guint series_id, guint capacity)
+{
+	GpmGraphSeries *series;
+
+	g_return_val_if_fail (GPM_IS_GRAPH (graph), FALSE);
+	g_return_val_if_fail (series_id < graph->priv->data_list->len, FALSE);
+
+	series = g_ptr_array_index (graph->priv->data_list, series_id);
+	if (gpm_graph_series_get_capacity (series) == capacity)
+		return TRUE;
+	gpm_graph_series_set_capacity (series, capacity);
+	gpm_graph_queue_damage (graph, gpm_graph_autorange_damage (graph));
+	return TRUE;
+}
+
+/**
+ * gpm_get_axis_label:
+ * @axis: The axis type, e.g. GPM_GRAPH_TYPE_TIME
+ * @value: The data value, e.g. 120
+ *
+ * Unit is:
+ * GPM_GRAPH_TYPE_TIME:		seconds
+ * GPM_GRAPH_TYPE_POWER: 	Wh (not Ah)
+ * GPM_GRAPH_TYPE_PERCENTAGE:	%
+ *
+ * Return value: a string value depending on the axis type and the value.
+ **/
+static gchar *
+gpm_get_axis_label (GpmGraphType axis, gfloat value)
+{
+	gchar *text = NULL;
+	if (axis == GPM_GRAPH_TYPE_TIME) {
+		gint time_s = abs((gint) value);
+		gint minutes = time_s / 60;
+		gint seconds = time_s - (minutes * 60);
+		gint hours = minutes / 60;
+		gint days = hours / 24;
+		minutes = minutes - (hours * 60);
+		hours = hours - (days * 24);
+		if (days > 0) {
+			if (hours == 0) {
+				/*Translators: This is %i days*/
+				text = g_strdup_printf (_("%id"), days);
+			} else {
+				/*Translators: This is %i days %02i hours*/
+				text = g_strdup_printf (_("%id%02ih"), days, hours);
+			}
+		} else if (hours > 0) {
+			if (minutes == 0) {
+				/*Translators: This is %i hours*/
+				text = g_strdup_printf (_("%ih"), hours);
+			} else {
+				/*Translators: This is %i hours %02i minutes*/
+				text = g_strdup_printf (_("%ih%02im"), hours, minutes);
+			}
+		} else if (minutes > 0) {
+			if (seconds == 0) {
+				/*Translators: This is %2i minutes*/
+				text = g_strdup_printf (_("%2im"), minutes);
+			} else {
+				/*Translators: This is %2i minutes %02i seconds*/
+				text = g_strdup_printf (_("%2im%02i"), minutes, seconds);
+			}
+		} else {
+			/*Translators: This is %2i seconds*/
+			text = g_strdup_printf (_("%2is"), seconds);
+		}
+	} else if (axis == GPM_GRAPH_TYPE_PERCENTAGE) {
+		/*Translators: This is %i Percentage*/
+		text = g_strdup_printf (_("%i%%"), (gint) value);
+	} else if (axis == GPM_GRAPH_TYPE_POWER) {
+		/*Translators: This is %.1f Watts*/
+		text = g_strdup_printf (_("%.1fW"), value);
+	} else if (axis == GPM_GRAPH_TYPE_FACTOR) {
+		text = g_strdup_printf ("%.1f", value);
+	} else if (axis == GPM_GRAPH_TYPE_VOLTAGE) {
+		/*Translators: This is %.1f Volts*/
+		text = g_strdup_printf (_("%.1fV"), value);
+	} else {
+		text = g_strdup_printf ("%i", (gint) value);
+	}
+	return text;
+}
+
+/**
+ * gpm_graph_stroke:
+ * @graph: This class instance
+ * @cr: Cairo drawing context
+ *
+ * Strokes the current path, counting it for the render stats.
+ **/
+static void
+gpm_graph_stroke (GpmGraph *graph, cairo_t *cr)
+{
+	graph->priv->stats.strokes++;
+	cairo_stroke (cr);
+}
+
+/**
+ * gpm_graph_draw_grid:
+ * @graph: This class instance
+ * @cr: Cairo drawing context
+ *
+ * Draw the 10x10 dotted grid onto the graph.
+ **/
+static void
+gpm_graph_draw_grid (GpmGraph *graph, cairo_t *cr)
+{
+	guint i;
+	gfloat b;
+	gdouble dotted[] = {1., 2.};
+	gfloat divwidth  = (gfloat)graph->priv->box_width / 10.0f;
+	gfloat divheight = (gfloat)graph->priv->box_height / 10.0f;
+
+	cairo_save (cr);
+
+	cairo_set_line_width (cr, 1);
+	cairo_set_dash (cr, dotted, 2, 0.0);
+
+	/* do vertical lines */
+	cairo_set_source_rgb (cr, 0.1, 0.1, 0.1);
+	for (i=1; i<10; i++) {
+		b = graph->priv->box_x + ((gfloat) i * divwidth);
+		cairo_move_to (cr, (gint)b + 0.5f, graph->priv->box_y);
+		cairo_line_to (cr, (gint)b + 0.5f, graph->priv->box_y + graph->priv->box_height);
+		gpm_graph_stroke (graph, cr);
+	}
+
+	/* do horizontal lines */
+	for (i=1; i<10; i++) {
+		b = graph->priv->box_y + ((gfloat) i * divheight);
+		cairo_move_to (cr, graph->priv->box_x, (gint)b + 0.5f);
+		cairo_line_to (cr, graph->priv->box_x + graph->priv->box_width, (int)b + 0.5f);
+		gpm_graph_stroke (graph, cr);
+	}
+
+	cairo_restore (cr);
+}
+
+/**
+ * gpm_graph_draw_labels_x:
+ * @graph: This class instance
+ * @cr: Cairo drawing context
+ *
+ * Draw the X labels onto the graph.
+ **/
+static void
+gpm_graph_draw_labels_x (GpmGraph *graph, cairo_t *cr)
+{
+	guint i;
+	gfloat b;
+	gchar *text;
+	gfloat value;
+	gfloat divwidth  = (gfloat)graph->priv->box_width / 10.0f;
+	gfloat length_x = graph->priv->view_stop_x - graph->priv->view_start_x;
+	PangoRectangle ink_rect, logical_rect;
+	gfloat offsetx = 0;
+
+	cairo_save (cr);
+
+	/* do x text */
+	cairo_set_source_rgb (cr, 0, 0, 0);
+	for (i=0; i<11; i++) {
+		b = graph->priv->box_x + ((gfloat) i * divwidth);
+		value = ((length_x / 10.0f) * (gfloat) i) + graph->priv->view_start_x;
+		text = gpm_get_axis_label (graph->priv->type_x, value);
+
+		pango_layout_set_text (graph->priv->layout, text, -1);
+		pango_layout_get_pixel_extents (graph->priv->layout, &ink_rect, &logical_rect);
+		/* have data points 0 and 10 bounded, but 1..9 centered */
+		if (i == 0)
+			offsetx = 2.0;
+		else if (i == 10)
+			offsetx = ink_rect.width;
+		else
+			offsetx = (ink_rect.width / 2.0f);
+
+		cairo_move_to (cr, b - offsetx,
+			       graph->priv->box_y + graph->priv->box_height + 2.0);
+
+		pango_cairo_show_layout (cr, graph->priv->layout);
+		g_free (text);
+	}
+
+	cairo_restore (cr);
+}
+
+/**
+ * gpm_graph_draw_labels_y:
+ * @graph: This class instance
+ * @cr: Cairo drawing context
+ *
+ * Draw the Y labels onto the graph.
+ **/
+static void
+gpm_graph_draw_labels_y (GpmGraph *graph, cairo_t *cr)
+{
+	guint i;
+	gfloat b;
+	gchar *text;
+	gfloat value;
+	gfloat divheight = (gfloat)graph->priv->box_height / 10.0f;
+	gfloat length_y = graph->priv->view_stop_y - graph->priv->view_start_y;
+	PangoRectangle ink_rect, logical_rect;
+	gfloat offsetx = 0;
+	gfloat offsety = 0;
+
+	cairo_save (cr);
+
+	/* do y text */
+	cairo_set_source_rgb (cr, 0, 0, 0);
+	for (i=0; i<11; i++) {
+		b = graph->priv->box_y + ((gfloat) i * divheight);
+		value = (length_y / 10.0f) * (10 - (gfloat) i) + graph->priv->view_start_y;
+		text = gpm_get_axis_label (graph->priv->type_y, value);
+
+		pango_layout_set_text (graph->priv->layout, text, -1);
+		pango_layout_get_pixel_extents (graph->priv->layout, &ink_rect, &logical_rect);
+
+		/* have data points 0 and 10 bounded, but 1..9 centered */
+		if (i == 10)
+			offsety = 0;
+		else if (i == 0)
+			offsety = ink_rect.height;
+		else
+			offsety = (ink_rect.height / 2.0f);
+		offsetx = ink_rect.width + 7;
+		offsety -= 10;
+		cairo_move_to (cr, graph->priv->box_x - offsetx - 2, b + offsety);
+		pango_cairo_show_layout (cr, graph->priv->layout);
+		g_free (text);
+	}
+
+	cairo_restore (cr);
+}
+
+/**
+ * gpm_color_to_rgb:
+ * @red: The red value
+ * @green: The green value
+ * @blue: The blue value
+ **/
+static void
+gpm_color_to_rgb (guint32 color, guint8 *red, guint8 *green, guint8 *blue)
+{
+	*red = (color & 0xff0000) / 0x10000;
+	*green = (color & 0x00ff00) / 0x100;
+	*blue = color & 0x0000ff;
+}
+
+/**
+ * gpm_graph_get_y_label_max_width:
+ * @graph: This class instance
+ * @cr: Cairo drawing context
+ *
+ * Gets the width of the widest Y label, which only changes with the axis.
+ **/
+static guint
+gpm_graph_get_y_label_max_width (GpmGraph *graph, cairo_t *cr)
+{
+	guint i;
+	gchar *text;
+	gint value;
+	gint length_y = graph->priv->stop_y - graph->priv->start_y;
+	PangoRectangle ink_rect, logical_rect;
+	guint biggest = 0;
+	GpmGraphPrivate *priv = graph->priv;
+
+	/* laying out the text is slow, so reuse the last width */
+	if (priv->label_width_valid &&
+	    priv->label_start_y == priv->start_y &&
+	    priv->label_stop_y == priv->stop_y &&
+	    priv->label_type_y == priv->type_y) {
+		priv->stats.labels = GPM_GRAPH_CACHE_HIT;
+		return priv->label_width;
+	}
+	priv->stats.labels = GPM_GRAPH_CACHE_MISS;
+
+	/* do y text */
+	for (i=0; i<11; i++) {
+		value = (length_y / 10) * (10 - (gfloat) i) + graph->priv->start_y;
+		text = gpm_get_axis_label (graph->priv->type_y, value);
+		pango_layout_set_text (graph->priv->layout, text, -1);
+		pango_layout_get_pixel_extents (graph->priv->layout, &ink_rect, &logical_rect);
+		if (ink_rect.width > (gint) biggest)
+			biggest = ink_rect.width;
+		g_free (text);
+	}
+	priv->label_width = biggest;
+	priv->label_start_y = priv->start_y;
+	priv->label_stop_y = priv->stop_y;
+	priv->label_type_y = priv->type_y;
+	priv->label_width_valid = TRUE;
+	return biggest;
+}
+
+/**
+ * gpm_round_up:
+ * @value: The input value
+ * @smallest: The smallest increment allowed
+ *
+ * 101, 10	110
+ * 95,  10	100
+ * 0,   10	0
+ * 112, 10	120
+ * 100, 10	100
+ **/
+static gint
+gpm_round_up (gfloat value, gint smallest)
+{
+	gfloat division;
+	if (fabs (value) < 0.01)
+		return 0;
+	if (smallest == 0) {
+		g_warning ("divisor zero");
+		return 0;
+	}
+	division = (gfloat) value / (gfloat) smallest;
+	division = ceilf (division);
+	division *= smallest;
+	return (gint) division;
+}
+
+/**
+ * gpm_round_down:
+ * @value: The input value
+ * @smallest: The smallest increment allowed
+ *
+ * 101, 10	100
+ * 95,  10	90
+ * 0,   10	0
+ * 112, 10	110
+ * 100, 10	100
+ **/
+static gint
+gpm_round_down (gfloat value, gint smallest)
+{
+	gfloat division;
+	if (fabs (value) < 0.01)
+		return 0;
+	if (smallest == 0) {
+		g_warning ("divisor zero");
+		return 0;
+	}
+	division = (gfloat) value / (gfloat) smallest;
+	division = floorf (division);
+	division *= smallest;
+	return (gint) division;
+}
+
+/**
+ * gpm_graph_autorange_x:
+ * @graph: This class instance
+ *
+ * Autoranges the graph axis depending on the axis type, and the maximum
+ * value of the data. We have to be careful to choose a number that gives good
+ * resolution but also a number that scales "well" to a 10x10 grid.
+ **/
+static void
+gpm_graph_autorange_x (GpmGraph *graph)
+{
+	gfloat biggest_x = G_MINFLOAT;
+	gfloat smallest_x = G_MAXFLOAT;
+	gfloat min, max;
+	guint rounding_x = 1;
+	gboolean has_data = FALSE;
+	GpmGraphSeries *series;
+	guint j;
+	GPtrArray *array;
+
+	array = graph->priv->data_list;
+
+	/* get the range for the graph, each series keeps its own bounds */
+	for (j=0; j<array->len; j++) {
+		series = g_ptr_array_index (array, j);
+		if (!gpm_graph_series_get_bounds (series, &min, &max, NULL, NULL))
+			continue;
+		if (max > biggest_x)
+			biggest_x = max;
+		if (min < smallest_x)
+			smallest_x = min;
+		has_data = TRUE;
+	}
+
+	/* no data in any array */
+	if (!has_data) {
+		g_debug ("no data");
+		graph->priv->start_x = 0;
+		graph->priv->stop_x = 10;
+		return;
+	}
+	g_debug ("Data range is %f<x<%f", smallest_x, biggest_x);
+	/* don't allow no difference */
+	if (biggest_x - smallest_x < 0.0001) {
+		biggest_x++;
+		smallest_x--;
+	}
+
+	if (graph->priv->type_x == GPM_GRAPH_TYPE_PERCENTAGE) {
+		rounding_x = 10;
+	} else if (graph->priv->type_x == GPM_GRAPH_TYPE_FACTOR) {
+		rounding_x = 1;
+	} else if (graph->priv->type_x == GPM_GRAPH_TYPE_POWER) {
+		rounding_x = 10;
+	} else if (graph->priv->type_x == GPM_GRAPH_TYPE_VOLTAGE) {
+		rounding_x = 1;
+	} else if (graph->priv->type_x == GPM_GRAPH_TYPE_TIME) {
+		if (biggest_x-smallest_x < 150)
+			rounding_x = 150;
+		else if (biggest_x-smallest_x < 5*60)
+			rounding_x = 5 * 60;
+		else
+			rounding_x = 10 * 60;
+	}
+
+	graph->priv->start_x = gpm_round_down (smallest_x, rounding_x);
+	graph->priv->stop_x = gpm_round_up (biggest_x, rounding_x);
+
+	g_debug ("Processed(1) range is %i<x<%i",
+		   graph->priv->start_x, graph->priv->stop_x);
+
+	/* if percentage, and close to the end points, then extend */
+	if (graph->priv->type_x == GPM_GRAPH_TYPE_PERCENTAGE) {
+		if (graph->priv->stop_x >= 90)
+			graph->priv->stop_x = 100;
+		if (graph->priv->start_x > 0 && graph->priv->start_x <= 10)
+			graph->priv->start_x = 0;
+	} else if (graph->priv->type_x == GPM_GRAPH_TYPE_TIME) {
+		if (graph->priv->start_x > 0 && graph->priv->start_x <= 60*10)
+			graph->priv->start_x = 0;
+	}
+
+	g_debug ("Processed range is %i<x<%i",
+		   graph->priv->start_x, graph->priv->stop_x);
+}
+
+/**
+ * gpm_graph_autorange_y:
+ * @graph: This class instance
+ *
+ * Autoranges the graph axis depending on the axis type, and the maximum
+ * value of the data. We have to be careful to choose a number that gives good
+ * resolution but also a number that scales "well" to a 10x10 grid.
+ **/
+static void
+gpm_graph_autorange_y (GpmGraph *graph)
+{
+	gfloat biggest_y = G_MINFLOAT;
+	gfloat smallest_y = G_MAXFLOAT;
+	gfloat min, max;
+	guint rounding_y = 1;
+	gboolean has_data = FALSE;
+	GpmGraphSeries *series;
+	guint j;
+	GPtrArray *array;
+
+	array = graph->priv->data_list;
+
+	/* get the range for the graph, each series keeps its own bounds */
+	for (j=0; j<array->len; j++) {
+		series = g_ptr_array_index (array, j);
+		if (!gpm_graph_series_get_bounds (series, NULL, NULL, &min, &max))
+			continue;
+		if (max > biggest_y)
+			biggest_y = max;
+		if (min < smallest_y)
+			smallest_y = min;
+		has_data = TRUE;
+	}
+
+	/* no data in any array */
+	if (!has_data) {
+		g_debug ("no data");
+		graph->priv->start_y = 0;
+		graph->priv->stop_y = 10;
+		return;
+	}
+	g_debug ("Data range is %f<y<%f", smallest_y, biggest_y);
+	/* don't allow no difference */
+	if (biggest_y - smallest_y < 0.0001) {
+		biggest_y++;
+		smallest_y--;
+	}
+
+	if (graph->priv->type_y == GPM_GRAPH_TYPE_PERCENTAGE) {
+		rounding_y = 10;
+	} else if (graph->priv->type_y == GPM_GRAPH_TYPE_FACTOR) {
+		rounding_y = 1;
+	} else if (graph->priv->type_y == GPM_GRAPH_TYPE_POWER) {
+		rounding_y = 10;
+	} else if (graph->priv->type_y == GPM_GRAPH_TYPE_VOLTAGE) {
+		rounding_y = 1;
+	} else if (graph->priv->type_y == GPM_GRAPH_TYPE_TIME) {
+		if (biggest_y-smallest_y < 150)
+			rounding_y = 150;
+		else if (biggest_y < 5*60)
+			rounding_y = 5 * 60;
+		else
+			rounding_y = 10 * 60;
+	}
+
+	graph->priv->start_y = gpm_round_down (smallest_y, rounding_y);
+	graph->priv->stop_y = gpm_round_up (biggest_y, rounding_y);
+
+	/* a factor graph always is centered around zero */
+	if (graph->priv->type_y == GPM_GRAPH_TYPE_FACTOR) {
+		if (abs (graph->priv->stop_y) > abs (graph->priv->start_y))
+			graph->priv->start_y = -graph->priv->stop_y;
+		else
+			graph->priv->stop_y = -graph->priv->start_y;
+	}
+
+	g_debug ("Processed(1) range is %i<y<%i",
+		   graph->priv->start_y, graph->priv->stop_y);
+
+	if (graph->priv->type_y == GPM_GRAPH_TYPE_PERCENTAGE) {
+		if (graph->priv->stop_y >= 90)
+			graph->priv->stop_y = 100;
+		if (graph->priv->start_y > 0 && graph->priv->start_y <= 10)
+			graph->priv->start_y = 0;
+	} else if (graph->priv->type_y == GPM_GRAPH_TYPE_TIME) {
+		if (graph->priv->start_y <= 60*10)
+			graph->priv->start_y = 0;
+	}
+
+	g_debug ("Processed range is %i<y<%i",
+		   graph->priv->start_y, graph->priv->stop_y);
+}
+
+/**
+ * gpm_graph_set_color:
+ * @cr: Cairo drawing context
+ * @color: The color enum
+ **/
+void
+gpm_graph_set_color (cairo_t *cr, guint32 color)
+{
+	guint8 r, g, b;
+	gpm_color_to_rgb (color, &r, &g, &b);
+	cairo_set_source_rgb (cr, ((gdouble) r)/256.0f, ((gdouble) g)/256.0f, ((gdouble) b)/256.0f);
+}
+
+/**
+ * gpm_graph_draw_legend_line:
+ * @cr: Cairo drawing context
+ * @x: The X-coordinate for the center
+ * @y: The Y-coordinate for the center
+ * @color: The color enum
+ *
+ * Draw the legend line on the graph of a specified color
+ **/
+static void
+gpm_graph_draw_legend_line (cairo_t *cr, gfloat x, gfloat y, guint32 color)
+{
+	gfloat width = 10;
+	gfloat height = 2;
+	/* background */
+	cairo_rectangle (cr, (int) (x - (width/2)) + 0.5, (int) (y - (height/2)) + 0.5, width, height);
+	gpm_graph_set_color (cr, color);
+	cairo_fill (cr);
+	/* solid outline box */
+	cairo_rectangle (cr, (int) (x - (width/2)) + 0.5, (int) (y - (height/2)) + 0.5, width, height);
+	cairo_set_source_rgb (cr, 0.1, 0.1, 0.1);
+	cairo_set_line_width (cr, 1);
+	cairo_stroke (cr);
+}
+
+/**
+ * gpm_graph_get_transform:
+ * @transform: the returned transform from data to cairo coordinates
+ **/
+static void
+gpm_graph_get_transform (GpmGraph *graph, GpmGraphSeriesTransform *transform)
+{
+	transform->origin_x = graph->priv->view_start_x;
+	transform->scale_x = graph->priv->unit_x;
+	transform->offset_x = graph->priv->box_x + 1;
+	transform->origin_y = graph->priv->view_stop_y;
+	transform->scale_y = -graph->priv->unit_y;
+	transform->offset_y = graph->priv->box_y + 1.5f;
+}
+
+/**
+ * gpm_graph_get_pos_on_graph:
+ * @graph: This class instance
+ * @data_x: The data X-coordinate
+ * @data_y: The data Y-coordinate
+ * @x: The returned X position on the cairo surface
+ * @y: The returned Y position on the cairo surface
+ **/
+void
+gpm_graph_get_pos_on_graph (GpmGraph *graph, gfloat data_x, gfloat data_y, float *x, float *y)
+{
+	GpmGraphSeriesTransform transform;
+
+	/* the same sums as the cached points, so they line up */
+	gpm_graph_get_transform (graph, &transform);
+	*x = (data_x - transform.origin_x) * transform.scale_x + transform.offset_x;
+	*y = (data_y - transform.origin_y) * transform.scale_y + transform.offset_y;
+}
+
+/**
+ * gpm_graph_draw_dot:
+ **/
+static void
+gpm_graph_draw_dot (GpmGraph *graph, cairo_t *cr, gfloat x, gfloat y, guint32 color)
+{
+	gfloat width;
+	/* box */
+	width = 2.0;
+	cairo_rectangle (cr, (gint)x + 0.5f - (width/2), (gint)y + 0.5f - (width/2), width, width);
+	gpm_graph_set_color (cr, color);
+	cairo_fill (cr);
+	cairo_rectangle (cr, (gint)x + 0.5f - (width/2), (gint)y + 0.5f - (width/2), width, width);
+	cairo_set_source_rgb (cr, 0, 0, 0);
+	cairo_set_line_width (cr, 1);
+	gpm_graph_stroke (graph, cr);
+}
+
+/**
+ * gpm_graph_raster_begin:
+ * @graph: This class instance
+ * @cr: Cairo drawing context
+ * @raster: set up for an image the size of the box
+ *
+ * Only the part being redrawn is drawn into the image.
+ *
+ * Return value: %FALSE if there is no box to draw into
+ **/
+static gboolean
+gpm_graph_raster_begin (GpmGraph *graph, cairo_t *cr, GpmRaster *raster)
+{
+	GpmGraphPrivate *priv = graph->priv;
+	gdouble x1, y1, x2, y2;
+
+	if (priv->box_width <= 0 || priv->box_height <= 0)
+		return FALSE;
+
+	/* the image is kept while the box is the same size */
+	if (priv->raster == NULL ||
+	    cairo_image_surface_get_width (priv->raster) != priv->box_width ||
+	    cairo_image_surface_get_height (priv->raster) != priv->box_height) {
+		if (priv->raster != NULL)
+			cairo_surface_destroy (priv->raster);
+		priv->raster = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+							   priv->box_width, priv->box_height);
+	}
+	cairo_surface_flush (priv->raster);
+	gpm_raster_init (raster, (guint32 *) cairo_image_surface_get_data (priv->raster),
+			 priv->box_x, priv->box_y, priv->box_width, priv->box_height,
+			 cairo_image_surface_get_stride (priv->raster));
+	cairo_clip_extents (cr, &x1, &y1, &x2, &y2);
+	gpm_raster_set_clip (raster, floor (x1), floor (y1), ceil (x2) - floor (x1), ceil (y2) - floor (y1));
+	return TRUE;
+}
+
+/**
+ * gpm_graph_raster_paint:
+ * @graph: This class instance
+ * @cr: Cairo drawing context
+ *
+ * Paints the image from gpm_graph_raster_begin() into the box.
+ **/
+static void
+gpm_graph_raster_paint (GpmGraph *graph, cairo_t *cr)
+{
+	GpmGraphPrivate *priv = graph->priv;
+
+	cairo_surface_mark_dirty (priv->raster);
+	cairo_save (cr);
+	cairo_set_source_surface (cr, priv->raster, priv->box_x, priv->box_y);
+	cairo_rectangle (cr, priv->box_x, priv->box_y, priv->box_width, priv->box_height);
+	cairo_fill (cr);
+	cairo_restore (cr);
+	priv->stats.strokes++;
+}
+
+/**
+ * gpm_graph_has_density:
+ * @graph: This class instance
+ *
+ * Return value: %TRUE if any series is drawn with %GPM_GRAPH_PLOT_DENSITY
+ **/
+static gboolean
+gpm_graph_has_density (GpmGraph *graph)
+{
+	guint j;
+	for (j=0; j<graph->priv->plot_list->len; j++) {
+		if (GPOINTER_TO_UINT (g_ptr_array_index (graph->priv->plot_list, j)) == GPM_GRAPH_PLOT_DENSITY)
+			return TRUE;
+	}
+	return FALSE;
+}
+
+/**
+ * gpm_graph_draw_density:
+ * @graph: This class instance
+ * @raster: from gpm_graph_raster_begin()
+ *
+ * Counts the visible points of every density series into one histogram the
+ * size of the box, and colors the image by it. This only goes over the points
+ * once and the pixels once, so it costs the same however many cycles are
+ * drawn on top of each other.
+ **/
+static void
+gpm_graph_draw_density (GpmGraph *graph, GpmRaster *raster)
+{
+	GpmGraphPrivate *priv = graph->priv;
+	GpmGraphSeries *series;
+	GpmGraphSeriesTransform transform;
+	const GpmPointObj *screen;
+	guint32 max = 0;
+	guint32 series_max;
+	guint first, last;
+	gsize len;
+	guint j;
+
+	len = (gsize) priv->box_width * priv->box_height;
+	if (priv->density_len != len) {
+		g_free (priv->density);
+		priv->density = g_new (guint32, len);
+		priv->density_len = len;
+	}
+	memset (priv->density, 0, len * sizeof (guint32));
+
+	gpm_graph_get_transform (graph, &transform);
+	for (j=0; j<priv->data_list->len; j++) {
+		if (GPOINTER_TO_UINT (g_ptr_array_index (priv->plot_list, j)) != GPM_GRAPH_PLOT_DENSITY)
+			continue;
+		series = g_ptr_array_index (priv->data_list, j);
+		if (gpm_graph_series_get_length (series) == 0)
+			continue;
+		gpm_graph_series_get_range (series, priv->view_start_x, priv->view_stop_x, &first, &last);
+		priv->stats.points += last - first + 1;
+		screen = gpm_graph_series_get_screen (series, &transform, first, last);
+		series_max = gpm_raster_bin (raster, priv->density, &screen[first], last - first + 1);
+		max = MAX (max, series_max);
+	}
+	gpm_raster_density (raster, priv->density, max);
+}
+
+/**
+ * gpm_graph_draw_line_raster:
+ * @graph: This class instance
+ * @cr: Cairo drawing context
+ *
+ * Draws the same as gpm_graph_draw_line() into an image the size of
+ * the box, which is then painted as one.
+ **/
+static void
+gpm_graph_draw_line_raster (GpmGraph *graph, cairo_t *cr)
+{
+	GpmGraphPrivate *priv = graph->priv;
+	GpmGraphSeries *series;
+	GpmGraphSeriesTransform transform;
+	GpmGraphPlot plot;
+	GpmRaster raster;
+	const GpmPointObj *screen;
+	const guint *breaks;
+	guint first, last;
+	guint n_breaks;
+	guint i, j;
+	guint b;
+
+	if (!gpm_graph_raster_begin (graph, cr, &raster))
+		return;
+
+	/* the lines go on top of any density */
+	if (gpm_graph_has_density (graph))
+		gpm_graph_draw_density (graph, &raster);
+	else
+		gpm_raster_clear (&raster);
+
+	gpm_graph_get_transform (graph, &transform);
+	for (j=0; j<priv->data_list->len; j++) {
+		series = g_ptr_array_index (priv->data_list, j);
+		if (gpm_graph_series_get_length (series) == 0)
+			continue;
+		plot = GPOINTER_TO_UINT (g_ptr_array_index (priv->plot_list, j));
+		if (plot == GPM_GRAPH_PLOT_DENSITY)
+			continue;
+		gpm_graph_series_get_range (series, priv->view_start_x, priv->view_stop_x, &first, &last);
+		priv->stats.points += last - first + 1;
+		screen = gpm_graph_series_get_screen (series, &transform, first, last);
+
+		/* each segment has the color of the point it ends at */
+		if (plot == GPM_GRAPH_PLOT_LINE || plot == GPM_GRAPH_PLOT_BOTH) {
+			breaks = gpm_graph_series_get_breaks (series, &n_breaks);
+			for (b=0; b<n_breaks && breaks[b] <= first; b++)
+				;
+			for (i=first+1; i <= last; i++) {
+				if (b < n_breaks && breaks[b] == i) {
+					b++;
+					continue;
+				}
+				if (screen[i].color == 0xffffff)
+					continue;
+				gpm_raster_line (&raster, screen[i-1].x, screen[i-1].y,
+						 screen[i].x, screen[i].y, 1.5f, screen[i].color);
+			}
+		}
+		if (plot == GPM_GRAPH_PLOT_POINTS || plot == GPM_GRAPH_PLOT_BOTH) {
+			for (i=first; i <= last; i++)
+				gpm_raster_dot (&raster, screen[i].x, screen[i].y, screen[i].color);
+		}
+	}
+	gpm_graph_raster_paint (graph, cr);
+}
+
+/**
+ * gpm_graph_draw_line:
+ * @graph: This class instance
+ * @cr: Cairo drawing context
+ *
+ * Draw the data line onto the graph with a big green line. The series keep
+ * where their points are on the screen, so this only walks the visible ones.
+ **/
+static void
+gpm_graph_draw_line (GpmGraph *graph, cairo_t *cr)
+{
+	gfloat oldx, oldy;
+	GpmGraphSeries *series;
+	GpmGraphSeriesTransform transform;
+	GPtrArray *array;
+	GpmGraphPlot plot;
+	GpmRaster raster;
+	const GpmPointObj *screen;
+	const GpmPointObj *point;
+	guint32 color;
+	guint i, j;
+	guint len;
+	guint first, last;
+	const guint *breaks;
+	guint n_breaks;
+	guint b;
+
+	if (graph->priv->data_list->len == 0) {
+		g_debug ("no data");
+		return;
+	}
+	if (graph->priv->use_raster) {
+		gpm_graph_draw_line_raster (graph, cr);
+		return;
+	}
+
+	/* there's no way to draw this with cairo that doesn't cost more
+	 * for every cycle, so it's always an image under the lines */
+	if (gpm_graph_has_density (graph) &&
+	    gpm_graph_raster_begin (graph, cr, &raster)) {
+		gpm_graph_draw_density (graph, &raster);
+		gpm_graph_raster_paint (graph, cr);
+	}
+	cairo_save (cr);
+
+	/* when zoomed in the lines go outside the box */
+	cairo_rectangle (cr, graph->priv->box_x, graph->priv->box_y,
+			 graph->priv->box_width, graph->priv->box_height);
+	cairo_clip (cr);
+
+	array = graph->priv->data_list;
+	gpm_graph_get_transform (graph, &transform);
+
+	/* do each line */
+	for (j=0; j<array->len; j++) {
+		series = g_ptr_array_index (array, j);
+		len = gpm_graph_series_get_length (series);
+		if (len == 0)
+			continue;
+		plot = GPOINTER_TO_UINT (g_ptr_array_index (graph->priv->plot_list, j));
+		if (plot == GPM_GRAPH_PLOT_DENSITY)
+			continue;
+
+		/* only draw the points we can see */
+		gpm_graph_series_get_range (series,
+					    graph->priv->view_start_x,
+					    graph->priv->view_stop_x,
+					    &first, &last);
+		graph->priv->stats.points += last - first + 1;
+		screen = gpm_graph_series_get_screen (series, &transform, first, last);
+
+		/* consecutive lines of the same color are stroked together */
+		if (plot == GPM_GRAPH_PLOT_LINE || plot == GPM_GRAPH_PLOT_BOTH) {
+			cairo_set_line_width (cr, 1.5);
+			cairo_set_line_join (cr, CAIRO_LINE_JOIN_ROUND);
+			oldx = screen[first].x;
+			oldy = screen[first].y;
+			color = 0xffffff;
+
+			/* the first segment that starts after the first point */
+			breaks = gpm_graph_series_get_breaks (series, &n_breaks);
+			for (b=0; b<n_breaks && breaks[b] <= first; b++)
+				;
+
+			for (i=first+1; i <= last; i++) {
+				point = &screen[i];
+
+				/* start a new sub-path rather than join across the gap */
+				if (b < n_breaks && breaks[b] == i) {
+					b++;
+					if (color != 0xffffff) {
+						gpm_graph_set_color (cr, color);
+						gpm_graph_stroke (graph, cr);
+					}
+					color = 0xffffff;
+					oldx = point->x;
+					oldy = point->y;
+					continue;
+				}
+
+				/* finish the last run */
+				if (point->color != color && color != 0xffffff) {
+					gpm_graph_set_color (cr, color);
+					gpm_graph_stroke (graph, cr);
+				}
+
+				/* ignore white lines */
+				if (point->color != 0xffffff) {
+					if (point->color != color)
+						cairo_move_to (cr, oldx, oldy);
+					cairo_line_to (cr, point->x, point->y);
+				}
+				color = point->color;
+
+				/* save old */
+				oldx = point->x;
+				oldy = point->y;
+			}
+			if (color != 0xffffff) {
+				gpm_graph_set_color (cr, color);
+				gpm_graph_stroke (graph, cr);
+			}
+		}
+
+		/* draw data dots on top of the lines */
+		if (plot == GPM_GRAPH_PLOT_POINTS || plot == GPM_GRAPH_PLOT_BOTH) {
+			for (i=first; i <= last; i++)
+				gpm_graph_draw_dot (graph, cr, screen[i].x, screen[i].y, screen[i].color);
+		}
+	}
+
+	cairo_restore (cr);
+}
+
+/**
+ * gpm_graph_queue_segment:
+ * @graph: This class instance
+ * @p1: The start of the line
+ * @p2: The end of the line
+ *
+ * Only redraw the area covered by one line and its data dots.
+ **/
+static void
+gpm_graph_queue_segment (GpmGraph *graph, const GpmPointObj *p1, const GpmPointObj *p2)
+{
+	gfloat x1, y1;
+	gfloat x2, y2;
+	cairo_rectangle_int_t area;
+
+	gpm_graph_get_pos_on_graph (graph, p1->x, p1->y, &x1, &y1);
+	gpm_graph_get_pos_on_graph (graph, p2->x, p2->y, &x2, &y2);
+
+	/* enough for the line width and the dots */
+	area.x = floorf (MIN (x1, x2)) - GPM_GRAPH_DAMAGE_PAD;
+	area.y = floorf (MIN (y1, y2)) - GPM_GRAPH_DAMAGE_PAD;
+	area.width = ceilf (fabsf (x2 - x1)) + 2 * GPM_GRAPH_DAMAGE_PAD + 1;
+	area.height = ceilf (fabsf (y2 - y1)) + 2 * GPM_GRAPH_DAMAGE_PAD + 1;
+	g_signal_emit (graph, signals [SIGNAL_DAMAGE_AREA], 0, &area);
+}
+
+/**
+ * gpm_graph_append:
+ * @graph: This class instance
+ * @series_id: The series ID, e.g. from gpm_graph_add_series()
+ * @x: The data X-coordinate
+ * @y: The data Y-coordinate
+ * @color: The color of the line to the new point
+ *
+ * Adds one point to the end of a series without copying the other points,
+ * which is much cheaper than assigning the whole series again for a live
+ * graph. If the axes do not have to change then only the area around the
+ * new point, and around any point that was dropped, is redrawn.
+ **/
+gboolean
+gpm_graph_append (GpmGraph *graph, guint series_id, gfloat x, gfloat y, guint32 color)
+{
+	gboolean dropped;
+	guint len;
+	GpmGraphDamage damage;
+	GpmPointObj evicted;
+	GpmPointObj p1, p2;
+	GpmGraphSeries *series;
+
+	g_return_val_if_fail (GPM_IS_GRAPH (graph), FALSE);
+	g_return_val_if_fail (series_id < graph->priv->data_list->len, FALSE);
+
+	series = g_ptr_array_index (graph->priv->data_list, series_id);
+	dropped = gpm_graph_series_append (series, x, y, color, &evicted);
+	graph->priv->autorange_valid = FALSE;
+
+	/* we've never been drawn, so we don't know where anything goes */
+	if (graph->priv->box_width == 0) {
+		gpm_graph_queue_damage (graph, GPM_GRAPH_DAMAGE_ALL);
+		return TRUE;
+	}
+
+	/* if the axes change then every point moves */
+	damage = gpm_graph_autorange_damage (graph);
+	if (damage != GPM_GRAPH_DAMAGE_DATA) {
+		gpm_graph_queue_damage (graph, damage);
+		return TRUE;
+	}
+
+	/* the line to the new point */
+	len = gpm_graph_series_get_length (series);
+	gpm_graph_series_get (series, len > 1 ? len - 2 : 0, &p1);
+	gpm_graph_series_get (series, len - 1, &p2);
+	gpm_graph_queue_segment (graph, &p1, &p2);
+
+	/* the line from the point that was dropped */
+	if (dropped) {
+		gpm_graph_series_get (series, 0, &p2);
+		gpm_graph_queue_segment (graph, &evicted, &p2);
+	}
+	return TRUE;
+}
+
+/**
+ * gpm_graph_autorange_damage:
+ * @graph: This class instance
+ *
+ * Autoranges the axes for new data, and works out what has to be redrawn.
+ * Every point moves if either axis changes, and the y labels can change
+ * width which moves the whole graph.
+ *
+ * Return value: the parts of the graph that are stale
+ **/
+static GpmGraphDamage
+gpm_graph_autorange_damage (GpmGraph *graph)
+{
+	gint start_x, stop_x;
+	gint start_y, stop_y;
+	GpmGraphDamage damage = GPM_GRAPH_DAMAGE_DATA;
+
+	start_x = graph->priv->start_x;
+	stop_x = graph->priv->stop_x;
+	start_y = graph->priv->start_y;
+	stop_y = graph->priv->stop_y;
+	if (graph->priv->autorange_x)
+		gpm_graph_autorange_x (graph);
+	if (graph->priv->autorange_y)
+		gpm_graph_autorange_y (graph);
+	graph->priv->autorange_valid = TRUE;
+	if (start_x != graph->priv->start_x || stop_x != graph->priv->stop_x)
+		damage |= GPM_GRAPH_DAMAGE_LABELS_X;
+	if (start_y != graph->priv->start_y || stop_y != graph->priv->stop_y)
+		damage = GPM_GRAPH_DAMAGE_ALL;
+	return damage;
+}
+
+/**
+ * gpm_graph_draw_bounding_box:
+ * @cr: Cairo drawing context
+ * @x: The X-coordinate for the top-left
+ * @y: The Y-coordinate for the top-left
+ * @width: The item width
+ * @height: The item height
+ **/
+void
+gpm_graph_draw_bounding_box (cairo_t *cr, gint x, gint y, gint width, gint height)
+{
+	/* background */
+	cairo_rectangle (cr, x, y, width, height);
+	cairo_set_source_rgb (cr, 1, 1, 1);
+	cairo_fill (cr);
+	/* solid outline box */
+	cairo_rectangle (cr, x + 0.5f, y + 0.5f, width - 1, height - 1);
+	cairo_set_source_rgb (cr, 0.1, 0.1, 0.1);
+	cairo_set_line_width (cr, 1);
+	cairo_stroke (cr);
+}
+
+/**
+ * gpm_graph_draw_legend:
+ * @graph: This class instance
+ * @cr: Cairo drawing context
+ * @x: The X-coordinate for the top-left
+ * @y: The Y-coordinate for the top-left
+ * @width: The item width
+ * @height: The item height
+ **/
+static void
+gpm_graph_draw_legend (GpmGraph *graph, cairo_t *cr, gint x, gint y, gint width, gint height)
+{
+	gint y_count;
+	guint i;
+	GpmGraphKeyData *keydataitem;
+
+	gpm_graph_draw_bounding_box (cr, x, y, width, height);
+	y_count = y + 10;
+
+	/* add the line colors to the legend */
+	for (i=0; i<g_slist_length (graph->priv->key_data); i++) {
+		keydataitem = (GpmGraphKeyData *) g_slist_nth_data (graph->priv->key_data, i);
+		if (keydataitem == NULL) {
+			/* this shouldn't ever happen */
+			g_warning ("keydataitem NULL!");
+			break;
+		}
+		gpm_graph_draw_legend_line (cr, x + 8, y_count, keydataitem->color);
+		cairo_move_to (cr, x + 8 + 10, y_count - 6);
+		cairo_set_source_rgb (cr, 0, 0, 0);
+		pango_layout_set_text (graph->priv->layout, keydataitem->desc, -1);
+		pango_cairo_show_layout (cr, graph->priv->layout);
+		y_count = y_count + GPM_GRAPH_LEGEND_SPACING;
+	}
+}
+
+/**
+ * gpm_graph_legend_calculate_width:
+ * @graph: This class instance
+ * @cr: Cairo drawing context
+ * Return value: The width of the legend, including borders.
+ *
+ * We have to find the maximum size of the text so we know the width of the
+ * legend box. We can't hardcode this as the dpi or font size might differ
+ * from machine to machine.
+ **/
+static gboolean
+gpm_graph_legend_calculate_size (GpmGraph *graph, cairo_t *cr,
+					guint *width, guint *height)
+{
+	guint i;
+	PangoRectangle ink_rect, logical_rect;
+	GpmGraphKeyData *keydataitem;
+
+	g_return_val_if_fail (GPM_IS_GRAPH (graph), FALSE);
+
+	/* set defaults */
+	*width = 0;
+	*height = 0;
+
+	/* add the line colors to the legend */
+	for (i=0; i<g_slist_length (graph->priv->key_data); i++) {
+		keydataitem = (GpmGraphKeyData *) g_slist_nth_data (graph->priv->key_data, i);
+		*height = *height + GPM_GRAPH_LEGEND_SPACING;
+		pango_layout_set_text (graph->priv->layout, keydataitem->desc, -1);
+		pango_layout_get_pixel_extents (graph->priv->layout, &ink_rect, &logical_rect);
+		if ((gint) *width < ink_rect.width)
+			*width = ink_rect.width;
+	}
+
+	/* have we got no entries? */
+	if (*width == 0 && *height == 0)
+		return TRUE;
+
+	/* add for borders */
+	*width += 25;
+	*height += 3;
+
+	return TRUE;
+}
+
+/**
+ * gpm_graph_set_layout:
+ * @graph: This class instance
+ * @layout: A layout for the surface the graph is drawn on
+ *
+ * The text is laid out with the font settings of @layout, e.g. from the
+ * widget showing the graph.
+ **/
+void
+gpm_graph_set_layout (GpmGraph *graph, PangoLayout *layout)
+{
+	g_return_if_fail (GPM_IS_GRAPH (graph));
+	g_return_if_fail (layout != NULL);
+
+	g_object_ref (layout);
+	if (graph->priv->layout != NULL)
+		g_object_unref (graph->priv->layout);
+	graph->priv->layout = layout;
+	gpm_graph_set_layout_font (layout);
+
+	/* the labels may not be the same size */
+	graph->priv->label_width_valid = FALSE;
+}
+
+/**
+ * gpm_graph_layout_box:
+ * @graph: This class instance
+ * @cr: Cairo drawing context
+ * @width: The width of the area to draw into
+ * @height: The height of the area to draw into
+ *
+ * Autoranges the axes, and works out where the box, the labels and the
+ * legend go. The whole of the axes is shown unless
+ * gpm_graph_set_view() is used afterwards.
+ **/
+void
+gpm_graph_layout_box (GpmGraph *graph, cairo_t *cr, gint width, gint height)
+{
+	guint legend_height = 0;
+	guint legend_width = 0;
+	gint64 trace;
+	GpmGraphPrivate *priv;
+
+	g_return_if_fail (GPM_IS_GRAPH (graph));
+	g_return_if_fail (graph->priv->layout != NULL);
+	priv = graph->priv;
+
+	trace = gpm_trace_begin ();
+	gpm_graph_legend_calculate_size (graph, cr, &legend_width, &legend_height);
+
+	/* we need this so we know the y text, but only if the data changed */
+	if (priv->autorange_valid) {
+		priv->stats.autorange = GPM_GRAPH_CACHE_HIT;
+	} else {
+		if (priv->autorange_x)
+			gpm_graph_autorange_x (graph);
+		if (priv->autorange_y)
+			gpm_graph_autorange_y (graph);
+		priv->autorange_valid = TRUE;
+		priv->stats.autorange = GPM_GRAPH_CACHE_MISS;
+	}
+
+	priv->box_x = gpm_graph_get_y_label_max_width (graph, cr) + 10;
+	priv->box_y = 5;
+
+	priv->box_height = height - (20 + priv->box_y);
+
+	/* make size adjustment for legend */
+	priv->legend_rect.x = 0;
+	priv->legend_rect.y = 0;
+	if (priv->use_legend && legend_height > 0) {
+		priv->box_width = width - (3 + legend_width + 5 + priv->box_x);
+		priv->legend_rect.x = priv->box_x + priv->box_width + 6;
+		priv->legend_rect.y = priv->box_y;
+	} else {
+		priv->box_width = width - (3 + priv->box_x);
+		legend_width = 0;
+		legend_height = 0;
+	}
+	priv->legend_rect.width = legend_width;
+	priv->legend_rect.height = legend_height;
+
+	gpm_graph_set_view (graph, priv->start_x, priv->stop_x, priv->start_y, priv->stop_y);
+	gpm_trace_end (trace, "draw", "Layout");
+}
+
+/**
+ * gpm_graph_get_axes:
+ * @graph: This class instance
+ *
+ * Gets the range of the axes, which is only autoranged when laid out.
+ **/
+void
+gpm_graph_get_axes (GpmGraph *graph, gint *start_x, gint *stop_x, gint *start_y, gint *stop_y)
+{
+	g_return_if_fail (GPM_IS_GRAPH (graph));
+
+	if (start_x != NULL)
+		*start_x = graph->priv->start_x;
+	if (stop_x != NULL)
+		*stop_x = graph->priv->stop_x;
+	if (start_y != NULL)
+		*start_y = graph->priv->start_y;
+	if (stop_y != NULL)
+		*stop_y = graph->priv->stop_y;
+}
+
+/**
+ * gpm_graph_set_view:
+ * @graph: This class instance
+ *
+ * Sets the part of the axes that is drawn, e.g. when zoomed in. This has to
+ * be after gpm_graph_layout_box().
+ **/
+void
+gpm_graph_set_view (GpmGraph *graph, gfloat start_x, gfloat stop_x, gfloat start_y, gfloat stop_y)
+{
+	GpmGraphPrivate *priv;
+
+	g_return_if_fail (GPM_IS_GRAPH (graph));
+	priv = graph->priv;
+
+	priv->view_start_x = start_x;
+	priv->view_stop_x = stop_x;
+	priv->view_start_y = start_y;
+	priv->view_stop_y = stop_y;
+
+	/* -3 is so we can keep the lines inside the box at both extremes */
+	priv->unit_x = (float)(priv->box_width - 3) / (float) (stop_x - start_x);
+	priv->unit_y = (float)(priv->box_height - 3) / (float) (stop_y - start_y);
+}
+
+/**
+ * gpm_graph_get_box:
+ * @graph: This class instance
+ * @box: The returned position of the white box the data is drawn in
+ *
+ * The box is empty until the graph has been laid out.
+ **/
+void
+gpm_graph_get_box (GpmGraph *graph, cairo_rectangle_int_t *box)
+{
+	g_return_if_fail (GPM_IS_GRAPH (graph));
+
+	box->x = graph->priv->box_x;
+	box->y = graph->priv->box_y;
+	box->width = graph->priv->box_width;
+	box->height = graph->priv->box_height;
+}
+
+/**
+ * gpm_graph_get_legend_rect:
+ * @graph: This class instance
+ * @rect: The returned position of the legend, which is empty if there is none
+ **/
+void
+gpm_graph_get_legend_rect (GpmGraph *graph, cairo_rectangle_int_t *rect)
+{
+	g_return_if_fail (GPM_IS_GRAPH (graph));
+	*rect = graph->priv->legend_rect;
+}
+
+/**
+ * gpm_graph_get_data_x:
+ * @graph: This class instance
+ * @x: The X position on the cairo surface
+ *
+ * Return value: the data X-coordinate at @x
+ **/
+gfloat
+gpm_graph_get_data_x (GpmGraph *graph, gdouble x)
+{
+	g_return_val_if_fail (GPM_IS_GRAPH (graph), 0.0f);
+	return graph->priv->view_start_x + (x - graph->priv->box_x - 1) / graph->priv->unit_x;
+}
+
+/**
+ * gpm_graph_get_point_label:
+ * @graph: This class instance
+ * @point: A point on the graph
+ *
+ * Return value: the text for the point, e.g. "2h10m 12.3W\nCharging"
+ **/
+gchar *
+gpm_graph_get_point_label (GpmGraph *graph, const GpmPointObj *point)
+{
+	gchar *text;
+	gchar *text_x;
+	gchar *text_y;
+	GSList *l;
+	const gchar *desc = NULL;
+	GpmGraphKeyData *keydataitem;
+
+	g_return_val_if_fail (GPM_IS_GRAPH (graph), NULL);
+
+	/* the key says what each color means */
+	for (l=graph->priv->key_data; l != NULL; l=l->next) {
+		keydataitem = (GpmGraphKeyData *) l->data;
+		if (keydataitem->color == point->color) {
+			desc = keydataitem->desc;
+			break;
+		}
+	}
+
+	text_x = gpm_get_axis_label (graph->priv->type_x, point->x);
+	text_y = gpm_get_axis_label (graph->priv->type_y, point->y);
+	if (desc != NULL)
+		text = g_strdup_printf ("%s  %s\n%s", text_x, text_y, desc);
+	else
+		text = g_strdup_printf ("%s  %s", text_x, text_y);
+	g_free (text_x);
+	g_free (text_y);
+	return text;
+}
+
+/**
+ * gpm_graph_find_nearest:
+ * @graph: This class instance
+ * @x: The pointer X-coordinate
+ * @y: The pointer Y-coordinate
+ * @radius: How far away the point can be, in pixels
+ * @nearest: The returned point
+ *
+ * Finds the closest point to the pointer on the screen. The series are in x
+ * order, so we binary search for the pointer and then only look at the
+ * points that are close enough in x. Anything else has to be scanned.
+ *
+ * Return value: %TRUE if a point is close enough to the pointer
+ **/
+gboolean
+gpm_graph_find_nearest (GpmGraph *graph, gdouble x, gdouble y, gfloat radius, GpmPointObj *nearest)
+{
+	gboolean found = FALSE;
+	gfloat best = radius * radius;
+	gfloat data_x;
+	gfloat distance;
+	gfloat pos_x, pos_y;
+	gint i;
+	gint len;
+	guint j;
+	guint first, last;
+	GpmPointObj point;
+	GpmGraphSeries *series;
+	GpmGraphPrivate *priv = graph->priv;
+
+	g_return_val_if_fail (GPM_IS_GRAPH (graph), FALSE);
+
+	/* not on the graph */
+	if (x < priv->box_x || x > priv->box_x + priv->box_width ||
+	    y < priv->box_y || y > priv->box_y + priv->box_height)
+		return FALSE;
+
+	data_x = priv->view_start_x + (x - priv->box_x - 1) / priv->unit_x;
+	for (j=0; j<priv->data_list->len; j++) {
+		series = g_ptr_array_index (priv->data_list, j);
+		len = gpm_graph_series_get_length (series);
+		if (len == 0)
+			continue;
+
+		/* the points either side of the pointer, or all of them */
+		gpm_graph_series_get_range (series, data_x, data_x, &first, &last);
+		for (i=first; i<=(gint)last; i++) {
+			gpm_graph_series_get (series, i, &point);
+			gpm_graph_get_pos_on_graph (graph, point.x, point.y, &pos_x, &pos_y);
+			distance = (pos_x - x) * (pos_x - x) + (pos_y - y) * (pos_y - y);
+			if (distance < best) {
+				best = distance;
+				*nearest = point;
+				found = TRUE;
+			}
+		}
+
+		/* then outwards until the points are too far away in x alone */
+		for (i=first-1; i>=0; i--) {
+			gpm_graph_series_get (series, i, &point);
+			gpm_graph_get_pos_on_graph (graph, point.x, point.y, &pos_x, &pos_y);
+			if (fabsf (pos_x - x) > radius)
+				break;
+			distance = (pos_x - x) * (pos_x - x) + (pos_y - y) * (pos_y - y);
+			if (distance < best) {
+				best = distance;
+				*nearest = point;
+				found = TRUE;
+			}
+		}
+		for (i=last+1; i<len; i++) {
+			gpm_graph_series_get (series, i, &point);
+			gpm_graph_get_pos_on_graph (graph, point.x, point.y, &pos_x, &pos_y);
+			if (fabsf (pos_x - x) > radius)
+				break;
+			distance = (pos_x - x) * (pos_x - x) + (pos_y - y) * (pos_y - y);
+			if (distance < best) {
+				best = distance;
+				*nearest = point;
+				found = TRUE;
+			}
+		}
+	}
+	return found;
+}
+
+/**
+ * gpm_graph_rect_intersects:
+ **/
+static gboolean
+gpm_graph_rect_intersects (const cairo_rectangle_int_t *a, const cairo_rectangle_int_t *b)
+{
+	return a->x < b->x + b->width && b->x < a->x + a->width &&
+	       a->y < b->y + b->height && b->y < a->y + a->height;
+}
+
+/**
+ * gpm_graph_draw:
+ * @graph: This class instance
+ * @cr: Cairo drawing context
+ * @width: The width of the area to draw into
+ * @height: The height of the area to draw into
+ *
+ * Draws the parts of the graph inside the clip of @cr, using the positions
+ * from gpm_graph_layout_box().
+ **/
+void
+gpm_graph_draw (GpmGraph *graph, cairo_t *cr, gint width, gint height)
+{
+	gdouble x1, y1, x2, y2;
+	gint bottom;
+	gint64 trace;
+	cairo_rectangle_int_t clip;
+	cairo_rectangle_int_t area;
+	GpmGraphPrivate *priv;
+
+	g_return_if_fail (GPM_IS_GRAPH (graph));
+	g_return_if_fail (graph->priv->layout != NULL);
+	priv = graph->priv;
+
+	cairo_save (cr);
+
+	/* only draw the parts that are stale */
+	cairo_clip_extents (cr, &x1, &y1, &x2, &y2);
+	clip.x = floor (x1);
+	clip.y = floor (y1);
+	clip.width = ceil (x2) - clip.x;
+	clip.height = ceil (y2) - clip.y;
+
+	/* graph background and data */
+	area.x = priv->box_x;
+	area.y = priv->box_y;
+	area.width = priv->box_width;
+	area.height = priv->box_height;
+	if (gpm_graph_rect_intersects (&area, &clip)) {
+		trace = gpm_trace_begin ();
+		gpm_graph_draw_bounding_box (cr, priv->box_x, priv->box_y,
+					     priv->box_width, priv->box_height);
+		if (priv->use_grid)
+			gpm_graph_draw_grid (graph, cr);
+		gpm_trace_end (trace, "draw", "Grid");
+		trace = gpm_trace_begin ();
+		gpm_graph_draw_line (graph, cr);
+		gpm_trace_end (trace, "draw", "Lines");
+	}
+
+	/* labels below and to the left of the box */
+	bottom = priv->box_y + priv->box_height;
+	area.x = 0;
+	area.y = bottom;
+	area.width = width;
+	area.height = height - bottom;
+	trace = gpm_trace_begin ();
+	if (gpm_graph_rect_intersects (&area, &clip))
+		gpm_graph_draw_labels_x (graph, cr);
+	area.y = 0;
+	area.width = priv->box_x;
+	area.height = height;
+	if (gpm_graph_rect_intersects (&area, &clip))
+		gpm_graph_draw_labels_y (graph, cr);
+	gpm_trace_end (trace, "draw", "Labels");
+
+	if (priv->legend_rect.height > 0 &&
+	    gpm_graph_rect_intersects (&priv->legend_rect, &clip)) {
+		trace = gpm_trace_begin ();
+		gpm_graph_draw_legend (graph, cr, priv->legend_rect.x, priv->legend_rect.y,
+				       priv->legend_rect.width, priv->legend_rect.height);
+		gpm_trace_end (trace, "draw", "Legend");
+	}
+
+	cairo_restore (cr);
+}
+
+/**
+ * gpm_graph_render:
+ * @graph: This class instance
+ * @cr: Cairo drawing context, e.g. for an image or SVG surface
+ * @width: The width of the graph in pixels
+ * @height: The height of the graph in pixels
+ *
+ * Draws the whole graph onto any cairo context using the same code as the
+ * widget, so that it can be saved to a file without a display.
+ *
+ * Return value: %TRUE for success
+ **/
+gboolean
+gpm_graph_render (GpmGraph *graph, cairo_t *cr, gint width, gint height)
+{
+	PangoLayout *layout;
+
+	g_return_val_if_fail (GPM_IS_GRAPH (graph), FALSE);
+	g_return_val_if_fail (cr != NULL, FALSE);
+
+	/* use a layout that is not tied to the screen */
+	layout = graph->priv->layout;
+	graph->priv->layout = pango_cairo_create_layout (cr);
+	gpm_graph_set_layout_font (graph->priv->layout);
+	graph->priv->label_width_valid = FALSE;
+
+	/* there is no window background to draw on */
+	cairo_save (cr);
+	cairo_set_source_rgb (cr, 1, 1, 1);
+	cairo_paint (cr);
+	cairo_restore (cr);
+
+	gpm_graph_layout_box (graph, cr, width, height);
+	gpm_graph_draw (graph, cr, width, height);
+
+	g_object_unref (graph->priv->layout);
+	graph->priv->layout = layout;
+
+	/* the positions are for the surface, not a widget */
+	graph->priv->box_width = 0;
+	graph->priv->label_width_valid = FALSE;
+	return TRUE;
+}
+
+/**
+ * gpm_graph_reset_stats:
+ * @graph: This class instance
+ *
+ * Anything not drawn after this is counted as cached.
+ **/
+void
+gpm_graph_reset_stats (GpmGraph *graph)
+{
+	g_return_if_fail (GPM_IS_GRAPH (graph));
+
+	graph->priv->stats.points = 0;
+	graph->priv->stats.strokes = 0;
+	graph->priv->stats.labels = GPM_GRAPH_CACHE_HIT;
+	graph->priv->stats.autorange = GPM_GRAPH_CACHE_HIT;
+}
+
+/**
+ * gpm_graph_get_stats:
+ * @graph: This class instance
+ * @stats: The returned counts, e.g. for the render stats
+ **/
+void
+gpm_graph_get_stats (GpmGraph *graph, GpmGraphStats *stats)
+{
+	guint i;
+
+	g_return_if_fail (GPM_IS_GRAPH (graph));
+
+	*stats = graph->priv->stats;
+	stats->points_total = 0;
+	for (i=0; i<graph->priv->data_list->len; i++)
+		stats->points_total += gpm_graph_series_get_length (g_ptr_array_index (graph->priv->data_list, i));
+}
+
+/**
+ * gpm_graph_new:
+ * Return value: A new GpmGraph object.
+ **/
+GpmGraph *
+gpm_graph_new (void)
+{
+	return g_object_new (GPM_TYPE_GRAPH, NULL);
+}
@@ -0,0 +1,199 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2006-2011 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __GPM_GRAPH_H__
+#define __GPM_GRAPH_H__
+
+#include <glib-object.h>
+#include <cairo.h>
+#include <pango/pango.h>
+#include "gpm-graph-series.h"
+#include "gpm-history-pack.h"
+#include "gpm-point-obj.h"
+
+G_BEGIN_DECLS
+
+#define GPM_TYPE_GRAPH		(gpm_graph_get_type ())
+#define GPM_GRAPH(obj)		(G_TYPE_CHECK_INSTANCE_CAST ((obj), GPM_TYPE_GRAPH, GpmGraph))
+#define GPM_GRAPH_CLASS(obj)	(G_TYPE_CHECK_CLASS_CAST ((obj), GPM_TYPE_GRAPH, GpmGraphClass))
+#define GPM_IS_GRAPH(obj)	(G_TYPE_CHECK_INSTANCE_TYPE ((obj), GPM_TYPE_GRAPH))
+#define GPM_IS_GRAPH_CLASS(obj)	(G_TYPE_CHECK_CLASS_TYPE ((obj), GPM_TYPE_GRAPH))
+#define GPM_GRAPH_GET_CLASS(obj)	(G_TYPE_INSTANCE_GET_CLASS ((obj), GPM_TYPE_GRAPH, GpmGraphClass))
+
+#define GPM_GRAPH_LEGEND_SPACING	17
+#define GPM_GRAPH_DAMAGE_PAD		3 /* px */
+
+typedef struct GpmGraph		GpmGraph;
+typedef struct GpmGraphClass	GpmGraphClass;
+typedef struct GpmGraphPrivate	GpmGraphPrivate;
+
+typedef enum {
+	GPM_GRAPH_TYPE_INVALID,
+	GPM_GRAPH_TYPE_PERCENTAGE,
+	GPM_GRAPH_TYPE_FACTOR,
+	GPM_GRAPH_TYPE_TIME,
+	GPM_GRAPH_TYPE_POWER,
+	GPM_GRAPH_TYPE_VOLTAGE,
+	GPM_GRAPH_TYPE_UNKNOWN
+} GpmGraphType;
+
+typedef enum {
+	GPM_GRAPH_PLOT_LINE,
+	GPM_GRAPH_PLOT_POINTS,
+	GPM_GRAPH_PLOT_BOTH,
+	GPM_GRAPH_PLOT_DENSITY
+} GpmGraphPlot;
+
+/* the parts of the graph that can be redrawn on their own */
+typedef enum {
+	GPM_GRAPH_DAMAGE_DATA		= 1 << 0,
+	GPM_GRAPH_DAMAGE_LABELS_X	= 1 << 1,
+	GPM_GRAPH_DAMAGE_LABELS_Y	= 1 << 2,
+	GPM_GRAPH_DAMAGE_LEGEND		= 1 << 3,
+	GPM_GRAPH_DAMAGE_ALL		= 0xff
+} GpmGraphDamage;
+
+/* what a cache did for the last frame */
+typedef enum {
+	GPM_GRAPH_CACHE_HIT,
+	GPM_GRAPH_CACHE_PARTIAL,
+	GPM_GRAPH_CACHE_MISS
+} GpmGraphCache;
+
+/* the different kinds of lines in the key */
+typedef struct {
+	guint32			 color;
+	gchar			*desc;
+} GpmGraphKeyData;
+
+/* what was drawn since gpm_graph_reset_stats() */
+typedef struct {
+	guint			 points;
+	guint			 points_total; /* in all the series */
+	guint			 strokes;
+	GpmGraphCache		 labels;
+	GpmGraphCache		 autorange;
+} GpmGraphStats;
+
+struct GpmGraph
+{
+	GObject			 parent;
+	GpmGraphPrivate		*priv;
+};
+
+struct GpmGraphClass
+{
+	GObjectClass		 parent_class;
+	void			(*damage)		(GpmGraph		*graph,
+							 GpmGraphDamage		 damage);
+	void			(*damage_area)		(GpmGraph		*graph,
+							 cairo_rectangle_int_t	*area);
+};
+
+GType		 gpm_graph_get_type			(void);
+GpmGraph	*gpm_graph_new				(void);
+
+gboolean	 gpm_graph_data_clear			(GpmGraph		*graph);
+gboolean	 gpm_graph_data_assign			(GpmGraph		*graph,
+							 GpmGraphPlot		 plot,
+							 GPtrArray		*array);
+gboolean	 gpm_graph_data_assign_pack		(GpmGraph		*graph,
+							 GpmGraphPlot		 plot,
+							 GpmHistoryPack		*pack);
+gboolean	 gpm_graph_data_assign_series		(GpmGraph		*graph,
+							 GpmGraphPlot		 plot,
+							 GpmGraphSeries		*series);
+gboolean	 gpm_graph_data_swap_series		(GpmGraph		*graph,
+							 GPtrArray		**series,
+							 GArray			*plots);
+guint		 gpm_graph_add_series			(GpmGraph		*graph,
+							 GpmGraphPlot		 plot,
+							 guint			 capacity);
+gboolean	 gpm_graph_set_series_capacity		(GpmGraph		*graph,
+							 guint			 series_id,
+							 guint			 capacity);
+gboolean	 gpm_graph_append			(GpmGraph		*graph,
+							 guint			 series_id,
+							 gfloat			 x,
+							 gfloat			 y,
+							 guint32		 color);
+gboolean	 gpm_graph_key_data_clear		(GpmGraph		*graph);
+gboolean	 gpm_graph_key_data_add			(GpmGraph		*graph,
+							 guint32		 color,
+							 const gchar		*desc);
+
+void		 gpm_graph_set_layout			(GpmGraph		*graph,
+							 PangoLayout		*layout);
+void		 gpm_graph_layout_box			(GpmGraph		*graph,
+							 cairo_t		*cr,
+							 gint			 width,
+							 gint			 height);
+void		 gpm_graph_get_axes			(GpmGraph		*graph,
+							 gint			*start_x,
+							 gint			*stop_x,
+							 gint			*start_y,
+							 gint			*stop_y);
+void		 gpm_graph_set_view			(GpmGraph		*graph,
+							 gfloat			 start_x,
+							 gfloat			 stop_x,
+							 gfloat			 start_y,
+							 gfloat			 stop_y);
+void		 gpm_graph_get_box			(GpmGraph		*graph,
+							 cairo_rectangle_int_t	*box);
+void		 gpm_graph_get_legend_rect		(GpmGraph		*graph,
+							 cairo_rectangle_int_t	*rect);
+void		 gpm_graph_get_pos_on_graph		(GpmGraph		*graph,
+							 gfloat			 data_x,
+							 gfloat			 data_y,
+							 gfloat			*x,
+							 gfloat			*y);
+gfloat		 gpm_graph_get_data_x			(GpmGraph		*graph,
+							 gdouble		 x);
+gboolean	 gpm_graph_find_nearest			(GpmGraph		*graph,
+							 gdouble		 x,
+							 gdouble		 y,
+							 gfloat			 radius,
+							 GpmPointObj		*nearest);
+gchar		*gpm_graph_get_point_label		(GpmGraph		*graph,
+							 const GpmPointObj	*point);
+void		 gpm_graph_draw				(GpmGraph		*graph,
+							 cairo_t		*cr,
+							 gint			 width,
+							 gint			 height);
+gboolean	 gpm_graph_render			(GpmGraph		*graph,
+							 cairo_t		*cr,
+							 gint			 width,
+							 gint			 height);
+void		 gpm_graph_reset_stats			(GpmGraph		*graph);
+void		 gpm_graph_get_stats			(GpmGraph		*graph,
+							 GpmGraphStats		*stats);
+
+void		 gpm_graph_draw_bounding_box		(cairo_t		*cr,
+							 gint			 x,
+							 gint			 y,
+							 gint			 width,
+							 gint			 height);
+void		 gpm_graph_set_color			(cairo_t		*cr,
+							 guint32		 color);
+
+G_END_DECLS
+
+#endif
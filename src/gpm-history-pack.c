@@ -0,0 +1,493 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2011 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+
+#include <math.h>
+#include <string.h>
+#include <glib.h>
+
+#include "gpm-history-pack.h"
+
+/* The points are compressed into blocks of a fixed number of points, using
+ * the scheme from the Gorilla paper:
+ *
+ * - the first point of each block is saved in full
+ * - the times are the change in the gap since the last point, which is zero
+ *   for evenly spaced data and saved in a single bit
+ * - the values are the XOR with the last value, which is zero if the value
+ *   didn't change, and usually only has a few bits set in the middle if it did
+ * - the colors are a single bit if they're the same as the last point
+ *
+ * Each block can be decoded on its own, so there's never more than one block
+ * of points that is not compressed. */
+typedef struct {
+	guint8			*data;
+	gsize			 alloc; /* bytes */
+	gsize			 bits;
+	guint			 len;
+	gint64			 first_time;
+	guint32			 first_value;
+	guint32			 first_color;
+} GpmHistoryPackBlock;
+
+/* the last point, which the next point is saved relative to */
+typedef struct {
+	gint64			 time;
+	gint64			 delta;
+	guint32			 value;
+	guint32			 color;
+	guint			 leading; /* zero bits either side of the last XOR */
+	guint			 trailing;
+	gboolean		 has_window;
+} GpmHistoryPackState;
+
+typedef struct {
+	const guint8		*data;
+	gsize			 bits;
+} GpmHistoryPackReader;
+
+struct GpmHistoryPack
+{
+	gdouble			 resolution; /* of x */
+	GPtrArray		*blocks;
+	guint			 len;
+	guint			 capacity; /* 0 is unlimited */
+	GpmHistoryPackState	 state;
+};
+
+/**
+ * gpm_history_pack_float_to_bits:
+ **/
+static guint32
+gpm_history_pack_float_to_bits (gfloat value)
+{
+	guint32 bits;
+	memcpy (&bits, &value, sizeof (bits));
+	return bits;
+}
+
+/**
+ * gpm_history_pack_bits_to_float:
+ **/
+static gfloat
+gpm_history_pack_bits_to_float (guint32 bits)
+{
+	gfloat value;
+	memcpy (&value, &bits, sizeof (value));
+	return value;
+}
+
+/**
+ * gpm_history_pack_block_free:
+ **/
+static void
+gpm_history_pack_block_free (GpmHistoryPackBlock *block)
+{
+	g_free (block->data);
+	g_free (block);
+}
+
+/**
+ * gpm_history_pack_write:
+ * @value: the bits to write, in the lowest @n bits
+ **/
+static void
+gpm_history_pack_write (GpmHistoryPackBlock *block, guint64 value, guint n)
+{
+	gsize alloc;
+	guint i;
+
+	/* zeroed, so only the bits that are set have to be written */
+	if (block->bits + n > block->alloc * 8) {
+		alloc = MAX (block->alloc * 2, 16);
+		block->data = g_renew (guint8, block->data, alloc);
+		memset (block->data + block->alloc, 0, alloc - block->alloc);
+		block->alloc = alloc;
+	}
+	for (i=n; i>0; i--) {
+		if ((value >> (i - 1)) & 1)
+			block->data[block->bits / 8] |= 0x80 >> (block->bits % 8);
+		block->bits++;
+	}
+}
+
+/**
+ * gpm_history_pack_read:
+ **/
+static guint64
+gpm_history_pack_read (GpmHistoryPackReader *reader, guint n)
+{
+	guint64 value = 0;
+	guint i;
+
+	for (i=0; i<n; i++) {
+		value <<= 1;
+		if (reader->data[reader->bits / 8] & (0x80 >> (reader->bits % 8)))
+			value |= 1;
+		reader->bits++;
+	}
+	return value;
+}
+
+/**
+ * gpm_history_pack_state_reset:
+ *
+ * Starts a new block with this point.
+ **/
+static void
+gpm_history_pack_state_reset (GpmHistoryPackState *state, const GpmHistoryPackBlock *block)
+{
+	state->time = block->first_time;
+	state->delta = 0;
+	state->value = block->first_value;
+	state->color = block->first_color;
+	state->has_window = FALSE;
+}
+
+/**
+ * gpm_history_pack_encode:
+ **/
+static void
+gpm_history_pack_encode (GpmHistoryPackBlock *block, GpmHistoryPackState *state,
+			 gint64 time, guint32 value, guint32 color)
+{
+	gint64 delta;
+	gint64 dod;
+	guint32 xor;
+	guint leading;
+	guint trailing;
+
+	/* the change in the gap between points */
+	delta = time - state->time;
+	dod = delta - state->delta;
+	if (dod == 0) {
+		gpm_history_pack_write (block, 0x0, 1);
+	} else if (dod >= -63 && dod <= 64) {
+		gpm_history_pack_write (block, 0x2, 2);
+		gpm_history_pack_write (block, dod + 63, 7);
+	} else if (dod >= -255 && dod <= 256) {
+		gpm_history_pack_write (block, 0x6, 3);
+		gpm_history_pack_write (block, dod + 255, 9);
+	} else if (dod >= -2047 && dod <= 2048) {
+		gpm_history_pack_write (block, 0xe, 4);
+		gpm_history_pack_write (block, dod + 2047, 12);
+	} else {
+		gpm_history_pack_write (block, 0xf, 4);
+		gpm_history_pack_write (block, (guint64) dod, 64);
+	}
+	state->time = time;
+	state->delta = delta;
+
+	/* only the bits that changed */
+	xor = value ^ state->value;
+	if (xor == 0) {
+		gpm_history_pack_write (block, 0x0, 1);
+	} else {
+		gpm_history_pack_write (block, 0x1, 1);
+		leading = MIN (31 - g_bit_nth_msf (xor, -1), 31);
+		trailing = g_bit_nth_lsf (xor, -1);
+		if (state->has_window &&
+		    leading >= state->leading &&
+		    trailing >= state->trailing) {
+			/* fits inside the same bits as last time */
+			gpm_history_pack_write (block, 0x0, 1);
+			gpm_history_pack_write (block, xor >> state->trailing,
+						32 - state->leading - state->trailing);
+		} else {
+			gpm_history_pack_write (block, 0x1, 1);
+			gpm_history_pack_write (block, leading, 5);
+			gpm_history_pack_write (block, 32 - leading - trailing - 1, 5);
+			gpm_history_pack_write (block, xor >> trailing, 32 - leading - trailing);
+			state->leading = leading;
+			state->trailing = trailing;
+			state->has_window = TRUE;
+		}
+	}
+	state->value = value;
+
+	/* the state hardly ever changes */
+	if (color == state->color) {
+		gpm_history_pack_write (block, 0x0, 1);
+	} else {
+		gpm_history_pack_write (block, 0x1, 1);
+		gpm_history_pack_write (block, color, 32);
+	}
+	state->color = color;
+}
+
+/**
+ * gpm_history_pack_decode:
+ **/
+static void
+gpm_history_pack_decode (GpmHistoryPackReader *reader, GpmHistoryPackState *state)
+{
+	gint64 dod;
+	guint length;
+
+	if (gpm_history_pack_read (reader, 1) == 0)
+		dod = 0;
+	else if (gpm_history_pack_read (reader, 1) == 0)
+		dod = (gint64) gpm_history_pack_read (reader, 7) - 63;
+	else if (gpm_history_pack_read (reader, 1) == 0)
+		dod = (gint64) gpm_history_pack_read (reader, 9) - 255;
+	else if (gpm_history_pack_read (reader, 1) == 0)
+		dod = (gint64) gpm_history_pack_read (reader, 12) - 2047;
+	else
+		dod = (gint64) gpm_history_pack_read (reader, 64);
+	state->delta += dod;
+	state->time += state->delta;
+
+	if (gpm_history_pack_read (reader, 1) == 1) {
+		if (gpm_history_pack_read (reader, 1) == 1) {
+			state->leading = gpm_history_pack_read (reader, 5);
+			length = gpm_history_pack_read (reader, 5) + 1;
+			state->trailing = 32 - state->leading - length;
+			state->has_window = TRUE;
+		}
+		length = 32 - state->leading - state->trailing;
+		state->value ^= (guint32) gpm_history_pack_read (reader, length) << state->trailing;
+	}
+
+	if (gpm_history_pack_read (reader, 1) == 1)
+		state->color = gpm_history_pack_read (reader, 32);
+}
+
+/**
+ * gpm_history_pack_decode_block:
+ * @points: an array of %GPM_HISTORY_PACK_BLOCK_LEN points to fill
+ *
+ * Return value: the number of points in the block
+ **/
+static guint
+gpm_history_pack_decode_block (GpmHistoryPack *pack, guint index, GpmPointObj *points)
+{
+	GpmHistoryPackBlock *block;
+	GpmHistoryPackReader reader;
+	GpmHistoryPackState state;
+	guint i;
+
+	block = g_ptr_array_index (pack->blocks, index);
+	reader.data = block->data;
+	reader.bits = 0;
+	gpm_history_pack_state_reset (&state, block);
+	for (i=0; i<block->len; i++) {
+		if (i > 0)
+			gpm_history_pack_decode (&reader, &state);
+		points[i].x = state.time * pack->resolution;
+		points[i].y = gpm_history_pack_bits_to_float (state.value);
+		points[i].color = state.color;
+	}
+	return block->len;
+}
+
+/**
+ * gpm_history_pack_new:
+ * @resolution: the smallest step in x, e.g. 1 for whole seconds
+ *
+ * Return value: a new pack, free with gpm_history_pack_free()
+ **/
+GpmHistoryPack *
+gpm_history_pack_new (gfloat resolution)
+{
+	GpmHistoryPack *pack;
+
+	g_return_val_if_fail (resolution > 0, NULL);
+
+	pack = g_new0 (GpmHistoryPack, 1);
+	pack->resolution = resolution;
+	pack->blocks = g_ptr_array_new_with_free_func ((GDestroyNotify) gpm_history_pack_block_free);
+	return pack;
+}
+
+/**
+ * gpm_history_pack_free:
+ **/
+void
+gpm_history_pack_free (GpmHistoryPack *pack)
+{
+	if (pack == NULL)
+		return;
+	g_ptr_array_unref (pack->blocks);
+	g_free (pack);
+}
+
+/**
+ * gpm_history_pack_drop_blocks:
+ *
+ * Drops the oldest blocks while there's still enough points without them.
+ **/
+static void
+gpm_history_pack_drop_blocks (GpmHistoryPack *pack)
+{
+	GpmHistoryPackBlock *block;
+
+	if (pack->capacity == 0)
+		return;
+	while (pack->blocks->len > 1) {
+		block = g_ptr_array_index (pack->blocks, 0);
+		if (pack->len - block->len < pack->capacity)
+			break;
+		pack->len -= block->len;
+		g_ptr_array_remove_index (pack->blocks, 0);
+	}
+}
+
+/**
+ * gpm_history_pack_set_capacity:
+ * @capacity: the number of points to keep, or 0 for no limit
+ *
+ * Whole blocks are dropped, so there may be up to a block more points than
+ * the capacity.
+ **/
+void
+gpm_history_pack_set_capacity (GpmHistoryPack *pack, guint capacity)
+{
+	g_return_if_fail (pack != NULL);
+	pack->capacity = capacity;
+	gpm_history_pack_drop_blocks (pack);
+}
+
+/**
+ * gpm_history_pack_append:
+ * @x: the x value, which is rounded to the resolution
+ *
+ * Adds a point to the end of the pack.
+ **/
+void
+gpm_history_pack_append (GpmHistoryPack *pack, gfloat x, gfloat y, guint32 color)
+{
+	GpmHistoryPackBlock *block = NULL;
+	gint64 time;
+	guint32 value;
+
+	g_return_if_fail (pack != NULL);
+
+	time = (gint64) floor (x / pack->resolution + 0.5);
+	value = gpm_history_pack_float_to_bits (y);
+	if (pack->blocks->len > 0)
+		block = g_ptr_array_index (pack->blocks, pack->blocks->len - 1);
+
+	/* start a new block, and give back what the last one didn't use */
+	if (block == NULL || block->len == GPM_HISTORY_PACK_BLOCK_LEN) {
+		if (block != NULL) {
+			block->alloc = (block->bits + 7) / 8;
+			block->data = g_renew (guint8, block->data, block->alloc);
+		}
+		block = g_new0 (GpmHistoryPackBlock, 1);
+		block->first_time = time;
+		block->first_value = value;
+		block->first_color = color;
+		block->len = 1;
+		g_ptr_array_add (pack->blocks, block);
+		gpm_history_pack_state_reset (&pack->state, block);
+	} else {
+		gpm_history_pack_encode (block, &pack->state, time, value, color);
+		block->len++;
+	}
+	pack->len++;
+	gpm_history_pack_drop_blocks (pack);
+}
+
+/**
+ * gpm_history_pack_get_length:
+ **/
+guint
+gpm_history_pack_get_length (GpmHistoryPack *pack)
+{
+	g_return_val_if_fail (pack != NULL, 0);
+	return pack->len;
+}
+
+/**
+ * gpm_history_pack_get_size:
+ *
+ * Return value: the memory used by the pack, in bytes
+ **/
+gsize
+gpm_history_pack_get_size (GpmHistoryPack *pack)
+{
+	GpmHistoryPackBlock *block;
+	gsize size;
+	guint i;
+
+	g_return_val_if_fail (pack != NULL, 0);
+
+	size = sizeof (GpmHistoryPack) + pack->blocks->len * sizeof (gpointer);
+	for (i=0; i<pack->blocks->len; i++) {
+		block = g_ptr_array_index (pack->blocks, i);
+		size += sizeof (GpmHistoryPackBlock) + block->alloc;
+	}
+	return size;
+}
+
+/**
+ * gpm_history_pack_get_last:
+ * @point: the returned newest point
+ *
+ * Return value: %FALSE if there are no points
+ **/
+gboolean
+gpm_history_pack_get_last (GpmHistoryPack *pack, GpmPointObj *point)
+{
+	g_return_val_if_fail (pack != NULL, FALSE);
+
+	if (pack->len == 0)
+		return FALSE;
+	point->x = pack->state.time * pack->resolution;
+	point->y = gpm_history_pack_bits_to_float (pack->state.value);
+	point->color = pack->state.color;
+	return TRUE;
+}
+
+/**
+ * gpm_history_pack_iter_init:
+ **/
+void
+gpm_history_pack_iter_init (GpmHistoryPackIter *iter, GpmHistoryPack *pack)
+{
+	g_return_if_fail (iter != NULL);
+	g_return_if_fail (pack != NULL);
+	iter->pack = pack;
+	iter->block = 0;
+}
+
+/**
+ * gpm_history_pack_iter_next:
+ * @points: the returned points, which are valid until the next call
+ *
+ * Decodes the next block of points, oldest first.
+ *
+ * Return value: the number of points, or 0 when there are no more blocks
+ **/
+guint
+gpm_history_pack_iter_next (GpmHistoryPackIter *iter, const GpmPointObj **points)
+{
+	guint len;
+
+	g_return_val_if_fail (iter != NULL, 0);
+
+	if (iter->block >= iter->pack->blocks->len)
+		return 0;
+	len = gpm_history_pack_decode_block (iter->pack, iter->block++, iter->points);
+	*points = iter->points;
+	return len;
+}
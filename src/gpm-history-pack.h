@@ -0,0 +1,61 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2011 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __GPM_HISTORY_PACK_H
+#define __GPM_HISTORY_PACK_H
+
+#include <glib.h>
+
+#include "gpm-point-obj.h"
+
+G_BEGIN_DECLS
+
+#define GPM_HISTORY_PACK_BLOCK_LEN	128 /* points */
+
+typedef struct GpmHistoryPack GpmHistoryPack;
+
+/* decodes one block at a time, so it can live on the stack */
+typedef struct {
+	GpmHistoryPack		*pack;
+	guint			 block;
+	GpmPointObj		 points[GPM_HISTORY_PACK_BLOCK_LEN];
+} GpmHistoryPackIter;
+
+GpmHistoryPack	*gpm_history_pack_new			(gfloat		 resolution);
+void		 gpm_history_pack_free			(GpmHistoryPack	*pack);
+void		 gpm_history_pack_set_capacity		(GpmHistoryPack	*pack,
+							 guint		 capacity);
+void		 gpm_history_pack_append		(GpmHistoryPack	*pack,
+							 gfloat		 x,
+							 gfloat		 y,
+							 guint32	 color);
+guint		 gpm_history_pack_get_length		(GpmHistoryPack	*pack);
+gsize		 gpm_history_pack_get_size		(GpmHistoryPack	*pack);
+gboolean	 gpm_history_pack_get_last		(GpmHistoryPack	*pack,
+							 GpmPointObj	*point);
+void		 gpm_history_pack_iter_init		(GpmHistoryPackIter *iter,
+							 GpmHistoryPack	*pack);
+guint		 gpm_history_pack_iter_next		(GpmHistoryPackIter *iter,
+							 const GpmPointObj **points);
+
+G_END_DECLS
+
+#endif /* __GPM_HISTORY_PACK_H */
@@ -0,0 +1,362 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2011 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+
+#include <math.h>
+#include <string.h>
+#include <glib.h>
+
+#include "gpm-raster.h"
+
+/* Cairo can stroke anything, but that costs a lot once there are tens of
+ * thousands of short segments, and all we ever draw are thin lines in one
+ * color at a time. Each line is drawn one column (or row, if it is steep) at
+ * a time, and the pixels across the line are blended by how much of them the
+ * line covers, which is what cairo does for a line this thin. */
+
+/**
+ * gpm_raster_init:
+ * @data: the pixels, e.g. from cairo_image_surface_get_data()
+ * @x: where the image is on the surface the coordinates are for
+ * @y: where the image is on the surface the coordinates are for
+ * @stride: the bytes between the start of each row
+ *
+ * Sets up a raster for an image, with everything in the clip.
+ **/
+void
+gpm_raster_init (GpmRaster *raster, guint32 *data, gint x, gint y, gint width, gint height, gint stride)
+{
+	g_return_if_fail (raster != NULL);
+	g_return_if_fail (stride % sizeof (guint32) == 0);
+
+	raster->data = data;
+	raster->stride = stride / sizeof (guint32);
+	raster->x = x;
+	raster->y = y;
+	raster->width = width;
+	raster->height = height;
+	raster->clip_x1 = 0;
+	raster->clip_y1 = 0;
+	raster->clip_x2 = width;
+	raster->clip_y2 = height;
+}
+
+/**
+ * gpm_raster_set_clip:
+ *
+ * Only draws inside this rectangle, in the coordinates of the surface.
+ **/
+void
+gpm_raster_set_clip (GpmRaster *raster, gint x, gint y, gint width, gint height)
+{
+	g_return_if_fail (raster != NULL);
+
+	raster->clip_x1 = CLAMP (x - raster->x, 0, raster->width);
+	raster->clip_y1 = CLAMP (y - raster->y, 0, raster->height);
+	raster->clip_x2 = CLAMP (x - raster->x + width, raster->clip_x1, raster->width);
+	raster->clip_y2 = CLAMP (y - raster->y + height, raster->clip_y1, raster->height);
+}
+
+/**
+ * gpm_raster_clear:
+ *
+ * Makes everything in the clip transparent.
+ **/
+void
+gpm_raster_clear (GpmRaster *raster)
+{
+	gint i;
+
+	g_return_if_fail (raster != NULL);
+
+	for (i=raster->clip_y1; i<raster->clip_y2; i++)
+		memset (&raster->data[i * raster->stride + raster->clip_x1], 0,
+			(raster->clip_x2 - raster->clip_x1) * sizeof (guint32));
+}
+
+/**
+ * gpm_raster_blend:
+ * @src: an opaque color
+ * @alpha: how much of the pixel is covered, from 0 to 255
+ *
+ * Return value: @src over @dst, premultiplied
+ **/
+static inline guint32
+gpm_raster_blend (guint32 dst, guint32 src, guint alpha)
+{
+	guint32 rb;
+	guint32 ag;
+
+	/* two channels at a time, dividing by 255 without dividing */
+	rb = (src & 0xff00ff) * alpha + (dst & 0xff00ff) * (255 - alpha) + 0x800080;
+	ag = ((src >> 8) & 0xff00ff) * alpha + ((dst >> 8) & 0xff00ff) * (255 - alpha) + 0x800080;
+	rb = ((rb + ((rb >> 8) & 0xff00ff)) >> 8) & 0xff00ff;
+	ag = (ag + ((ag >> 8) & 0xff00ff)) & 0xff00ff00;
+	return rb | ag;
+}
+
+/**
+ * gpm_raster_span:
+ * @steep: if the line moves more in y than in x, so a and b are swapped
+ * @a1: the start of the line along the way it moves most
+ * @b1: the start of the line across the way it moves most
+ *
+ * Draws the line a column at a time, where the column is a row if it is
+ * @steep. The line only covers the pixel centers from @a1 up to @a2, so the
+ * pixel where two lines meet is only drawn once.
+ **/
+static void
+gpm_raster_span (GpmRaster *raster, gboolean steep, gfloat a1, gfloat b1, gfloat a2, gfloat b2,
+		 gfloat width, guint32 color)
+{
+	gfloat slope;
+	gfloat half;
+	gfloat center;
+	gfloat low;
+	gfloat high;
+	gfloat coverage;
+	gint clip_a1, clip_a2;
+	gint clip_b1, clip_b2;
+	gint start, end;
+	gint first, last;
+	gint a, b;
+	guint32 *pixel;
+
+	if (a1 > a2) {
+		center = a1; a1 = a2; a2 = center;
+		center = b1; b1 = b2; b2 = center;
+	}
+	if (a1 == a2)
+		return;
+	slope = (b2 - b1) / (a2 - a1);
+	if (!isfinite (slope))
+		return;
+
+	/* the line is wider across a column when it is at an angle */
+	half = width * 0.5f * sqrtf (1.0f + slope * slope);
+
+	clip_a1 = steep ? raster->clip_y1 : raster->clip_x1;
+	clip_a2 = steep ? raster->clip_y2 : raster->clip_x2;
+	clip_b1 = steep ? raster->clip_x1 : raster->clip_y1;
+	clip_b2 = steep ? raster->clip_x2 : raster->clip_y2;
+
+	/* clip in floats first, as a line can go a long way off the screen */
+	start = CLAMP (ceilf (a1 - 0.5f), (gfloat) clip_a1, (gfloat) clip_a2);
+	end = CLAMP (ceilf (a2 - 0.5f), (gfloat) clip_a1, (gfloat) clip_a2);
+	for (a=start; a<end; a++) {
+		center = b1 + ((gfloat) a + 0.5f - a1) * slope;
+		low = center - half;
+		high = center + half;
+		if (high <= clip_b1 || low >= clip_b2)
+			continue;
+		first = MAX (floorf (low), (gfloat) clip_b1);
+		last = MIN (floorf (high), (gfloat) (clip_b2 - 1));
+		for (b=first; b<=last; b++) {
+			coverage = MIN (high, b + 1.0f) - MAX (low, (gfloat) b);
+			if (coverage <= 0.0f)
+				continue;
+			if (steep)
+				pixel = &raster->data[a * raster->stride + b];
+			else
+				pixel = &raster->data[b * raster->stride + a];
+			if (coverage >= 1.0f)
+				*pixel = color;
+			else
+				*pixel = gpm_raster_blend (*pixel, color, (guint) (coverage * 255.0f + 0.5f));
+		}
+	}
+}
+
+/**
+ * gpm_raster_line:
+ * @width: the width of the line, e.g. 1.5
+ * @color: the color, as 0xrrggbb
+ *
+ * Draws an antialiased line with flat ends, in the coordinates of the
+ * surface. Lines that are not finite are not drawn.
+ **/
+void
+gpm_raster_line (GpmRaster *raster, gfloat x1, gfloat y1, gfloat x2, gfloat y2, gfloat width, guint32 color)
+{
+	g_return_if_fail (raster != NULL);
+
+	if (!isfinite (x1) || !isfinite (y1) || !isfinite (x2) || !isfinite (y2))
+		return;
+	x1 -= raster->x;
+	x2 -= raster->x;
+	y1 -= raster->y;
+	y2 -= raster->y;
+	color |= 0xff000000;
+	if (fabsf (x2 - x1) >= fabsf (y2 - y1))
+		gpm_raster_span (raster, FALSE, x1, y1, x2, y2, width, color);
+	else
+		gpm_raster_span (raster, TRUE, y1, x1, y2, x2, width, color);
+}
+
+/**
+ * gpm_raster_dot:
+ * @color: the color, as 0xrrggbb
+ *
+ * Draws a data point the same as the graph does with cairo, which is one
+ * pixel of @color with a black pixel all around it.
+ **/
+void
+gpm_raster_dot (GpmRaster *raster, gfloat x, gfloat y, guint32 color)
+{
+	gint px, py;
+	gint i, j;
+
+	g_return_if_fail (raster != NULL);
+
+	if (!isfinite (x) || !isfinite (y) || fabsf (x) > G_MAXINT / 2 || fabsf (y) > G_MAXINT / 2)
+		return;
+	px = (gint) x - raster->x;
+	py = (gint) y - raster->y;
+	for (j=py-1; j<=py+1; j++) {
+		if (j < raster->clip_y1 || j >= raster->clip_y2)
+			continue;
+		for (i=px-1; i<=px+1; i++) {
+			if (i < raster->clip_x1 || i >= raster->clip_x2)
+				continue;
+			if (i == px && j == py)
+				raster->data[j * raster->stride + i] = color | 0xff000000;
+			else
+				raster->data[j * raster->stride + i] = 0xff000000;
+		}
+	}
+}
+
+/* from the fewest points in a pixel to the most, as 0xrrggbb */
+static const guint32 gpm_raster_ramp_stops[] = {
+	0x0000ff, 0x00c0ff, 0x00c000, 0xffc000, 0xff0000 };
+
+/**
+ * gpm_raster_get_ramp:
+ *
+ * Return value: 256 premultiplied colors, which get less transparent as
+ * they go from blue to red
+ **/
+static const guint32 *
+gpm_raster_get_ramp (void)
+{
+	static guint32 ramp[256];
+	static gsize ramp_valid = 0;
+	guint32 from, to;
+	guint alpha;
+	guint channel;
+	guint stop;
+	guint i, j;
+	gfloat pos;
+	gfloat frac;
+	guint32 color;
+
+	if (!g_once_init_enter (&ramp_valid))
+		return ramp;
+	for (i=0; i<256; i++) {
+		pos = (gfloat) i * (G_N_ELEMENTS (gpm_raster_ramp_stops) - 1) / 255.0f;
+		stop = MIN ((guint) pos, G_N_ELEMENTS (gpm_raster_ramp_stops) - 2);
+		frac = pos - stop;
+		from = gpm_raster_ramp_stops[stop];
+		to = gpm_raster_ramp_stops[stop + 1];
+		alpha = 96 + (159 * i + 127) / 255;
+		color = alpha << 24;
+		for (j=0; j<24; j+=8) {
+			channel = (guint) ((1.0f - frac) * ((from >> j) & 0xff) + frac * ((to >> j) & 0xff) + 0.5f);
+			color |= ((channel * alpha + 127) / 255) << j;
+		}
+		ramp[i] = color;
+	}
+	g_once_init_leave (&ramp_valid, 1);
+	return ramp;
+}
+
+/**
+ * gpm_raster_bin:
+ * @bins: a count for each pixel of the image, @raster->width to a row
+ * @points: points in the coordinates of the surface
+ *
+ * Adds one to the bin of each point that is inside the image. This ignores
+ * the clip, so the counts don't depend on what is being redrawn.
+ *
+ * Return value: the highest count of the bins that were added to
+ **/
+guint32
+gpm_raster_bin (GpmRaster *raster, guint32 *bins, const GpmPointObj *points, guint length)
+{
+	guint32 max = 0;
+	gfloat x, y;
+	guint32 *bin;
+	guint i;
+
+	g_return_val_if_fail (raster != NULL, 0);
+	g_return_val_if_fail (bins != NULL, 0);
+
+	for (i=0; i<length; i++) {
+		/* this is false for NaN too */
+		x = points[i].x - raster->x;
+		y = points[i].y - raster->y;
+		if (!(x >= 0.0f && x < raster->width && y >= 0.0f && y < raster->height))
+			continue;
+		bin = &bins[(gint) y * raster->width + (gint) x];
+		if (++(*bin) > max)
+			max = *bin;
+	}
+	return max;
+}
+
+/**
+ * gpm_raster_density:
+ * @bins: the counts from gpm_raster_bin()
+ * @max: the highest count in @bins
+ *
+ * Colors every pixel in the clip by how many points are in it, on a log
+ * scale so a few busy pixels don't hide the rest. Pixels with no points are
+ * made transparent, so this does not need gpm_raster_clear() first.
+ **/
+void
+gpm_raster_density (GpmRaster *raster, const guint32 *bins, guint32 max)
+{
+	const guint32 *ramp;
+	const guint32 *row;
+	guint32 *pixel;
+	gfloat scale = 0.0f;
+	gint i, j;
+
+	g_return_if_fail (raster != NULL);
+	g_return_if_fail (bins != NULL);
+
+	ramp = gpm_raster_get_ramp ();
+	if (max > 1)
+		scale = 254.0f / logf (max);
+	for (j=raster->clip_y1; j<raster->clip_y2; j++) {
+		row = &bins[j * raster->width];
+		pixel = &raster->data[j * raster->stride];
+		for (i=raster->clip_x1; i<raster->clip_x2; i++) {
+			if (row[i] == 0)
+				pixel[i] = 0;
+			else if (max <= 1)
+				pixel[i] = ramp[255];
+			else
+				pixel[i] = ramp[1 + (guint) (logf (MIN (row[i], max)) * scale + 0.5f)];
+		}
+	}
+}
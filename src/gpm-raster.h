@@ -0,0 +1,79 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2011 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __GPM_RASTER_H
+#define __GPM_RASTER_H
+
+#include <glib.h>
+
+#include "gpm-point-obj.h"
+
+G_BEGIN_DECLS
+
+/* draws into memory the caller owns, so it can live on the stack */
+typedef struct {
+	guint32			*data; /* premultiplied ARGB32, as cairo uses */
+	gint			 stride; /* in pixels */
+	gint			 x; /* where the image is on the surface */
+	gint			 y;
+	gint			 width;
+	gint			 height;
+	gint			 clip_x1; /* only these pixels are touched */
+	gint			 clip_y1;
+	gint			 clip_x2;
+	gint			 clip_y2;
+} GpmRaster;
+
+void		 gpm_raster_init			(GpmRaster	*raster,
+							 guint32	*data,
+							 gint		 x,
+							 gint		 y,
+							 gint		 width,
+							 gint		 height,
+							 gint		 stride);
+void		 gpm_raster_set_clip			(GpmRaster	*raster,
+							 gint		 x,
+							 gint		 y,
+							 gint		 width,
+							 gint		 height);
+void		 gpm_raster_clear			(GpmRaster	*raster);
+void		 gpm_raster_line			(GpmRaster	*raster,
+							 gfloat		 x1,
+							 gfloat		 y1,
+							 gfloat		 x2,
+							 gfloat		 y2,
+							 gfloat		 width,
+							 guint32	 color);
+void		 gpm_raster_dot				(GpmRaster	*raster,
+							 gfloat		 x,
+							 gfloat		 y,
+							 guint32	 color);
+guint32		 gpm_raster_bin				(GpmRaster	*raster,
+							 guint32	*bins,
+							 const GpmPointObj *points,
+							 guint		 length);
+void		 gpm_raster_density			(GpmRaster	*raster,
+							 const guint32	*bins,
+							 guint32	 max);
+
+G_END_DECLS
+
+#endif /* __GPM_RASTER_H */
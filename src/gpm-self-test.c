@@ -22,11 +22,56 @@
 #include "config.h"
 
 #include <glib.h>
+#include <glib/gstdio.h>
 #include <math.h>
+#include <stdlib.h>
+#include <string.h>
 #include <glib-object.h>
 #include <gtk/gtk.h>
 
 #include "gpm-array-float.h"
+#include "gpm-graph-series.h"
+#include "gpm-history-pack.h"
+#include "gpm-raster.h"
+#include "gpm-trace.h"
+
+#ifdef __GLIBC__
+/* GLib no longer lets the allocator be swapped with g_mem_set_vtable(), so
+ * count the calls into the C library instead */
+extern void *__libc_malloc (size_t size);
+extern void *__libc_calloc (size_t nmemb, size_t size);
+extern void *__libc_realloc (void *ptr, size_t size);
+
+static gint gpm_test_allocations = -1; /* not counting */
+
+static void
+gpm_test_count_allocation (void)
+{
+	if (g_atomic_int_get (&gpm_test_allocations) >= 0)
+		g_atomic_int_inc (&gpm_test_allocations);
+}
+
+void *
+malloc (size_t size)
+{
+	gpm_test_count_allocation ();
+	return __libc_malloc (size);
+}
+
+void *
+calloc (size_t nmemb, size_t size)
+{
+	gpm_test_count_allocation ();
+	return __libc_calloc (nmemb, size);
+}
+
+void *
+realloc (void *ptr, size_t size)
+{
+	gpm_test_count_allocation ();
+	return __libc_realloc (ptr, size);
+}
+#endif
 
 static void
 gpm_test_array_float_func (void)
@@ -34,9 +79,16 @@ gpm_test_array_float_func (void)
 	GpmArrayFloat *array;
 	GpmArrayFloat *kernel;
 	GpmArrayFloat *result;
+	GpmArrayFloat *expected;
+	GpmArrayFloat *other;
 	gfloat value;
 	gfloat sigma;
 	guint size;
+	guint i;
+	guint j;
+	const guint windows[] = { 3, 9, 65 };
+	const guint kernels[] = { 9, 15, 71 };
+	const gfloat sigmas[] = { 1.1f, 2.0f, 10.0f };
 
 	/* make sure we get a non null array */
 	array = gpm_array_float_new (10);
@@ -297,6 +349,1405 @@ gpm_test_array_float_func (void)
 	gpm_array_float_free (result);
 	gpm_array_float_free (array);
 	gpm_array_float_free (kernel);
+
+	/* uninitialised array has the right length */
+	array = gpm_array_float_new_uninitialised (200);
+	g_assert_cmpint (array->len, ==, 200);
+	for (i=0; i<array->len; i++)
+		gpm_array_float_set (array, i, 40.0f + 20.0f * sinf (i * 0.07f) + (i % 13 == 0 ? 25.0f : 0.0f));
+
+	/* in place is the same as into another array, including windows
+	 * too big to remember on the stack */
+	for (j=0; j<G_N_ELEMENTS (windows); j++) {
+		expected = gpm_array_float_remove_outliers (array, windows[j], 1.0);
+		result = gpm_array_float_new (0);
+		g_array_append_vals (result, array->data, array->len);
+		g_assert (gpm_array_float_remove_outliers_into (result, windows[j], 1.0, result) == result);
+		for (i=0; i<array->len; i++)
+			g_assert_cmpfloat (gpm_array_float_get (result, i), ==, gpm_array_float_get (expected, i));
+		gpm_array_float_free (expected);
+		gpm_array_float_free (result);
+	}
+	for (j=0; j<G_N_ELEMENTS (kernels); j++) {
+		kernel = gpm_array_float_compute_gaussian (kernels[j], sigmas[j]);
+		g_assert (kernel != NULL);
+		expected = gpm_array_float_convolve (array, kernel);
+		result = gpm_array_float_new (0);
+		g_array_append_vals (result, array->data, array->len);
+		g_assert (gpm_array_float_convolve_into (result, kernel, result) == result);
+		for (i=0; i<array->len; i++)
+			g_assert_cmpfloat (gpm_array_float_get (result, i), ==, gpm_array_float_get (expected, i));
+		gpm_array_float_free (expected);
+		gpm_array_float_free (result);
+		gpm_array_float_free (kernel);
+	}
+
+	/* stages can be chained using two buffers */
+	kernel = gpm_array_float_compute_gaussian (15, 2.0);
+	result = gpm_array_float_remove_outliers (array, 3, 0.1);
+	expected = gpm_array_float_convolve (result, kernel);
+	gpm_array_float_free (result);
+	result = gpm_array_float_new (0);
+	other = gpm_array_float_new (0);
+	g_array_append_vals (result, array->data, array->len);
+	g_assert (gpm_array_float_convolve_into (gpm_array_float_remove_outliers_into (result, 3, 0.1, other),
+						 kernel, result) == result);
+	for (i=0; i<array->len; i++)
+		g_assert_cmpfloat (gpm_array_float_get (result, i), ==, gpm_array_float_get (expected, i));
+	gpm_array_float_free (expected);
+	gpm_array_float_free (result);
+	gpm_array_float_free (other);
+	gpm_array_float_free (kernel);
+	gpm_array_float_free (array);
+}
+
+static gint
+gpm_test_float_compare (gconstpointer a, gconstpointer b)
+{
+	gfloat fa = *((const gfloat *) a);
+	gfloat fb = *((const gfloat *) b);
+	if (fa < fb)
+		return -1;
+	return fa > fb;
+}
+
+static void
+gpm_test_filter_pipeline_func (void)
+{
+	GpmArrayFloat *array;
+	GpmArrayFloat *expected;
+	GpmArrayFloat *input;
+	GpmArrayFloat *kernel;
+	GpmArrayFloat *result;
+	GpmArrayFloat *times;
+	GpmArrayFloat *segment;
+	GpmFilterPipeline *pipeline;
+	gfloat window[65];
+	gpointer data;
+	const guint *breaks;
+	guint n_breaks;
+	guint start;
+	guint end;
+	guint i;
+	guint j;
+	guint k;
+	gint idx;
+	const guint windows[] = { 1, 3, 5, 9, 65 };
+
+	array = gpm_array_float_new_uninitialised (300);
+	for (i=0; i<array->len; i++)
+		gpm_array_float_set (array, i, 40.0f + 20.0f * sinf (i * 0.05f) + (i * 7919 % 101) / 10.0f +
+				     (i % 23 == 0 ? 60.0f : 0.0f));
+
+	/* median is the same as sorting each window, in place or not */
+	for (j=0; j<G_N_ELEMENTS (windows); j++) {
+		result = gpm_array_float_median_into (array, windows[j], gpm_array_float_new (0));
+		g_assert_cmpint (result->len, ==, array->len);
+		for (i=0; i<array->len; i++) {
+			for (k=0; k<windows[j]; k++) {
+				idx = CLAMP ((gint) (i + k) - (gint) windows[j] / 2, 0, (gint) array->len - 1);
+				window[k] = gpm_array_float_get (array, idx);
+			}
+			qsort (window, windows[j], sizeof (gfloat), gpm_test_float_compare);
+			g_assert_cmpfloat (gpm_array_float_get (result, i), ==, window[windows[j] / 2]);
+		}
+		expected = result;
+		result = gpm_array_float_new (0);
+		g_array_append_vals (result, array->data, array->len);
+		gpm_array_float_median_into (result, windows[j], result);
+		for (i=0; i<array->len; i++)
+			g_assert_cmpfloat (gpm_array_float_get (result, i), ==, gpm_array_float_get (expected, i));
+		gpm_array_float_free (expected);
+		gpm_array_float_free (result);
+	}
+
+	/* the median removes a single spike completely */
+	result = gpm_array_float_new (7);
+	gpm_array_float_set (result, 3, 100.0f);
+	gpm_array_float_median_into (result, 3, result);
+	g_assert_cmpfloat (gpm_array_float_sum (result), ==, 0.0f);
+	gpm_array_float_free (result);
+
+	/* exponential moving average */
+	result = gpm_array_float_new (4);
+	gpm_array_float_set (result, 0, 10.0f);
+	gpm_array_float_set (result, 1, 20.0f);
+	gpm_array_float_set (result, 2, 20.0f);
+	gpm_array_float_set (result, 3, 20.0f);
+	gpm_array_float_ema_into (result, 0.5f, result);
+	g_assert_cmpfloat (gpm_array_float_get (result, 0), ==, 10.0f);
+	g_assert_cmpfloat (gpm_array_float_get (result, 1), ==, 15.0f);
+	g_assert_cmpfloat (gpm_array_float_get (result, 2), ==, 17.5f);
+	g_assert_cmpfloat (gpm_array_float_get (result, 3), ==, 18.75f);
+
+	/* resample */
+	expected = gpm_array_float_new (0);
+	gpm_array_float_resample_into (result, 7, expected);
+	g_assert_cmpint (expected->len, ==, 7);
+	g_assert_cmpfloat (gpm_array_float_get (expected, 0), ==, 10.0f);
+	g_assert_cmpfloat (gpm_array_float_get (expected, 1), ==, 12.5f);
+	g_assert_cmpfloat (gpm_array_float_get (expected, 2), ==, 15.0f);
+	g_assert_cmpfloat (gpm_array_float_get (expected, 6), ==, 18.75f);
+	gpm_array_float_resample_into (result, 1, expected);
+	g_assert_cmpint (expected->len, ==, 1);
+	g_assert_cmpfloat (gpm_array_float_get (expected, 0), ==, 10.0f);
+	gpm_array_float_free (expected);
+	gpm_array_float_free (result);
+
+	/* the pipeline gives the same as the stages one at a time */
+	pipeline = gpm_filter_pipeline_new ();
+	gpm_filter_pipeline_add_outliers (pipeline, 3, 0.1);
+	g_assert (gpm_filter_pipeline_add_gaussian (pipeline, 15, 2.0));
+	g_assert (!gpm_filter_pipeline_add_gaussian (pipeline, 5, 1.1));
+	kernel = gpm_array_float_compute_gaussian (15, 2.0);
+	result = gpm_array_float_remove_outliers (array, 3, 0.1);
+	expected = gpm_array_float_convolve (result, kernel);
+	gpm_array_float_free (result);
+	for (j=0; j<3; j++) {
+		input = gpm_filter_pipeline_get_input (pipeline, array->len);
+		memcpy (input->data, array->data, array->len * sizeof (gfloat));
+
+		/* the same buffer is used each time */
+		if (j == 0)
+			data = input->data;
+		g_assert (input->data == data);
+
+		result = gpm_filter_pipeline_run (pipeline);
+		g_assert (result == input);
+		g_assert_cmpint (result->len, ==, array->len);
+		for (i=0; i<array->len; i++)
+			g_assert_cmpfloat (gpm_array_float_get (result, i), ==, gpm_array_float_get (expected, i));
+	}
+	gpm_array_float_free (expected);
+	gpm_array_float_free (kernel);
+	gpm_filter_pipeline_free (pipeline);
+
+	/* stages after a resample work on fewer values */
+	pipeline = gpm_filter_pipeline_new ();
+	gpm_filter_pipeline_add_median (pipeline, 5);
+	gpm_filter_pipeline_add_resample (pipeline, 100);
+	gpm_filter_pipeline_add_ema (pipeline, 0.3f);
+	expected = gpm_array_float_median_into (array, 5, gpm_array_float_new (0));
+	result = gpm_array_float_resample_into (expected, 100, gpm_array_float_new (0));
+	gpm_array_float_ema_into (result, 0.3f, expected);
+	gpm_array_float_free (result);
+	for (j=0; j<2; j++) {
+		input = gpm_filter_pipeline_get_input (pipeline, array->len);
+		memcpy (input->data, array->data, array->len * sizeof (gfloat));
+		result = gpm_filter_pipeline_run (pipeline);
+		g_assert_cmpint (result->len, ==, 100);
+		for (i=0; i<result->len; i++)
+			g_assert_cmpfloat (gpm_array_float_get (result, i), ==, gpm_array_float_get (expected, i));
+	}
+	gpm_array_float_free (expected);
+	gpm_filter_pipeline_free (pipeline);
+
+	/* each segment is smoothed as if the others weren't there, even a
+	 * segment of one value */
+	pipeline = gpm_filter_pipeline_new ();
+	gpm_filter_pipeline_add_segments (pipeline, 600.0f);
+	gpm_filter_pipeline_add_median (pipeline, 5);
+	gpm_filter_pipeline_add_outliers (pipeline, 3, 0.1);
+	g_assert (gpm_filter_pipeline_add_gaussian (pipeline, 15, 2.0));
+	kernel = gpm_array_float_compute_gaussian (15, 2.0);
+	input = gpm_filter_pipeline_get_input (pipeline, array->len);
+	memcpy (input->data, array->data, array->len * sizeof (gfloat));
+	times = gpm_filter_pipeline_get_times (pipeline, array->len);
+	for (i=0; i<array->len; i++)
+		gpm_array_float_set (times, i, 60.0f * i + (i >= 120 ? 7200.0f : 0.0f) +
+				     (i >= 200 ? 900.0f : 0.0f) + (i >= 299 ? 3600.0f : 0.0f));
+	result = gpm_filter_pipeline_run (pipeline);
+	breaks = gpm_filter_pipeline_get_breaks (pipeline, &n_breaks);
+	g_assert_cmpint (n_breaks, ==, 3);
+	g_assert_cmpint (breaks[0], ==, 120);
+	g_assert_cmpint (breaks[1], ==, 200);
+	g_assert_cmpint (breaks[2], ==, 299);
+	start = 0;
+	for (j=0; j<=n_breaks; j++) {
+		end = j < n_breaks ? breaks[j] : array->len;
+		segment = gpm_array_float_new_uninitialised (0);
+		g_array_append_vals (segment, &g_array_index (array, gfloat, start), end - start);
+		gpm_array_float_median_into (segment, 5, segment);
+		gpm_array_float_remove_outliers_into (segment, 3, 0.1, segment);
+		gpm_array_float_convolve_into (segment, kernel, segment);
+		for (i=start; i<end; i++)
+			g_assert_cmpfloat (gpm_array_float_get (result, i), ==, gpm_array_float_get (segment, i - start));
+		gpm_array_float_free (segment);
+		start = end;
+	}
+	gpm_array_float_free (kernel);
+	gpm_filter_pipeline_free (pipeline);
+
+	gpm_array_float_free (array);
+}
+
+static void
+gpm_test_median_func (void)
+{
+	GpmArrayFloat *array;
+	GpmArrayFloat *result;
+	gint64 start;
+	gdouble elapsed_median;
+	gdouble elapsed_outliers;
+	guint i;
+	guint j;
+	const guint windows[] = { 3, 5, 15, 65 };
+
+	/* a burst of spikes is left by removing the biggest outlier */
+	array = gpm_array_float_new (20);
+	for (i=0; i<array->len; i++)
+		gpm_array_float_set (array, i, 10.0f);
+	gpm_array_float_set (array, 9, 50.0f);
+	gpm_array_float_set (array, 10, 55.0f);
+	result = gpm_array_float_remove_outliers (array, 3, 0.1);
+	g_assert_cmpfloat (gpm_array_float_get (result, 10), >, 20.0f);
+	gpm_array_float_free (result);
+
+	/* but not by the median */
+	result = gpm_array_float_median_into (array, 5, gpm_array_float_new (0));
+	for (i=0; i<result->len; i++)
+		g_assert_cmpfloat (gpm_array_float_get (result, i), ==, 10.0f);
+	gpm_array_float_free (result);
+	gpm_array_float_free (array);
+
+	if (!g_test_perf ())
+		return;
+
+	/* compare the speed with removing the outliers */
+	array = gpm_array_float_new_uninitialised (100000);
+	for (i=0; i<array->len; i++)
+		gpm_array_float_set (array, i, 40.0f + 20.0f * sinf (i * 0.01f) + (i * 7919 % 101) / 10.0f);
+	result = gpm_array_float_new (0);
+	for (j=0; j<G_N_ELEMENTS (windows); j++) {
+		start = g_get_monotonic_time ();
+		gpm_array_float_median_into (array, windows[j], result);
+		elapsed_median = (g_get_monotonic_time () - start) * 1000.0 / array->len;
+		start = g_get_monotonic_time ();
+		gpm_array_float_remove_outliers_into (array, windows[j], 0.1, result);
+		elapsed_outliers = (g_get_monotonic_time () - start) * 1000.0 / array->len;
+		g_test_minimized_result (elapsed_median, "median of %u: %.1f ns per point", windows[j], elapsed_median);
+		g_test_minimized_result (elapsed_outliers, "outliers of %u: %.1f ns per point", windows[j], elapsed_outliers);
+	}
+	gpm_array_float_free (result);
+	gpm_array_float_free (array);
+}
+
+static void
+gpm_test_convolve_parallel_func (void)
+{
+	GpmArrayFloat *array;
+	GpmArrayFloat *kernel;
+	GpmArrayFloat *expected;
+	GpmArrayFloat *result;
+	GpmArrayFloat *input;
+	GpmFilterPipeline *pipeline;
+	gint64 start;
+	gdouble elapsed;
+	gdouble elapsed_serial = 0;
+	guint i;
+	guint j;
+	guint k;
+	const guint lengths[] = { 0, 1, 100, 4096, 4097, 50000 };
+	const guint threads[] = { 0, 1, 2, 3, 4, 8 };
+
+	/* exactly the same as one thread, however the work is split */
+	kernel = gpm_array_float_compute_gaussian (71, 10);
+	result = gpm_array_float_new (0);
+	for (k=0; k<G_N_ELEMENTS (lengths); k++) {
+		array = gpm_array_float_new_uninitialised (lengths[k]);
+		for (i=0; i<array->len; i++)
+			gpm_array_float_set (array, i, 40.0f + 20.0f * sinf (i * 0.01f) + (i * 7919 % 101) / 10.0f);
+		expected = gpm_array_float_convolve (array, kernel);
+		for (j=0; j<G_N_ELEMENTS (threads); j++) {
+			gpm_array_float_convolve_parallel_into (array, kernel, threads[j], result);
+			g_assert_cmpint (result->len, ==, array->len);
+			g_assert (memcmp (result->data, expected->data, array->len * sizeof (gfloat)) == 0);
+		}
+		gpm_array_float_free (expected);
+		gpm_array_float_free (array);
+	}
+	gpm_array_float_free (kernel);
+
+	/* the pipeline uses it for long series */
+	array = gpm_array_float_new_uninitialised (50000);
+	for (i=0; i<array->len; i++)
+		gpm_array_float_set (array, i, 40.0f + 20.0f * sinf (i * 0.01f) + (i * 7919 % 101) / 10.0f);
+	pipeline = gpm_filter_pipeline_new ();
+	g_assert (gpm_filter_pipeline_add_gaussian (pipeline, 15, 2.0));
+	kernel = gpm_array_float_compute_gaussian (15, 2.0);
+	expected = gpm_array_float_convolve (array, kernel);
+	input = gpm_filter_pipeline_get_input (pipeline, array->len);
+	memcpy (input->data, array->data, array->len * sizeof (gfloat));
+	g_assert (memcmp (gpm_filter_pipeline_run (pipeline)->data, expected->data,
+			  array->len * sizeof (gfloat)) == 0);
+	gpm_array_float_free (expected);
+	gpm_array_float_free (kernel);
+	gpm_filter_pipeline_free (pipeline);
+
+	if (!g_test_perf ())
+		goto out;
+
+	/* how well it scales with the number of threads */
+	kernel = gpm_array_float_compute_gaussian (71, 10);
+	for (j=0; j<4; j++) {
+		start = g_get_monotonic_time ();
+		for (k=0; k<20; k++)
+			gpm_array_float_convolve_parallel_into (array, kernel, 1 << j, result);
+		elapsed = (g_get_monotonic_time () - start) * 1000.0 / (20 * array->len);
+		if (j == 0)
+			elapsed_serial = elapsed;
+		g_test_minimized_result (elapsed, "%u threads: %.2f ns per point, %.1fx",
+					 1 << j, elapsed, elapsed_serial / elapsed);
+	}
+	gpm_array_float_free (kernel);
+out:
+	gpm_array_float_free (result);
+	gpm_array_float_free (array);
+}
+
+/**
+ * gpm_test_pipeline_run:
+ *
+ * Return value: what @pipeline gives for the first @length values and times
+ **/
+static GpmArrayFloat *
+gpm_test_pipeline_run (GpmFilterPipeline *pipeline, GpmArrayFloat *array, GpmArrayFloat *times, guint length)
+{
+	GpmArrayFloat *input;
+	input = gpm_filter_pipeline_get_input (pipeline, length);
+	memcpy (input->data, array->data, length * sizeof (gfloat));
+	if (times != NULL) {
+		input = gpm_filter_pipeline_get_times (pipeline, length);
+		memcpy (input->data, times->data, length * sizeof (gfloat));
+	}
+	return gpm_filter_pipeline_run (pipeline);
+}
+
+/**
+ * gpm_test_pipeline_new:
+ **/
+static GpmFilterPipeline *
+gpm_test_pipeline_new (gboolean incremental, gboolean use_time)
+{
+	GpmFilterPipeline *pipeline;
+	pipeline = gpm_filter_pipeline_new ();
+	gpm_filter_pipeline_set_incremental (pipeline, incremental);
+	gpm_filter_pipeline_add_segments (pipeline, 600.0f);
+	gpm_filter_pipeline_add_median (pipeline, 5);
+	gpm_filter_pipeline_add_outliers (pipeline, 3, 0.1);
+	g_assert (gpm_filter_pipeline_add_gaussian (pipeline, 15, 2.0));
+	gpm_filter_pipeline_add_ema (pipeline, 0.3f);
+	if (use_time)
+		gpm_filter_pipeline_add_time (pipeline, 120.0f, 600.0f);
+	return pipeline;
+}
+
+static void
+gpm_test_pipeline_incremental_func (void)
+{
+	GpmArrayFloat *array;
+	GpmArrayFloat *times;
+	GpmArrayFloat *result;
+	GpmArrayFloat *expected;
+	GpmFilterPipeline *pipeline;
+	GpmFilterPipeline *serial;
+	gint64 start;
+	gdouble elapsed;
+	gdouble elapsed_serial;
+	guint i;
+	guint j;
+	guint k;
+	const guint lengths[] = { 100, 100, 107, 150, 149, 3, 0, 150, 200, 200 };
+
+	array = gpm_array_float_new_uninitialised (200);
+	times = gpm_array_float_new_uninitialised (200);
+	for (i=0; i<array->len; i++) {
+		gpm_array_float_set (array, i, 40.0f + 20.0f * sinf (i * 0.05f) + (i * 7919 % 101) / 10.0f +
+				     (i % 23 == 0 ? 60.0f : 0.0f));
+		gpm_array_float_set (times, i, 60.0f * i + (i >= 120 ? 7200.0f : 0.0f));
+	}
+
+	/* the same as smoothing everything, as values are added, removed,
+	 * changed and split by a new gap */
+	for (k=0; k<2; k++) {
+		pipeline = gpm_test_pipeline_new (TRUE, k == 1);
+		serial = gpm_test_pipeline_new (FALSE, k == 1);
+		for (j=0; j<G_N_ELEMENTS (lengths); j++) {
+			if (j == 8)
+				gpm_array_float_set (array, 160, 0.0f);
+			if (j == 9)
+				gpm_array_float_set (times, 180, 60.0f * 180 + 9000.0f);
+			result = gpm_test_pipeline_run (pipeline, array, times, lengths[j]);
+			expected = gpm_test_pipeline_run (serial, array, times, lengths[j]);
+			g_assert_cmpint (result->len, ==, lengths[j]);
+			g_assert_cmpint (expected->len, ==, lengths[j]);
+			g_assert (memcmp (result->data, expected->data, lengths[j] * sizeof (gfloat)) == 0);
+		}
+		gpm_filter_pipeline_free (pipeline);
+		gpm_filter_pipeline_free (serial);
+	}
+
+	/* resampling doesn't change the times that are compared next time */
+	pipeline = gpm_filter_pipeline_new ();
+	gpm_filter_pipeline_set_incremental (pipeline, TRUE);
+	gpm_filter_pipeline_add_outliers (pipeline, 3, 0.1);
+	gpm_filter_pipeline_add_resample (pipeline, 50);
+	gpm_filter_pipeline_add_time (pipeline, 120.0f, 600.0f);
+	serial = gpm_filter_pipeline_new ();
+	gpm_filter_pipeline_add_outliers (serial, 3, 0.1);
+	gpm_filter_pipeline_add_resample (serial, 50);
+	gpm_filter_pipeline_add_time (serial, 120.0f, 600.0f);
+	for (j=0; j<G_N_ELEMENTS (lengths); j++) {
+		result = gpm_test_pipeline_run (pipeline, array, times, lengths[j]);
+		expected = gpm_test_pipeline_run (serial, array, times, lengths[j]);
+		g_assert_cmpint (result->len, ==, expected->len);
+		g_assert (memcmp (result->data, expected->data, result->len * sizeof (gfloat)) == 0);
+		result = gpm_filter_pipeline_get_times (pipeline, lengths[j]);
+		g_assert (memcmp (result->data, times->data, lengths[j] * sizeof (gfloat)) == 0);
+	}
+	gpm_filter_pipeline_free (pipeline);
+	gpm_filter_pipeline_free (serial);
+	gpm_array_float_free (times);
+	gpm_array_float_free (array);
+
+	if (!g_test_perf ())
+		return;
+
+	/* adding a few values costs about the same however long the series */
+	array = gpm_array_float_new_uninitialised (100000);
+	times = gpm_array_float_new_uninitialised (100000);
+	for (i=0; i<array->len; i++) {
+		gpm_array_float_set (array, i, 40.0f + 20.0f * sinf (i * 0.01f) + (i * 7919 % 101) / 10.0f);
+		gpm_array_float_set (times, i, 60.0f * i);
+	}
+	pipeline = gpm_test_pipeline_new (TRUE, FALSE);
+	serial = gpm_test_pipeline_new (FALSE, FALSE);
+	for (j=1000; j<=array->len; j*=10) {
+		gpm_test_pipeline_run (pipeline, array, times, j - 10);
+		start = g_get_monotonic_time ();
+		gpm_test_pipeline_run (pipeline, array, times, j);
+		elapsed = g_get_monotonic_time () - start;
+		start = g_get_monotonic_time ();
+		gpm_test_pipeline_run (serial, array, times, j);
+		elapsed_serial = g_get_monotonic_time () - start;
+		g_test_minimized_result (elapsed, "adding 10 to %u: %.0f us, %.0f us for all",
+					 j - 10, elapsed, elapsed_serial);
+	}
+	gpm_filter_pipeline_free (pipeline);
+	gpm_filter_pipeline_free (serial);
+	gpm_array_float_free (times);
+	gpm_array_float_free (array);
+}
+
+static void
+gpm_test_smooth_time_func (void)
+{
+	GpmArrayFloat *array;
+	GpmArrayFloat *times;
+	GpmArrayFloat *weights;
+	GpmArrayFloat *result;
+	GpmArrayFloat *input;
+	GpmFilterPipeline *pipeline;
+	gdouble sum;
+	gdouble weight;
+	gdouble w;
+	guint i;
+	guint j;
+
+	/* irregular times, with a suspend in the middle */
+	array = gpm_array_float_new_uninitialised (200);
+	times = gpm_array_float_new_uninitialised (200);
+	for (i=0; i<array->len; i++) {
+		gpm_array_float_set (times, i, i * 60.0f + (i * 7919 % 37) + (i >= 100 ? 1200.0f : 0.0f));
+		gpm_array_float_set (array, i, (i < 100 ? 10.0f : 50.0f) + (i * 104729 % 11) / 5.0f);
+	}
+	weights = gpm_array_float_new (0);
+	result = gpm_array_float_new (0);
+
+	/* without a gap it's the same as weighting every point by time */
+	g_assert (gpm_array_float_smooth_time_into (array, times, 600.0f, G_MAXFLOAT, weights, result) == result);
+	g_assert_cmpint (result->len, ==, array->len);
+	for (i=0; i<array->len; i++) {
+		sum = 0.0;
+		weight = 0.0;
+		for (j=0; j<array->len; j++) {
+			w = exp (-fabs (gpm_array_float_get (times, j) - gpm_array_float_get (times, i)) / 600.0);
+			sum += w * gpm_array_float_get (array, j);
+			weight += w;
+		}
+		g_assert_cmpfloat (fabs (gpm_array_float_get (result, i) - sum / weight), <, 0.001);
+	}
+	g_assert_cmpfloat (gpm_array_float_get (result, 99), >, 15.0f);
+
+	/* with it the points either side of the suspend are not mixed */
+	gpm_array_float_smooth_time_into (array, times, 600.0f, 900.0f, weights, result);
+	for (i=0; i<array->len; i++) {
+		if (i < 100) {
+			g_assert_cmpfloat (gpm_array_float_get (result, i), >=, 10.0f);
+			g_assert_cmpfloat (gpm_array_float_get (result, i), <=, 12.0f);
+		} else {
+			g_assert_cmpfloat (gpm_array_float_get (result, i), >=, 50.0f);
+			g_assert_cmpfloat (gpm_array_float_get (result, i), <=, 52.0f);
+		}
+	}
+
+	/* the same from a pipeline */
+	pipeline = gpm_filter_pipeline_new ();
+	gpm_filter_pipeline_add_time (pipeline, 600.0f, 900.0f);
+	for (j=0; j<2; j++) {
+		input = gpm_filter_pipeline_get_input (pipeline, array->len);
+		memcpy (input->data, array->data, array->len * sizeof (gfloat));
+		input = gpm_filter_pipeline_get_times (pipeline, times->len);
+		memcpy (input->data, times->data, times->len * sizeof (gfloat));
+		input = gpm_filter_pipeline_run (pipeline);
+		g_assert_cmpint (input->len, ==, array->len);
+		for (i=0; i<array->len; i++)
+			g_assert_cmpfloat (gpm_array_float_get (input, i), ==, gpm_array_float_get (result, i));
+	}
+	gpm_filter_pipeline_free (pipeline);
+
+	/* one point is left alone */
+	g_array_set_size (array, 1);
+	g_array_set_size (times, 1);
+	gpm_array_float_smooth_time_into (array, times, 120.0f, 600.0f, weights, result);
+	g_assert_cmpint (result->len, ==, 1);
+	g_assert_cmpfloat (gpm_array_float_get (result, 0), ==, gpm_array_float_get (array, 0));
+
+	gpm_array_float_free (weights);
+	gpm_array_float_free (result);
+	gpm_array_float_free (times);
+	gpm_array_float_free (array);
+}
+
+/**
+ * gpm_test_graph_series_check_screen:
+ **/
+static void
+gpm_test_graph_series_check_screen (GpmGraphSeries *series, const GpmGraphSeriesTransform *transform,
+				    guint first, guint last)
+{
+	const GpmPointObj *screen;
+	GpmPointObj point;
+	guint i;
+
+	screen = gpm_graph_series_get_screen (series, transform, first, last);
+	for (i=first; i<=last; i++) {
+		gpm_graph_series_get (series, i, &point);
+		g_assert_cmpfloat (screen[i].x, ==, (point.x - transform->origin_x) * transform->scale_x + transform->offset_x);
+		g_assert_cmpfloat (screen[i].y, ==, (point.y - transform->origin_y) * transform->scale_y + transform->offset_y);
+		g_assert_cmpint (screen[i].color, ==, point.color);
+	}
+}
+
+static void
+gpm_test_graph_series_func (void)
+{
+	GpmGraphSeriesTransform transform = { 0.0f, 0.05f, 11.0f, 100.0f, -2.5f, 6.5f };
+	GpmGraphSeries *series;
+	GpmPointObj point;
+	GpmPointObj evicted;
+	GpmPointObj points[6];
+	gboolean ret;
+	gfloat min_x, max_x;
+	gfloat min_y, max_y;
+	guint first, last;
+	const guint *breaks;
+	guint n_breaks;
+	guint i;
+
+	/* no bounds with no data */
+	series = gpm_graph_series_new (4);
+	ret = gpm_graph_series_get_bounds (series, &min_x, &max_x, &min_y, &max_y);
+	g_assert (!ret);
+
+	/* fill up to the capacity */
+	for (i=0; i<4; i++) {
+		ret = gpm_graph_series_append (series, i, 10.0f * i, i, &evicted);
+		g_assert (!ret);
+	}
+	g_assert_cmpint (gpm_graph_series_get_length (series), ==, 4);
+	ret = gpm_graph_series_get_bounds (series, &min_x, &max_x, &min_y, &max_y);
+	g_assert (ret);
+	g_assert_cmpfloat (min_x, ==, 0.0f);
+	g_assert_cmpfloat (max_x, ==, 3.0f);
+	g_assert_cmpfloat (max_y, ==, 30.0f);
+
+	/* the oldest point is dropped */
+	ret = gpm_graph_series_append (series, 4, 5.0f, 4, &evicted);
+	g_assert (ret);
+	g_assert_cmpfloat (evicted.x, ==, 0.0f);
+	g_assert_cmpint (gpm_graph_series_get_length (series), ==, 4);
+	gpm_graph_series_get (series, 0, &point);
+	g_assert_cmpfloat (point.x, ==, 1.0f);
+	gpm_graph_series_get (series, 3, &point);
+	g_assert_cmpfloat (point.x, ==, 4.0f);
+	g_assert_cmpint (point.color, ==, 4);
+
+	/* the bounds are updated when an extreme point is dropped */
+	ret = gpm_graph_series_get_bounds (series, &min_x, &max_x, &min_y, &max_y);
+	g_assert (ret);
+	g_assert_cmpfloat (min_x, ==, 1.0f);
+	g_assert_cmpfloat (max_x, ==, 4.0f);
+	g_assert_cmpfloat (min_y, ==, 5.0f);
+	g_assert_cmpfloat (max_y, ==, 30.0f);
+
+	/* wrap around a few times */
+	for (i=5; i<11; i++)
+		gpm_graph_series_append (series, i, 1.0f, 0, NULL);
+	for (i=0; i<4; i++) {
+		gpm_graph_series_get (series, i, &point);
+		g_assert_cmpfloat (point.x, ==, 7.0f + i);
+	}
+	gpm_graph_series_get_bounds (series, &min_x, &max_x, &min_y, &max_y);
+	g_assert_cmpfloat (min_x, ==, 7.0f);
+	g_assert_cmpfloat (max_y, ==, 1.0f);
+
+	/* shrinking keeps the newest points */
+	gpm_graph_series_set_capacity (series, 2);
+	g_assert_cmpint (gpm_graph_series_get_length (series), ==, 2);
+	gpm_graph_series_get (series, 0, &point);
+	g_assert_cmpfloat (point.x, ==, 9.0f);
+	gpm_graph_series_append (series, 11, 1.0f, 0, NULL);
+	gpm_graph_series_get (series, 1, &point);
+	g_assert_cmpfloat (point.x, ==, 11.0f);
+
+	/* no limit */
+	gpm_graph_series_set_capacity (series, 0);
+	for (i=0; i<100; i++) {
+		ret = gpm_graph_series_append (series, 12 + i, 1.0f, 0, NULL);
+		g_assert (!ret);
+	}
+	g_assert_cmpint (gpm_graph_series_get_length (series), ==, 102);
+	gpm_graph_series_get (series, 0, &point);
+	g_assert_cmpfloat (point.x, ==, 10.0f);
+
+	/* find the visible points, x is 10..111 */
+	ret = gpm_graph_series_get_range (series, 50.0f, 60.5f, &first, &last);
+	g_assert (ret);
+	g_assert_cmpint (first, ==, 39);
+	g_assert_cmpint (last, ==, 51);
+	ret = gpm_graph_series_get_range (series, 0.0f, 5.0f, &first, &last);
+	g_assert (ret);
+	g_assert_cmpint (first, ==, 0);
+	g_assert_cmpint (last, ==, 0);
+	ret = gpm_graph_series_get_range (series, 200.0f, 300.0f, &first, &last);
+	g_assert (ret);
+	g_assert_cmpint (first, ==, 101);
+	g_assert_cmpint (last, ==, 101);
+
+	/* clear */
+	gpm_graph_series_clear (series);
+	g_assert_cmpint (gpm_graph_series_get_length (series), ==, 0);
+
+	/* newest first, like some history data */
+	for (i=0; i<10; i++)
+		gpm_graph_series_append (series, -10.0f * i, 1.0f, 0, NULL);
+	ret = gpm_graph_series_get_range (series, -45.0f, -25.0f, &first, &last);
+	g_assert (ret);
+	g_assert_cmpint (first, ==, 2);
+	g_assert_cmpint (last, ==, 5);
+
+	/* not in order, so draw everything */
+	gpm_graph_series_append (series, 50.0f, 1.0f, 0, NULL);
+	ret = gpm_graph_series_get_range (series, -45.0f, -25.0f, &first, &last);
+	g_assert (!ret);
+	g_assert_cmpint (first, ==, 0);
+	g_assert_cmpint (last, ==, 10);
+
+	/* a long history of whole seconds can be stored compactly */
+	gpm_graph_series_clear (series);
+	for (i=0; i<1000; i++)
+		gpm_graph_series_append (series, -60.0f * i, 12.3f + (i % 7), i % 3 ? 0xff0000 : 0x00ff00, NULL);
+	ret = gpm_graph_series_compact (series);
+	g_assert (ret);
+	g_assert_cmpint (gpm_graph_series_get_length (series), ==, 1000);
+	for (i=0; i<1000; i++) {
+		gpm_graph_series_get (series, i, &point);
+		g_assert_cmpfloat (point.x, ==, -60.0f * i);
+		g_assert_cmpfloat (fabsf (point.y - (12.3f + (i % 7))), <, 0.001f);
+		g_assert_cmpint (point.color, ==, i % 3 ? 0xff0000 : 0x00ff00);
+	}
+	ret = gpm_graph_series_get_range (series, -125.0f, -59.0f, &first, &last);
+	g_assert (ret);
+	g_assert_cmpint (first, ==, 0);
+	g_assert_cmpint (last, ==, 3);
+
+	/* dropping points keeps it compact */
+	gpm_graph_series_set_capacity (series, 10);
+	gpm_graph_series_append (series, -60000.0f, 14.3f, 0xff0000, &evicted);
+	g_assert_cmpfloat (evicted.x, ==, -59400.0f);
+	gpm_graph_series_get (series, 9, &point);
+	g_assert_cmpfloat (point.x, ==, -60000.0f);
+	g_assert_cmpfloat (fabsf (point.y - 14.3f), <, 0.001f);
+
+	/* a point that doesn't fit goes back to floats */
+	gpm_graph_series_append (series, 0.5f, 1000.0f, 0x0000ff, NULL);
+	gpm_graph_series_get (series, 9, &point);
+	g_assert_cmpfloat (point.x, ==, 0.5f);
+	g_assert_cmpfloat (point.y, ==, 1000.0f);
+	g_assert_cmpint (point.color, ==, 0x0000ff);
+	gpm_graph_series_get (series, 0, &point);
+	g_assert_cmpfloat (point.x, ==, -59520.0f);
+	gpm_graph_series_get_bounds (series, &min_x, &max_x, &min_y, &max_y);
+	g_assert_cmpfloat (max_y, ==, 1000.0f);
+
+	gpm_graph_series_free (series);
+
+	/* split where the points are far apart */
+	series = gpm_graph_series_new (6);
+	gpm_graph_series_set_gap (series, 100.0f);
+	gpm_graph_series_append (series, 0.0f, 1.0f, 0, NULL);
+	gpm_graph_series_append (series, 60.0f, 1.0f, 0, NULL);
+	gpm_graph_series_append (series, 120.0f, 1.0f, 0, NULL);
+	gpm_graph_series_append (series, 1000.0f, 1.0f, 0, NULL);
+	gpm_graph_series_append (series, 1060.0f, 1.0f, 0, NULL);
+	gpm_graph_series_append (series, 2000.0f, 1.0f, 0, NULL);
+	breaks = gpm_graph_series_get_breaks (series, &n_breaks);
+	g_assert_cmpint (n_breaks, ==, 2);
+	g_assert_cmpint (breaks[0], ==, 3);
+	g_assert_cmpint (breaks[1], ==, 5);
+
+	/* the breaks move with the points that are dropped */
+	gpm_graph_series_append (series, 2060.0f, 1.0f, 0, NULL);
+	breaks = gpm_graph_series_get_breaks (series, &n_breaks);
+	g_assert_cmpint (n_breaks, ==, 2);
+	g_assert_cmpint (breaks[0], ==, 2);
+	g_assert_cmpint (breaks[1], ==, 4);
+	gpm_graph_series_append (series, 2120.0f, 1.0f, 0, NULL);
+	gpm_graph_series_append (series, 2180.0f, 1.0f, 0, NULL);
+	breaks = gpm_graph_series_get_breaks (series, &n_breaks);
+	g_assert_cmpint (n_breaks, ==, 1);
+	g_assert_cmpint (breaks[0], ==, 2);
+
+	/* and are found again when the gap changes */
+	gpm_graph_series_set_gap (series, 0.0f);
+	breaks = gpm_graph_series_get_breaks (series, &n_breaks);
+	g_assert (breaks == NULL);
+	g_assert_cmpint (n_breaks, ==, 0);
+	gpm_graph_series_set_gap (series, 50.0f);
+	breaks = gpm_graph_series_get_breaks (series, &n_breaks);
+	g_assert_cmpint (n_breaks, ==, 5);
+	g_assert (gpm_graph_series_compact (series));
+	gpm_graph_series_set_gap (series, 100.0f);
+	breaks = gpm_graph_series_get_breaks (series, &n_breaks);
+	g_assert_cmpint (n_breaks, ==, 1);
+	g_assert_cmpint (breaks[0], ==, 2);
+	gpm_graph_series_set_capacity (series, 2);
+	gpm_graph_series_get_breaks (series, &n_breaks);
+	g_assert_cmpint (n_breaks, ==, 0);
+	gpm_graph_series_free (series);
+
+	/* the screen coordinates follow the points as they are dropped */
+	series = gpm_graph_series_new (50);
+	for (i=0; i<30; i++)
+		gpm_graph_series_append (series, 60.0f * i, i % 11, i % 2 ? 0xff0000 : 0x00ff00, NULL);
+	gpm_test_graph_series_check_screen (series, &transform, 10, 19);
+	gpm_test_graph_series_check_screen (series, &transform, 0, 29);
+	for (i=30; i<200; i++) {
+		gpm_graph_series_append (series, 60.0f * i, i % 11, i % 2 ? 0xff0000 : 0x00ff00, NULL);
+		gpm_test_graph_series_check_screen (series, &transform, i % 7, MIN (i, 49));
+	}
+
+	/* and are found again when the graph moves, or the points are rounded */
+	transform.origin_x = 6000.0f;
+	gpm_test_graph_series_check_screen (series, &transform, 0, 49);
+	g_assert (gpm_graph_series_compact (series));
+	gpm_test_graph_series_check_screen (series, &transform, 0, 49);
+	gpm_graph_series_append (series, 60.0f * i, 12.34f, 0x0000ff, NULL);
+	gpm_test_graph_series_check_screen (series, &transform, 40, 49);
+	gpm_graph_series_set_capacity (series, 5);
+	gpm_test_graph_series_check_screen (series, &transform, 0, 4);
+	gpm_graph_series_clear (series);
+	gpm_graph_series_append (series, 1.0f, 2.0f, 0, NULL);
+	gpm_test_graph_series_check_screen (series, &transform, 0, 0);
+	gpm_graph_series_free (series);
+
+	/* made from points, split at the gaps */
+	for (i=0; i<6; i++) {
+		points[i].x = i < 3 ? 60.0f * i : 1000.0f + 60.0f * i;
+		points[i].y = 10.0f + i;
+		points[i].color = 0xff0000;
+	}
+	series = gpm_graph_series_new_from_points (points, 6, 100.0f);
+	g_assert_cmpint (gpm_graph_series_get_length (series), ==, 6);
+	g_assert_cmpint (gpm_graph_series_get_capacity (series), ==, 0);
+	breaks = gpm_graph_series_get_breaks (series, &n_breaks);
+	g_assert_cmpint (n_breaks, ==, 1);
+	g_assert_cmpint (breaks[0], ==, 3);
+	gpm_graph_series_get (series, 4, &point);
+	g_assert_cmpfloat (point.x, ==, 1240.0f);
+	g_assert_cmpfloat (point.y, ==, 14.0f);
+	g_assert_cmpint (point.color, ==, 0xff0000);
+	gpm_graph_series_free (series);
+	series = gpm_graph_series_new_from_points (NULL, 0, 0.0f);
+	g_assert_cmpint (gpm_graph_series_get_length (series), ==, 0);
+	gpm_graph_series_free (series);
+}
+
+static void
+gpm_test_history_pack_func (void)
+{
+	GpmArrayFloat *array;
+	GpmArrayFloat *raw;
+	GpmFilterPipeline *pipeline;
+	GpmHistoryPack *pack;
+	GpmHistoryPack *smoothed;
+	GpmHistoryPackIter iter;
+	GpmPointObj point;
+	const GpmPointObj *points;
+	gboolean ret;
+	guint i;
+	guint j;
+	guint k;
+	guint len;
+	guint total = 0;
+
+	/* no points */
+	pack = gpm_history_pack_new (1.0f);
+	ret = gpm_history_pack_get_last (pack, &point);
+	g_assert (!ret);
+	gpm_history_pack_iter_init (&iter, pack);
+	g_assert_cmpint (gpm_history_pack_iter_next (&iter, &points), ==, 0);
+
+	/* a discharge with some jitter in the times, like upowerd saves */
+	raw = gpm_array_float_new (1000);
+	for (i=0; i<1000; i++) {
+		gpm_array_float_set (raw, i, 100.0f - i * 0.05f + (i % 7) * 0.1f);
+		gpm_history_pack_append (pack, -60000.0f + 60.0f * i + (i % 5 ? 0 : 3),
+					 gpm_array_float_get (raw, i),
+					 i < 600 ? 0xff0000 : 0x00ff00);
+	}
+	g_assert_cmpint (gpm_history_pack_get_length (pack), ==, 1000);
+	g_assert_cmpint (gpm_history_pack_get_size (pack), <, 1000 * sizeof (GpmPointObj) / 2);
+	ret = gpm_history_pack_get_last (pack, &point);
+	g_assert (ret);
+	g_assert_cmpfloat (point.x, ==, -60000.0f + 60.0f * 999);
+	g_assert_cmpfloat (point.y, ==, gpm_array_float_get (raw, 999));
+
+	/* everything comes back exactly, a block at a time */
+	gpm_history_pack_iter_init (&iter, pack);
+	while ((len = gpm_history_pack_iter_next (&iter, &points)) > 0) {
+		g_assert_cmpint (len, <=, GPM_HISTORY_PACK_BLOCK_LEN);
+		for (j=0; j<len; j++) {
+			i = total + j;
+			g_assert_cmpfloat (points[j].x, ==, -60000.0f + 60.0f * i + (i % 5 ? 0 : 3));
+			g_assert_cmpfloat (points[j].y, ==, gpm_array_float_get (raw, i));
+			g_assert_cmpint (points[j].color, ==, i < 600 ? 0xff0000 : 0x00ff00);
+		}
+		total += len;
+	}
+	g_assert_cmpint (total, ==, 1000);
+
+	/* smoothing a block at a time is the same as smoothing it all at once */
+	for (k=0; k<2; k++) {
+		pipeline = gpm_filter_pipeline_new ();
+		if (k == 0)
+			gpm_filter_pipeline_add_outliers (pipeline, 3, 0.1);
+		else
+			gpm_filter_pipeline_add_median (pipeline, 5);
+		gpm_filter_pipeline_add_gaussian (pipeline, 15, 1.1);
+		smoothed = gpm_history_pack_new (1.0f);
+		ret = gpm_filter_pipeline_run_pack (pipeline, pack, smoothed);
+		g_assert (ret);
+		g_assert_cmpint (gpm_history_pack_get_length (smoothed), ==, 1000);
+		array = gpm_filter_pipeline_get_input (pipeline, 1000);
+		for (i=0; i<1000; i++)
+			gpm_array_float_set (array, i, gpm_array_float_get (raw, i));
+		array = gpm_filter_pipeline_run (pipeline);
+		total = 0;
+		gpm_history_pack_iter_init (&iter, smoothed);
+		while ((len = gpm_history_pack_iter_next (&iter, &points)) > 0) {
+			for (j=0; j<len; j++) {
+				i = total + j;
+				g_assert_cmpfloat (points[j].x, ==, -60000.0f + 60.0f * i + (i % 5 ? 0 : 3));
+				g_assert_cmpfloat (points[j].y, ==, gpm_array_float_get (array, i));
+				g_assert_cmpint (points[j].color, ==, i < 600 ? 0xff0000 : 0x00ff00);
+			}
+			total += len;
+		}
+		g_assert_cmpint (total, ==, 1000);
+		gpm_history_pack_free (smoothed);
+		gpm_filter_pipeline_free (pipeline);
+	}
+
+	/* only whole blocks are dropped */
+	gpm_history_pack_set_capacity (pack, 300);
+	len = gpm_history_pack_get_length (pack);
+	g_assert_cmpint (len, >=, 300);
+	g_assert_cmpint (len, <, 300 + GPM_HISTORY_PACK_BLOCK_LEN);
+	gpm_history_pack_iter_init (&iter, pack);
+	gpm_history_pack_iter_next (&iter, &points);
+	g_assert_cmpfloat (points[0].y, ==, gpm_array_float_get (raw, 1000 - len));
+	gpm_history_pack_free (pack);
+
+	/* fractions of a second, like the live data */
+	pack = gpm_history_pack_new (0.001f);
+	gpm_history_pack_append (pack, 0.25f, 12.3f, 0);
+	gpm_history_pack_append (pack, 31.5f, 12.1f, 0);
+	gpm_history_pack_get_last (pack, &point);
+	g_assert_cmpfloat (fabsf (point.x - 31.5f), <, 0.001f);
+	g_assert_cmpfloat (point.y, ==, 12.1f);
+	gpm_history_pack_free (pack);
+
+	gpm_array_float_free (raw);
+}
+
+static gboolean
+gpm_test_pipeline_stop_cb (gpointer user_data)
+{
+	guint *checks = (guint *) user_data;
+
+	/* give up before the second stage */
+	return ++(*checks) > 1;
+}
+
+static void
+gpm_test_pipeline_points_func (void)
+{
+	GpmArrayFloat *kernel;
+	GpmArrayFloat *raw;
+	GpmArrayFloat *input;
+	GpmArrayFloat *outliers;
+	GpmArrayFloat *expected;
+	GpmFilterPipeline *pipeline;
+	GpmPointObj *points;
+	const GpmPointObj *smoothed;
+	const GpmPointObj *first_smoothed = NULL;
+	gpointer first_input = NULL;
+	guint checks;
+	guint i;
+	guint j;
+	guint length;
+
+	/* smooth like the statistics window does, on each refresh */
+	pipeline = gpm_filter_pipeline_new ();
+	gpm_filter_pipeline_set_incremental (pipeline, TRUE);
+	gpm_filter_pipeline_add_outliers (pipeline, 3, 0.1);
+	gpm_filter_pipeline_add_gaussian (pipeline, 15, 1.1);
+	kernel = gpm_array_float_compute_gaussian (15, 1.1);
+	points = g_new (GpmPointObj, 150);
+	raw = gpm_array_float_new (0);
+	for (j=0; j<20; j++) {
+		length = 150 - (j % 3) * 20;
+		g_array_set_size (raw, length);
+		for (i=0; i<length; i++) {
+			points[i].x = i;
+			points[i].y = 50.0f + 10.0f * sinf (i * 0.1f + j) + (i % 17 == 0 ? 30.0f : 0.0f);
+			points[i].color = i % 2 ? 0xff0000 : 0x0000ff;
+			gpm_array_float_set (raw, i, points[i].y);
+		}
+		smoothed = gpm_filter_pipeline_run_points (pipeline, points, length);
+		g_assert (smoothed != NULL);
+
+		/* the buffers from the longest run are used from then on */
+		input = gpm_filter_pipeline_get_input (pipeline, length);
+		if (j == 0) {
+			first_smoothed = smoothed;
+			first_input = input->data;
+		}
+		g_assert (smoothed == first_smoothed);
+		g_assert (input->data == first_input);
+
+		/* and it's the same as smoothing each step on its own */
+		outliers = gpm_array_float_remove_outliers (raw, 3, 0.1);
+		expected = gpm_array_float_convolve (outliers, kernel);
+		for (i=0; i<length; i++) {
+			g_assert_cmpfloat (smoothed[i].x, ==, points[i].x);
+			g_assert_cmpint (smoothed[i].color, ==, points[i].color);
+			g_assert_cmpfloat (fabsf (smoothed[i].y - gpm_array_float_get (expected, i)), <, 0.0001f);
+		}
+		gpm_array_float_free (outliers);
+		gpm_array_float_free (expected);
+	}
+
+	/* giving up part of the way through is not remembered as done */
+	for (i=0; i<length; i++) {
+		points[i].y += i % 5;
+		gpm_array_float_set (raw, i, points[i].y);
+	}
+	checks = 0;
+	gpm_filter_pipeline_set_stop_func (pipeline, gpm_test_pipeline_stop_cb, &checks);
+	g_assert (gpm_filter_pipeline_run_points (pipeline, points, length) == NULL);
+	g_assert_cmpint (checks, ==, 2);
+	gpm_filter_pipeline_set_stop_func (pipeline, NULL, NULL);
+	smoothed = gpm_filter_pipeline_run_points (pipeline, points, length);
+	g_assert (smoothed != NULL);
+	outliers = gpm_array_float_remove_outliers (raw, 3, 0.1);
+	expected = gpm_array_float_convolve (outliers, kernel);
+	for (i=0; i<length; i++)
+		g_assert_cmpfloat (fabsf (smoothed[i].y - gpm_array_float_get (expected, i)), <, 0.0001f);
+	gpm_array_float_free (outliers);
+	gpm_array_float_free (expected);
+
+	/* a pipeline that changes the length can't give back the same points */
+	gpm_filter_pipeline_free (pipeline);
+	pipeline = gpm_filter_pipeline_new ();
+	gpm_filter_pipeline_add_resample (pipeline, 10);
+	g_test_expect_message (G_LOG_DOMAIN, G_LOG_LEVEL_WARNING, "*smoothed 150 points into 10*");
+	g_assert (gpm_filter_pipeline_run_points (pipeline, points, 150) == NULL);
+	g_test_assert_expected_messages ();
+
+	gpm_filter_pipeline_free (pipeline);
+	gpm_array_float_free (kernel);
+	gpm_array_float_free (raw);
+	g_free (points);
+}
+
+/**
+ * gpm_test_refresh:
+ *
+ * Does what the statistics window does with the data on each refresh: the
+ * points are copied into the job, smoothed, and put in the series the graph
+ * gave back.
+ **/
+static void
+gpm_test_refresh (GpmFilterPipeline *pipeline, GArray *input, GpmGraphSeries **series,
+		  const GpmPointObj *points, guint length)
+{
+	const GpmPointObj *smoothed;
+
+	g_array_set_size (input, 0);
+	g_array_append_vals (input, points, length);
+	smoothed = gpm_filter_pipeline_run_points (pipeline, (const GpmPointObj *) input->data, input->len);
+	g_assert (smoothed != NULL);
+	gpm_graph_series_assign (series[0], (const GpmPointObj *) input->data, input->len);
+	gpm_graph_series_assign (series[1], smoothed, input->len);
+	g_assert_cmpint (gpm_graph_series_get_length (series[1]), ==, length);
+}
+
+static void
+gpm_test_refresh_allocations_func (void)
+{
+#ifdef __GLIBC__
+	GArray *input;
+	GpmFilterPipeline *pipeline;
+	GpmGraphSeries *series[2];
+	GpmPointObj *points;
+	guint i;
+	guint j;
+	guint k;
+	guint length;
+
+	points = g_new (GpmPointObj, 600);
+	input = g_array_new (FALSE, FALSE, sizeof (GpmPointObj));
+	for (k=0; k<2; k++) {
+		/* the statistics, then the history with a suspend in it */
+		pipeline = gpm_filter_pipeline_new ();
+		if (k == 0) {
+			gpm_filter_pipeline_set_incremental (pipeline, TRUE);
+			gpm_filter_pipeline_add_outliers (pipeline, 3, 0.1);
+			gpm_filter_pipeline_add_gaussian (pipeline, 15, 1.1);
+		} else {
+			gpm_filter_pipeline_add_segments (pipeline, 500.0f);
+			gpm_filter_pipeline_add_outliers (pipeline, 3, 0.1);
+			gpm_filter_pipeline_add_time (pipeline, 120.0f, 500.0f);
+		}
+		series[0] = gpm_graph_series_new (0);
+		series[1] = gpm_graph_series_new (0);
+		gpm_graph_series_set_gap (series[0], 500.0f);
+		gpm_graph_series_set_gap (series[1], 500.0f);
+
+		for (j=0; j<10; j++) {
+			length = 600 - (j % 3) * 50;
+			for (i=0; i<length; i++) {
+				points[i].x = -60.0f * (length - i) - (i < length / 2 ? 3600.0f : 0.0f);
+				points[i].y = 50.0f + 10.0f * sinf (i * 0.1f + j) + (i % 17 == 0 ? 30.0f : 0.0f);
+				points[i].color = i < 100 ? 0xff0000 : 0x0000ff;
+			}
+
+			/* the first refresh sets up the buffers */
+			if (j > 0)
+				g_atomic_int_set (&gpm_test_allocations, 0);
+			gpm_test_refresh (pipeline, input, series, points, length);
+			if (j > 0) {
+				g_assert_cmpint (g_atomic_int_get (&gpm_test_allocations), ==, 0);
+				g_atomic_int_set (&gpm_test_allocations, -1);
+			}
+		}
+		gpm_graph_series_free (series[0]);
+		gpm_graph_series_free (series[1]);
+		gpm_filter_pipeline_free (pipeline);
+	}
+	g_array_unref (input);
+	g_free (points);
+#else
+	g_test_message ("cannot count allocations with this C library");
+#endif
+}
+
+static void
+gpm_test_trace_func (void)
+{
+	gboolean ret;
+	gchar *contents = NULL;
+	gchar *filename;
+	gint64 begin;
+	GError *error = NULL;
+
+	/* not tracing, so nothing to save */
+	g_assert_cmpint (gpm_trace_begin (), ==, 0);
+	ret = gpm_trace_stop (&error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* save one span */
+	filename = g_build_filename (g_get_tmp_dir (), "gpm-self-test-trace.json", NULL);
+	gpm_trace_start (filename);
+	begin = gpm_trace_begin ();
+	g_assert_cmpint (begin, >, 0);
+	gpm_trace_end (begin, "test", "Span");
+	ret = gpm_trace_stop (&error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (gpm_trace_begin (), ==, 0);
+
+	/* check it's in the Chrome trace format */
+	ret = g_file_get_contents (filename, &contents, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert (g_str_has_prefix (contents, "{\"traceEvents\":[\n{"));
+	g_assert (strstr (contents, "\"name\":\"Span\",\"cat\":\"test\",\"ph\":\"X\"") != NULL);
+	g_assert (g_str_has_suffix (contents, "}\n],\"displayTimeUnit\":\"ms\"}\n"));
+
+	g_unlink (filename);
+	g_free (contents);
+	g_free (filename);
+}
+
+/**
+ * gpm_test_raster_walk:
+ *
+ * Fills @xs and @ys with a long noisy line across a graph-sized area.
+ **/
+static void
+gpm_test_raster_walk (gfloat *xs, gfloat *ys, guint length, gint width, gint height)
+{
+	guint i;
+	for (i=0; i<length; i++) {
+		xs[i] = (gfloat) width * i / length;
+		ys[i] = height / 2 + height / 3 * sinf (i * 0.001f) + (i * 7919 % 41) - 20;
+	}
+}
+
+static void
+gpm_test_raster_func (void)
+{
+	GpmRaster raster;
+	guint32 *data;
+	guint32 *copy;
+	gfloat *xs;
+	gfloat *ys;
+	cairo_surface_t *surface;
+	cairo_t *cr;
+	gint64 start;
+	gdouble elapsed;
+	gdouble elapsed_cairo;
+	guint i;
+	guint j;
+	const guint length = 50000;
+
+	/* a flat line covers the row it's on, and a quarter of each side */
+	data = g_new0 (guint32, 20 * 20);
+	gpm_raster_init (&raster, data, 0, 0, 20, 20, 20 * sizeof (guint32));
+	gpm_raster_line (&raster, 2.0f, 10.5f, 12.0f, 10.5f, 1.5f, 0x00ff00);
+	g_assert_cmphex (data[10 * 20 + 2], ==, 0xff00ff00);
+	g_assert_cmphex (data[10 * 20 + 11], ==, 0xff00ff00);
+	g_assert_cmphex (data[10 * 20 + 1], ==, 0);
+	g_assert_cmphex (data[10 * 20 + 12], ==, 0);
+	g_assert_cmphex (data[9 * 20 + 5], ==, 0x40004000);
+	g_assert_cmphex (data[11 * 20 + 5], ==, 0x40004000);
+	g_assert_cmphex (data[8 * 20 + 5], ==, 0);
+
+	/* where two lines meet is only drawn once */
+	gpm_raster_line (&raster, 12.0f, 10.5f, 18.0f, 10.5f, 1.5f, 0x00ff00);
+	g_assert_cmphex (data[9 * 20 + 12], ==, 0x40004000);
+	g_assert_cmphex (data[9 * 20 + 17], ==, 0x40004000);
+
+	/* steep lines are drawn a row at a time */
+	gpm_raster_line (&raster, 4.5f, 0.0f, 4.5f, 8.0f, 1.5f, 0xff0000);
+	g_assert_cmphex (data[3 * 20 + 4], ==, 0xffff0000);
+	g_assert_cmphex (data[3 * 20 + 3], ==, 0x40400000);
+	g_assert_cmphex (data[8 * 20 + 4], ==, 0);
+
+	/* half covered over opaque black is half way to the color */
+	gpm_raster_clear (&raster);
+	for (i=0; i<20 * 20; i++)
+		g_assert_cmphex (data[i], ==, 0);
+	data[5 * 20 + 5] = 0xff000000;
+	gpm_raster_line (&raster, 5.0f, 5.5f, 6.0f, 5.5f, 1.0f, 0xffffff);
+	g_assert_cmphex (data[5 * 20 + 5], ==, 0xffffffff);
+	gpm_raster_clear (&raster);
+	data[5 * 20 + 5] = 0xff000000;
+	gpm_raster_line (&raster, 5.0f, 5.0f, 6.0f, 5.0f, 1.0f, 0xffffff);
+	g_assert_cmphex (data[5 * 20 + 5], ==, 0xff808080);
+
+	/* a dot is a pixel of color with black all around */
+	gpm_raster_clear (&raster);
+	gpm_raster_dot (&raster, 5.7f, 5.2f, 0x0000ff);
+	g_assert_cmphex (data[5 * 20 + 5], ==, 0xff0000ff);
+	g_assert_cmphex (data[4 * 20 + 4], ==, 0xff000000);
+	g_assert_cmphex (data[6 * 20 + 6], ==, 0xff000000);
+	g_assert_cmphex (data[7 * 20 + 5], ==, 0);
+
+	/* nothing outside the clip is touched, even by lines from far away */
+	gpm_raster_clear (&raster);
+	gpm_raster_set_clip (&raster, 5, 5, 10, 10);
+	gpm_raster_line (&raster, -1e30f, 8.0f, 1e30f, 9.0f, 1.5f, 0xffffff);
+	gpm_raster_line (&raster, 0.0f, 0.0f, 20.0f, 20.0f, 1.5f, 0xffffff);
+	gpm_raster_line (&raster, 0.0f, NAN, 20.0f, 20.0f, 1.5f, 0xffffff);
+	gpm_raster_dot (&raster, 5.0f, 10.0f, 0xffffff);
+	gpm_raster_dot (&raster, 1e30f, 10.0f, 0xffffff);
+	for (j=0; j<20; j++) {
+		for (i=0; i<20; i++) {
+			if (i < 5 || i >= 15 || j < 5 || j >= 15)
+				g_assert_cmphex (data[j * 20 + i], ==, 0);
+		}
+	}
+	g_assert_cmphex (data[10 * 20 + 10], ==, 0xffffffff);
+
+	/* the image can be anywhere on the surface */
+	copy = g_memdup (data, 20 * 20 * sizeof (guint32));
+	gpm_raster_init (&raster, data, 100, 200, 20, 20, 20 * sizeof (guint32));
+	gpm_raster_set_clip (&raster, 105, 205, 10, 10);
+	gpm_raster_clear (&raster);
+	gpm_raster_line (&raster, 100.0f - 1e30f, 208.0f, 100.0f + 1e30f, 209.0f, 1.5f, 0xffffff);
+	gpm_raster_line (&raster, 100.0f, 200.0f, 120.0f, 220.0f, 1.5f, 0xffffff);
+	gpm_raster_dot (&raster, 105.0f, 210.0f, 0xffffff);
+	g_assert (memcmp (data, copy, 20 * 20 * sizeof (guint32)) == 0);
+	g_free (copy);
+	g_free (data);
+
+	if (!g_test_perf ())
+		return;
+
+	/* a long history drawn across a graph-sized image */
+	xs = g_new (gfloat, length);
+	ys = g_new (gfloat, length);
+	gpm_test_raster_walk (xs, ys, length, 600, 300);
+	surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, 600, 300);
+	start = g_get_monotonic_time ();
+	for (i=0; i<10; i++) {
+		cairo_surface_flush (surface);
+		gpm_raster_init (&raster, (guint32 *) cairo_image_surface_get_data (surface), 0, 0,
+				 600, 300, cairo_image_surface_get_stride (surface));
+		gpm_raster_clear (&raster);
+		for (j=1; j<length; j++)
+			gpm_raster_line (&raster, xs[j-1], ys[j-1], xs[j], ys[j], 1.5f, 0x00ff00);
+		cairo_surface_mark_dirty (surface);
+	}
+	elapsed = (g_get_monotonic_time () - start) * 1000.0 / (10 * length);
+
+	start = g_get_monotonic_time ();
+	for (i=0; i<10; i++) {
+		cr = cairo_create (surface);
+		cairo_set_line_width (cr, 1.5);
+		cairo_set_line_join (cr, CAIRO_LINE_JOIN_ROUND);
+		cairo_set_source_rgb (cr, 0, 1, 0);
+		cairo_move_to (cr, xs[0], ys[0]);
+		for (j=1; j<length; j++)
+			cairo_line_to (cr, xs[j], ys[j]);
+		cairo_stroke (cr);
+		cairo_destroy (cr);
+	}
+	elapsed_cairo = (g_get_monotonic_time () - start) * 1000.0 / (10 * length);
+	g_test_minimized_result (elapsed, "%u segments: %.1f ns each, or %.1f ns with cairo",
+				 length, elapsed, elapsed_cairo);
+	cairo_surface_destroy (surface);
+	g_free (xs);
+	g_free (ys);
+}
+
+static void
+gpm_test_raster_density_func (void)
+{
+	GpmRaster raster;
+	GpmPointObj *many;
+	guint32 *data;
+	guint32 *bins;
+	guint32 max;
+	gint64 start;
+	gdouble elapsed[3];
+	gfloat *xs;
+	gfloat *ys;
+	guint i, j;
+	guint k;
+	guint total;
+	const guint length = 50000;
+	const guint cycles[] = { 1, 10, 100 };
+	const GpmPointObj points[] = {
+		{ 105.5f, 205.5f, 0 },
+		{ 105.9f, 205.1f, 0 },
+		{ 105.0f, 205.0f, 0 },
+		{ 110.0f, 210.0f, 0 },
+		{ 99.9f, 205.0f, 0 },	/* off the left */
+		{ 120.0f, 205.0f, 0 },	/* off the right */
+		{ NAN, 205.0f, 0 } };
+
+	/* each point is counted in the pixel it is in, if it's in the image */
+	data = g_new0 (guint32, 20 * 20);
+	bins = g_new0 (guint32, 20 * 20);
+	gpm_raster_init (&raster, data, 100, 200, 20, 20, 20 * sizeof (guint32));
+	max = gpm_raster_bin (&raster, bins, points, G_N_ELEMENTS (points));
+	g_assert_cmpint (max, ==, 3);
+	g_assert_cmpint (bins[5 * 20 + 5], ==, 3);
+	g_assert_cmpint (bins[10 * 20 + 10], ==, 1);
+	total = 0;
+	for (i=0; i<20 * 20; i++)
+		total += bins[i];
+	g_assert_cmpint (total, ==, 4);
+
+	/* the busiest pixel is opaque red, and empty ones are transparent */
+	gpm_raster_density (&raster, bins, max);
+	g_assert_cmphex (data[5 * 20 + 5], ==, 0xffff0000);
+	g_assert_cmphex (data[10 * 20 + 10] >> 24, >, 0);
+	g_assert_cmphex (data[10 * 20 + 10] >> 24, <, 0xff);
+	g_assert_cmphex (data[0], ==, 0);
+
+	/* only the clip is colored */
+	for (i=0; i<20 * 20; i++)
+		data[i] = 0x12345678;
+	gpm_raster_set_clip (&raster, 105, 205, 1, 1);
+	gpm_raster_density (&raster, bins, max);
+	g_assert_cmphex (data[5 * 20 + 5], ==, 0xffff0000);
+	g_assert_cmphex (data[10 * 20 + 10], ==, 0x12345678);
+	g_assert_cmphex (data[5 * 20 + 4], ==, 0x12345678);
+	g_free (bins);
+	g_free (data);
+
+	if (!g_test_perf ())
+		return;
+
+	/* the same history drawn again for each cycle, a little higher each time */
+	xs = g_new (gfloat, length);
+	ys = g_new (gfloat, length);
+	gpm_test_raster_walk (xs, ys, length, 600, 300);
+	many = g_new (GpmPointObj, length * cycles[G_N_ELEMENTS (cycles) - 1]);
+	data = g_new (guint32, 600 * 300);
+	bins = g_new (guint32, 600 * 300);
+	for (k=0; k<G_N_ELEMENTS (cycles); k++) {
+		for (i=0; i<length * cycles[k]; i++) {
+			many[i].x = xs[i % length];
+			many[i].y = ys[i % length] + (gfloat) (i / length) / cycles[k] * 20.0f;
+			many[i].color = 0;
+		}
+		start = g_get_monotonic_time ();
+		for (j=0; j<10; j++) {
+			gpm_raster_init (&raster, data, 0, 0, 600, 300, 600 * sizeof (guint32));
+			memset (bins, 0, 600 * 300 * sizeof (guint32));
+			max = gpm_raster_bin (&raster, bins, many, length * cycles[k]);
+			gpm_raster_density (&raster, bins, max);
+		}
+		elapsed[k] = (g_get_monotonic_time () - start) / 10.0;
+	}
+	g_test_minimized_result (elapsed[2] / (length * cycles[2]) * 1000.0,
+				 "density of %u, %u and %u cycles of %u points: %.0f, %.0f and %.0f us",
+				 cycles[0], cycles[1], cycles[2], length,
+				 elapsed[0], elapsed[1], elapsed[2]);
+	g_free (many);
+	g_free (bins);
+	g_free (data);
+	g_free (xs);
+	g_free (ys);
 }
 
 int
@@ -307,6 +1758,18 @@ main (int argc, char **argv)
 
 	/* tests go here */
 	g_test_add_func ("/power/array_float", gpm_test_array_float_func);
+	g_test_add_func ("/power/filter_pipeline", gpm_test_filter_pipeline_func);
+	g_test_add_func ("/power/median", gpm_test_median_func);
+	g_test_add_func ("/power/convolve_parallel", gpm_test_convolve_parallel_func);
+	g_test_add_func ("/power/pipeline_incremental", gpm_test_pipeline_incremental_func);
+	g_test_add_func ("/power/smooth_time", gpm_test_smooth_time_func);
+	g_test_add_func ("/power/graph_series", gpm_test_graph_series_func);
+	g_test_add_func ("/power/history_pack", gpm_test_history_pack_func);
+	g_test_add_func ("/power/pipeline_points", gpm_test_pipeline_points_func);
+	g_test_add_func ("/power/refresh_allocations", gpm_test_refresh_allocations_func);
+	g_test_add_func ("/power/trace", gpm_test_trace_func);
+	g_test_add_func ("/power/raster", gpm_test_raster_func);
+	g_test_add_func ("/power/raster_density", gpm_test_raster_density_func);
 
 	return g_test_run ();
 }
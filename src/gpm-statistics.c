@@ -22,13 +22,20 @@
 #include "config.h"
 
 #include <locale.h>
+#include <string.h>
 #include <glib.h>
 #include <glib/gi18n.h>
 #include <gtk/gtk.h>
 #include <libupower-glib/upower.h>
+#ifdef CAIRO_HAS_SVG_SURFACE
+#include <cairo-svg.h>
+#endif
 
 #include "gpm-array-float.h"
+#include "gpm-graph-series.h"
 #include "gpm-graph-widget.h"
+#include "gpm-history-pack.h"
+#include "gpm-trace.h"
 
 #define GPM_SETTINGS_SCHEMA				"org.gnome.power-manager"
 #define GPM_SETTINGS_INFO_HISTORY_TIME			"info-history-time"
@@ -38,6 +45,8 @@
 #define GPM_SETTINGS_INFO_STATS_TYPE			"info-stats-type"
 #define GPM_SETTINGS_INFO_STATS_GRAPH_SMOOTH		"info-stats-graph-smooth"
 #define GPM_SETTINGS_INFO_STATS_GRAPH_POINTS		"info-stats-graph-points"
+#define GPM_SETTINGS_INFO_STATS_GRAPH_DENSITY		"info-stats-graph-density"
+#define GPM_SETTINGS_INFO_GRAPH_MEDIAN			"info-graph-median"
 #define GPM_SETTINGS_INFO_PAGE_NUMBER			"info-page-number"
 #define GPM_SETTINGS_INFO_LAST_DEVICE			"info-last-device"
 
@@ -50,10 +59,36 @@ static const gchar *history_type;
 static const gchar *stats_type;
 static guint history_time;
 static GSettings *settings;
-static gfloat sigma_smoothing = 0.0f;
 static UpWakeups *wakeups = NULL;
 static GtkWidget *graph_history = NULL;
 static GtkWidget *graph_statistics = NULL;
+static gchar *render_filename = NULL;
+static gchar *render_type = NULL;
+static gint render_width = 800;
+static gint render_height = 500;
+static GHashTable *live_data = NULL;
+static gboolean history_live = FALSE;
+static gboolean history_compare = FALSE;
+static GCancellable *compare_cancellable = NULL;
+static GPtrArray *compare_items = NULL; /* what the compare graph shows */
+static GCancellable *history_cancellable = NULL;
+static GCancellable *stats_cancellable = NULL;
+static GDBusConnection *connection = NULL;
+static GHashTable *device_table = NULL; /* object path to UpDevice */
+static gboolean coldplug_done = FALSE;
+static guint coldplug_pending = 0; /* devices we're still asking about */
+static gchar *coldplug_device = NULL; /* to select once we have the devices */
+static gchar *trace_filename = NULL;
+static gboolean show_render_stats = FALSE;
+static gboolean fast_render = FALSE;
+static GpmFilterPipeline *history_pipeline = NULL;
+static GpmFilterPipeline *stats_pipeline = NULL;
+static guint history_pipeline_time = 0;
+static gboolean pipelines_median = FALSE;
+static GpmFilterPipeline *live_pipeline = NULL;
+static gboolean live_pipeline_median = FALSE;
+static GThreadPool *smooth_pool = NULL;
+static gint smooth_generation[2] = { 0, 0 }; /* statistics, history */
 
 enum {
 	GPM_INFO_COLUMN_TEXT,
@@ -81,12 +116,19 @@ enum {
 #define GPM_HISTORY_CHARGE_TEXT			_("Charge")
 #define GPM_HISTORY_TIME_FULL_TEXT		_("Time to full")
 #define GPM_HISTORY_TIME_EMPTY_TEXT		_("Time to empty")
+#define GPM_HISTORY_VOLTAGE_TEXT		_("Voltage")
 
 #define GPM_HISTORY_RATE_VALUE			"rate"
 #define GPM_HISTORY_CHARGE_VALUE		"charge"
 #define GPM_HISTORY_TIME_FULL_VALUE		"time-full"
 #define GPM_HISTORY_TIME_EMPTY_VALUE		"time-empty"
+#define GPM_HISTORY_VOLTAGE_VALUE		"voltage"
+
+/* where the types are in the combo box, voltage being only for live */
+#define GPM_HISTORY_CHARGE_INDEX		1
+#define GPM_HISTORY_VOLTAGE_INDEX		4
 
+#define GPM_HISTORY_LIVE_TEXT			_("Live")
 #define GPM_HISTORY_MINUTE_TEXT			_("10 minutes")
 #define GPM_HISTORY_HOUR_TEXT			_("2 hours")
 #define GPM_HISTORY_HOURS_TEXT			_("6 hours")
@@ -98,6 +140,109 @@ enum {
 #define GPM_HISTORY_HOURS_VALUE			6*60*60
 #define GPM_HISTORY_DAY_VALUE			24*60*60
 #define GPM_HISTORY_WEEK_VALUE			7*24*60*60
+#define GPM_HISTORY_RESOLUTION			150 /* points */
+#define GPM_HISTORY_GAP_MIN			10*60 /* s */
+
+#define GPM_STATS_LIVE_CAPACITY			600 /* samples */
+
+/* the profiles only have 100 points, so the density comes from the history */
+#define GPM_STATS_DENSITY_TIME			30*24*60*60 /* s */
+#define GPM_STATS_DENSITY_RESOLUTION		20000 /* points */
+
+#define GPM_STATS_UPOWER_SERVICE		"org.freedesktop.UPower"
+#define GPM_STATS_UPOWER_PATH			"/org/freedesktop/UPower"
+#define GPM_STATS_UPOWER_INTERFACE		"org.freedesktop.UPower"
+#define GPM_STATS_UPOWER_DEVICE_INTERFACE	"org.freedesktop.UPower.Device"
+#define GPM_STATS_PROPERTIES_INTERFACE		"org.freedesktop.DBus.Properties"
+
+typedef enum {
+	GPM_STATS_LIVE_RATE,
+	GPM_STATS_LIVE_CHARGE,
+	GPM_STATS_LIVE_TIME_FULL,
+	GPM_STATS_LIVE_TIME_EMPTY,
+	GPM_STATS_LIVE_VOLTAGE,
+	GPM_STATS_LIVE_LAST
+} GpmStatsLiveKind;
+
+/* the values sent with each device-changed signal, kept for the live graph */
+typedef struct {
+	gint64			 start; /* monotonic, in us */
+	GpmHistoryPack		*pack[GPM_STATS_LIVE_LAST];
+} GpmStatsLive;
+
+/* a request for the history of all the selected devices */
+typedef struct {
+	GPtrArray		*items;
+	guint			 pending; /* replies still to come */
+	GCancellable		*cancellable;
+} GpmStatsCompare;
+
+/* one of the devices shown when comparing the history */
+typedef struct {
+	gchar			*object_path;
+	gchar			*description;
+	gchar			*history_type;
+	guint			 history_time;
+	guint32			 color;
+	GpmHistoryPack		*pack; /* in the color of the device */
+} GpmStatsCompareItem;
+
+/* one of the replies a compare is waiting for */
+typedef struct {
+	GpmStatsCompare		*compare;
+	GpmStatsCompareItem	*item;
+} GpmStatsCompareReply;
+
+typedef enum {
+	GPM_STATS_FETCH_HISTORY,
+	GPM_STATS_FETCH_STATS
+} GpmStatsFetchKind;
+
+/* a request for the history or statistics of one device */
+typedef struct {
+	GpmStatsFetchKind	 kind;
+	gchar			*object_path;
+	gchar			*type;
+	guint			 timespec;
+	gboolean		 use_data;
+	gboolean		 use_density;
+	GCancellable		*cancellable;
+	GPtrArray		*items[2]; /* the rates and charges for the density */
+	guint			 pending; /* replies still to come */
+} GpmStatsFetch;
+
+/* one of the replies a fetch is waiting for */
+typedef struct {
+	GpmStatsFetch		*fetch;
+	guint			 index; /* into items */
+} GpmStatsFetchReply;
+
+/* the data for one graph, which is smoothed and turned into series in a
+ * worker thread so the window keeps responding to the user. The settings
+ * are copied as the worker can't look at the widgets. */
+typedef struct {
+	gint			 generation; /* outdated when a newer job is made */
+	gboolean		 is_history;
+	gboolean		 smooth;
+	gboolean		 use_points;
+	gboolean		 use_median;
+	gboolean		 use_density;
+	guint			 history_time;
+	gint			 gap_x;
+	GpmGraph		*graph;
+	GPtrArray		*inputs; /* of GArray of GpmPointObj */
+	guint			 n_inputs; /* the rest are kept for the next job */
+	GPtrArray		*series; /* of GpmGraphSeries, swapped with the graph */
+	guint			 n_series;
+	GArray			*plots; /* of GpmGraphPlot, one for each series */
+} GpmStatsSmoothJob;
+
+/* the last job for the statistics and the history, to use again */
+static GpmStatsSmoothJob *smooth_spare[2] = { NULL, NULL };
+
+/* each device has its own color when comparing the history */
+static const guint32 gpm_stats_compare_colors[] = {
+	0x0000ff, 0xff0000, 0x00a000, 0xff8000, 0x8000c0, 0x00a0a0, 0x808080 };
 
 /* TRANSLATORS: what we've observed about the device */
 #define GPM_STATS_CHARGE_DATA_TEXT		_("Charge profile")
@@ -114,6 +259,62 @@ enum {
 #define GPM_UP_TIME_PRECISION			5*60 /* seconds */
 #define GPM_UP_TEXT_MIN_TIME			120 /* seconds */
 
+static const GOptionEntry render_options[] = {
+	{ "render-graph", '\0', 0, G_OPTION_ARG_FILENAME, &render_filename,
+	  /* TRANSLATORS: save a graph to a PNG or SVG file rather than showing a window */
+	  N_("Save the graph to a PNG or SVG file and exit"), NULL },
+	{ "render-type", '\0', 0, G_OPTION_ARG_STRING, &render_type,
+	  /* TRANSLATORS: the kind of graph to save, e.g. "charge" or "discharge-data" */
+	  N_("The graph to save, e.g. 'rate', 'charge' or 'charge-data'"), NULL },
+	{ "render-width", '\0', 0, G_OPTION_ARG_INT, &render_width,
+	  /* TRANSLATORS: the size of the saved graph */
+	  N_("The width of the saved graph in pixels"), NULL },
+	{ "render-height", '\0', 0, G_OPTION_ARG_INT, &render_height,
+	  /* TRANSLATORS: the size of the saved graph */
+	  N_("The height of the saved graph in pixels"), NULL },
+	{ NULL}
+};
+
+static const GOptionEntry trace_options[] = {
+	{ "trace", '\0', 0, G_OPTION_ARG_FILENAME, &trace_filename,
+	  /* TRANSLATORS: save how long each part of the program took */
+	  N_("Save timing information to a file in the Chrome trace format"), NULL },
+	{ NULL}
+};
+
+/* how the graphs are drawn, which is shown with --help-graph */
+static const GOptionEntry graph_options[] = {
+	{ "show-render-stats", '\0', 0, G_OPTION_ARG_NONE, &show_render_stats,
+	  /* TRANSLATORS: show how long it took to draw the graphs on top of them */
+	  N_("Show how long each graph took to draw"), NULL },
+	{ "fast-render", '\0', 0, G_OPTION_ARG_NONE, &fast_render,
+	  /* TRANSLATORS: draw the lines on the graphs without using cairo, which is faster with a lot of data */
+	  N_("Draw the graphs with a faster renderer"), NULL },
+	{ NULL}
+};
+
+/**
+ * gpm_stats_add_option_entries:
+ **/
+static void
+gpm_stats_add_option_entries (GOptionContext *context)
+{
+	GOptionGroup *group;
+
+	g_option_context_add_main_entries (context, render_options, NULL);
+	g_option_context_add_main_entries (context, trace_options, NULL);
+
+	group = g_option_group_new ("graph",
+				    /* TRANSLATORS: the heading for the options in --help-graph */
+				    _("Graph Options:"),
+				    /* TRANSLATORS: the description of --help-graph */
+				    _("Show graph drawing options"),
+				    NULL, NULL);
+	g_option_group_set_translation_domain (group, GETTEXT_PACKAGE);
+	g_option_group_add_entries (group, graph_options);
+	g_option_context_add_group (context, group);
+}
+
 /**
  * gpm_stats_get_device_icon_suffix:
  * @device: The UpDevice
@@ -490,52 +691,92 @@ gpm_stats_add_info_data (const gchar *attr, const gchar *text)
 }
 
 /**
- * gpm_stats_update_smooth_data:
+ * gpm_stats_get_history_gap:
+ *
+ * Return value: the time between points in the history that is taken to be
+ * a suspend, which is never smoothed or drawn across
  **/
-static GPtrArray *
-gpm_stats_update_smooth_data (GPtrArray *list)
+static gfloat
+gpm_stats_get_history_gap (guint timespec)
 {
-	guint i;
-	GpmPointObj *point;
-	GpmPointObj *point_new;
-	GPtrArray *new;
-	GpmArrayFloat *raw;
-	GpmArrayFloat *convolved;
-	GpmArrayFloat *outliers;
-	GpmArrayFloat *gaussian = NULL;
+	gfloat spacing;
+	spacing = (gfloat) timespec / GPM_HISTORY_RESOLUTION;
+	return MAX (5.0f * spacing, GPM_HISTORY_GAP_MIN);
+}
 
-	/* convert the y data to a GpmArrayFloat array */
-	raw = gpm_array_float_new (list->len);
-	for (i=0; i<list->len; i++) {
-		point = (GpmPointObj *) g_ptr_array_index (list, i);
-		gpm_array_float_set (raw, i, point->y);
-	}
+/**
+ * gpm_stats_pipelines_free:
+ *
+ * The pipelines are set up again the next time they are needed.
+ **/
+static void
+gpm_stats_pipelines_free (void)
+{
+	gpm_filter_pipeline_free (history_pipeline);
+	history_pipeline = NULL;
+	gpm_filter_pipeline_free (stats_pipeline);
+	stats_pipeline = NULL;
+}
 
-	/* remove any outliers */
-	outliers = gpm_array_float_remove_outliers (raw, 3, 0.1);
+/**
+ * gpm_stats_get_pipeline:
+ * @job: what to smooth, which is only ever done by one thread at a time
+ *
+ * Return value: the smoothing for the graph, which is set up the first time
+ **/
+static GpmFilterPipeline *
+gpm_stats_get_pipeline (GpmStatsSmoothJob *job)
+{
+	GpmFilterPipeline **pipeline;
+	gfloat spacing;
 
-	/* convolve with gaussian */
-	gaussian = gpm_array_float_compute_gaussian (15, sigma_smoothing);
-	convolved = gpm_array_float_convolve (outliers, gaussian);
+	/* the way outliers are removed has changed */
+	if (pipelines_median != job->use_median) {
+		gpm_stats_pipelines_free ();
+		pipelines_median = job->use_median;
+	}
 
-	/* add the smoothed data back into a new array */
-	new = g_ptr_array_new_with_free_func ((GDestroyNotify) gpm_point_obj_free);
-	for (i=0; i<list->len; i++) {
-		point = (GpmPointObj *) g_ptr_array_index (list, i);
-		point_new = g_new0 (GpmPointObj, 1);
-		point_new->color = point->color;
-		point_new->x = point->x;
-		point_new->y = gpm_array_float_get (convolved, i);
-		g_ptr_array_add (new, point_new);
+	/* the history is smoothed by time, which depends on the range shown */
+	if (job->is_history && history_pipeline != NULL && history_pipeline_time != job->history_time) {
+		gpm_filter_pipeline_free (history_pipeline);
+		history_pipeline = NULL;
 	}
 
-	/* free data */
-	gpm_array_float_free (gaussian);
-	gpm_array_float_free (raw);
-	gpm_array_float_free (convolved);
-	gpm_array_float_free (outliers);
+	pipeline = job->is_history ? &history_pipeline : &stats_pipeline;
+	if (*pipeline != NULL)
+		return *pipeline;
 
-	return new;
+	/* the profiles are the same each time unless upowerd has learnt
+	 * something, so only what changed is smoothed again. The history
+	 * times are from now, so every value moves on each refresh, and
+	 * smoothing by time has to start again from the first value anyway,
+	 * so comparing it would only cost more */
+	*pipeline = gpm_filter_pipeline_new ();
+	gpm_filter_pipeline_set_incremental (*pipeline, !job->is_history);
+
+	/* smooth each side of a suspend on its own */
+	if (job->is_history)
+		gpm_filter_pipeline_add_segments (*pipeline, gpm_stats_get_history_gap (job->history_time));
+
+	/* remove any outliers */
+	if (job->use_median)
+		gpm_filter_pipeline_add_median (*pipeline, 5);
+	else
+		gpm_filter_pipeline_add_outliers (*pipeline, 3, 0.1);
+
+	/* the stats are evenly spaced, so convolve with gaussian */
+	if (!job->is_history) {
+		gpm_filter_pipeline_add_gaussian (*pipeline, 15, 1.1);
+		return *pipeline;
+	}
+
+	/* upowerd skips times when nothing changed and we drop unknown
+	 * states, so weight the history by how far apart the points are,
+	 * and don't smooth across a suspend */
+	spacing = (gfloat) job->history_time / GPM_HISTORY_RESOLUTION;
+	gpm_filter_pipeline_add_time (*pipeline, 2.0f * spacing, gpm_stats_get_history_gap (job->history_time));
+	history_pipeline_time = job->history_time;
+	return *pipeline;
 }
 
 /**
@@ -578,6 +819,23 @@ gpm_stats_bool_to_string (gboolean ret)
 	return ret ? _("Yes") : _("No");
 }
 
+/**
+ * gpm_stats_device_get_object_path:
+ *
+ * The devices in the window are made from properties we fetched ourselves,
+ * so upower-glib doesn't know their object path.
+ **/
+static const gchar *
+gpm_stats_device_get_object_path (UpDevice *device)
+{
+	const gchar *object_path;
+
+	object_path = g_object_get_data (G_OBJECT (device), "gpm-object-path");
+	if (object_path == NULL)
+		object_path = up_device_get_object_path (device);
+	return object_path;
+}
+
 /**
  * gpm_stats_get_printable_device_path:
  **/
@@ -588,7 +846,7 @@ gpm_stats_get_printable_device_path (UpDevice *device)
 	gchar *device_path = NULL;
 
 	/* get object path */
-	object_path = up_device_get_object_path (device);
+	object_path = gpm_stats_device_get_object_path (device);
 	if (object_path != NULL)
 		device_path = g_filename_display_basename (object_path);
 
@@ -783,31 +1041,307 @@ gpm_stats_update_info_page_details (UpDevice *device)
 }
 
 /**
- * gpm_stats_set_graph_data:
+ * gpm_stats_smooth_cancel:
+ * @is_history: %TRUE for the history graph, %FALSE for the statistics graph
+ *
+ * Makes any job for the graph outdated, so its results are never shown.
  **/
 static void
-gpm_stats_set_graph_data (GtkWidget *widget, GPtrArray *data, gboolean use_smoothed, gboolean use_points)
+gpm_stats_smooth_cancel (gboolean is_history)
 {
-	GPtrArray *smoothed;
+	g_atomic_int_inc (&smooth_generation[is_history ? 1 : 0]);
+}
 
-	gpm_graph_widget_data_clear (GPM_GRAPH_WIDGET (widget));
+/**
+ * gpm_stats_smooth_job_new:
+ * @smooth: if the data should be smoothed, rather than shown as it is
+ *
+ * Makes any earlier job for the graph outdated. The last job that was shown
+ * is used again if there is one, so its buffers and the series the graph
+ * gave back don't have to be allocated again on each refresh.
+ *
+ * Return value: a job with no data, add some with gpm_stats_smooth_job_add()
+ **/
+static GpmStatsSmoothJob *
+gpm_stats_smooth_job_new (GpmGraph *graph, gboolean is_history, gboolean smooth, gboolean use_points)
+{
+	GpmStatsSmoothJob *job;
+
+	job = smooth_spare[is_history ? 1 : 0];
+	if (job != NULL) {
+		smooth_spare[is_history ? 1 : 0] = NULL;
+		job->n_inputs = 0;
+		job->n_series = 0;
+		g_array_set_size (job->plots, 0);
+	} else {
+		job = g_new0 (GpmStatsSmoothJob, 1);
+		job->inputs = g_ptr_array_new_with_free_func ((GDestroyNotify) g_array_unref);
+		job->series = g_ptr_array_new_with_free_func ((GDestroyNotify) gpm_graph_series_free);
+		job->plots = g_array_new (FALSE, FALSE, sizeof (GpmGraphPlot));
+	}
+	gpm_stats_smooth_cancel (is_history);
+	job->generation = g_atomic_int_get (&smooth_generation[is_history ? 1 : 0]);
+	job->is_history = is_history;
+	job->smooth = smooth;
+	job->use_points = use_points;
+	job->use_density = FALSE;
+	job->use_median = g_settings_get_boolean (settings, GPM_SETTINGS_INFO_GRAPH_MEDIAN);
+	job->history_time = history_time;
+	g_object_get (graph, "gap-x", &job->gap_x, NULL);
+	job->graph = g_object_ref (graph);
+	return job;
+}
 
-	/* add correct data */
-	if (!use_smoothed) {
-		if (use_points)
-			gpm_graph_widget_data_assign (GPM_GRAPH_WIDGET (widget), GPM_GRAPH_WIDGET_PLOT_BOTH, data);
-		else
-			gpm_graph_widget_data_assign (GPM_GRAPH_WIDGET (widget), GPM_GRAPH_WIDGET_PLOT_LINE, data);
+/**
+ * gpm_stats_smooth_job_free:
+ **/
+static void
+gpm_stats_smooth_job_free (GpmStatsSmoothJob *job)
+{
+	if (job->graph != NULL)
+		g_object_unref (job->graph);
+	g_ptr_array_unref (job->inputs);
+	g_ptr_array_unref (job->series);
+	g_array_unref (job->plots);
+	g_free (job);
+}
+
+/**
+ * gpm_stats_smooth_job_release:
+ *
+ * Keeps the job for the next refresh of the same graph, as long as no other
+ * job is being kept for it. This is only done in the main loop.
+ **/
+static void
+gpm_stats_smooth_job_release (GpmStatsSmoothJob *job)
+{
+	GpmStatsSmoothJob **spare = &smooth_spare[job->is_history ? 1 : 0];
+
+	if (*spare != NULL) {
+		gpm_stats_smooth_job_free (job);
+		return;
+	}
+	g_object_unref (job->graph);
+	job->graph = NULL;
+	*spare = job;
+}
+
+/**
+ * gpm_stats_smooth_job_get_input:
+ * @length: the number of points that will be added
+ *
+ * Return value: an empty array for the points, which is kept from an
+ * earlier job if there is one
+ **/
+static GArray *
+gpm_stats_smooth_job_get_input (GpmStatsSmoothJob *job, guint length)
+{
+	GArray *points;
+
+	if (job->n_inputs < job->inputs->len) {
+		points = g_ptr_array_index (job->inputs, job->n_inputs++);
+		g_array_set_size (points, 0);
+		return points;
+	}
+	points = g_array_sized_new (FALSE, FALSE, sizeof (GpmPointObj), length);
+	g_ptr_array_add (job->inputs, points);
+	job->n_inputs++;
+	return points;
+}
+
+/**
+ * gpm_stats_smooth_job_add:
+ * @data: an array of GpmPointObj's, which is copied
+ *
+ * The points are copied into one block, which is what the pipeline and the
+ * series take.
+ **/
+static void
+gpm_stats_smooth_job_add (GpmStatsSmoothJob *job, GPtrArray *data)
+{
+	GArray *points;
+	guint i;
+
+	points = gpm_stats_smooth_job_get_input (job, data->len);
+	for (i=0; i<data->len; i++)
+		g_array_append_vals (points, g_ptr_array_index (data, i), 1);
+}
+
+/**
+ * gpm_stats_smooth_job_add_pack:
+ * @pack: the points, which are decoded a block at a time
+ **/
+static void
+gpm_stats_smooth_job_add_pack (GpmStatsSmoothJob *job, GpmHistoryPack *pack)
+{
+	GArray *points;
+	GpmHistoryPackIter iter;
+	const GpmPointObj *block;
+	guint len;
+
+	points = gpm_stats_smooth_job_get_input (job, gpm_history_pack_get_length (pack));
+	gpm_history_pack_iter_init (&iter, pack);
+	while ((len = gpm_history_pack_iter_next (&iter, &block)) > 0)
+		g_array_append_vals (points, block, len);
+}
+
+/**
+ * gpm_stats_smooth_job_is_outdated:
+ **/
+static gboolean
+gpm_stats_smooth_job_is_outdated (GpmStatsSmoothJob *job)
+{
+	return job->generation != g_atomic_int_get (&smooth_generation[job->is_history ? 1 : 0]);
+}
+
+/**
+ * gpm_stats_smooth_job_add_series:
+ * @points: the points, which are copied
+ *
+ * Makes a series that the graph can take as it is, as it's already
+ * compact and split at the gaps. A series the graph gave back is filled
+ * again if there is one, which only allocates if it is too small.
+ **/
+static void
+gpm_stats_smooth_job_add_series (GpmStatsSmoothJob *job, GpmGraphPlot plot,
+				 const GpmPointObj *points, guint length)
+{
+	GpmGraphSeries *series;
+
+	if (job->n_series < job->series->len) {
+		series = g_ptr_array_index (job->series, job->n_series);
+		gpm_graph_series_set_gap (series, job->gap_x);
+		gpm_graph_series_assign (series, points, length);
 	} else {
-		smoothed = gpm_stats_update_smooth_data (data);
-		if (use_points)
-			gpm_graph_widget_data_assign (GPM_GRAPH_WIDGET (widget), GPM_GRAPH_WIDGET_PLOT_POINTS, data);
-		gpm_graph_widget_data_assign (GPM_GRAPH_WIDGET (widget), GPM_GRAPH_WIDGET_PLOT_LINE, smoothed);
-		g_ptr_array_unref (smoothed);
+		g_ptr_array_add (job->series, gpm_graph_series_new_from_points (points, length, job->gap_x));
 	}
+	job->n_series++;
+	g_array_append_val (job->plots, plot);
+}
 
-	/* show */
-	gtk_widget_show (widget);
+/**
+ * gpm_stats_smooth_job_process:
+ *
+ * Does the work for a job, which can be in any thread as it only uses
+ * what the job has a copy of. The job is given up as soon as a newer one
+ * is made, between the inputs or part of the way through smoothing one.
+ **/
+static void
+gpm_stats_smooth_job_process (GpmStatsSmoothJob *job)
+{
+	GpmFilterPipeline *pipeline = NULL;
+	const GpmPointObj *smoothed;
+	const GpmPointObj *points;
+	GArray *data;
+	gint64 trace;
+	guint i;
+
+	if (job->smooth && !job->use_density) {
+		pipeline = gpm_stats_get_pipeline (job);
+		gpm_filter_pipeline_set_stop_func (pipeline, (GpmFilterPipelineStopFunc) gpm_stats_smooth_job_is_outdated, job);
+	}
+	for (i=0; i<job->n_inputs; i++) {
+
+		/* there's no point finishing if it's not going to be shown */
+		if (gpm_stats_smooth_job_is_outdated (job)) {
+			g_debug ("smoothing job %i is outdated", job->generation);
+			goto out;
+		}
+
+		data = g_ptr_array_index (job->inputs, i);
+		points = (const GpmPointObj *) data->data;
+		if (job->use_density) {
+			gpm_stats_smooth_job_add_series (job, GPM_GRAPH_PLOT_DENSITY, points, data->len);
+			continue;
+		}
+		if (pipeline == NULL) {
+			gpm_stats_smooth_job_add_series (job, job->use_points ? GPM_GRAPH_PLOT_BOTH :
+										  GPM_GRAPH_PLOT_LINE,
+							 points, data->len);
+			continue;
+		}
+
+		/* the pipelines here never resample */
+		trace = gpm_trace_begin ();
+		smoothed = gpm_filter_pipeline_run_points (pipeline, points, data->len);
+		gpm_trace_end (trace, "stats", "Smooth");
+		if (smoothed == NULL) {
+			g_debug ("smoothing job %i was given up", job->generation);
+			goto out;
+		}
+		if (job->use_points)
+			gpm_stats_smooth_job_add_series (job, GPM_GRAPH_PLOT_POINTS, points, data->len);
+		gpm_stats_smooth_job_add_series (job, GPM_GRAPH_PLOT_LINE, smoothed, data->len);
+	}
+out:
+	/* the job is freed once it has been shown */
+	if (pipeline != NULL)
+		gpm_filter_pipeline_set_stop_func (pipeline, NULL, NULL);
+}
+
+/**
+ * gpm_stats_smooth_job_done_cb:
+ *
+ * Swaps the new series into the graph, unless a newer job has been made
+ * since this one was. The job gets the old series back to use next time.
+ **/
+static gboolean
+gpm_stats_smooth_job_done_cb (gpointer user_data)
+{
+	GpmStatsSmoothJob *job = (GpmStatsSmoothJob *) user_data;
+
+	if (gpm_stats_smooth_job_is_outdated (job))
+		return FALSE;
+
+	/* the series an earlier job had that were not needed this time */
+	if (job->series->len > job->n_series)
+		g_ptr_array_set_size (job->series, job->n_series);
+	gpm_graph_data_swap_series (job->graph, &job->series, job->plots);
+	return FALSE;
+}
+
+/**
+ * gpm_stats_smooth_thread_cb:
+ **/
+static void
+gpm_stats_smooth_thread_cb (gpointer data, gpointer user_data)
+{
+	GpmStatsSmoothJob *job = (GpmStatsSmoothJob *) data;
+
+	/* the widget is only touched in the main loop, which frees the job */
+	gpm_stats_smooth_job_process (job);
+	g_idle_add_full (G_PRIORITY_DEFAULT, gpm_stats_smooth_job_done_cb,
+			 job, (GDestroyNotify) gpm_stats_smooth_job_release);
+}
+
+/**
+ * gpm_stats_smooth_job_run:
+ * @job: the job, which is freed when it has been shown
+ *
+ * The graph keeps showing the old data until the job is done. There is
+ * only one worker so the pipelines are never used by two threads at once,
+ * and the jobs are done in order.
+ **/
+static void
+gpm_stats_smooth_job_run (GpmStatsSmoothJob *job)
+{
+	GError *error = NULL;
+
+	if (smooth_pool == NULL) {
+		smooth_pool = g_thread_pool_new (gpm_stats_smooth_thread_cb, NULL, 1, FALSE, &error);
+		if (smooth_pool == NULL) {
+			g_warning ("failed to start smoothing thread: %s", error->message);
+			g_error_free (error);
+			goto out;
+		}
+	}
+	g_thread_pool_push (smooth_pool, job, NULL);
+	return;
+out:
+	/* do it now instead */
+	gpm_stats_smooth_job_process (job);
+	gpm_stats_smooth_job_done_cb (job);
+	gpm_stats_smooth_job_release (job);
 }
 
 /**
@@ -827,27 +1361,36 @@ gpm_color_from_rgb (guint8 red, guint8 green, guint8 blue)
 }
 
 /**
- * gpm_stats_update_info_page_history:
+ * gpm_stats_state_to_color:
+ * @state: The device state
+ * @is_rate: If the line should be hidden when neither charging nor discharging
  **/
-static void
-gpm_stats_update_info_page_history (UpDevice *device)
+static guint32
+gpm_stats_state_to_color (UpDeviceState state, gboolean is_rate)
 {
-	GPtrArray *array;
-	guint i;
-	UpHistoryItem *item;
-	GtkWidget *widget;
-	gboolean checked;
-	gboolean points;
-	GpmPointObj *point;
-	GPtrArray *new;
-	gint32 offset = 0;
-	GTimeVal timeval;
+	if (state == UP_DEVICE_STATE_CHARGING)
+		return gpm_color_from_rgb (255, 0, 0);
+	if (state == UP_DEVICE_STATE_DISCHARGING)
+		return gpm_color_from_rgb (0, 0, 255);
+	if (state == UP_DEVICE_STATE_PENDING_CHARGE)
+		return gpm_color_from_rgb (200, 0, 0);
+	if (state == UP_DEVICE_STATE_PENDING_DISCHARGE)
+		return gpm_color_from_rgb (0, 0, 200);
+	if (is_rate)
+		return gpm_color_from_rgb (255, 255, 255);
+	return gpm_color_from_rgb (0, 255, 0);
+}
 
-	new = g_ptr_array_new_with_free_func ((GDestroyNotify) gpm_point_obj_free);
+/**
+ * gpm_stats_set_history_graph_axes:
+ **/
+static void
+gpm_stats_set_history_graph_axes (GpmGraph *graph)
+{
 	if (g_strcmp0 (history_type, GPM_HISTORY_CHARGE_VALUE) == 0) {
-		g_object_set (graph_history,
-			      "type-x", GPM_GRAPH_WIDGET_TYPE_TIME,
-			      "type-y", GPM_GRAPH_WIDGET_TYPE_PERCENTAGE,
+		g_object_set (graph,
+			      "type-x", GPM_GRAPH_TYPE_TIME,
+			      "type-y", GPM_GRAPH_TYPE_PERCENTAGE,
 			      "autorange-x", FALSE,
 			      "start-x", -history_time,
 			      "stop-x", 0,
@@ -856,18 +1399,27 @@ gpm_stats_update_info_page_history (UpDevice *device)
 			      "stop-y", 100,
 			      NULL);
 	} else if (g_strcmp0 (history_type, GPM_HISTORY_RATE_VALUE) == 0) {
-		g_object_set (graph_history,
-			      "type-x", GPM_GRAPH_WIDGET_TYPE_TIME,
-			      "type-y", GPM_GRAPH_WIDGET_TYPE_POWER,
+		g_object_set (graph,
+			      "type-x", GPM_GRAPH_TYPE_TIME,
+			      "type-y", GPM_GRAPH_TYPE_POWER,
+			      "autorange-x", FALSE,
+			      "start-x", -history_time,
+			      "stop-x", 0,
+			      "autorange-y", TRUE,
+			      NULL);
+	} else if (g_strcmp0 (history_type, GPM_HISTORY_VOLTAGE_VALUE) == 0) {
+		g_object_set (graph,
+			      "type-x", GPM_GRAPH_TYPE_TIME,
+			      "type-y", GPM_GRAPH_TYPE_VOLTAGE,
 			      "autorange-x", FALSE,
 			      "start-x", -history_time,
 			      "stop-x", 0,
 			      "autorange-y", TRUE,
 			      NULL);
 	} else {
-		g_object_set (graph_history,
-			      "type-x", GPM_GRAPH_WIDGET_TYPE_TIME,
-			      "type-y", GPM_GRAPH_WIDGET_TYPE_TIME,
+		g_object_set (graph,
+			      "type-x", GPM_GRAPH_TYPE_TIME,
+			      "type-y", GPM_GRAPH_TYPE_TIME,
 			      "autorange-x", FALSE,
 			      "start-x", -history_time,
 			      "stop-x", 0,
@@ -875,24 +1427,55 @@ gpm_stats_update_info_page_history (UpDevice *device)
 			      NULL);
 	}
 
-	widget = GTK_WIDGET (gtk_builder_get_object (builder, "label_history_nodata"));
-	array = up_device_get_history_sync (device, history_type, history_time, 150, NULL, NULL);
-	if (array == NULL) {
-		/* show no data label and hide graph */
-		gtk_widget_hide (graph_history);
-		gtk_widget_show (widget);
-		goto out;
-	}
+	/* don't draw a line across a suspend */
+	g_object_set (graph, "gap-x", (gint) gpm_stats_get_history_gap (history_time), NULL);
 
-	/* hide no data and show graph */
-	gtk_widget_hide (widget);
-	gtk_widget_show (graph_history);
+	/* the live data is the time since we started watching the device */
+	if (history_live)
+		g_object_set (graph, "autorange-x", TRUE, NULL);
+}
+
+/**
+ * gpm_stats_device_set_object_path:
+ *
+ * Like up_device_set_object_path_sync(), but the D-Bus call is traced.
+ **/
+static gboolean
+gpm_stats_device_set_object_path (UpDevice *device, const gchar *object_path,
+				  GCancellable *cancellable, GError **error)
+{
+	gboolean ret;
+	gint64 trace;
+
+	trace = gpm_trace_begin ();
+	ret = up_device_set_object_path_sync (device, object_path, cancellable, error);
+	gpm_trace_end (trace, "dbus", "SetObjectPath");
+	return ret;
+}
+
+/**
+ * gpm_stats_history_items_to_data:
+ * @items: an array of UpHistoryItem's
+ * @type: The history type, e.g. "charge"
+ *
+ * Return value: an array of GpmPointObj's
+ **/
+static GPtrArray *
+gpm_stats_history_items_to_data (GPtrArray *items, const gchar *type)
+{
+	guint i;
+	UpHistoryItem *item;
+	GpmPointObj *point;
+	GPtrArray *new;
+	gint32 offset = 0;
+	GTimeVal timeval;
 
 	g_get_current_time (&timeval);
 	offset = timeval.tv_sec;
 
-	for (i=0; i<array->len; i++) {
-		item = (UpHistoryItem *) g_ptr_array_index (array, i);
+	new = g_ptr_array_new_with_free_func ((GDestroyNotify) gpm_point_obj_free);
+	for (i=0; i<items->len; i++) {
+		item = (UpHistoryItem *) g_ptr_array_index (items, i);
 
 		/* abandon this point */
 		if (up_history_item_get_state (item) == UP_DEVICE_STATE_UNKNOWN)
@@ -901,93 +1484,1120 @@ gpm_stats_update_info_page_history (UpDevice *device)
 		point = gpm_point_obj_new ();
 		point->x = (gint32) up_history_item_get_time (item) - offset;
 		point->y = up_history_item_get_value (item);
-		if (up_history_item_get_state (item) == UP_DEVICE_STATE_CHARGING)
-			point->color = gpm_color_from_rgb (255, 0, 0);
-		else if (up_history_item_get_state (item) == UP_DEVICE_STATE_DISCHARGING)
-			point->color = gpm_color_from_rgb (0, 0, 255);
-		else if (up_history_item_get_state (item) == UP_DEVICE_STATE_PENDING_CHARGE)
-			point->color = gpm_color_from_rgb (200, 0, 0);
-		else if (up_history_item_get_state (item) == UP_DEVICE_STATE_PENDING_DISCHARGE)
-			point->color = gpm_color_from_rgb (0, 0, 200);
-		else {
-			if (g_strcmp0 (history_type, GPM_HISTORY_RATE_VALUE) == 0)
-				point->color = gpm_color_from_rgb (255, 255, 255);
-			else
-				point->color = gpm_color_from_rgb (0, 255, 0);
-		}
+		point->color = gpm_stats_state_to_color (up_history_item_get_state (item),
+							 g_strcmp0 (type, GPM_HISTORY_RATE_VALUE) == 0);
 		g_ptr_array_add (new, point);
 	}
+	return new;
+}
 
-	/* render */
-	sigma_smoothing = 2.0;
-	widget = GTK_WIDGET (gtk_builder_get_object (builder, "checkbutton_smooth_history"));
-	checked = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (widget));
-	widget = GTK_WIDGET (gtk_builder_get_object (builder, "checkbutton_points_history"));
-	points = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (widget));
+/**
+ * gpm_stats_get_history_data:
+ * @type: The history type, e.g. "charge"
+ * @timespec: How far back to go, in seconds
+ *
+ * Return value: an array of GpmPointObj's, or %NULL if there is no history
+ **/
+static GPtrArray *
+gpm_stats_get_history_data (UpDevice *device, const gchar *type, guint timespec)
+{
+	GPtrArray *array;
+	GPtrArray *new = NULL;
+	gint64 trace;
 
-	/* present data to graph */
-	gpm_stats_set_graph_data (graph_history, new, checked, points);
+	/* upowerd does not keep this, it's only available live */
+	if (g_strcmp0 (type, GPM_HISTORY_VOLTAGE_VALUE) == 0)
+		goto out;
 
+	trace = gpm_trace_begin ();
+	array = up_device_get_history_sync (device, type, timespec, GPM_HISTORY_RESOLUTION, NULL, NULL);
+	gpm_trace_end (trace, "dbus", "GetHistory");
+	if (array == NULL)
+		goto out;
+	new = gpm_stats_history_items_to_data (array, type);
 	g_ptr_array_unref (array);
-	g_ptr_array_unref (new);
 out:
-	return;
+	return new;
 }
 
+/* a D-Bus call to upowerd, which is traced when the reply comes back */
+typedef struct {
+	const gchar		*method;
+	gint64			 trace;
+} GpmStatsDBusCall;
+
 /**
- * gpm_stats_update_info_page_stats:
+ * gpm_stats_dbus_call_cb:
  **/
 static void
-gpm_stats_update_info_page_stats (UpDevice *device)
+gpm_stats_dbus_call_cb (GObject *source_object, GAsyncResult *res, gpointer user_data)
 {
-	GPtrArray *array;
-	guint i;
-	UpStatsItem *item;
-	GtkWidget *widget;
-	gboolean checked;
-	gboolean points;
-	GpmPointObj *point;
-	GPtrArray *new;
-	gboolean use_data = FALSE;
-	const gchar *type = NULL;
+	GError *error = NULL;
+	GTask *task = G_TASK (user_data);
+	GpmStatsDBusCall *call;
+	GVariant *reply;
+
+	call = (GpmStatsDBusCall *) g_task_get_task_data (task);
+	reply = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source_object), res, &error);
+	gpm_trace_end (call->trace, "dbus", call->method);
+	if (reply == NULL)
+		g_task_return_error (task, error);
+	else
+		g_task_return_pointer (task, reply, (GDestroyNotify) g_variant_unref);
+	g_object_unref (task);
+}
+
+/**
+ * gpm_stats_dbus_call:
+ * @interface_name: e.g. GPM_STATS_UPOWER_DEVICE_INTERFACE
+ * @method: a method of the interface, e.g. "GetHistory"
+ * @parameters: the arguments, or %NULL for none
+ *
+ * Calls upowerd without waiting for the reply. upower-glib 0.9 is built on
+ * dbus-glib, which can only be used from the main thread and has no async
+ * calls at all, so this uses GDBus from the main loop instead.
+ **/
+static void
+gpm_stats_dbus_call (const gchar *object_path, const gchar *interface_name,
+		     const gchar *method, GVariant *parameters,
+		     const GVariantType *reply_type, GCancellable *cancellable,
+		     GAsyncReadyCallback callback, gpointer user_data)
+{
+	GpmStatsDBusCall *call;
+	GTask *task;
+
+	task = g_task_new (NULL, cancellable, callback, user_data);
+	call = g_new0 (GpmStatsDBusCall, 1);
+	call->method = method;
+	call->trace = gpm_trace_begin ();
+	g_task_set_task_data (task, call, g_free);
+
+	/* we warned when we failed to connect */
+	if (connection == NULL) {
+		if (parameters != NULL)
+			g_variant_unref (g_variant_ref_sink (parameters));
+		g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_NOT_CONNECTED,
+					 "not connected to the system bus");
+		g_object_unref (task);
+		return;
+	}
+	g_dbus_connection_call (connection, GPM_STATS_UPOWER_SERVICE, object_path,
+				interface_name, method, parameters, reply_type,
+				G_DBUS_CALL_FLAGS_NONE, -1, cancellable,
+				gpm_stats_dbus_call_cb, task);
+}
+
+/**
+ * gpm_stats_get_history_async:
+ * @resolution: the most points to get
+ *
+ * Like up_device_get_history_sync(), but without blocking.
+ **/
+static void
+gpm_stats_get_history_async (const gchar *object_path, const gchar *type, guint timespec,
+			     guint resolution, GCancellable *cancellable,
+			     GAsyncReadyCallback callback, gpointer user_data)
+{
+	gpm_stats_dbus_call (object_path, GPM_STATS_UPOWER_DEVICE_INTERFACE, "GetHistory",
+			     g_variant_new ("(suu)", type, timespec, resolution),
+			     G_VARIANT_TYPE ("(a(udu))"),
+			     cancellable, callback, user_data);
+}
+
+/**
+ * gpm_stats_get_history_finish:
+ *
+ * Return value: an array of UpHistoryItem's, or %NULL for an error
+ **/
+static GPtrArray *
+gpm_stats_get_history_finish (GAsyncResult *res, GError **error)
+{
+	GPtrArray *items = NULL;
+	GVariant *reply;
+	GVariantIter *iter;
+	UpHistoryItem *item;
+	gdouble value;
+	guint32 timestamp;
+	guint32 state;
+
+	reply = g_task_propagate_pointer (G_TASK (res), error);
+	if (reply == NULL)
+		goto out;
+	items = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	g_variant_get (reply, "(a(udu))", &iter);
+	while (g_variant_iter_next (iter, "(udu)", &timestamp, &value, &state)) {
+		item = up_history_item_new ();
+		up_history_item_set_time (item, timestamp);
+		up_history_item_set_value (item, value);
+		up_history_item_set_state (item, state);
+		g_ptr_array_add (items, item);
+	}
+	g_variant_iter_free (iter);
+	g_variant_unref (reply);
+out:
+	return items;
+}
+
+/**
+ * gpm_stats_get_statistics_async:
+ *
+ * Like up_device_get_statistics_sync(), but without blocking.
+ **/
+static void
+gpm_stats_get_statistics_async (const gchar *object_path, const gchar *type,
+				GCancellable *cancellable,
+				GAsyncReadyCallback callback, gpointer user_data)
+{
+	gpm_stats_dbus_call (object_path, GPM_STATS_UPOWER_DEVICE_INTERFACE, "GetStatistics",
+			     g_variant_new ("(s)", type),
+			     G_VARIANT_TYPE ("(a(dd))"),
+			     cancellable, callback, user_data);
+}
+
+/**
+ * gpm_stats_get_statistics_finish:
+ *
+ * Return value: an array of UpStatsItem's, or %NULL for an error
+ **/
+static GPtrArray *
+gpm_stats_get_statistics_finish (GAsyncResult *res, GError **error)
+{
+	GPtrArray *items = NULL;
+	GVariant *reply;
+	GVariantIter *iter;
+	UpStatsItem *item;
+	gdouble value;
+	gdouble accuracy;
+
+	reply = g_task_propagate_pointer (G_TASK (res), error);
+	if (reply == NULL)
+		goto out;
+	items = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	g_variant_get (reply, "(a(dd))", &iter);
+	while (g_variant_iter_next (iter, "(dd)", &value, &accuracy)) {
+		item = up_stats_item_new ();
+		up_stats_item_set_value (item, value);
+		up_stats_item_set_accuracy (item, accuracy);
+		g_ptr_array_add (items, item);
+	}
+	g_variant_iter_free (iter);
+	g_variant_unref (reply);
+out:
+	return items;
+}
+
+/**
+ * gpm_stats_live_free:
+ **/
+static void
+gpm_stats_live_free (GpmStatsLive *live)
+{
+	guint i;
+	for (i=0; i<GPM_STATS_LIVE_LAST; i++)
+		gpm_history_pack_free (live->pack[i]);
+	g_free (live);
+}
+
+/**
+ * gpm_stats_get_live_kind:
+ *
+ * Return value: the live series to show for the history type
+ **/
+static GpmStatsLiveKind
+gpm_stats_get_live_kind (void)
+{
+	if (g_strcmp0 (history_type, GPM_HISTORY_RATE_VALUE) == 0)
+		return GPM_STATS_LIVE_RATE;
+	if (g_strcmp0 (history_type, GPM_HISTORY_TIME_FULL_VALUE) == 0)
+		return GPM_STATS_LIVE_TIME_FULL;
+	if (g_strcmp0 (history_type, GPM_HISTORY_TIME_EMPTY_VALUE) == 0)
+		return GPM_STATS_LIVE_TIME_EMPTY;
+	if (g_strcmp0 (history_type, GPM_HISTORY_VOLTAGE_VALUE) == 0)
+		return GPM_STATS_LIVE_VOLTAGE;
+	return GPM_STATS_LIVE_CHARGE;
+}
+
+/**
+ * gpm_stats_live_capture:
+ *
+ * Saves the values that came with the last change of the device. This is
+ * far more often than upowerd saves the history, and needs no D-Bus call.
+ *
+ * Return value: the live data for the device, or %NULL if nothing was saved
+ **/
+static GpmStatsLive *
+gpm_stats_live_capture (UpDevice *device)
+{
+	const gchar *object_path;
+	gdouble energy_rate;
+	gdouble percentage;
+	gdouble voltage;
+	gfloat x;
+	gint64 time_to_full;
+	gint64 time_to_empty;
+	guint32 color;
+	guint i;
+	GpmStatsLive *live;
+	UpDeviceState state;
+
+	object_path = gpm_stats_device_get_object_path (device);
+	if (object_path == NULL)
+		return NULL;
+
+	g_object_get (device,
+		      "state", &state,
+		      "energy-rate", &energy_rate,
+		      "percentage", &percentage,
+		      "voltage", &voltage,
+		      "time-to-full", &time_to_full,
+		      "time-to-empty", &time_to_empty,
+		      NULL);
+
+	/* abandon this point, like the history */
+	if (state == UP_DEVICE_STATE_UNKNOWN)
+		return NULL;
+
+	live = g_hash_table_lookup (live_data, object_path);
+	if (live == NULL) {
+		live = g_new0 (GpmStatsLive, 1);
+		live->start = g_get_monotonic_time ();
+		/* x is in seconds, so keep it to the nearest ms */
+		for (i=0; i<GPM_STATS_LIVE_LAST; i++) {
+			live->pack[i] = gpm_history_pack_new (0.001f);
+			gpm_history_pack_set_capacity (live->pack[i], GPM_STATS_LIVE_CAPACITY);
+		}
+		g_hash_table_insert (live_data, g_strdup (object_path), live);
+	}
+
+	x = (gfloat) (g_get_monotonic_time () - live->start) / G_USEC_PER_SEC;
+	color = gpm_stats_state_to_color (state, FALSE);
+	gpm_history_pack_append (live->pack[GPM_STATS_LIVE_RATE], x, energy_rate,
+				 gpm_stats_state_to_color (state, TRUE));
+	gpm_history_pack_append (live->pack[GPM_STATS_LIVE_CHARGE], x, percentage, color);
+	gpm_history_pack_append (live->pack[GPM_STATS_LIVE_TIME_FULL], x, time_to_full, color);
+	gpm_history_pack_append (live->pack[GPM_STATS_LIVE_TIME_EMPTY], x, time_to_empty, color);
+	gpm_history_pack_append (live->pack[GPM_STATS_LIVE_VOLTAGE], x, voltage, color);
+	return live;
+}
+
+/**
+ * gpm_stats_update_info_page_history_live:
+ *
+ * Shows the values saved since we started watching the device. New values
+ * are added to the end of the graph as they arrive, so there's no smoothing.
+ **/
+static void
+gpm_stats_update_info_page_history_live (UpDevice *device)
+{
+	GtkWidget *widget;
+	gboolean points;
+	GpmGraphPlot plot;
+	GpmStatsLive *live;
+	GpmGraph *graph = gpm_graph_widget_get_graph (GPM_GRAPH_WIDGET (graph_history));
+
+	gpm_stats_set_history_graph_axes (graph);
+
+	/* always show the graph, as it gets filled in as the device changes */
+	widget = GTK_WIDGET (gtk_builder_get_object (builder, "label_history_nodata"));
+	gtk_widget_hide (widget);
+
+	widget = GTK_WIDGET (gtk_builder_get_object (builder, "checkbutton_points_history"));
+	points = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (widget));
+	plot = points ? GPM_GRAPH_PLOT_BOTH : GPM_GRAPH_PLOT_LINE;
+
+	/* present data to graph, dropping the oldest points like the live data */
+	gpm_stats_smooth_cancel (TRUE);
+	gpm_graph_data_clear (graph);
+	live = g_hash_table_lookup (live_data, gpm_stats_device_get_object_path (device));
+	if (live != NULL) {
+		gpm_graph_data_assign_pack (graph, plot, live->pack[gpm_stats_get_live_kind ()]);
+		gpm_graph_set_series_capacity (graph, 0, GPM_STATS_LIVE_CAPACITY);
+	} else {
+		gpm_graph_add_series (graph, plot, GPM_STATS_LIVE_CAPACITY);
+	}
+	gtk_widget_show (graph_history);
+}
+
+/**
+ * gpm_stats_cancel:
+ *
+ * Cancels a request that is still running, as a newer one replaces it.
+ **/
+static void
+gpm_stats_cancel (GCancellable **cancellable)
+{
+	if (*cancellable == NULL)
+		return;
+	g_cancellable_cancel (*cancellable);
+	g_object_unref (*cancellable);
+	*cancellable = NULL;
+}
+
+/**
+ * gpm_stats_add_history_keys:
+ *
+ * The legend is not shown, but the hover label uses it for the state.
+ **/
+static void
+gpm_stats_add_history_keys (void)
+{
+	gpm_graph_key_data_add (gpm_graph_widget_get_graph (GPM_GRAPH_WIDGET (graph_history)),
+				gpm_stats_state_to_color (UP_DEVICE_STATE_CHARGING, FALSE),
+				gpm_device_state_to_localised_string (UP_DEVICE_STATE_CHARGING));
+	gpm_graph_key_data_add (gpm_graph_widget_get_graph (GPM_GRAPH_WIDGET (graph_history)),
+				gpm_stats_state_to_color (UP_DEVICE_STATE_DISCHARGING, FALSE),
+				gpm_device_state_to_localised_string (UP_DEVICE_STATE_DISCHARGING));
+	gpm_graph_key_data_add (gpm_graph_widget_get_graph (GPM_GRAPH_WIDGET (graph_history)),
+				gpm_stats_state_to_color (UP_DEVICE_STATE_PENDING_CHARGE, FALSE),
+				gpm_device_state_to_localised_string (UP_DEVICE_STATE_PENDING_CHARGE));
+	gpm_graph_key_data_add (gpm_graph_widget_get_graph (GPM_GRAPH_WIDGET (graph_history)),
+				gpm_stats_state_to_color (UP_DEVICE_STATE_PENDING_DISCHARGE, FALSE),
+				gpm_device_state_to_localised_string (UP_DEVICE_STATE_PENDING_DISCHARGE));
+}
+
+/**
+ * gpm_stats_compare_item_free:
+ **/
+static void
+gpm_stats_compare_item_free (GpmStatsCompareItem *item)
+{
+	g_free (item->object_path);
+	g_free (item->description);
+	g_free (item->history_type);
+	if (item->pack != NULL)
+		gpm_history_pack_free (item->pack);
+	g_free (item);
+}
+
+/**
+ * gpm_stats_compare_free:
+ **/
+static void
+gpm_stats_compare_free (GpmStatsCompare *compare)
+{
+	g_ptr_array_unref (compare->items);
+	g_object_unref (compare->cancellable);
+	g_free (compare);
+}
+
+/**
+ * gpm_stats_compare_item_add:
+ *
+ * When comparing the color shows the device rather than the state, but the
+ * lines that are hidden stay hidden.
+ **/
+static void
+gpm_stats_compare_item_add (GpmStatsCompareItem *item, const GpmPointObj *point)
+{
+	/* x is in seconds, so keep it to the nearest ms like the live data */
+	if (item->pack == NULL)
+		item->pack = gpm_history_pack_new (0.001f);
+	gpm_history_pack_append (item->pack, point->x, point->y,
+				 point->color != 0xffffff ? item->color : point->color);
+}
+
+/**
+ * gpm_stats_compare_item_set_live:
+ *
+ * Copies the live data a block at a time, as it's already compressed.
+ **/
+static void
+gpm_stats_compare_item_set_live (GpmStatsCompareItem *item, GpmHistoryPack *pack)
+{
+	GpmHistoryPackIter iter;
+	const GpmPointObj *points;
+	guint len;
+	guint i;
+
+	gpm_history_pack_iter_init (&iter, pack);
+	while ((len = gpm_history_pack_iter_next (&iter, &points)) > 0) {
+		for (i=0; i<len; i++)
+			gpm_stats_compare_item_add (item, &points[i]);
+	}
+}
+
+/**
+ * gpm_stats_get_live_pipeline:
+ *
+ * Return value: the smoothing for the live data, which is only done in the
+ * main loop so it is not shared with the worker
+ **/
+static GpmFilterPipeline *
+gpm_stats_get_live_pipeline (void)
+{
+	gboolean use_median;
+
+	/* the way outliers are removed has changed */
+	use_median = g_settings_get_boolean (settings, GPM_SETTINGS_INFO_GRAPH_MEDIAN);
+	if (live_pipeline != NULL && live_pipeline_median != use_median) {
+		gpm_filter_pipeline_free (live_pipeline);
+		live_pipeline = NULL;
+	}
+	if (live_pipeline != NULL)
+		return live_pipeline;
+
+	/* only look at a window of values so it can be done a block at a time */
+	live_pipeline = gpm_filter_pipeline_new ();
+	if (use_median)
+		gpm_filter_pipeline_add_median (live_pipeline, 5);
+	else
+		gpm_filter_pipeline_add_outliers (live_pipeline, 3, 0.1);
+	gpm_filter_pipeline_add_gaussian (live_pipeline, 15, 1.1);
+	live_pipeline_median = use_median;
+	return live_pipeline;
+}
+
+/**
+ * gpm_stats_compare_add_live:
+ *
+ * Adds the live data for a device straight from the pack. There are never
+ * more than GPM_STATS_LIVE_CAPACITY points, so it's smoothed here rather
+ * than in the worker.
+ **/
+static void
+gpm_stats_compare_add_live (GpmGraph *graph, GpmHistoryPack *pack, gboolean smooth, gboolean use_points)
+{
+	GpmHistoryPack *smoothed;
+
+	if (!smooth) {
+		gpm_graph_data_assign_pack (graph, use_points ? GPM_GRAPH_PLOT_BOTH : GPM_GRAPH_PLOT_LINE, pack);
+		return;
+	}
+	if (use_points)
+		gpm_graph_data_assign_pack (graph, GPM_GRAPH_PLOT_POINTS, pack);
+	smoothed = gpm_history_pack_new (0.001f);
+	if (gpm_filter_pipeline_run_pack (gpm_stats_get_live_pipeline (), pack, smoothed))
+		gpm_graph_data_assign_pack (graph, GPM_GRAPH_PLOT_LINE, smoothed);
+	gpm_history_pack_free (smoothed);
+}
+
+/**
+ * gpm_stats_compare_is_selected:
+ **/
+static gboolean
+gpm_stats_compare_is_selected (const gchar *object_path)
+{
+	gboolean found;
+	gboolean ret;
+	gboolean selected = FALSE;
+	gchar *id;
+	GtkTreeIter iter;
+	GtkTreeSelection *selection;
+	GtkWidget *widget;
+
+	widget = GTK_WIDGET (gtk_builder_get_object (builder, "treeview_devices"));
+	selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (widget));
+	ret = gtk_tree_model_get_iter_first (GTK_TREE_MODEL (list_store_devices), &iter);
+	while (ret) {
+		gtk_tree_model_get (GTK_TREE_MODEL (list_store_devices), &iter, GPM_DEVICES_COLUMN_ID, &id, -1);
+		found = (g_strcmp0 (id, object_path) == 0);
+		g_free (id);
+		if (found) {
+			selected = gtk_tree_selection_iter_is_selected (selection, &iter);
+			break;
+		}
+		ret = gtk_tree_model_iter_next (GTK_TREE_MODEL (list_store_devices), &iter);
+	}
+	return selected;
+}
+
+/**
+ * gpm_stats_compare_get_items:
+ *
+ * Return value: a #GpmStatsCompareItem for each selected device
+ **/
+static GPtrArray *
+gpm_stats_compare_get_items (void)
+{
+	gchar *basename;
+	gchar *id;
+	gchar *text;
+	GList *list;
+	GList *l;
+	GPtrArray *items;
+	GpmStatsCompareItem *item;
+	GtkTreeIter iter;
+	GtkTreeModel *model;
+	GtkTreeSelection *selection;
+	GtkWidget *widget;
+
+	items = g_ptr_array_new_with_free_func ((GDestroyNotify) gpm_stats_compare_item_free);
+	widget = GTK_WIDGET (gtk_builder_get_object (builder, "treeview_devices"));
+	selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (widget));
+	list = gtk_tree_selection_get_selected_rows (selection, &model);
+	for (l=list; l != NULL; l=l->next) {
+		if (!gtk_tree_model_get_iter (model, &iter, (GtkTreePath *) l->data))
+			continue;
+		gtk_tree_model_get (model, &iter,
+				    GPM_DEVICES_COLUMN_ID, &id,
+				    GPM_DEVICES_COLUMN_TEXT, &text,
+				    -1);
+		if (g_strcmp0 (id, "wakeups") == 0) {
+			g_free (id);
+			g_free (text);
+			continue;
+		}
+
+		/* two batteries have the same description */
+		basename = g_path_get_basename (id);
+		item = g_new0 (GpmStatsCompareItem, 1);
+		item->object_path = id;
+		item->description = g_strdup_printf ("%s (%s)", text, basename);
+		item->history_type = g_strdup (history_type);
+		item->history_time = history_time;
+		item->color = gpm_stats_compare_colors[items->len % G_N_ELEMENTS (gpm_stats_compare_colors)];
+		g_ptr_array_add (items, item);
+		g_free (basename);
+		g_free (text);
+	}
+	g_list_free_full (list, (GDestroyNotify) gtk_tree_path_free);
+	return items;
+}
+
+/**
+ * gpm_stats_compare_show:
+ *
+ * Adds all the devices to the graph at once, so the ranges of all the
+ * series are only merged when the graph is next drawn. The items are kept
+ * so that when one device changes the others don't have to be fetched again.
+ **/
+static void
+gpm_stats_compare_show (GPtrArray *items)
+{
+	GtkWidget *widget;
+	gboolean checked;
+	gboolean points;
+	gboolean has_data = FALSE;
+	guint i;
+	GpmStatsCompareItem *item;
+	GpmStatsSmoothJob *job = NULL;
+	GpmGraph *graph = gpm_graph_widget_get_graph (GPM_GRAPH_WIDGET (graph_history));
+
+	if (compare_items != items) {
+		if (compare_items != NULL)
+			g_ptr_array_unref (compare_items);
+		compare_items = g_ptr_array_ref (items);
+	}
+
+	widget = GTK_WIDGET (gtk_builder_get_object (builder, "checkbutton_smooth_history"));
+	checked = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (widget));
+	widget = GTK_WIDGET (gtk_builder_get_object (builder, "checkbutton_points_history"));
+	points = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (widget));
+
+	/* the live data is small enough to not need the worker */
+	if (history_live) {
+		gpm_stats_smooth_cancel (TRUE);
+		gpm_graph_data_clear (graph);
+	} else {
+		job = gpm_stats_smooth_job_new (graph, TRUE, checked, points);
+	}
+	gpm_graph_key_data_clear (graph);
+	for (i=0; i<items->len; i++) {
+		item = (GpmStatsCompareItem *) g_ptr_array_index (items, i);
+		if (item->pack == NULL || gpm_history_pack_get_length (item->pack) == 0)
+			continue;
+		gpm_graph_key_data_add (graph, item->color, item->description);
+		if (history_live)
+			gpm_stats_compare_add_live (graph, item->pack, checked, points);
+		else
+			gpm_stats_smooth_job_add_pack (job, item->pack);
+		has_data = TRUE;
+	}
+	if (job != NULL)
+		gpm_stats_smooth_job_run (job);
+
+	/* show no data label rather than an empty graph */
+	widget = GTK_WIDGET (gtk_builder_get_object (builder, "label_history_nodata"));
+	if (has_data || history_live) {
+		gtk_widget_hide (widget);
+		gtk_widget_show (graph_history);
+	} else {
+		gtk_widget_hide (graph_history);
+		gtk_widget_show (widget);
+	}
+}
+
+/**
+ * gpm_stats_compare_reply_cb:
+ **/
+static void
+gpm_stats_compare_reply_cb (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+	GError *error = NULL;
+	GPtrArray *items;
+	GPtrArray *data;
+	guint i;
+	GpmStatsCompareReply *reply = (GpmStatsCompareReply *) user_data;
+	GpmStatsCompareItem *item = reply->item;
+	GpmStatsCompare *compare = reply->compare;
+
+	g_free (reply);
+	items = gpm_stats_get_history_finish (res, &error);
+	if (items == NULL) {
+		if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+			g_warning ("failed to get history for %s: %s", item->object_path, error->message);
+		g_error_free (error);
+	} else {
+		/* this replaces what was shown before */
+		if (item->pack != NULL) {
+			gpm_history_pack_free (item->pack);
+			item->pack = NULL;
+		}
+		data = gpm_stats_history_items_to_data (items, item->history_type);
+		for (i=0; i<data->len; i++)
+			gpm_stats_compare_item_add (item, g_ptr_array_index (data, i));
+		g_ptr_array_unref (data);
+		g_ptr_array_unref (items);
+	}
+
+	/* wait for the other devices */
+	if (--compare->pending > 0)
+		return;
+
+	/* a newer request has been started */
+	if (!g_cancellable_is_cancelled (compare->cancellable))
+		gpm_stats_compare_show (compare->items);
+	gpm_stats_compare_free (compare);
+}
+
+/**
+ * gpm_stats_compare_fetch:
+ *
+ * Asks for the history of one of the devices, which is shown once the
+ * replies for all of the devices in the request are in.
+ **/
+static void
+gpm_stats_compare_fetch (GpmStatsCompare *compare, GpmStatsCompareItem *item)
+{
+	GpmStatsCompareReply *reply;
+
+	reply = g_new0 (GpmStatsCompareReply, 1);
+	reply->compare = compare;
+	reply->item = item;
+	compare->pending++;
+	gpm_stats_get_history_async (item->object_path, item->history_type, item->history_time,
+				     GPM_HISTORY_RESOLUTION, compare->cancellable,
+				     gpm_stats_compare_reply_cb, reply);
+}
+
+/**
+ * gpm_stats_update_info_page_history_compare:
+ *
+ * Shows the history of all the selected devices on the same axes. The
+ * history of each device is asked for at the same time, and the graph is
+ * only changed once all of the replies are in.
+ **/
+static void
+gpm_stats_update_info_page_history_compare (void)
+{
+	guint i;
+	GpmStatsCompare *compare;
+	GpmStatsCompareItem *item;
+	GpmStatsLive *live;
+	GpmGraph *graph = gpm_graph_widget_get_graph (GPM_GRAPH_WIDGET (graph_history));
+
+	gpm_stats_set_history_graph_axes (graph);
+
+	/* any request that is still running is out of date, and so is what
+	 * the graph is showing until the replies are in */
+	gpm_stats_cancel (&compare_cancellable);
+	compare_cancellable = g_cancellable_new ();
+	if (compare_items != NULL) {
+		g_ptr_array_unref (compare_items);
+		compare_items = NULL;
+	}
+
+	compare = g_new0 (GpmStatsCompare, 1);
+	compare->items = gpm_stats_compare_get_items ();
+	compare->cancellable = g_object_ref (compare_cancellable);
+
+	/* we already have the live data */
+	if (history_live || compare->items->len == 0) {
+		for (i=0; i<compare->items->len; i++) {
+			item = (GpmStatsCompareItem *) g_ptr_array_index (compare->items, i);
+			live = g_hash_table_lookup (live_data, item->object_path);
+			if (live == NULL)
+				continue;
+			gpm_stats_compare_item_set_live (item, live->pack[gpm_stats_get_live_kind ()]);
+		}
+		gpm_stats_compare_show (compare->items);
+		gpm_stats_compare_free (compare);
+		return;
+	}
+
+	for (i=0; i<compare->items->len; i++) {
+		item = (GpmStatsCompareItem *) g_ptr_array_index (compare->items, i);
+		gpm_stats_compare_fetch (compare, item);
+	}
+}
+
+/**
+ * gpm_stats_update_info_page_history_compare_device:
+ * @object_path: the device that changed
+ *
+ * Only gets the history of the device that changed, and shows it with what
+ * we already have for the other devices.
+ **/
+static void
+gpm_stats_update_info_page_history_compare_device (const gchar *object_path)
+{
+	guint i;
+	GpmStatsCompare *compare;
+	GpmStatsCompareItem *item = NULL;
+	GpmStatsLive *live;
+
+	for (i=0; compare_items != NULL && i<compare_items->len; i++) {
+		item = (GpmStatsCompareItem *) g_ptr_array_index (compare_items, i);
+		if (g_strcmp0 (item->object_path, object_path) == 0)
+			break;
+		item = NULL;
+	}
+
+	/* nothing has been shown yet, or it is being fetched again */
+	if (item == NULL) {
+		gpm_stats_update_info_page_history_compare ();
+		return;
+	}
+
+	/* we already have the live data */
+	if (history_live) {
+		if (item->pack != NULL) {
+			gpm_history_pack_free (item->pack);
+			item->pack = NULL;
+		}
+		live = g_hash_table_lookup (live_data, object_path);
+		if (live != NULL)
+			gpm_stats_compare_item_set_live (item, live->pack[gpm_stats_get_live_kind ()]);
+		gpm_stats_compare_show (compare_items);
+		return;
+	}
+
+	/* this is not newer than a change of another device, so don't
+	 * cancel the request for that */
+	if (compare_cancellable == NULL)
+		compare_cancellable = g_cancellable_new ();
+	compare = g_new0 (GpmStatsCompare, 1);
+	compare->items = g_ptr_array_ref (compare_items);
+	compare->cancellable = g_object_ref (compare_cancellable);
+	gpm_stats_compare_fetch (compare, item);
+}
+
+/**
+ * gpm_stats_show_history_data:
+ * @new: an array of GpmPointObj's, or %NULL if there is no history
+ **/
+static void
+gpm_stats_show_history_data (GPtrArray *new)
+{
+	GtkWidget *widget;
+	gboolean checked;
+	gboolean points;
+	GpmStatsSmoothJob *job;
+
+	gpm_stats_set_history_graph_axes (gpm_graph_widget_get_graph (GPM_GRAPH_WIDGET (graph_history)));
+
+	widget = GTK_WIDGET (gtk_builder_get_object (builder, "label_history_nodata"));
+	if (new == NULL) {
+		/* show no data label and hide graph */
+		gpm_stats_smooth_cancel (TRUE);
+		gtk_widget_hide (graph_history);
+		gtk_widget_show (widget);
+		goto out;
+	}
+
+	/* hide no data and show graph */
+	gtk_widget_hide (widget);
+	gtk_widget_show (graph_history);
+
+	/* render */
+	widget = GTK_WIDGET (gtk_builder_get_object (builder, "checkbutton_smooth_history"));
+	checked = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (widget));
+	widget = GTK_WIDGET (gtk_builder_get_object (builder, "checkbutton_points_history"));
+	points = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (widget));
+
+	/* present data to graph */
+	job = gpm_stats_smooth_job_new (gpm_graph_widget_get_graph (GPM_GRAPH_WIDGET (graph_history)),
+					TRUE, checked, points);
+	gpm_stats_smooth_job_add (job, new);
+	gpm_stats_smooth_job_run (job);
+out:
+	return;
+}
+
+/**
+ * gpm_stats_set_stats_graph_axes:
+ **/
+static void
+gpm_stats_set_stats_graph_axes (GpmGraph *graph, gboolean use_data, gboolean use_density)
+{
+	if (use_density) {
+		g_object_set (graph,
+			      "type-x", GPM_GRAPH_TYPE_PERCENTAGE,
+			      "type-y", GPM_GRAPH_TYPE_POWER,
+			      "autorange-x", TRUE,
+			      "autorange-y", TRUE,
+			      NULL);
+	} else if (use_data) {
+		g_object_set (graph,
+			      "type-x", GPM_GRAPH_TYPE_PERCENTAGE,
+			      "type-y", GPM_GRAPH_TYPE_FACTOR,
+			      "autorange-x", TRUE,
+			      "autorange-y", TRUE,
+			      NULL);
+	} else {
+		g_object_set (graph,
+			      "type-x", GPM_GRAPH_TYPE_PERCENTAGE,
+			      "type-y", GPM_GRAPH_TYPE_PERCENTAGE,
+			      "autorange-x", TRUE,
+			      "autorange-y", TRUE,
+			      NULL);
+	}
+}
+
+/**
+ * gpm_stats_get_stats_type:
+ * @use_data: set to %TRUE if the value is wanted rather than the accuracy
+ *
+ * Return value: the statistics type to ask UPower for, e.g. "charging"
+ **/
+static const gchar *
+gpm_stats_get_stats_type (gboolean *use_data)
+{
+	const gchar *type = NULL;
 
-	new = g_ptr_array_new_with_free_func ((GDestroyNotify) gpm_point_obj_free);
 	if (g_strcmp0 (stats_type, GPM_STATS_CHARGE_DATA_VALUE) == 0) {
 		type = "charging";
-		use_data = TRUE;
+		*use_data = TRUE;
 	} else if (g_strcmp0 (stats_type, GPM_STATS_DISCHARGE_DATA_VALUE) == 0) {
 		type = "discharging";
-		use_data = TRUE;
+		*use_data = TRUE;
 	} else if (g_strcmp0 (stats_type, GPM_STATS_CHARGE_ACCURACY_VALUE) == 0) {
 		type = "charging";
-		use_data = FALSE;
+		*use_data = FALSE;
 	} else if (g_strcmp0 (stats_type, GPM_STATS_DISCHARGE_ACCURACY_VALUE) == 0) {
 		type = "discharging";
-		use_data = FALSE;
+		*use_data = FALSE;
 	} else {
 		g_assert_not_reached ();
 	}
+	return type;
+}
+
+/**
+ * gpm_stats_get_stats_use_density:
+ * @use_data: from gpm_stats_get_stats_type()
+ *
+ * Return value: %TRUE if the profile should be shown as the density of
+ * every cycle in the history
+ **/
+static gboolean
+gpm_stats_get_stats_use_density (gboolean use_data)
+{
+	return use_data && g_settings_get_boolean (settings, GPM_SETTINGS_INFO_STATS_GRAPH_DENSITY);
+}
+
+/**
+ * gpm_stats_stats_items_to_data:
+ * @items: an array of UpStatsItem's
+ * @use_data: %TRUE if the value is wanted rather than the accuracy
+ *
+ * Return value: an array of GpmPointObj's
+ **/
+static GPtrArray *
+gpm_stats_stats_items_to_data (GPtrArray *items, gboolean use_data)
+{
+	guint i;
+	UpStatsItem *item;
+	GpmPointObj *point;
+	GPtrArray *new;
+
+	new = g_ptr_array_new_with_free_func ((GDestroyNotify) gpm_point_obj_free);
+	for (i=0; i<items->len; i++) {
+		item = (UpStatsItem *) g_ptr_array_index (items, i);
+		point = gpm_point_obj_new ();
+		point->x = i;
+		if (use_data)
+			point->y = up_stats_item_get_value (item);
+		else
+			point->y = up_stats_item_get_accuracy (item);
+		point->color = gpm_color_from_rgb (255, 0, 0);
+		g_ptr_array_add (new, point);
+	}
+	return new;
+}
+
+/**
+ * gpm_stats_get_stats_data:
+ * @type: The statistics type, e.g. "charging"
+ * @use_data: %TRUE if the value is wanted rather than the accuracy
+ *
+ * Return value: an array of GpmPointObj's, or %NULL if there are no statistics
+ **/
+static GPtrArray *
+gpm_stats_get_stats_data (UpDevice *device, const gchar *type, gboolean use_data)
+{
+	GPtrArray *array;
+	GPtrArray *new = NULL;
+	gint64 trace;
+
+	trace = gpm_trace_begin ();
+	array = up_device_get_statistics_sync (device, type, NULL, NULL);
+	gpm_trace_end (trace, "dbus", "GetStatistics");
+	if (array == NULL)
+		goto out;
+	new = gpm_stats_stats_items_to_data (array, use_data);
+	g_ptr_array_unref (array);
+out:
+	return new;
+}
+
+/* a charge in the history, as a float can't hold the time to the second */
+typedef struct {
+	guint			 time;
+	gfloat			 value;
+} GpmStatsDensitySample;
+
+/**
+ * gpm_stats_density_sample_sort_cb:
+ **/
+static gint
+gpm_stats_density_sample_sort_cb (gconstpointer a, gconstpointer b)
+{
+	const GpmStatsDensitySample *sample_a = (const GpmStatsDensitySample *) a;
+	const GpmStatsDensitySample *sample_b = (const GpmStatsDensitySample *) b;
+	if (sample_a->time < sample_b->time)
+		return -1;
+	if (sample_a->time > sample_b->time)
+		return 1;
+	return 0;
+}
+
+/**
+ * gpm_stats_density_items_to_data:
+ * @rates: an array of UpHistoryItem's for the rate, or %NULL
+ * @charges: an array of UpHistoryItem's for the charge, or %NULL
+ * @type: The statistics type, e.g. "charging"
+ *
+ * Pairs each rate in the history with the charge at that time, so every
+ * charge or discharge cycle becomes a line of rate against percentage.
+ * UPower only saves a value when it changes, so the charge is the last one
+ * saved at or before the rate.
+ *
+ * Return value: an array of GpmPointObj's, or %NULL if there is no history
+ **/
+static GPtrArray *
+gpm_stats_density_items_to_data (GPtrArray *rates, GPtrArray *charges, const gchar *type)
+{
+	GArray *charge = NULL;
+	GPtrArray *new = NULL;
+	UpHistoryItem *item;
+	UpDeviceState state;
+	GpmStatsDensitySample sample;
+	GpmPointObj *point;
+	guint lower, upper, mid;
+	guint i;
+
+	if (g_strcmp0 (type, "charging") == 0)
+		state = UP_DEVICE_STATE_CHARGING;
+	else
+		state = UP_DEVICE_STATE_DISCHARGING;
+
+	if (rates == NULL || charges == NULL || charges->len == 0)
+		goto out;
+
+	/* the charge by time, so each rate can find its charge */
+	charge = g_array_sized_new (FALSE, FALSE, sizeof (GpmStatsDensitySample), charges->len);
+	for (i=0; i<charges->len; i++) {
+		item = (UpHistoryItem *) g_ptr_array_index (charges, i);
+		sample.time = up_history_item_get_time (item);
+		sample.value = up_history_item_get_value (item);
+		g_array_append_val (charge, sample);
+	}
+	g_array_sort (charge, gpm_stats_density_sample_sort_cb);
+
+	new = g_ptr_array_new_with_free_func ((GDestroyNotify) gpm_point_obj_free);
+	for (i=0; i<rates->len; i++) {
+		item = (UpHistoryItem *) g_ptr_array_index (rates, i);
+		if (up_history_item_get_state (item) != state)
+			continue;
+
+		/* the last charge at or before the rate */
+		lower = 0;
+		upper = charge->len;
+		while (lower < upper) {
+			mid = (lower + upper) / 2;
+			if (g_array_index (charge, GpmStatsDensitySample, mid).time <= up_history_item_get_time (item))
+				lower = mid + 1;
+			else
+				upper = mid;
+		}
+		if (lower == 0)
+			continue;
+
+		point = gpm_point_obj_new ();
+		point->x = g_array_index (charge, GpmStatsDensitySample, lower - 1).value;
+		point->y = up_history_item_get_value (item);
+		point->color = gpm_stats_state_to_color (state, TRUE);
+		g_ptr_array_add (new, point);
+	}
+	if (new->len == 0) {
+		g_ptr_array_unref (new);
+		new = NULL;
+	}
+out:
+	if (charge != NULL)
+		g_array_unref (charge);
+	return new;
+}
+
+/**
+ * gpm_stats_get_density_data:
+ * @type: The statistics type, e.g. "charging"
+ * @timespec: How far back to go, in seconds
+ *
+ * Return value: an array of GpmPointObj's, or %NULL if there is no history
+ **/
+static GPtrArray *
+gpm_stats_get_density_data (UpDevice *device, const gchar *type, guint timespec)
+{
+	GPtrArray *rates;
+	GPtrArray *charges;
+	GPtrArray *new;
+	gint64 trace;
+
+	trace = gpm_trace_begin ();
+	rates = up_device_get_history_sync (device, GPM_HISTORY_RATE_VALUE, timespec,
+					    GPM_STATS_DENSITY_RESOLUTION, NULL, NULL);
+	charges = up_device_get_history_sync (device, GPM_HISTORY_CHARGE_VALUE, timespec,
+					      GPM_STATS_DENSITY_RESOLUTION, NULL, NULL);
+	gpm_trace_end (trace, "dbus", "GetHistory");
+	new = gpm_stats_density_items_to_data (rates, charges, type);
+	if (rates != NULL)
+		g_ptr_array_unref (rates);
+	if (charges != NULL)
+		g_ptr_array_unref (charges);
+	return new;
+}
+
+/**
+ * gpm_stats_show_stats_data:
+ * @new: an array of GpmPointObj's, or %NULL if there are no statistics
+ **/
+static void
+gpm_stats_show_stats_data (GPtrArray *new, gboolean use_data, gboolean use_density)
+{
+	GtkWidget *widget;
+	gboolean checked;
+	gboolean points;
+	GpmStatsSmoothJob *job;
 
-	if (use_data) {
-		g_object_set (graph_statistics,
-			      "type-x", GPM_GRAPH_WIDGET_TYPE_PERCENTAGE,
-			      "type-y", GPM_GRAPH_WIDGET_TYPE_FACTOR,
-			      "autorange-x", TRUE,
-			      "autorange-y", TRUE,
-			      NULL);
-	} else {
-		g_object_set (graph_statistics,
-			      "type-x", GPM_GRAPH_WIDGET_TYPE_PERCENTAGE,
-			      "type-y", GPM_GRAPH_WIDGET_TYPE_PERCENTAGE,
-			      "autorange-x", TRUE,
-			      "autorange-y", TRUE,
-			      NULL);
-	}
+	gpm_stats_set_stats_graph_axes (gpm_graph_widget_get_graph (GPM_GRAPH_WIDGET (graph_statistics)),
+					use_data, use_density);
 
 	widget = GTK_WIDGET (gtk_builder_get_object (builder, "label_stats_nodata"));
-	array = up_device_get_statistics_sync (device, type, NULL, NULL);
-	if (array == NULL) {
+	if (new == NULL) {
 		/* show no data label and hide graph */
+		gpm_stats_smooth_cancel (FALSE);
 		gtk_widget_hide (graph_statistics);
 		gtk_widget_show (widget);
 		goto out;
@@ -997,34 +2607,206 @@ gpm_stats_update_info_page_stats (UpDevice *device)
 	gtk_widget_hide (widget);
 	gtk_widget_show (graph_statistics);
 
-	for (i=0; i<array->len; i++) {
-		item = (UpStatsItem *) g_ptr_array_index (array, i);
-		point = gpm_point_obj_new ();
-		point->x = i;
-		if (use_data)
-			point->y = up_stats_item_get_value (item);
-		else
-			point->y = up_stats_item_get_accuracy (item);
-		point->color = gpm_color_from_rgb (255, 0, 0);
-		g_ptr_array_add (new, point);
-	}
-
 	/* render */
-	sigma_smoothing = 1.1;
 	widget = GTK_WIDGET (gtk_builder_get_object (builder, "checkbutton_smooth_stats"));
 	checked = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (widget));
 	widget = GTK_WIDGET (gtk_builder_get_object (builder, "checkbutton_points_stats"));
 	points = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (widget));
 
 	/* present data to graph */
-	gpm_stats_set_graph_data (graph_statistics, new, checked, points);
-
-	g_ptr_array_unref (array);
-	g_ptr_array_unref (new);
+	job = gpm_stats_smooth_job_new (gpm_graph_widget_get_graph (GPM_GRAPH_WIDGET (graph_statistics)),
+					FALSE, checked, points);
+	job->use_density = use_density;
+	gpm_stats_smooth_job_add (job, new);
+	gpm_stats_smooth_job_run (job);
 out:
 	return;
 }
 
+/**
+ * gpm_stats_fetch_free:
+ **/
+static void
+gpm_stats_fetch_free (GpmStatsFetch *fetch)
+{
+	guint i;
+
+	for (i=0; i<G_N_ELEMENTS (fetch->items); i++) {
+		if (fetch->items[i] != NULL)
+			g_ptr_array_unref (fetch->items[i]);
+	}
+	g_object_unref (fetch->cancellable);
+	g_free (fetch->object_path);
+	g_free (fetch->type);
+	g_free (fetch);
+}
+
+/**
+ * gpm_stats_fetch_done:
+ *
+ * Draws the page once all the replies are in.
+ **/
+static void
+gpm_stats_fetch_done (GpmStatsFetch *fetch)
+{
+	GPtrArray *data = NULL;
+
+	/* a newer request has been started */
+	if (g_cancellable_is_cancelled (fetch->cancellable))
+		return;
+
+	if (fetch->kind == GPM_STATS_FETCH_HISTORY) {
+		if (fetch->items[0] != NULL)
+			data = gpm_stats_history_items_to_data (fetch->items[0], fetch->type);
+		gpm_stats_show_history_data (data);
+	} else {
+		if (fetch->use_density)
+			data = gpm_stats_density_items_to_data (fetch->items[0], fetch->items[1], fetch->type);
+		else if (fetch->items[0] != NULL)
+			data = gpm_stats_stats_items_to_data (fetch->items[0], fetch->use_data);
+		gpm_stats_show_stats_data (data, fetch->use_data, fetch->use_density);
+	}
+	if (data != NULL)
+		g_ptr_array_unref (data);
+}
+
+/**
+ * gpm_stats_fetch_reply_cb:
+ **/
+static void
+gpm_stats_fetch_reply_cb (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+	GError *error = NULL;
+	GPtrArray *items;
+	GpmStatsFetchReply *reply = (GpmStatsFetchReply *) user_data;
+	GpmStatsFetch *fetch = reply->fetch;
+
+	if (fetch->kind == GPM_STATS_FETCH_STATS && !fetch->use_density)
+		items = gpm_stats_get_statistics_finish (res, &error);
+	else
+		items = gpm_stats_get_history_finish (res, &error);
+	if (items == NULL) {
+		if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+			g_warning ("failed to get data for %s: %s", fetch->object_path, error->message);
+		g_error_free (error);
+	}
+	fetch->items[reply->index] = items;
+	g_free (reply);
+
+	if (--fetch->pending > 0)
+		return;
+	gpm_stats_fetch_done (fetch);
+	gpm_stats_fetch_free (fetch);
+}
+
+/**
+ * gpm_stats_fetch_reply_new:
+ * @index: where to keep the reply in @fetch
+ **/
+static GpmStatsFetchReply *
+gpm_stats_fetch_reply_new (GpmStatsFetch *fetch, guint index)
+{
+	GpmStatsFetchReply *reply;
+
+	reply = g_new0 (GpmStatsFetchReply, 1);
+	reply->fetch = fetch;
+	reply->index = index;
+	fetch->pending++;
+	return reply;
+}
+
+/**
+ * gpm_stats_fetch_start:
+ *
+ * Asks upowerd for the data for a page without waiting, so the history and
+ * statistics are fetched at the same time without blocking the window.
+ **/
+static void
+gpm_stats_fetch_start (GpmStatsFetchKind kind, const gchar *object_path)
+{
+	GCancellable **cancellable;
+	GpmStatsFetch *fetch;
+
+	fetch = g_new0 (GpmStatsFetch, 1);
+	fetch->kind = kind;
+	fetch->object_path = g_strdup (object_path);
+	if (kind == GPM_STATS_FETCH_HISTORY) {
+		fetch->type = g_strdup (history_type);
+		fetch->timespec = history_time;
+		cancellable = &history_cancellable;
+	} else {
+		fetch->type = g_strdup (gpm_stats_get_stats_type (&fetch->use_data));
+		fetch->use_density = gpm_stats_get_stats_use_density (fetch->use_data);
+		fetch->timespec = GPM_STATS_DENSITY_TIME;
+		cancellable = &stats_cancellable;
+	}
+
+	/* only the newest request is shown */
+	gpm_stats_cancel (cancellable);
+	*cancellable = g_cancellable_new ();
+	fetch->cancellable = g_object_ref (*cancellable);
+
+	if (kind == GPM_STATS_FETCH_HISTORY) {
+		/* upowerd does not keep this, it's only available live */
+		if (g_strcmp0 (fetch->type, GPM_HISTORY_VOLTAGE_VALUE) == 0) {
+			gpm_stats_fetch_done (fetch);
+			gpm_stats_fetch_free (fetch);
+			return;
+		}
+		gpm_stats_get_history_async (object_path, fetch->type, fetch->timespec,
+					     GPM_HISTORY_RESOLUTION, fetch->cancellable,
+					     gpm_stats_fetch_reply_cb,
+					     gpm_stats_fetch_reply_new (fetch, 0));
+		return;
+	}
+
+	/* the rate and the charge at the same time */
+	if (fetch->use_density) {
+		gpm_stats_get_history_async (object_path, GPM_HISTORY_RATE_VALUE, fetch->timespec,
+					     GPM_STATS_DENSITY_RESOLUTION, fetch->cancellable,
+					     gpm_stats_fetch_reply_cb,
+					     gpm_stats_fetch_reply_new (fetch, 0));
+		gpm_stats_get_history_async (object_path, GPM_HISTORY_CHARGE_VALUE, fetch->timespec,
+					     GPM_STATS_DENSITY_RESOLUTION, fetch->cancellable,
+					     gpm_stats_fetch_reply_cb,
+					     gpm_stats_fetch_reply_new (fetch, 1));
+		return;
+	}
+	gpm_stats_get_statistics_async (object_path, fetch->type, fetch->cancellable,
+					gpm_stats_fetch_reply_cb,
+					gpm_stats_fetch_reply_new (fetch, 0));
+}
+
+/**
+ * gpm_stats_update_info_page_history:
+ **/
+static void
+gpm_stats_update_info_page_history (UpDevice *device)
+{
+	/* only the newest request is shown */
+	if (history_compare) {
+		gpm_stats_cancel (&history_cancellable);
+		gpm_stats_update_info_page_history_compare ();
+		return;
+	}
+	gpm_stats_cancel (&compare_cancellable);
+	if (history_live) {
+		gpm_stats_cancel (&history_cancellable);
+		gpm_stats_update_info_page_history_live (device);
+		return;
+	}
+	gpm_stats_fetch_start (GPM_STATS_FETCH_HISTORY, gpm_stats_device_get_object_path (device));
+}
+
+/**
+ * gpm_stats_update_info_page_stats:
+ **/
+static void
+gpm_stats_update_info_page_stats (UpDevice *device)
+{
+	gpm_stats_fetch_start (GPM_STATS_FETCH_STATS, gpm_stats_device_get_object_path (device));
+}
+
 /**
  * gpm_stats_update_info_data_page:
  **/
@@ -1045,7 +2827,6 @@ gpm_stats_update_info_data_page (UpDevice *device, gint page)
 static void
 gpm_stats_update_info_data (UpDevice *device)
 {
-	gint page;
 	GtkNotebook *notebook;
 	GtkWidget *page_widget;
 	gboolean has_history;
@@ -1081,10 +2862,12 @@ gpm_stats_update_info_data (UpDevice *device)
 	page_widget = gtk_notebook_get_nth_page (notebook, 3);
 	gtk_widget_hide (page_widget);
 
-	page = gtk_notebook_get_current_page (notebook);
-	gpm_stats_update_info_data_page (device, page);
-
-	return;
+	/* the details are already here, and the graphs are fetched together */
+	gpm_stats_update_info_page_details (device);
+	if (has_history)
+		gpm_stats_update_info_page_history (device);
+	if (has_statistics)
+		gpm_stats_update_info_page_stats (device);
 }
 
 /**
@@ -1311,6 +3094,7 @@ gpm_stats_update_wakeups_data (void)
 	gchar *text;
 	guint i;
 	GError *error = NULL;
+	gint64 trace;
 	GPtrArray *array;
 
 	widget = GTK_WIDGET (gtk_builder_get_object (builder, "notebook1"));
@@ -1328,7 +3112,9 @@ gpm_stats_update_wakeups_data (void)
 	gtk_widget_show (page_widget);
 
 	/* show total */
+	trace = gpm_trace_begin ();
 	total = up_wakeups_get_total_sync (wakeups, NULL, &error);
+	gpm_trace_end (trace, "dbus", "GetTotal");
 	widget = GTK_WIDGET (gtk_builder_get_object (builder, "label_total_wakeups"));
 	if (error == NULL) {
 		text = g_strdup_printf ("%i", total);
@@ -1341,7 +3127,9 @@ gpm_stats_update_wakeups_data (void)
 
 	/* get data */
 	gtk_list_store_clear (list_store_wakeups);
+	trace = gpm_trace_begin ();
 	array = up_wakeups_get_data_sync (wakeups, NULL, NULL);
+	gpm_trace_end (trace, "dbus", "GetData");
 	if (array == NULL)
 		return;
 	for (i=0; i<array->len; i++) {
@@ -1394,11 +3182,10 @@ gpm_stats_notebook_changed_cb (GtkNotebook *notebook, gpointer page, gint page_n
 	if (g_strcmp0 (current_device, "wakeups") == 0)
 		return;
 
-	device = up_device_new ();
-	up_device_set_object_path_sync (device, current_device, NULL, NULL);
-	gpm_stats_update_info_data_page (device, page_num);
-	gpm_stats_update_info_data (device);
-	g_object_unref (device);
+	/* the page already has data, but it may be out of date */
+	device = g_hash_table_lookup (device_table, current_device);
+	if (device != NULL)
+		gpm_stats_update_info_data_page (device, page_num);
 }
 
 /**
@@ -1407,11 +3194,18 @@ gpm_stats_notebook_changed_cb (GtkNotebook *notebook, gpointer page, gint page_n
 static void
 gpm_stats_button_update_ui (void)
 {
+	GtkNotebook *notebook;
 	UpDevice *device;
-	device = up_device_new ();
-	up_device_set_object_path_sync (device, current_device, NULL, NULL);
-	gpm_stats_update_info_data (device);
-	g_object_unref (device);
+
+	/* we've not got any devices yet */
+	if (current_device == NULL || g_strcmp0 (current_device, "wakeups") == 0)
+		return;
+
+	device = g_hash_table_lookup (device_table, current_device);
+	if (device == NULL)
+		return;
+	notebook = GTK_NOTEBOOK (gtk_builder_get_object (builder, "notebook1"));
+	gpm_stats_update_info_data_page (device, gtk_notebook_get_current_page (notebook));
 }
 
 /**
@@ -1420,12 +3214,25 @@ gpm_stats_button_update_ui (void)
 static void
 gpm_stats_devices_treeview_clicked_cb (GtkTreeSelection *selection, gpointer user_data)
 {
+	gboolean ret;
 	GtkTreeModel *model;
 	GtkTreeIter iter;
+	GtkTreePath *path;
+	GtkTreeView *treeview;
 	UpDevice *device;
 
-	/* This will only work in single or browse selection mode! */
-	if (gtk_tree_selection_get_selected (selection, &model, &iter)) {
+	/* when comparing the other pages show the row with the focus */
+	if (history_compare) {
+		treeview = gtk_tree_selection_get_tree_view (selection);
+		model = gtk_tree_view_get_model (treeview);
+		gtk_tree_view_get_cursor (treeview, &path, NULL);
+		ret = path != NULL && gtk_tree_model_get_iter (model, &iter, path);
+		gtk_tree_path_free (path);
+	} else {
+		/* This will only work in single or browse selection mode! */
+		ret = gtk_tree_selection_get_selected (selection, &model, &iter);
+	}
+	if (ret) {
 		g_free (current_device);
 		gtk_tree_model_get (model, &iter, GPM_DEVICES_COLUMN_ID, &current_device, -1);
 
@@ -1435,14 +3242,17 @@ gpm_stats_devices_treeview_clicked_cb (GtkTreeSelection *selection, gpointer use
 		/* show transaction_id */
 		g_debug ("selected row is: %s", current_device);
 
+		/* the zoom is for the old device */
+		gpm_graph_widget_viewport_reset (GPM_GRAPH_WIDGET (graph_history));
+
 		/* is special device */
 		if (g_strcmp0 (current_device, "wakeups") == 0) {
 			gpm_stats_update_wakeups_data ();
 		} else {
-			device = up_device_new ();
-			up_device_set_object_path_sync (device, current_device, NULL, NULL);
-			gpm_stats_update_info_data (device);
-			g_object_unref (device);
+			/* the properties are kept up to date, so don't ask again */
+			device = g_hash_table_lookup (device_table, current_device);
+			if (device != NULL)
+				gpm_stats_update_info_data (device);
 		}
 
 	} else {
@@ -1467,8 +3277,11 @@ gpm_stats_add_device (UpDevice *device)
 		      "kind", &kind,
 		      NULL);
 
-	id = up_device_get_object_path (device);
+	id = gpm_stats_device_get_object_path (device);
 	text = gpm_device_kind_to_localised_string (kind, 1);
+
+	/* so the live graph has a point to start from */
+	gpm_stats_live_capture (device);
 	icon = gpm_stats_get_device_icon (device, FALSE);
 
 	gtk_list_store_append (list_store_devices, &iter);
@@ -1490,45 +3303,69 @@ gpm_stats_data_changed_cb (UpClient *client, gpointer user_data)
 }
 
 /**
- * gpm_stats_device_added_cb:
+ * gpm_stats_device_added:
  **/
 static void
-gpm_stats_device_added_cb (UpClient *client, UpDevice *device, gpointer user_data)
+gpm_stats_device_added (UpDevice *device)
 {
 	const gchar *object_path;
-	object_path = up_device_get_object_path (device);
+	object_path = gpm_stats_device_get_object_path (device);
 	g_debug ("added:     %s", object_path);
 	gpm_stats_add_device (device);
 }
 
 /**
- * gpm_stats_device_changed_cb:
+ * gpm_stats_device_changed:
  **/
 static void
-gpm_stats_device_changed_cb (UpClient *client, UpDevice *device, gpointer user_data)
+gpm_stats_device_changed (UpDevice *device)
 {
 	const gchar *object_path;
-	object_path = up_device_get_object_path (device);
+	GpmPointObj point;
+	GpmStatsLive *live;
+	GtkNotebook *notebook;
+
+	/* save for the live graph, even if we're not looking at it */
+	live = gpm_stats_live_capture (device);
+
+	object_path = gpm_stats_device_get_object_path (device);
 	if (object_path == NULL || current_device == NULL)
 		return;
 	g_debug ("changed:   %s", object_path);
-	if (g_strcmp0 (current_device, object_path) == 0)
-		gpm_stats_update_info_data (device);
+
+	/* any of the devices being compared */
+	notebook = GTK_NOTEBOOK (gtk_builder_get_object (builder, "notebook1"));
+	if (history_compare && gtk_notebook_get_current_page (notebook) == 1) {
+		if (gpm_stats_compare_is_selected (object_path))
+			gpm_stats_update_info_page_history_compare_device (object_path);
+		return;
+	}
+	if (g_strcmp0 (current_device, object_path) != 0)
+		return;
+
+	/* just add the new point to the end of the live graph */
+	if (history_live && live != NULL && gtk_notebook_get_current_page (notebook) == 1) {
+		gpm_history_pack_get_last (live->pack[gpm_stats_get_live_kind ()], &point);
+		gpm_graph_append (gpm_graph_widget_get_graph (GPM_GRAPH_WIDGET (graph_history)), 0,
+				  point.x, point.y, point.color);
+		return;
+	}
+	gpm_stats_update_info_data_page (device, gtk_notebook_get_current_page (notebook));
 }
 
 /**
- * gpm_stats_device_removed_cb:
+ * gpm_stats_device_removed:
  **/
 static void
-gpm_stats_device_removed_cb (UpClient *client, UpDevice *device, gpointer user_data)
+gpm_stats_device_removed (const gchar *object_path)
 {
-	const gchar *object_path;
 	GtkTreeIter iter;
 	gchar *id = NULL;
 	gboolean ret;
 
-	object_path = up_device_get_object_path (device);
 	g_debug ("removed:   %s", object_path);
+	g_hash_table_remove (device_table, object_path);
+	g_hash_table_remove (live_data, object_path);
 	if (g_strcmp0 (current_device, object_path) == 0) {
 		gtk_list_store_clear (list_store_info);
 	}
@@ -1546,6 +3383,191 @@ gpm_stats_device_removed_cb (UpClient *client, UpDevice *device, gpointer user_d
 	};
 }
 
+/**
+ * gpm_stats_device_new_from_properties:
+ * @properties: the reply to GetAll
+ *
+ * Makes a device like up_device_set_object_path_sync() does, but from
+ * properties we already have. The D-Bus names are the property names in
+ * CamelCase, apart from the kind, which is called "Type".
+ **/
+static UpDevice *
+gpm_stats_device_new_from_properties (const gchar *object_path, GVariant *properties)
+{
+	const gchar *key;
+	guint i;
+	GObjectClass *klass;
+	GParamSpec *pspec;
+	GString *name;
+	GValue value = G_VALUE_INIT;
+	GVariant *variant;
+	GVariantIter *iter;
+	UpDevice *device;
+
+	device = up_device_new ();
+	g_object_set_data_full (G_OBJECT (device), "gpm-object-path",
+				g_strdup (object_path), g_free);
+	klass = G_OBJECT_GET_CLASS (device);
+	name = g_string_new (NULL);
+	g_variant_get (properties, "(a{sv})", &iter);
+	while (g_variant_iter_next (iter, "{&sv}", &key, &variant)) {
+		/* e.g. "EnergyFullDesign" is "energy-full-design" */
+		g_string_truncate (name, 0);
+		if (g_strcmp0 (key, "Type") == 0) {
+			g_string_append (name, "kind");
+		} else {
+			for (i=0; key[i] != '\0'; i++) {
+				if (i > 0 && g_ascii_isupper (key[i]))
+					g_string_append_c (name, '-');
+				g_string_append_c (name, g_ascii_tolower (key[i]));
+			}
+		}
+
+		/* a newer upowerd can have properties we don't know about */
+		pspec = g_object_class_find_property (klass, name->str);
+		if (pspec != NULL && (pspec->flags & G_PARAM_WRITABLE) != 0) {
+			g_dbus_gvariant_to_gvalue (variant, &value);
+			g_object_set_property (G_OBJECT (device), name->str, &value);
+			g_value_unset (&value);
+		}
+		g_variant_unref (variant);
+	}
+	g_variant_iter_free (iter);
+	g_string_free (name, TRUE);
+	return device;
+}
+
+/* why we are asking for the properties of a device */
+typedef enum {
+	GPM_STATS_DEVICE_COLDPLUG,
+	GPM_STATS_DEVICE_ADDED,
+	GPM_STATS_DEVICE_CHANGED
+} GpmStatsDeviceEvent;
+
+typedef struct {
+	GpmStatsDeviceEvent	 event;
+	gchar			*object_path;
+} GpmStatsDeviceFetch;
+
+static void	gpm_stats_coldplug_done (void);
+
+/**
+ * gpm_stats_device_fetch_cb:
+ **/
+static void
+gpm_stats_device_fetch_cb (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+	gboolean is_new;
+	GError *error = NULL;
+	GpmStatsDeviceFetch *fetch = (GpmStatsDeviceFetch *) user_data;
+	GVariant *reply;
+	UpDevice *device = NULL;
+
+	reply = g_task_propagate_pointer (G_TASK (res), &error);
+	if (reply == NULL) {
+		g_warning ("failed to get %s: %s", fetch->object_path, error->message);
+		g_error_free (error);
+		goto out;
+	}
+	device = gpm_stats_device_new_from_properties (fetch->object_path, reply);
+	g_variant_unref (reply);
+
+	/* it was removed while we were waiting, or we don't know it yet */
+	is_new = g_hash_table_lookup (device_table, fetch->object_path) == NULL;
+	if (fetch->event == GPM_STATS_DEVICE_CHANGED && is_new)
+		goto out;
+	g_hash_table_insert (device_table, g_strdup (fetch->object_path), g_object_ref (device));
+
+	/* the coldplug adds all the devices in one go */
+	if (!coldplug_done)
+		goto out;
+	if (fetch->event == GPM_STATS_DEVICE_CHANGED)
+		gpm_stats_device_changed (device);
+	else if (is_new)
+		gpm_stats_device_added (device);
+out:
+	if (fetch->event == GPM_STATS_DEVICE_COLDPLUG && --coldplug_pending == 0)
+		gpm_stats_coldplug_done ();
+	if (device != NULL)
+		g_object_unref (device);
+	g_free (fetch->object_path);
+	g_free (fetch);
+}
+
+/**
+ * gpm_stats_device_fetch:
+ *
+ * Gets all the properties of the device in one call without waiting for
+ * the reply, which is what upower-glib does in SetObjectPath.
+ **/
+static void
+gpm_stats_device_fetch (const gchar *object_path, GpmStatsDeviceEvent event)
+{
+	GpmStatsDeviceFetch *fetch;
+
+	fetch = g_new0 (GpmStatsDeviceFetch, 1);
+	fetch->event = event;
+	fetch->object_path = g_strdup (object_path);
+	gpm_stats_dbus_call (object_path, GPM_STATS_PROPERTIES_INTERFACE, "GetAll",
+			     g_variant_new ("(s)", GPM_STATS_UPOWER_DEVICE_INTERFACE),
+			     G_VARIANT_TYPE ("(a{sv})"), NULL,
+			     gpm_stats_device_fetch_cb, fetch);
+}
+
+/**
+ * gpm_stats_upower_signal_cb:
+ *
+ * The devices upowerd adds, removes and changes, like UpClient would tell
+ * us, but without a blocking call to get the properties.
+ **/
+static void
+gpm_stats_upower_signal_cb (GDBusConnection *bus, const gchar *sender_name,
+			    const gchar *object_path, const gchar *interface_name,
+			    const gchar *signal_name, GVariant *parameters,
+			    gpointer user_data)
+{
+	const gchar *device_path;
+
+	/* not about a device */
+	if (!g_variant_is_of_type (parameters, G_VARIANT_TYPE ("(o)")))
+		return;
+	g_variant_get (parameters, "(&o)", &device_path);
+	if (g_strcmp0 (signal_name, "DeviceAdded") == 0)
+		gpm_stats_device_fetch (device_path, GPM_STATS_DEVICE_ADDED);
+	else if (g_strcmp0 (signal_name, "DeviceChanged") == 0)
+		gpm_stats_device_fetch (device_path, GPM_STATS_DEVICE_CHANGED);
+	else if (g_strcmp0 (signal_name, "DeviceRemoved") == 0)
+		gpm_stats_device_removed (device_path);
+}
+
+/**
+ * gpm_stats_get_saved_history_type:
+ *
+ * The voltage is only kept for the live range so it is never saved, but an
+ * older version may have saved it, or the setting may have been edited.
+ *
+ * Return value: the saved history type, or the charge if it is not one of
+ * the types UPower keeps
+ **/
+static const gchar *
+gpm_stats_get_saved_history_type (void)
+{
+	const gchar *type = GPM_HISTORY_CHARGE_VALUE;
+	gchar *value;
+
+	value = g_settings_get_string (settings, GPM_SETTINGS_INFO_HISTORY_TYPE);
+	if (g_strcmp0 (value, GPM_HISTORY_RATE_VALUE) == 0)
+		type = GPM_HISTORY_RATE_VALUE;
+	else if (g_strcmp0 (value, GPM_HISTORY_TIME_FULL_VALUE) == 0)
+		type = GPM_HISTORY_TIME_FULL_VALUE;
+	else if (g_strcmp0 (value, GPM_HISTORY_TIME_EMPTY_VALUE) == 0)
+		type = GPM_HISTORY_TIME_EMPTY_VALUE;
+	else if (g_strcmp0 (value, GPM_HISTORY_CHARGE_VALUE) != 0)
+		g_debug ("using the charge rather than the saved history type '%s'", value);
+	g_free (value);
+	return type;
+}
+
 /**
  * gpm_stats_history_type_combo_changed_cb:
  **/
@@ -1580,6 +3602,12 @@ gpm_stats_history_type_combo_changed_cb (GtkWidget *widget, gpointer data)
 		axis_x = _("Time elapsed");
 		/* TRANSLATORS: this is the Y axis on the graph */
 		axis_y = _("Predicted time");
+	} else if (g_strcmp0 (value, GPM_HISTORY_VOLTAGE_TEXT) == 0) {
+		history_type = GPM_HISTORY_VOLTAGE_VALUE;
+		/* TRANSLATORS: this is the X axis on the graph */
+		axis_x = _("Time elapsed");
+		/* TRANSLATORS: this is the Y axis on the graph */
+		axis_y = _("Voltage");
 	} else {
 		g_assert (FALSE);
 	}
@@ -1590,11 +3618,13 @@ gpm_stats_history_type_combo_changed_cb (GtkWidget *widget, gpointer data)
 	widget = GTK_WIDGET (gtk_builder_get_object (builder, "label_axis_history_y"));
 	gtk_label_set_label (GTK_LABEL(widget), axis_y);
 
+	gpm_graph_widget_viewport_reset (GPM_GRAPH_WIDGET (graph_history));
 	gpm_stats_button_update_ui ();
 	g_free (value);
 
-	/* save to gconf */
-	g_settings_set_string (settings, GPM_SETTINGS_INFO_HISTORY_TYPE, history_type);
+	/* save to gconf, apart from the voltage as there is none when we next start */
+	if (g_strcmp0 (history_type, GPM_HISTORY_VOLTAGE_VALUE) != 0)
+		g_settings_set_string (settings, GPM_SETTINGS_INFO_HISTORY_TYPE, history_type);
 }
 
 /**
@@ -1648,6 +3678,32 @@ gpm_stats_type_combo_changed_cb (GtkWidget *widget, gpointer data)
 	g_settings_set_string (settings, GPM_SETTINGS_INFO_STATS_TYPE, stats_type);
 }
 
+/**
+ * gpm_stats_update_history_types:
+ *
+ * UPower does not keep the voltage, so it's only offered for the live
+ * history, which is always the last in the list.
+ **/
+static void
+gpm_stats_update_history_types (void)
+{
+	GtkWidget *widget;
+	GtkTreeModel *model;
+	gint n_types;
+
+	widget = GTK_WIDGET (gtk_builder_get_object (builder, "combobox_history_type"));
+	model = gtk_combo_box_get_model (GTK_COMBO_BOX (widget));
+	n_types = gtk_tree_model_iter_n_children (model, NULL);
+	if (history_live && n_types == GPM_HISTORY_VOLTAGE_INDEX) {
+		gtk_combo_box_text_append_text (GTK_COMBO_BOX_TEXT (widget), GPM_HISTORY_VOLTAGE_TEXT);
+	} else if (!history_live && n_types > GPM_HISTORY_VOLTAGE_INDEX) {
+		/* there would be nothing to show */
+		if (gtk_combo_box_get_active (GTK_COMBO_BOX (widget)) == GPM_HISTORY_VOLTAGE_INDEX)
+			gtk_combo_box_set_active (GTK_COMBO_BOX (widget), GPM_HISTORY_CHARGE_INDEX);
+		gtk_combo_box_text_remove (GTK_COMBO_BOX_TEXT (widget), GPM_HISTORY_VOLTAGE_INDEX);
+	}
+}
+
 /**
  * gpm_stats_range_combo_changed:
  **/
@@ -1656,6 +3712,18 @@ gpm_stats_range_combo_changed (GtkWidget *widget, gpointer data)
 {
 	gchar *value;
 	value = gtk_combo_box_text_get_active_text (GTK_COMBO_BOX_TEXT (widget));
+
+	gpm_graph_widget_viewport_reset (GPM_GRAPH_WIDGET (graph_history));
+
+	/* this is not saved, as there is no data when we next start */
+	history_live = (g_strcmp0 (value, GPM_HISTORY_LIVE_TEXT) == 0);
+	if (history_live) {
+		gpm_stats_update_history_types ();
+		gpm_stats_button_update_ui ();
+		g_free (value);
+		return;
+	}
+
 	if (g_strcmp0 (value, GPM_HISTORY_MINUTE_TEXT) == 0)
 		history_time = GPM_HISTORY_MINUTE_VALUE;
 	else if (g_strcmp0 (value, GPM_HISTORY_HOUR_TEXT) == 0)
@@ -1671,47 +3739,97 @@ gpm_stats_range_combo_changed (GtkWidget *widget, gpointer data)
 
 	/* save to gconf */
 	g_settings_set_int (settings, GPM_SETTINGS_INFO_HISTORY_TIME, history_time);
+	gpm_stats_update_history_types ();
+
+	/* move to the new range with the data we have, and the new data
+	 * is shown when it has been fetched */
+	gpm_stats_set_history_graph_axes (gpm_graph_widget_get_graph (GPM_GRAPH_WIDGET (graph_history)));
+
+	gpm_stats_button_update_ui ();
+	g_free (value);
+}
+
+/**
+ * gpm_stats_smooth_checkbox_history_cb:
+ * @widget: The GtkWidget object
+ **/
+static void
+gpm_stats_smooth_checkbox_history_cb (GtkWidget *widget, gpointer data)
+{
+	gboolean checked;
+	checked = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (widget));
+	g_settings_set_boolean (settings, GPM_SETTINGS_INFO_HISTORY_GRAPH_SMOOTH, checked);
+	gpm_stats_button_update_ui ();
+}
 
+/**
+ * gpm_stats_smooth_checkbox_stats_cb:
+ * @widget: The GtkWidget object
+ **/
+static void
+gpm_stats_smooth_checkbox_stats_cb (GtkWidget *widget, gpointer data)
+{
+	gboolean checked;
+	checked = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (widget));
+	g_settings_set_boolean (settings, GPM_SETTINGS_INFO_STATS_GRAPH_SMOOTH, checked);
+	gpm_stats_button_update_ui ();
+}
+
+/**
+ * gpm_stats_median_changed_cb:
+ **/
+static void
+gpm_stats_median_changed_cb (GSettings *gsettings, const gchar *key, gpointer user_data)
+{
+	/* the pipelines are set up again by the worker */
 	gpm_stats_button_update_ui ();
-	g_free (value);
 }
 
 /**
- * gpm_stats_smooth_checkbox_history_cb:
- * @widget: The GtkWidget object
+ * gpm_stats_density_changed_cb:
  **/
 static void
-gpm_stats_smooth_checkbox_history_cb (GtkWidget *widget, gpointer data)
+gpm_stats_density_changed_cb (GSettings *gsettings, const gchar *key, gpointer user_data)
 {
-	gboolean checked;
-	checked = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (widget));
-	g_settings_set_boolean (settings, GPM_SETTINGS_INFO_HISTORY_GRAPH_SMOOTH, checked);
+	/* the statistics are fetched again, from the history this time */
 	gpm_stats_button_update_ui ();
 }
 
 /**
- * gpm_stats_smooth_checkbox_stats_cb:
+ * gpm_stats_points_checkbox_history_cb:
  * @widget: The GtkWidget object
  **/
 static void
-gpm_stats_smooth_checkbox_stats_cb (GtkWidget *widget, gpointer data)
+gpm_stats_points_checkbox_history_cb (GtkWidget *widget, gpointer data)
 {
 	gboolean checked;
 	checked = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (widget));
-	g_settings_set_boolean (settings, GPM_SETTINGS_INFO_STATS_GRAPH_SMOOTH, checked);
+	g_settings_set_boolean (settings, GPM_SETTINGS_INFO_HISTORY_GRAPH_POINTS, checked);
 	gpm_stats_button_update_ui ();
 }
 
 /**
- * gpm_stats_points_checkbox_history_cb:
+ * gpm_stats_compare_checkbox_history_cb:
  * @widget: The GtkWidget object
  **/
 static void
-gpm_stats_points_checkbox_history_cb (GtkWidget *widget, gpointer data)
+gpm_stats_compare_checkbox_history_cb (GtkWidget *widget, gpointer data)
 {
-	gboolean checked;
-	checked = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (widget));
-	g_settings_set_boolean (settings, GPM_SETTINGS_INFO_HISTORY_GRAPH_POINTS, checked);
+	GtkTreeSelection *selection;
+	GpmGraph *graph = gpm_graph_widget_get_graph (GPM_GRAPH_WIDGET (graph_history));
+
+	history_compare = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (widget));
+
+	/* the legend says which line is which device */
+	gpm_graph_key_data_clear (graph);
+	if (!history_compare)
+		gpm_stats_add_history_keys ();
+	g_object_set (graph, "use-legend", history_compare, NULL);
+
+	widget = GTK_WIDGET (gtk_builder_get_object (builder, "treeview_devices"));
+	selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (widget));
+	gtk_tree_selection_set_mode (selection, history_compare ? GTK_SELECTION_MULTIPLE : GTK_SELECTION_SINGLE);
+
 	gpm_stats_button_update_ui ();
 }
 
@@ -1823,6 +3941,7 @@ gpm_stats_commandline_cb (GApplication *application,
 	/* TRANSLATORS: the program name */
 	g_option_context_set_summary (context, _("Power Statistics"));
 	g_option_context_add_main_entries (context, options, NULL);
+	gpm_stats_add_option_entries (context);
 	ret = g_option_context_parse (context, &argc, &argv, NULL);
 	if (!ret)
 		goto out;
@@ -1832,7 +3951,11 @@ gpm_stats_commandline_cb (GApplication *application,
 		last_device = g_settings_get_string (settings, GPM_SETTINGS_INFO_LAST_DEVICE);
 
 	/* set the correct focus on the last device */
-	if (last_device != NULL) {
+	if (last_device != NULL && !coldplug_done) {
+		/* we don't know about any devices yet */
+		g_free (coldplug_device);
+		coldplug_device = last_device;
+	} else if (last_device != NULL) {
 		ret = gpm_stats_highlight_device (last_device);
 		if (!ret)
 			g_warning ("failed to select");
@@ -1848,6 +3971,132 @@ out:
 	return ret;
 }
 
+/**
+ * gpm_stats_coldplug_done:
+ *
+ * Fills in the device list once we know the properties of all the devices.
+ **/
+static void
+gpm_stats_coldplug_done (void)
+{
+	gboolean ret;
+	gint64 trace;
+	GIcon *icon;
+	GList *devices;
+	GList *l;
+	GtkTreeIter iter;
+	guint j;
+	UpDevice *device;
+	UpDevice *first = NULL;
+	UpDeviceKind kind;
+
+	coldplug_done = TRUE;
+	trace = gpm_trace_begin ();
+	devices = g_hash_table_get_values (device_table);
+
+	/* add devices in visually pleasing order */
+	for (j=0; j<UP_DEVICE_KIND_LAST; j++) {
+		for (l=devices; l != NULL; l=l->next) {
+			device = UP_DEVICE (l->data);
+			g_object_get (device, "kind", &kind, NULL);
+			if (kind != j)
+				continue;
+			gpm_stats_add_device (device);
+			if (first == NULL)
+				first = device;
+		}
+	}
+
+	gpm_trace_end (trace, "startup", "AddDevices");
+
+	/* has capability to measure wakeups */
+	trace = gpm_trace_begin ();
+	ret = up_wakeups_get_has_capability (wakeups);
+	gpm_trace_end (trace, "dbus", "GetHasCapability");
+	if (ret) {
+		icon = g_themed_icon_new ("computer");
+		gtk_list_store_append (list_store_devices, &iter);
+		gtk_list_store_set (list_store_devices, &iter,
+				    GPM_DEVICES_COLUMN_ID, "wakeups",
+				    /* TRANSLATORS: the icon for the CPU */
+				    GPM_DEVICES_COLUMN_TEXT, _("Processor"),
+				    GPM_DEVICES_COLUMN_ICON, icon, -1);
+		g_object_unref (icon);
+	}
+
+	/* set current device, unless one was asked for */
+	ret = FALSE;
+	if (coldplug_device != NULL) {
+		ret = gpm_stats_highlight_device (coldplug_device);
+		if (!ret)
+			g_warning ("failed to select");
+	}
+	if (!ret && first != NULL) {
+		trace = gpm_trace_begin ();
+		gpm_stats_update_info_data (first);
+		current_device = g_strdup (gpm_stats_device_get_object_path (first));
+		gpm_trace_end (trace, "startup", "SelectDevice");
+	}
+
+	g_list_free (devices);
+	g_free (coldplug_device);
+	coldplug_device = NULL;
+}
+
+/**
+ * gpm_stats_coldplug_enumerate_cb:
+ **/
+static void
+gpm_stats_coldplug_enumerate_cb (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+	const gchar *object_path;
+	GError *error = NULL;
+	GVariant *reply;
+	GVariantIter *iter;
+
+	reply = g_task_propagate_pointer (G_TASK (res), &error);
+	if (reply == NULL) {
+		g_warning ("failed to get devices: %s", error->message);
+		g_error_free (error);
+		gpm_stats_coldplug_done ();
+		return;
+	}
+
+	/* the devices are added once all their properties are back */
+	g_variant_get (reply, "(ao)", &iter);
+	while (g_variant_iter_next (iter, "&o", &object_path)) {
+		coldplug_pending++;
+		gpm_stats_device_fetch (object_path, GPM_STATS_DEVICE_COLDPLUG);
+	}
+	g_variant_iter_free (iter);
+	g_variant_unref (reply);
+	if (coldplug_pending == 0)
+		gpm_stats_coldplug_done ();
+}
+
+/**
+ * gpm_stats_coldplug_idle_cb:
+ *
+ * Asks for the devices once the window has been drawn. Nothing here waits
+ * for upowerd, so the window can still be drawn while the replies come in.
+ **/
+static gboolean
+gpm_stats_coldplug_idle_cb (gpointer user_data)
+{
+	/* watch before asking, so no change is missed */
+	if (connection != NULL) {
+		g_dbus_connection_signal_subscribe (connection, GPM_STATS_UPOWER_SERVICE,
+						    GPM_STATS_UPOWER_INTERFACE, NULL,
+						    GPM_STATS_UPOWER_PATH, NULL,
+						    G_DBUS_SIGNAL_FLAGS_NONE,
+						    gpm_stats_upower_signal_cb, NULL, NULL);
+	}
+	gpm_stats_dbus_call (GPM_STATS_UPOWER_PATH, GPM_STATS_UPOWER_INTERFACE,
+			     "EnumerateDevices", NULL, G_VARIANT_TYPE ("(ao)"), NULL,
+			     gpm_stats_coldplug_enumerate_cb, NULL);
+	return FALSE;
+}
+
 /**
  * gpm_stats_startup_cb:
  **/
@@ -1859,30 +4108,39 @@ gpm_stats_startup_cb (GApplication *application,
 	GtkWidget *widget;
 	GtkWindow *window;
 	GtkTreeSelection *selection;
-	gboolean ret;
-	UpClient *client;
-	GPtrArray *devices;
-	UpDevice *device;
-	UpDeviceKind kind;
-	guint i, j;
+	gint64 trace;
 	gint page;
 	gboolean checked;
 	guint retval;
 	GError *error = NULL;
 
 	/* get UI */
+	trace = gpm_trace_begin ();
 	builder = gtk_builder_new ();
 	retval = gtk_builder_add_from_resource (builder,
 						"/org/gnome/power-manager/gpm-statistics.ui",
 						&error);
 	if (retval == 0) {
 		g_warning ("failed to load ui: %s", error->message);
-		g_error_free (error);
+		g_clear_error (&error);
 	}
+	gpm_trace_end (trace, "startup", "LoadUi");
+	trace = gpm_trace_begin ();
 
 	/* add history graph */
 	box = GTK_BOX (gtk_builder_get_object (builder, "hbox_history"));
 	graph_history = gpm_graph_widget_new ();
+	g_object_set (graph_history,
+		      "use-viewport", TRUE,
+		      "use-hover", TRUE,
+		      "use-animation", TRUE,
+		      "show-render-stats", show_render_stats,
+		      NULL);
+	g_object_set (gpm_graph_widget_get_graph (GPM_GRAPH_WIDGET (graph_history)),
+		      "use-raster", fast_render,
+		      NULL);
+
+	gpm_stats_add_history_keys ();
 	gtk_box_pack_start (box, graph_history, TRUE, TRUE, 0);
 	gtk_widget_set_size_request (graph_history, 400, 250);
 	gtk_widget_show (graph_history);
@@ -1890,6 +4148,13 @@ gpm_stats_startup_cb (GApplication *application,
 	/* add statistics graph */
 	box = GTK_BOX (gtk_builder_get_object (builder, "hbox_statistics"));
 	graph_statistics = gpm_graph_widget_new ();
+	g_object_set (graph_statistics,
+		      "use-hover", TRUE,
+		      "show-render-stats", show_render_stats,
+		      NULL);
+	g_object_set (gpm_graph_widget_get_graph (GPM_GRAPH_WIDGET (graph_statistics)),
+		      "use-raster", fast_render,
+		      NULL);
 	gtk_box_pack_start (box, graph_statistics, TRUE, TRUE, 0);
 	gtk_widget_set_size_request (graph_statistics, 400, 250);
 	gtk_widget_show (graph_statistics);
@@ -1928,6 +4193,10 @@ gpm_stats_startup_cb (GApplication *application,
 	g_signal_connect (widget, "clicked",
 			  G_CALLBACK (gpm_stats_points_checkbox_history_cb), NULL);
 
+	widget = GTK_WIDGET (gtk_builder_get_object (builder, "checkbutton_compare_history"));
+	g_signal_connect (widget, "clicked",
+			  G_CALLBACK (gpm_stats_compare_checkbox_history_cb), NULL);
+
 	widget = GTK_WIDGET (gtk_builder_get_object (builder, "checkbutton_points_stats"));
 	checked = g_settings_get_boolean (settings, GPM_SETTINGS_INFO_STATS_GRAPH_POINTS);
 	gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (widget), checked);
@@ -1977,10 +4246,8 @@ gpm_stats_startup_cb (GApplication *application,
 	gpm_stats_add_wakeups_columns (GTK_TREE_VIEW (widget));
 	gtk_tree_view_columns_autosize (GTK_TREE_VIEW (widget)); /* show */
 
-	history_type = g_settings_get_string (settings, GPM_SETTINGS_INFO_HISTORY_TYPE);
+	history_type = gpm_stats_get_saved_history_type ();
 	history_time = g_settings_get_int (settings, GPM_SETTINGS_INFO_HISTORY_TIME);
-	if (history_type == NULL)
-		history_type = GPM_HISTORY_CHARGE_VALUE;
 	if (history_time == 0)
 		history_time = GPM_HISTORY_HOUR_VALUE;
 
@@ -1996,7 +4263,7 @@ gpm_stats_startup_cb (GApplication *application,
 	if (g_strcmp0 (history_type, GPM_HISTORY_RATE_VALUE) == 0)
 		gtk_combo_box_set_active (GTK_COMBO_BOX (widget), 0);
 	else
-		gtk_combo_box_set_active (GTK_COMBO_BOX (widget), 1);
+		gtk_combo_box_set_active (GTK_COMBO_BOX (widget), GPM_HISTORY_CHARGE_INDEX);
 	g_signal_connect (G_OBJECT (widget), "changed",
 			  G_CALLBACK (gpm_stats_history_type_combo_changed_cb), NULL);
 
@@ -2019,67 +4286,42 @@ gpm_stats_startup_cb (GApplication *application,
 			  G_CALLBACK (gpm_stats_type_combo_changed_cb), NULL);
 
 	widget = GTK_WIDGET (gtk_builder_get_object (builder, "combobox_history_time"));
+	gtk_combo_box_text_append_text (GTK_COMBO_BOX_TEXT (widget), GPM_HISTORY_LIVE_TEXT);
 	gtk_combo_box_text_append_text (GTK_COMBO_BOX_TEXT (widget), GPM_HISTORY_MINUTE_TEXT);
 	gtk_combo_box_text_append_text (GTK_COMBO_BOX_TEXT (widget), GPM_HISTORY_HOUR_TEXT);
 	gtk_combo_box_text_append_text (GTK_COMBO_BOX_TEXT (widget), GPM_HISTORY_HOURS_TEXT);
 	gtk_combo_box_text_append_text (GTK_COMBO_BOX_TEXT (widget), GPM_HISTORY_DAY_TEXT);
 	gtk_combo_box_text_append_text (GTK_COMBO_BOX_TEXT (widget), GPM_HISTORY_WEEK_TEXT);
-	gtk_combo_box_set_active (GTK_COMBO_BOX (widget), 1);
+	gtk_combo_box_set_active (GTK_COMBO_BOX (widget), 2);
 	if (history_time == GPM_HISTORY_MINUTE_VALUE)
-		gtk_combo_box_set_active (GTK_COMBO_BOX (widget), 0);
-	else if (history_time == GPM_HISTORY_HOUR_VALUE)
 		gtk_combo_box_set_active (GTK_COMBO_BOX (widget), 1);
-	else
+	else if (history_time == GPM_HISTORY_HOUR_VALUE)
 		gtk_combo_box_set_active (GTK_COMBO_BOX (widget), 2);
+	else
+		gtk_combo_box_set_active (GTK_COMBO_BOX (widget), 3);
 	g_signal_connect (G_OBJECT (widget), "changed",
 			  G_CALLBACK (gpm_stats_range_combo_changed), NULL);
 
 	wakeups = up_wakeups_new ();
 	g_signal_connect (wakeups, "data-changed", G_CALLBACK (gpm_stats_data_changed_cb), NULL);
 
-	/* coldplug */
-	client = up_client_new ();
-	ret = up_client_enumerate_devices_sync (client, NULL, NULL);
-	if (!ret)
-		goto out;
-	devices = up_client_get_devices (client);
-	g_signal_connect (client, "device-added", G_CALLBACK (gpm_stats_device_added_cb), NULL);
-	g_signal_connect (client, "device-removed", G_CALLBACK (gpm_stats_device_removed_cb), NULL);
-	g_signal_connect (client, "device-changed", G_CALLBACK (gpm_stats_device_changed_cb), NULL);
-
-	/* add devices in visually pleasing order */
-	for (j=0; j<UP_DEVICE_KIND_LAST; j++) {
-		for (i=0; i < devices->len; i++) {
-			device = g_ptr_array_index (devices, i);
-			g_object_get (device, "kind", &kind, NULL);
-			if (kind == j)
-				gpm_stats_add_device (device);
-		}
-	}
-
-	/* set current device */
-	if (devices->len > 0) {
-		device = g_ptr_array_index (devices, 0);
-		gpm_stats_update_info_data (device);
-		current_device = g_strdup (up_device_get_object_path (device));
+	/* the devices, history and statistics are fetched without upower-glib */
+	connection = g_bus_get_sync (G_BUS_TYPE_SYSTEM, NULL, &error);
+	if (connection == NULL) {
+		g_warning ("failed to connect to the system bus: %s", error->message);
+		g_clear_error (&error);
 	}
 
-	/* has capability to measure wakeups */
-	ret = up_wakeups_get_has_capability (wakeups);
-	if (ret) {
-		GtkTreeIter iter;
-		GIcon *icon;
-		icon = g_themed_icon_new ("computer");
-		gtk_list_store_append (list_store_devices, &iter);
-		gtk_list_store_set (list_store_devices, &iter,
-				    GPM_DEVICES_COLUMN_ID, "wakeups",
-				    /* TRANSLATORS: the icon for the CPU */
-				    GPM_DEVICES_COLUMN_TEXT, _("Processor"),
-				    GPM_DEVICES_COLUMN_ICON, icon, -1);
-		g_object_unref (icon);
-	}
+	live_data = g_hash_table_new_full (g_str_hash, g_str_equal,
+					   g_free, (GDestroyNotify) gpm_stats_live_free);
+	device_table = g_hash_table_new_full (g_str_hash, g_str_equal,
+					      g_free, g_object_unref);
 
-	g_ptr_array_unref (devices);
+	/* there's no checkbox for this, but it can be changed while open */
+	g_signal_connect (settings, "changed::" GPM_SETTINGS_INFO_GRAPH_MEDIAN,
+			  G_CALLBACK (gpm_stats_median_changed_cb), NULL);
+	g_signal_connect (settings, "changed::" GPM_SETTINGS_INFO_STATS_GRAPH_DENSITY,
+			  G_CALLBACK (gpm_stats_density_changed_cb), NULL);
 
 	/* set axis */
 	widget = GTK_WIDGET (gtk_builder_get_object (builder, "combobox_history_type"));
@@ -2087,10 +4329,295 @@ gpm_stats_startup_cb (GApplication *application,
 	widget = GTK_WIDGET (gtk_builder_get_object (builder, "combobox_stats_type"));
 	gpm_stats_type_combo_changed_cb (widget, NULL);
 
+	gpm_trace_end (trace, "startup", "SetupUi");
+
+	/* show the window before we know about any devices */
+	trace = gpm_trace_begin ();
 	widget = GTK_WIDGET (gtk_builder_get_object (builder, "dialog_stats"));
 	gtk_widget_show (widget);
+	gpm_trace_end (trace, "startup", "ShowWindow");
+
+	/* coldplug once the window has been drawn */
+	g_idle_add_full (G_PRIORITY_DEFAULT_IDLE, gpm_stats_coldplug_idle_cb,
+			 NULL, NULL);
+}
+
+/**
+ * gpm_stats_get_render_device:
+ *
+ * Return value: the object path of the first device that has the data we
+ * want to render, or %NULL
+ **/
+static gchar *
+gpm_stats_get_render_device (gboolean is_history)
+{
+	gboolean ret;
+	gboolean has_data;
+	gchar *object_path = NULL;
+	gint64 trace;
+	guint i;
+	GPtrArray *devices = NULL;
+	UpClient *client;
+	UpDevice *device;
+
+	client = up_client_new ();
+	trace = gpm_trace_begin ();
+	ret = up_client_enumerate_devices_sync (client, NULL, NULL);
+	gpm_trace_end (trace, "dbus", "EnumerateDevices");
+	if (!ret)
+		goto out;
+	devices = up_client_get_devices (client);
+	for (i=0; i < devices->len && object_path == NULL; i++) {
+		device = g_ptr_array_index (devices, i);
+		g_object_get (device,
+			      is_history ? "has-history" : "has-statistics", &has_data,
+			      NULL);
+		if (has_data)
+			object_path = g_strdup (up_device_get_object_path (device));
+	}
+	g_ptr_array_unref (devices);
 out:
 	g_object_unref (client);
+	return object_path;
+}
+
+/**
+ * gpm_stats_render_graph:
+ * @device_id: The device object path, or %NULL to use the last device
+ *
+ * Draws the history or statistics graph into render_filename using the
+ * same data and drawing code as the window. No widgets are made, so this
+ * works without a display.
+ *
+ * Return value: %TRUE for success
+ **/
+static gboolean
+gpm_stats_render_graph (const gchar *device_id)
+{
+	gboolean ret = FALSE;
+	gboolean is_history = TRUE;
+	gboolean use_data = FALSE;
+	gboolean use_density = FALSE;
+	const gchar *type;
+	gboolean is_svg;
+	gboolean checked;
+	gboolean points;
+	gchar *object_path = NULL;
+	cairo_status_t status;
+	cairo_surface_t *surface = NULL;
+	cairo_t *cr;
+	GError *error = NULL;
+	GPtrArray *data = NULL;
+	GpmGraph *graph = NULL;
+	UpDevice *device = NULL;
+	GpmStatsSmoothJob *job;
+
+	/* get the graph type, defaulting to what the window shows */
+	history_time = g_settings_get_int (settings, GPM_SETTINGS_INFO_HISTORY_TIME);
+	if (history_time == 0)
+		history_time = GPM_HISTORY_HOUR_VALUE;
+	if (render_type == NULL)
+		render_type = g_strdup (gpm_stats_get_saved_history_type ());
+	if (g_strcmp0 (render_type, GPM_HISTORY_RATE_VALUE) == 0) {
+		history_type = GPM_HISTORY_RATE_VALUE;
+	} else if (g_strcmp0 (render_type, GPM_HISTORY_CHARGE_VALUE) == 0) {
+		history_type = GPM_HISTORY_CHARGE_VALUE;
+	} else if (g_strcmp0 (render_type, GPM_HISTORY_TIME_FULL_VALUE) == 0) {
+		history_type = GPM_HISTORY_TIME_FULL_VALUE;
+	} else if (g_strcmp0 (render_type, GPM_HISTORY_TIME_EMPTY_VALUE) == 0) {
+		history_type = GPM_HISTORY_TIME_EMPTY_VALUE;
+	} else if (g_strcmp0 (render_type, GPM_STATS_CHARGE_DATA_VALUE) == 0) {
+		stats_type = GPM_STATS_CHARGE_DATA_VALUE;
+		is_history = FALSE;
+	} else if (g_strcmp0 (render_type, GPM_STATS_CHARGE_ACCURACY_VALUE) == 0) {
+		stats_type = GPM_STATS_CHARGE_ACCURACY_VALUE;
+		is_history = FALSE;
+	} else if (g_strcmp0 (render_type, GPM_STATS_DISCHARGE_DATA_VALUE) == 0) {
+		stats_type = GPM_STATS_DISCHARGE_DATA_VALUE;
+		is_history = FALSE;
+	} else if (g_strcmp0 (render_type, GPM_STATS_DISCHARGE_ACCURACY_VALUE) == 0) {
+		stats_type = GPM_STATS_DISCHARGE_ACCURACY_VALUE;
+		is_history = FALSE;
+	} else {
+		g_warning ("graph type '%s' not recognised", render_type);
+		goto out;
+	}
+
+	/* get the device, defaulting to the last one shown in the window */
+	if (device_id != NULL)
+		object_path = g_strdup (device_id);
+	else
+		object_path = g_settings_get_string (settings, GPM_SETTINGS_INFO_LAST_DEVICE);
+	if (object_path == NULL || !g_str_has_prefix (object_path, "/")) {
+		g_free (object_path);
+		object_path = gpm_stats_get_render_device (is_history);
+	}
+	if (object_path == NULL) {
+		g_warning ("no device to render");
+		goto out;
+	}
+	device = up_device_new ();
+	ret = gpm_stats_device_set_object_path (device, object_path, NULL, &error);
+	if (!ret) {
+		g_warning ("failed to get device %s: %s", object_path, error->message);
+		g_error_free (error);
+		goto out;
+	}
+
+	/* build the series exactly like the history and statistics pages */
+	graph = gpm_graph_new ();
+	if (is_history) {
+		gpm_stats_set_history_graph_axes (graph);
+		data = gpm_stats_get_history_data (device, history_type, history_time);
+		checked = g_settings_get_boolean (settings, GPM_SETTINGS_INFO_HISTORY_GRAPH_SMOOTH);
+		points = g_settings_get_boolean (settings, GPM_SETTINGS_INFO_HISTORY_GRAPH_POINTS);
+	} else {
+		type = gpm_stats_get_stats_type (&use_data);
+		use_density = gpm_stats_get_stats_use_density (use_data);
+		gpm_stats_set_stats_graph_axes (graph, use_data, use_density);
+		if (use_density)
+			data = gpm_stats_get_density_data (device, type, GPM_STATS_DENSITY_TIME);
+		else
+			data = gpm_stats_get_stats_data (device, type, use_data);
+		checked = g_settings_get_boolean (settings, GPM_SETTINGS_INFO_STATS_GRAPH_SMOOTH);
+		points = g_settings_get_boolean (settings, GPM_SETTINGS_INFO_STATS_GRAPH_POINTS);
+	}
+	if (data == NULL) {
+		g_warning ("no %s data for %s", render_type, object_path);
+		ret = FALSE;
+		goto out;
+	}
+
+	/* there's no window to keep responsive */
+	job = gpm_stats_smooth_job_new (graph, is_history, checked, points);
+	job->use_density = use_density;
+	gpm_stats_smooth_job_add (job, data);
+	gpm_stats_smooth_job_process (job);
+	gpm_stats_smooth_job_done_cb (job);
+	gpm_stats_smooth_job_free (job);
+
+	/* choose the surface from the file extension */
+	is_svg = g_str_has_suffix (render_filename, ".svg");
+	if (is_svg) {
+#ifdef CAIRO_HAS_SVG_SURFACE
+		surface = cairo_svg_surface_create (render_filename, render_width, render_height);
+#else
+		g_warning ("SVG output is not supported by cairo");
+		ret = FALSE;
+		goto out;
+#endif
+	} else {
+		surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, render_width, render_height);
+	}
+	cr = cairo_create (surface);
+	gpm_graph_render (graph, cr, render_width, render_height);
+	cairo_destroy (cr);
+
+	/* write the file */
+	if (is_svg) {
+		cairo_surface_finish (surface);
+		status = cairo_surface_status (surface);
+	} else {
+		status = cairo_surface_write_to_png (surface, render_filename);
+	}
+	if (status != CAIRO_STATUS_SUCCESS) {
+		g_warning ("failed to write %s: %s", render_filename, cairo_status_to_string (status));
+		ret = FALSE;
+		goto out;
+	}
+	ret = TRUE;
+out:
+	if (surface != NULL)
+		cairo_surface_destroy (surface);
+	if (data != NULL)
+		g_ptr_array_unref (data);
+	if (graph != NULL)
+		g_object_unref (graph);
+	if (device != NULL)
+		g_object_unref (device);
+	g_free (object_path);
+	return ret;
+}
+
+/**
+ * gpm_stats_parse_render_options:
+ * @device_id: The returned device, or %NULL
+ *
+ * Looks for the options to render a graph or to save a trace before GTK
+ * needs a display. The real arguments are left untouched for GApplication.
+ *
+ * Return value: %TRUE if a graph should be rendered
+ **/
+static gboolean
+gpm_stats_parse_render_options (int argc, char *argv[], gchar **device_id)
+{
+	gchar **argv_copy;
+	gint argc_copy = argc;
+	GOptionContext *context;
+
+	const GOptionEntry options[] = {
+		{ "device", '\0', 0, G_OPTION_ARG_STRING, device_id, NULL, NULL },
+		{ NULL}
+	};
+
+	/* the parser removes the options it finds, so use a shallow copy */
+	argv_copy = g_new0 (gchar *, argc + 1);
+	memcpy (argv_copy, argv, sizeof (gchar *) * argc);
+
+	context = g_option_context_new (NULL);
+	g_option_context_set_ignore_unknown_options (context, TRUE);
+	g_option_context_set_help_enabled (context, FALSE);
+	g_option_context_add_main_entries (context, options, NULL);
+	gpm_stats_add_option_entries (context);
+	g_option_context_parse (context, &argc_copy, &argv_copy, NULL);
+	g_option_context_free (context);
+	g_free (argv_copy);
+
+	return render_filename != NULL;
+}
+
+/**
+ * gpm_stats_trace_stop:
+ **/
+static void
+gpm_stats_trace_stop (void)
+{
+	GError *error = NULL;
+
+	if (trace_filename == NULL)
+		return;
+	if (!gpm_trace_stop (&error)) {
+		g_warning ("failed to save trace: %s", error->message);
+		g_error_free (error);
+	}
+	g_free (trace_filename);
+	trace_filename = NULL;
+}
+
+/**
+ * gpm_stats_smooth_free:
+ **/
+static void
+gpm_stats_smooth_free (void)
+{
+	guint i;
+
+	/* let the worker give up on anything it was doing */
+	if (smooth_pool != NULL) {
+		gpm_stats_smooth_cancel (TRUE);
+		gpm_stats_smooth_cancel (FALSE);
+		g_thread_pool_free (smooth_pool, TRUE, TRUE);
+		smooth_pool = NULL;
+	}
+	gpm_stats_pipelines_free ();
+	gpm_filter_pipeline_free (live_pipeline);
+	live_pipeline = NULL;
+	for (i=0; i<G_N_ELEMENTS (smooth_spare); i++) {
+		if (smooth_spare[i] == NULL)
+			continue;
+		gpm_stats_smooth_job_free (smooth_spare[i]);
+		smooth_spare[i] = NULL;
+	}
 }
 
 /**
@@ -2100,6 +4627,8 @@ int
 main (int argc, char *argv[])
 {
 	GtkApplication *application;
+	gboolean ret;
+	gchar *device_id = NULL;
 	int status = 0;
 
 	setlocale (LC_ALL, "");
@@ -2110,11 +4639,28 @@ main (int argc, char *argv[])
 
 	g_type_init ();
 
-	gtk_init (&argc, &argv);
-
 	/* get data from gconf */
 	settings = g_settings_new (GPM_SETTINGS_SCHEMA);
 
+	/* just save the graph to a file, there may be no display */
+	ret = gpm_stats_parse_render_options (argc, argv, &device_id);
+	if (trace_filename != NULL)
+		gpm_trace_start (trace_filename);
+	if (ret) {
+		status = gpm_stats_render_graph (device_id) ? 0 : 1;
+		/* the worker can still be adding spans */
+		gpm_stats_smooth_free ();
+		gpm_stats_trace_stop ();
+		g_free (device_id);
+		g_free (render_filename);
+		g_free (render_type);
+		g_object_unref (settings);
+		return status;
+	}
+	g_free (device_id);
+
+	gtk_init (&argc, &argv);
+
 	/* are we already activated? */
 	application = gtk_application_new ("org.gnome.PowerManager.Statistics",
 					   G_APPLICATION_HANDLES_COMMAND_LINE);
@@ -2129,6 +4675,11 @@ main (int argc, char *argv[])
 
 	/* run */
 	status = g_application_run (G_APPLICATION (application), argc, argv);
+	/* the worker can still be adding spans */
+	gpm_stats_smooth_free ();
+	gpm_stats_trace_stop ();
+	if (connection != NULL)
+		g_object_unref (connection);
 
 	g_object_unref (settings);
 	g_object_unref (application);
@@ -0,0 +1,160 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2011 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+
+#include <unistd.h>
+#include <glib.h>
+
+#ifdef HAVE_SYSPROF
+#include <sysprof-capture.h>
+#endif
+
+#include "gpm-trace.h"
+
+/* the spans are saved as complete events in the Chrome trace format, which
+ * can be loaded into chrome://tracing or Perfetto */
+static GMutex trace_mutex;
+static GString *trace_events = NULL;
+static gchar *trace_filename = NULL;
+static gint trace_next_tid = 0;
+static GPrivate trace_tid;
+
+/**
+ * gpm_trace_start:
+ * @filename: the file to save the spans to when gpm_trace_stop() is called
+ **/
+void
+gpm_trace_start (const gchar *filename)
+{
+	g_return_if_fail (filename != NULL);
+
+	g_mutex_lock (&trace_mutex);
+	if (trace_events == NULL)
+		g_atomic_pointer_set (&trace_events, g_string_new (""));
+	g_free (trace_filename);
+	trace_filename = g_strdup (filename);
+	g_mutex_unlock (&trace_mutex);
+}
+
+/**
+ * gpm_trace_stop:
+ *
+ * Saves all the spans to the file, and stops recording.
+ *
+ * Return value: %FALSE if the file could not be written
+ **/
+gboolean
+gpm_trace_stop (GError **error)
+{
+	gboolean ret = TRUE;
+	gchar *data;
+
+	g_mutex_lock (&trace_mutex);
+	if (trace_events == NULL)
+		goto out;
+
+	/* the events are all followed by a comma, so remove the last one */
+	if (trace_events->len > 0)
+		g_string_truncate (trace_events, trace_events->len - 2);
+	data = g_strdup_printf ("{\"traceEvents\":[\n%s\n],\"displayTimeUnit\":\"ms\"}\n",
+				trace_events->str);
+	ret = g_file_set_contents (trace_filename, data, -1, error);
+	g_free (data);
+
+	g_string_free (trace_events, TRUE);
+	g_atomic_pointer_set (&trace_events, NULL);
+	g_free (trace_filename);
+	trace_filename = NULL;
+out:
+	g_mutex_unlock (&trace_mutex);
+	return ret;
+}
+
+/**
+ * gpm_trace_begin:
+ *
+ * Return value: the start of the span, or 0 if we're not tracing
+ **/
+gint64
+gpm_trace_begin (void)
+{
+#ifdef HAVE_SYSPROF
+	if (sysprof_collector_is_active ())
+		return g_get_monotonic_time ();
+#endif
+	/* not worth taking the lock on the fast path, and gpm_trace_end()
+	 * checks again under the lock in case we stopped in between */
+	if (g_atomic_pointer_get (&trace_events) == NULL)
+		return 0;
+	return g_get_monotonic_time ();
+}
+
+/**
+ * gpm_trace_get_tid:
+ *
+ * Return value: a small number for the thread, which is easier to read
+ * than a pointer
+ **/
+static gint
+gpm_trace_get_tid (void)
+{
+	gint tid;
+	tid = GPOINTER_TO_INT (g_private_get (&trace_tid));
+	if (tid == 0) {
+		tid = g_atomic_int_add (&trace_next_tid, 1) + 1;
+		g_private_set (&trace_tid, GINT_TO_POINTER (tid));
+	}
+	return tid;
+}
+
+/**
+ * gpm_trace_end:
+ * @begin: the value from gpm_trace_begin()
+ * @category: the kind of span, e.g. "dbus" or "draw"
+ * @name: the name of the span, which is not escaped
+ *
+ * Records the time since gpm_trace_begin() was called.
+ **/
+void
+gpm_trace_end (gint64 begin, const gchar *category, const gchar *name)
+{
+	gint64 end;
+
+	if (begin == 0)
+		return;
+	end = g_get_monotonic_time ();
+
+#ifdef HAVE_SYSPROF
+	sysprof_collector_mark (begin * 1000, (end - begin) * 1000, category, name, NULL);
+#endif
+
+	g_mutex_lock (&trace_mutex);
+	if (trace_events != NULL) {
+		g_string_append_printf (trace_events,
+					"{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\","
+					"\"ts\":%" G_GINT64_FORMAT ",\"dur\":%" G_GINT64_FORMAT ","
+					"\"pid\":%i,\"tid\":%i},\n",
+					name, category, begin, end - begin,
+					(gint) getpid (), gpm_trace_get_tid ());
+	}
+	g_mutex_unlock (&trace_mutex);
+}